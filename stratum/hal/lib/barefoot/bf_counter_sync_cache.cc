@@ -0,0 +1,81 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bf_counter_sync_cache.h"
+
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+CounterSyncCache::CounterSyncCache() : lock_(), sync_done_(), tables_() {}
+
+::util::Status CounterSyncCache::Synchronize(
+    int device, uint32 table_id, absl::Duration max_staleness,
+    absl::Duration timeout, const std::function<::util::Status()>& sync) {
+  const absl::Time request_time = absl::Now();
+  const absl::Time oldest_acceptable = request_time - max_staleness;
+  const absl::Time deadline = request_time + timeout;
+  std::shared_ptr<TableState> state;
+  {
+    absl::MutexLock l(&lock_);
+    auto& entry = tables_[std::make_pair(device, table_id)];
+    if (entry == nullptr) entry = std::make_shared<TableState>();
+    state = entry;
+    while (true) {
+      if (state->last_sync_start >= oldest_acceptable) {
+        return ::util::OkStatus();
+      }
+      if (!state->in_flight) break;
+      // A sync started after the oldest acceptable time can be joined. An
+      // older one has to complete before we can check again.
+      const bool join = state->in_flight_start >= oldest_acceptable;
+      const uint64 generation = state->generation;
+      while (state->generation == generation) {
+        if (sync_done_.WaitWithDeadline(&lock_, deadline) &&
+            state->generation == generation) {
+          return MAKE_ERROR(ERR_OPER_TIMEOUT)
+                 << "Timeout while waiting for the counters of table "
+                 << table_id << " to be synced.";
+        }
+      }
+      if (join) return state->last_status;
+    }
+    state->in_flight = true;
+    state->in_flight_start = absl::Now();
+    state->in_flight_invalidated = false;
+  }
+
+  ::util::Status status = sync();
+
+  absl::MutexLock l(&lock_);
+  state->in_flight = false;
+  ++state->generation;
+  state->last_status = status;
+  if (status.ok() && !state->in_flight_invalidated) {
+    state->last_sync_start = state->in_flight_start;
+  }
+  sync_done_.SignalAll();
+
+  return status;
+}
+
+void CounterSyncCache::Invalidate(int device, uint32 table_id) {
+  absl::MutexLock l(&lock_);
+  auto it = tables_.find(std::make_pair(device, table_id));
+  if (it == tables_.end()) return;
+  it->second->last_sync_start = absl::InfinitePast();
+  if (it->second->in_flight) it->second->in_flight_invalidated = true;
+}
+
+void CounterSyncCache::Clear() {
+  absl::MutexLock l(&lock_);
+  tables_.clear();
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,87 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BF_COUNTER_SYNC_CACHE_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BF_COUNTER_SYNC_CACHE_H_
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// Bookkeeping of the hardware-to-software counter syncs of BfRt tables. A
+// counter sync copies a whole table from the ASIC and is therefore expensive.
+// The cache makes sure that:
+//   - concurrent readers of the same table share a single in-flight sync, and
+//   - no sync is issued if the last one started less than a given staleness
+//     bound ago.
+// The class is thread-safe.
+class CounterSyncCache {
+ public:
+  CounterSyncCache();
+
+  // Makes sure the counters of the given table are at most max_staleness old,
+  // calling sync to synchronize them if needed. sync is called without any
+  // lock held and its status is shared with all callers which joined it.
+  // A zero max_staleness still coalesces concurrent callers, but only onto a
+  // sync which started after the call was made. Returns ERR_OPER_TIMEOUT if
+  // waiting for another caller's sync takes longer than timeout.
+  ::util::Status Synchronize(int device, uint32 table_id,
+                             absl::Duration max_staleness,
+                             absl::Duration timeout,
+                             const std::function<::util::Status()>& sync)
+      LOCKS_EXCLUDED(lock_);
+
+  // Forgets the last sync of the given table, e.g. after its counters were
+  // written.
+  void Invalidate(int device, uint32 table_id) LOCKS_EXCLUDED(lock_);
+
+  // Forgets all syncs, e.g. after a pipeline push.
+  void Clear() LOCKS_EXCLUDED(lock_);
+
+  // CounterSyncCache is neither copyable nor movable.
+  CounterSyncCache(const CounterSyncCache&) = delete;
+  CounterSyncCache& operator=(const CounterSyncCache&) = delete;
+
+ private:
+  // Sync state of a single table. Shared with the callers waiting on it, so
+  // that Clear() can drop it while a sync is in flight.
+  struct TableState {
+    // Start time of the last successful sync.
+    absl::Time last_sync_start = absl::InfinitePast();
+    // Whether a sync is running and when it was started.
+    bool in_flight = false;
+    absl::Time in_flight_start = absl::InfinitePast();
+    // Set by Invalidate() to keep the running sync from being cached.
+    bool in_flight_invalidated = false;
+    // Incremented whenever a sync completes, successful or not.
+    uint64 generation = 0;
+    // Result of the last completed sync.
+    ::util::Status last_status;
+  };
+
+  mutable absl::Mutex lock_;
+
+  // Signalled whenever a sync completes.
+  absl::CondVar sync_done_;
+
+  // Map from (device, BfRt table ID) to the sync state of the table.
+  absl::flat_hash_map<std::pair<int, uint32>, std::shared_ptr<TableState>>
+      tables_ GUARDED_BY(lock_);
+};
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BF_COUNTER_SYNC_CACHE_H_
@@ -0,0 +1,187 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bf_counter_sync_cache.h"
+
+#include <thread>  // NOLINT
+
+#include "absl/synchronization/notification.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+namespace {
+
+constexpr int kDevice = 0;
+constexpr uint32 kTableId = 33554433;
+constexpr absl::Duration kTimeout = absl::Seconds(10);
+
+// Counts the syncs.
+class FakeSync {
+ public:
+  FakeSync() : num_syncs_(0), status_() {}
+  std::function<::util::Status()> Get() {
+    return [this]() {
+      ++num_syncs_;
+      return status_;
+    };
+  }
+  int num_syncs() const { return num_syncs_; }
+  void set_status(const ::util::Status& status) { status_ = status; }
+
+ private:
+  int num_syncs_;
+  ::util::Status status_;
+};
+
+}  // namespace
+
+TEST(CounterSyncCacheTest, ZeroStalenessAlwaysSyncs) {
+  CounterSyncCache cache;
+  FakeSync sync;
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::ZeroDuration(),
+                              kTimeout, sync.Get()));
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::ZeroDuration(),
+                              kTimeout, sync.Get()));
+  EXPECT_EQ(2, sync.num_syncs());
+}
+
+TEST(CounterSyncCacheTest, RecentSyncIsReused) {
+  CounterSyncCache cache;
+  FakeSync sync;
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  EXPECT_EQ(1, sync.num_syncs());
+  // A caller asking for fresh counters still gets a sync.
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::ZeroDuration(),
+                              kTimeout, sync.Get()));
+  EXPECT_EQ(2, sync.num_syncs());
+}
+
+TEST(CounterSyncCacheTest, TablesAreSyncedIndependently) {
+  CounterSyncCache cache;
+  FakeSync sync;
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId + 1, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  EXPECT_OK(cache.Synchronize(kDevice + 1, kTableId, absl::Hours(1),
+                              kTimeout, sync.Get()));
+  EXPECT_EQ(3, sync.num_syncs());
+}
+
+TEST(CounterSyncCacheTest, InvalidateAndClearForceSync) {
+  CounterSyncCache cache;
+  FakeSync sync;
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  cache.Invalidate(kDevice, kTableId);
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  EXPECT_EQ(2, sync.num_syncs());
+  cache.Clear();
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  EXPECT_EQ(3, sync.num_syncs());
+}
+
+TEST(CounterSyncCacheTest, FailedSyncIsNotCached) {
+  CounterSyncCache cache;
+  FakeSync sync;
+  sync.set_status(::util::Status(StratumErrorSpace(), ERR_INTERNAL, "fail"));
+  ::util::Status status = cache.Synchronize(kDevice, kTableId, absl::Hours(1),
+                                            kTimeout, sync.Get());
+  EXPECT_EQ(ERR_INTERNAL, status.error_code());
+  sync.set_status(::util::OkStatus());
+  EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                              sync.Get()));
+  EXPECT_EQ(2, sync.num_syncs());
+}
+
+TEST(CounterSyncCacheTest, ConcurrentCallersShareInFlightSync) {
+  CounterSyncCache cache;
+  absl::Notification sync_started;
+  absl::Notification release_sync;
+  int num_syncs = 0;
+  auto blocking_sync = [&]() {
+    ++num_syncs;
+    sync_started.Notify();
+    release_sync.WaitForNotification();
+    return ::util::OkStatus();
+  };
+  std::thread first([&]() {
+    EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                                blocking_sync));
+  });
+  sync_started.WaitForNotification();
+  std::thread second([&]() {
+    EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                                blocking_sync));
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  release_sync.Notify();
+  first.join();
+  second.join();
+  EXPECT_EQ(1, num_syncs);
+}
+
+TEST(CounterSyncCacheTest, ZeroStalenessDoesNotJoinOlderSync) {
+  CounterSyncCache cache;
+  absl::Notification sync_started;
+  absl::Notification release_sync;
+  int num_syncs = 0;
+  auto blocking_sync = [&]() {
+    if (++num_syncs == 1) {
+      sync_started.Notify();
+      release_sync.WaitForNotification();
+    }
+    return ::util::OkStatus();
+  };
+  std::thread first([&]() {
+    EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::ZeroDuration(),
+                                kTimeout, blocking_sync));
+  });
+  sync_started.WaitForNotification();
+  std::thread second([&]() {
+    EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::ZeroDuration(),
+                                kTimeout, blocking_sync));
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  release_sync.Notify();
+  first.join();
+  second.join();
+  EXPECT_EQ(2, num_syncs);
+}
+
+TEST(CounterSyncCacheTest, WaitingForInFlightSyncTimesOut) {
+  CounterSyncCache cache;
+  absl::Notification sync_started;
+  absl::Notification release_sync;
+  std::thread first([&]() {
+    EXPECT_OK(cache.Synchronize(kDevice, kTableId, absl::Hours(1), kTimeout,
+                                [&]() {
+                                  sync_started.Notify();
+                                  release_sync.WaitForNotification();
+                                  return ::util::OkStatus();
+                                }));
+  });
+  sync_started.WaitForNotification();
+  FakeSync sync;
+  ::util::Status status =
+      cache.Synchronize(kDevice, kTableId, absl::Hours(1),
+                        absl::Milliseconds(10), sync.Get());
+  EXPECT_EQ(ERR_OPER_TIMEOUT, status.error_code());
+  EXPECT_EQ(0, sync.num_syncs());
+  release_sync.Notify();
+  first.join();
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,120 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BF_OBJECT_POOL_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BF_OBJECT_POOL_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "stratum/glue/integral_types.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// A thread-safe pool of heap objects, kept in one free list per key (e.g. a
+// BfRt table ID). Objects are handed out as unique_ptrs whose deleter puts them
+// back into the free list of their key instead of destroying them. The deleter
+// only holds a weak reference to the pool: objects may outlive the pool, in
+// which case they are destroyed normally. Dropping the pool is therefore the
+// way to invalidate all pooled objects, e.g. after a pipeline push.
+//
+// The pool does not reset objects, callers have to do that after Acquire().
+template <typename T>
+class ObjectPool : public std::enable_shared_from_this<ObjectPool<T>> {
+ public:
+  // Deleter of pooled objects, recycling them into the pool if it still
+  // exists. A default constructed Recycler deletes the object.
+  class Recycler {
+   public:
+    Recycler() : pool_(), key_(0) {}
+    Recycler(std::weak_ptr<ObjectPool> pool, uint32 key)
+        : pool_(std::move(pool)), key_(key) {}
+
+    void operator()(T* object) const {
+      std::unique_ptr<T> owned(object);
+      std::shared_ptr<ObjectPool> pool = pool_.lock();
+      if (pool != nullptr) pool->Recycle(key_, std::move(owned));
+    }
+
+   private:
+    std::weak_ptr<ObjectPool> pool_;
+    uint32 key_;
+  };
+
+  // A pooled object.
+  using Handle = std::unique_ptr<T, Recycler>;
+
+  // Creates a pool which keeps at most max_free_objects idle objects per key.
+  static std::shared_ptr<ObjectPool> Create(size_t max_free_objects) {
+    return std::shared_ptr<ObjectPool>(new ObjectPool(max_free_objects));
+  }
+
+  // Returns an idle object of the given key, or nullptr if there is none.
+  Handle Acquire(uint32 key) LOCKS_EXCLUDED(lock_) {
+    std::unique_ptr<T> object;
+    {
+      absl::MutexLock l(&lock_);
+      auto it = free_objects_.find(key);
+      if (it != free_objects_.end() && !it->second.empty()) {
+        object = std::move(it->second.back());
+        it->second.pop_back();
+      }
+    }
+    if (object == nullptr) return Handle(nullptr, Recycler());
+
+    return Adopt(key, std::move(object));
+  }
+
+  // Takes ownership of a newly allocated object, which is recycled under the
+  // given key once the returned handle is destroyed.
+  Handle Adopt(uint32 key, std::unique_ptr<T> object) {
+    return Handle(object.release(),
+                  Recycler(this->shared_from_this(), key));
+  }
+
+  // Number of idle objects of the given key.
+  size_t NumFreeObjects(uint32 key) const LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    auto it = free_objects_.find(key);
+    return it == free_objects_.end() ? 0 : it->second.size();
+  }
+
+  // ObjectPool is neither copyable nor movable.
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+ private:
+  // Private constructor. Use Create() to create an instance of this class.
+  explicit ObjectPool(size_t max_free_objects)
+      : lock_(), free_objects_(), max_free_objects_(max_free_objects) {}
+
+  // Takes back an object handed out under the given key.
+  void Recycle(uint32 key, std::unique_ptr<T> object) LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    std::vector<std::unique_ptr<T>>& free_list = free_objects_[key];
+    if (free_list.size() < max_free_objects_) {
+      free_list.push_back(std::move(object));
+    }
+    // Otherwise the object is destroyed when going out of scope.
+  }
+
+  mutable absl::Mutex lock_;
+
+  // Map from key to the idle objects of that key.
+  absl::flat_hash_map<uint32, std::vector<std::unique_ptr<T>>> free_objects_
+      GUARDED_BY(lock_);
+
+  const size_t max_free_objects_;
+};
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BF_OBJECT_POOL_H_
@@ -0,0 +1,77 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bf_object_pool.h"
+
+#include <memory>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+namespace {
+
+constexpr uint32 kTableId = 33554433;
+
+// Counts the live instances.
+class Object {
+ public:
+  Object() { ++num_live_objects_; }
+  ~Object() { --num_live_objects_; }
+  static int num_live_objects() { return num_live_objects_; }
+
+ private:
+  static int num_live_objects_;
+};
+
+int Object::num_live_objects_ = 0;
+
+}  // namespace
+
+TEST(ObjectPoolTest, ObjectsAreRecycledPerKey) {
+  auto pool = ObjectPool<Object>::Create(4);
+  EXPECT_EQ(nullptr, pool->Acquire(kTableId));
+  Object* raw_object;
+  {
+    auto object = pool->Adopt(kTableId, std::unique_ptr<Object>(new Object()));
+    raw_object = object.get();
+  }
+  EXPECT_EQ(1, Object::num_live_objects());
+  EXPECT_EQ(1, pool->NumFreeObjects(kTableId));
+  EXPECT_EQ(nullptr, pool->Acquire(kTableId + 1));
+
+  auto object = pool->Acquire(kTableId);
+  EXPECT_EQ(raw_object, object.get());
+  EXPECT_EQ(0, pool->NumFreeObjects(kTableId));
+  object.reset();
+  EXPECT_EQ(1, pool->NumFreeObjects(kTableId));
+}
+
+TEST(ObjectPoolTest, FreeListIsBounded) {
+  auto pool = ObjectPool<Object>::Create(1);
+  {
+    auto first = pool->Adopt(kTableId, std::unique_ptr<Object>(new Object()));
+    auto second = pool->Adopt(kTableId, std::unique_ptr<Object>(new Object()));
+    EXPECT_EQ(2, Object::num_live_objects());
+  }
+  EXPECT_EQ(1, pool->NumFreeObjects(kTableId));
+  EXPECT_EQ(1, Object::num_live_objects());
+  pool.reset();
+  EXPECT_EQ(0, Object::num_live_objects());
+}
+
+TEST(ObjectPoolTest, ObjectsMayOutliveThePool) {
+  auto pool = ObjectPool<Object>::Create(4);
+  auto object = pool->Adopt(kTableId, std::unique_ptr<Object>(new Object()));
+  pool.reset();
+  EXPECT_EQ(1, Object::num_live_objects());
+  object.reset();
+  EXPECT_EQ(0, Object::num_live_objects());
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,83 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bf_packet_buffer_pool.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+namespace {
+
+// The key of all the buffers in the ObjectPool.
+constexpr uint32 kBufferKey = 0;
+
+}  // namespace
+
+PacketBuffer::PacketBuffer() : data_() {}
+
+PacketBuffer::PacketBuffer(ObjectPool<std::string>::Handle data)
+    : data_(std::move(data)) {}
+
+PacketBuffer::PacketBuffer(const PacketBuffer& other) : data_() {
+  if (other.data_ != nullptr) *mutable_data() = *other.data_;
+}
+
+PacketBuffer& PacketBuffer::operator=(const PacketBuffer& other) {
+  if (this != &other) {
+    if (other.data_ != nullptr) {
+      *mutable_data() = *other.data_;
+    } else if (data_ != nullptr) {
+      data_->clear();
+    }
+  }
+  return *this;
+}
+
+const std::string& PacketBuffer::data() const {
+  static const std::string* const kEmpty = new std::string();
+  return data_ != nullptr ? *data_ : *kEmpty;
+}
+
+std::string* PacketBuffer::mutable_data() {
+  if (data_ == nullptr) {
+    data_ = ObjectPool<std::string>::Handle(
+        new std::string(), ObjectPool<std::string>::Recycler());
+  }
+  return data_.get();
+}
+
+PacketBufferPool::PacketBufferPool(size_t max_free_buffers,
+                                   size_t buffer_capacity)
+    : pool_(ObjectPool<std::string>::Create(max_free_buffers)),
+      buffer_capacity_(buffer_capacity) {}
+
+std::unique_ptr<PacketBufferPool> PacketBufferPool::Create(
+    size_t max_free_buffers, size_t buffer_capacity) {
+  return absl::WrapUnique(
+      new PacketBufferPool(max_free_buffers, buffer_capacity));
+}
+
+PacketBuffer PacketBufferPool::Acquire() {
+  ObjectPool<std::string>::Handle data = pool_->Acquire(kBufferKey);
+  if (data == nullptr) {
+    data = pool_->Adopt(kBufferKey, absl::make_unique<std::string>());
+  }
+  // The pool does not reset the recycled buffers.
+  data->clear();
+  if (data->capacity() < buffer_capacity_) data->reserve(buffer_capacity_);
+
+  return PacketBuffer(std::move(data));
+}
+
+size_t PacketBufferPool::NumFreeBuffers() const {
+  return pool_->NumFreeObjects(kBufferKey);
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
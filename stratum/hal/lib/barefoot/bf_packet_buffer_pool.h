@@ -0,0 +1,81 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BF_PACKET_BUFFER_POOL_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BF_PACKET_BUFFER_POOL_H_
+
+#include <memory>
+#include <string>
+
+#include "stratum/hal/lib/barefoot/bf_object_pool.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// A packet buffer. A buffer acquired from a PacketBufferPool hands its storage
+// back to the pool when it is destroyed or assigned to, so that packets can be
+// passed by move from the SDE callback to the packet I/O manager without a heap
+// allocation per packet. Copies are supported (Channel<T> requires them), but
+// allocate and do not belong to any pool.
+class PacketBuffer {
+ public:
+  // Creates an empty buffer which does not belong to any pool. Does not
+  // allocate until data is written to it.
+  PacketBuffer();
+
+  PacketBuffer(const PacketBuffer& other);
+  PacketBuffer& operator=(const PacketBuffer& other);
+  PacketBuffer(PacketBuffer&& other) noexcept = default;
+  PacketBuffer& operator=(PacketBuffer&& other) noexcept = default;
+
+  // Packet data. The capacity of the underlying string is kept across uses.
+  const std::string& data() const;
+  std::string* mutable_data();
+
+ private:
+  friend class PacketBufferPool;
+
+  explicit PacketBuffer(ObjectPool<std::string>::Handle data);
+
+  // The storage of the buffer, recycled by the pool it came from, if any.
+  // Null for an empty buffer which was never written to.
+  ObjectPool<std::string>::Handle data_;
+};
+
+// A thread-safe free list of packet buffers, backed by an ObjectPool. Buffers
+// are recycled with their capacity, so once the pool is warm no allocation
+// happens for packets up to the largest size seen so far. Buffers only hold a
+// weak reference to the pool and may outlive it.
+class PacketBufferPool {
+ public:
+  // Creates a pool which keeps at most max_free_buffers idle buffers, each
+  // new buffer reserving buffer_capacity bytes.
+  static std::unique_ptr<PacketBufferPool> Create(size_t max_free_buffers,
+                                                  size_t buffer_capacity);
+
+  // Returns an empty buffer, recycled if possible.
+  PacketBuffer Acquire();
+
+  // Number of idle buffers in the pool.
+  size_t NumFreeBuffers() const;
+
+  // PacketBufferPool is neither copyable nor movable.
+  PacketBufferPool(const PacketBufferPool&) = delete;
+  PacketBufferPool& operator=(const PacketBufferPool&) = delete;
+
+ private:
+  // Private constructor. Use Create() to create an instance of this class.
+  PacketBufferPool(size_t max_free_buffers, size_t buffer_capacity);
+
+  // The pool of buffer storage. All buffers use the same key.
+  const std::shared_ptr<ObjectPool<std::string>> pool_;
+
+  const size_t buffer_capacity_;
+};
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BF_PACKET_BUFFER_POOL_H_
@@ -13,6 +13,7 @@
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/barefoot/bf.pb.h"
+#include "stratum/hal/lib/barefoot/bf_packet_buffer_pool.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/utils.h"
 #include "stratum/lib/channel/channel.h"
@@ -160,16 +161,24 @@ class BfSdeInterface {
   virtual ::util::Status AddDevice(int device,
                                    const BfrtDeviceConfig& device_config) = 0;
 
+  // Updates the P4Info of a device added with AddDevice(), without reloading
+  // the pipeline. Only the mapping between P4Info and BfRt IDs is rebuilt, so
+  // the BfRt info and the binaries of the config must be the ones loaded.
+  virtual ::util::Status UpdateP4Info(
+      int device, const BfrtDeviceConfig& device_config) = 0;
+
   // Creates a new BfRt session.
   virtual ::util::StatusOr<std::shared_ptr<SessionInterface>>
   CreateSession() = 0;
 
-  // Allocates a new table key object.
+  // Allocates a new table key object. Implementations may recycle key objects
+  // of the same table, which are handed out reset. Callers should therefore
+  // drop keys once done with them, instead of keeping them around.
   virtual ::util::StatusOr<std::unique_ptr<TableKeyInterface>> CreateTableKey(
       int table_id) = 0;
 
   // Allocates a new table data object. Action id can be zero when not known or
-  // not applicable.
+  // not applicable. As for keys, data objects may be recycled.
   virtual ::util::StatusOr<std::unique_ptr<TableDataInterface>> CreateTableData(
       int table_id, int action_id) = 0;
 
@@ -264,9 +273,10 @@ class BfSdeInterface {
   virtual ::util::Status StopPacketIo(int device) = 0;
 
   // Registers a writer to be invoked when we receive a packet on the PCIe CPU
-  // port. There can only be one writer per device.
+  // port. There can only be one writer per device. Packets are handed over in
+  // pooled buffers, which are recycled once the reader drops them.
   virtual ::util::Status RegisterPacketReceiveWriter(
-      int device, std::unique_ptr<ChannelWriter<std::string>> writer) = 0;
+      int device, std::unique_ptr<ChannelWriter<PacketBuffer>> writer) = 0;
 
   // Unregisters the writer registered to this device by
   // RegisterPacketReceiveWriter().
@@ -362,7 +372,8 @@ class BfSdeInterface {
 
   // Reads the data from an indirect counter. The counter ID must be a
   // BfRt table ID, not P4Runtime. Timeout specifies the maximum time to wait
-  // for the counters to sync.
+  // for the counters to sync. The counters are not synced again if the last
+  // sync of the table started less than max_staleness ago.
   // TODO(max): figure out optional counter data API, see TotW#163
   virtual ::util::Status ReadIndirectCounter(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -370,7 +381,7 @@ class BfSdeInterface {
       std::vector<uint32>* counter_indices,
       std::vector<absl::optional<uint64>>* byte_counts,
       std::vector<absl::optional<uint64>>* packet_counts,
-      absl::Duration timeout) = 0;
+      absl::Duration timeout, absl::Duration max_staleness) = 0;
 
   // Updates a register at the given index in a table. The table ID must be a
   // BfRt table ID, not P4Runtime. Timeout specifies the maximum time to wait
@@ -484,6 +495,33 @@ class BfSdeInterface {
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, const TableKeyInterface* table_key) = 0;
 
+  // Inserts a batch of new entries into one table, using the key and data at
+  // the same index for each entry. The previous content of results is
+  // replaced by one status per entry, in order. An error is only returned if
+  // the batch could not be attempted at all, e.g. because the table does not
+  // exist. This saves the per-entry overhead of InsertTableEntry() when
+  // writing many entries.
+  virtual ::util::Status InsertTableEntries(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+      const std::vector<const TableDataInterface*>& table_datas,
+      std::vector<::util::Status>* results) = 0;
+
+  // Modifies a batch of existing entries of one table. Same as
+  // InsertTableEntries() otherwise.
+  virtual ::util::Status ModifyTableEntries(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+      const std::vector<const TableDataInterface*>& table_datas,
+      std::vector<::util::Status>* results) = 0;
+
+  // Deletes a batch of existing entries of one table. Same as
+  // InsertTableEntries() otherwise.
+  virtual ::util::Status DeleteTableEntries(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+      std::vector<::util::Status>* results) = 0;
+
   // Fetches an existing table entry for the given key. Fails if the table entry
   // does not exists.
   virtual ::util::Status GetTableEntry(
@@ -539,10 +577,12 @@ class BfSdeInterface {
       absl::Duration* max_timeout) = 0;
 
   // Synchronizes the driver cached counter values with the current hardware
-  // state for a given BfRt table.
+  // state for a given BfRt table. Concurrent callers share a single sync, and
+  // no sync is done if the last one started less than max_staleness ago.
   virtual ::util::Status SynchronizeCounters(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
-      uint32 table_id, absl::Duration timeout) = 0;
+      uint32 table_id, absl::Duration timeout,
+      absl::Duration max_staleness) = 0;
 
   // Returns the equivalent BfRt ID for the given P4RT ID.
   virtual ::util::StatusOr<uint32> GetBfRtId(uint32 p4info_id) const = 0;
@@ -68,6 +68,9 @@ class BfSdeMock : public BfSdeInterface {
   MOCK_METHOD2(AddDevice,
                ::util::Status(int device,
                               const BfrtDeviceConfig& device_config));
+  MOCK_METHOD2(UpdateP4Info,
+               ::util::Status(int device,
+                              const BfrtDeviceConfig& device_config));
   MOCK_METHOD0(CreateSession,
                ::util::StatusOr<std::shared_ptr<SessionInterface>>());
   MOCK_METHOD2(GetPortState, ::util::StatusOr<PortState>(int device, int port));
@@ -112,7 +115,7 @@ class BfSdeMock : public BfSdeInterface {
   MOCK_METHOD2(
       RegisterPacketReceiveWriter,
       ::util::Status(int device,
-                     std::unique_ptr<ChannelWriter<std::string>> writer));
+                     std::unique_ptr<ChannelWriter<PacketBuffer>> writer));
   MOCK_METHOD1(UnregisterPacketReceiveWriter, ::util::Status(int device));
   MOCK_METHOD2(
       RegisterDigestListWriter,
@@ -192,7 +195,7 @@ class BfSdeMock : public BfSdeInterface {
                      uint32 counter_id, int counter_index,
                      absl::optional<uint64> byte_count,
                      absl::optional<uint64> packet_count));
-  MOCK_METHOD8(
+  MOCK_METHOD9(
       ReadIndirectCounter,
       ::util::Status(int device,
                      std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -200,7 +203,7 @@ class BfSdeMock : public BfSdeInterface {
                      std::vector<uint32>* counter_indices,
                      std::vector<absl::optional<uint64>>* byte_counts,
                      std::vector<absl::optional<uint64>>* packet_counts,
-                     absl::Duration timeout));
+                     absl::Duration timeout, absl::Duration max_staleness));
   MOCK_METHOD5(
       WriteRegister,
       ::util::Status(int device,
@@ -304,6 +307,29 @@ class BfSdeMock : public BfSdeInterface {
       ::util::Status(int device,
                      std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      uint32 table_id, const TableKeyInterface* table_key));
+  MOCK_METHOD6(
+      InsertTableEntries,
+      ::util::Status(int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 table_id,
+                     const std::vector<const TableKeyInterface*>& table_keys,
+                     const std::vector<const TableDataInterface*>& table_datas,
+                     std::vector<::util::Status>* results));
+  MOCK_METHOD6(
+      ModifyTableEntries,
+      ::util::Status(int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 table_id,
+                     const std::vector<const TableKeyInterface*>& table_keys,
+                     const std::vector<const TableDataInterface*>& table_datas,
+                     std::vector<::util::Status>* results));
+  MOCK_METHOD5(
+      DeleteTableEntries,
+      ::util::Status(int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 table_id,
+                     const std::vector<const TableKeyInterface*>& table_keys,
+                     std::vector<::util::Status>* results));
   MOCK_METHOD5(
       GetTableEntry,
       ::util::Status(int device,
@@ -353,11 +379,12 @@ class BfSdeMock : public BfSdeInterface {
                      std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      uint32 table_id, std::vector<uint32>* digest_ids,
                      absl::Duration* max_timeout));
-  MOCK_METHOD4(
+  MOCK_METHOD5(
       SynchronizeCounters,
       ::util::Status(int device,
                      std::shared_ptr<BfSdeInterface::SessionInterface> session,
-                     uint32 table_id, absl::Duration timeout));
+                     uint32 table_id, absl::Duration timeout,
+                     absl::Duration max_staleness));
   MOCK_CONST_METHOD1(GetBfRtId, ::util::StatusOr<uint32>(uint32 p4info_id));
   MOCK_CONST_METHOD1(GetP4InfoId, ::util::StatusOr<uint32>(uint32 bfrt_id));
   MOCK_CONST_METHOD1(GetActionSelectorBfRtId,
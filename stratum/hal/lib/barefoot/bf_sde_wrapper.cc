@@ -53,6 +53,9 @@ namespace barefoot {
 
 constexpr absl::Duration BfSdeWrapper::kWriteTimeout;
 constexpr int32 BfSdeWrapper::kBfDefaultMtu;
+constexpr size_t BfSdeWrapper::kMaxFreePacketRxBuffers;
+constexpr size_t BfSdeWrapper::kPacketRxBufferCapacity;
+constexpr size_t BfSdeWrapper::kMaxFreeBfRtObjectsPerTable;
 constexpr int _PI_UPDATE_MAX_NAME_SIZE = 100;
 
 // Helper functions for dealing with the SDE API.
@@ -573,6 +576,52 @@ template <typename T>
   return ::util::OkStatus();
 }
 
+// Returns a key object of the given table, recycled from the pool if possible.
+// Recycled objects are reset before being returned.
+::util::StatusOr<BfRtTableKeyPool::Handle> AllocateTableKey(
+    const bfrt::BfRtTable* table, BfRtTableKeyPool* pool) {
+  bf_rt_id_t table_id;
+  RETURN_IF_BFRT_ERROR(table->tableIdGet(&table_id));
+  BfRtTableKeyPool::Handle table_key = pool->Acquire(table_id);
+  if (table_key) {
+    // On error the handle hands the object back to the pool.
+    RETURN_IF_BFRT_ERROR(table->keyReset(table_key.get()));
+    return table_key;
+  }
+  std::unique_ptr<bfrt::BfRtTableKey> new_table_key;
+  RETURN_IF_BFRT_ERROR(table->keyAllocate(&new_table_key));
+
+  return pool->Adopt(table_id, std::move(new_table_key));
+}
+
+// Returns a data object of the given table, recycled from the pool if
+// possible. Recycled objects are reset before being returned. Action id can be
+// zero when not known or not applicable.
+::util::StatusOr<BfRtTableDataPool::Handle> AllocateTableData(
+    const bfrt::BfRtTable* table, bf_rt_id_t action_id,
+    BfRtTableDataPool* pool) {
+  bf_rt_id_t table_id;
+  RETURN_IF_BFRT_ERROR(table->tableIdGet(&table_id));
+  BfRtTableDataPool::Handle table_data = pool->Acquire(table_id);
+  if (table_data) {
+    // On error the handle hands the object back to the pool.
+    if (action_id) {
+      RETURN_IF_BFRT_ERROR(table->dataReset(action_id, table_data.get()));
+    } else {
+      RETURN_IF_BFRT_ERROR(table->dataReset(table_data.get()));
+    }
+    return table_data;
+  }
+  std::unique_ptr<bfrt::BfRtTableData> new_table_data;
+  if (action_id) {
+    RETURN_IF_BFRT_ERROR(table->dataAllocate(action_id, &new_table_data));
+  } else {
+    RETURN_IF_BFRT_ERROR(table->dataAllocate(&new_table_data));
+  }
+
+  return pool->Adopt(table_id, std::move(new_table_data));
+}
+
 }  // namespace
 
 ::util::Status TableKey::SetExact(int id, const std::string& value) {
@@ -729,11 +778,11 @@ template <typename T>
 }
 
 ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableKeyInterface>>
-TableKey::CreateTableKey(const bfrt::BfRtInfo* bfrt_info_, int table_id) {
+TableKey::CreateTableKey(const bfrt::BfRtInfo* bfrt_info_,
+                         BfRtTableKeyPool* pool, int table_id) {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  ASSIGN_OR_RETURN(auto table_key, AllocateTableKey(table, pool));
   auto key = std::unique_ptr<BfSdeInterface::TableKeyInterface>(
       new TableKey(std::move(table_key)));
   return key;
@@ -962,16 +1011,12 @@ TableKey::CreateTableKey(const bfrt::BfRtInfo* bfrt_info_, int table_id) {
 }
 
 ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableDataInterface>>
-TableData::CreateTableData(const bfrt::BfRtInfo* bfrt_info_, int table_id,
+TableData::CreateTableData(const bfrt::BfRtInfo* bfrt_info_,
+                           BfRtTableDataPool* pool, int table_id,
                            int action_id) {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  if (action_id) {
-    RETURN_IF_BFRT_ERROR(table->dataAllocate(action_id, &table_data));
-  } else {
-    RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
-  }
+  ASSIGN_OR_RETURN(auto table_data, AllocateTableData(table, action_id, pool));
   auto data = std::unique_ptr<BfSdeInterface::TableDataInterface>(
       new TableData(std::move(table_data)));
   return data;
@@ -1073,7 +1118,16 @@ BfSdeWrapper* BfSdeWrapper::singleton_ = nullptr;
 ABSL_CONST_INIT absl::Mutex BfSdeWrapper::init_lock_(absl::kConstInit);
 
 BfSdeWrapper::BfSdeWrapper()
-    : port_status_event_writer_(nullptr), device_to_ppg_handles_() {}
+    : port_status_event_writer_(nullptr),
+      packet_rx_buffer_pool_(PacketBufferPool::Create(
+          kMaxFreePacketRxBuffers, kPacketRxBufferCapacity)),
+      counter_sync_cache_(),
+      device_to_ppg_handles_(),
+      bfrt_id_mapper_(nullptr),
+      bfrt_info_(nullptr),
+      table_key_pool_(BfRtTableKeyPool::Create(kMaxFreeBfRtObjectsPerTable)),
+      table_data_pool_(BfRtTableDataPool::Create(kMaxFreeBfRtObjectsPerTable)),
+      bfrt_device_manager_(nullptr) {}
 
 ::util::StatusOr<PortState> BfSdeWrapper::GetPortState(int device, int port) {
   int state;
@@ -1801,6 +1855,8 @@ std::string BfSdeWrapper::GetSdeVersion() const {
 
   bfrt_device_manager_ = &bfrt::BfRtDevMgr::getInstance();
   bfrt_id_mapper_.reset();
+  // Table IDs are only valid within a pipeline.
+  counter_sync_cache_.Clear();
 
   RETURN_IF_BFRT_ERROR(bf_pal_device_warm_init_begin(
       device, BF_DEV_WARM_INIT_FAST_RECFG, BF_DEV_SERDES_UPD_NONE,
@@ -1882,6 +1938,8 @@ std::string BfSdeWrapper::GetSdeVersion() const {
 
   RETURN_IF_BFRT_ERROR(bfrt_device_manager_->bfRtInfoGet(
       device, device_config.programs(0).name(), &bfrt_info_));
+  table_key_pool_ = BfRtTableKeyPool::Create(kMaxFreeBfRtObjectsPerTable);
+  table_data_pool_ = BfRtTableDataPool::Create(kMaxFreeBfRtObjectsPerTable);
 
   // FIXME: if all we ever do is create and push, this could be one call.
   bfrt_id_mapper_ = BfrtIdMapper::CreateInstance();
@@ -1891,6 +1949,21 @@ std::string BfSdeWrapper::GetSdeVersion() const {
   return ::util::OkStatus();
 }
 
+::util::Status BfSdeWrapper::UpdateP4Info(
+    int device, const BfrtDeviceConfig& device_config) {
+  absl::WriterMutexLock l(&data_lock_);
+  RET_CHECK(bfrt_info_) << "No pipeline loaded on device " << device << ".";
+  RET_CHECK(device_config.programs_size() > 0);
+
+  // The BfRt info stays valid, as the pipeline is not reloaded.
+  auto bfrt_id_mapper = BfrtIdMapper::CreateInstance();
+  RETURN_IF_ERROR(
+      bfrt_id_mapper->PushForwardingPipelineConfig(device_config, bfrt_info_));
+  bfrt_id_mapper_ = std::move(bfrt_id_mapper);
+
+  return ::util::OkStatus();
+}
+
 // Create and start an new session.
 ::util::StatusOr<std::shared_ptr<BfSdeInterface::SessionInterface>>
 BfSdeWrapper::CreateSession() {
@@ -1900,13 +1973,14 @@ BfSdeWrapper::CreateSession() {
 ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableKeyInterface>>
 BfSdeWrapper::CreateTableKey(int table_id) {
   ::absl::ReaderMutexLock l(&data_lock_);
-  return TableKey::CreateTableKey(bfrt_info_, table_id);
+  return TableKey::CreateTableKey(bfrt_info_, table_key_pool_.get(), table_id);
 }
 
 ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableDataInterface>>
 BfSdeWrapper::CreateTableData(int table_id, int action_id) {
   ::absl::ReaderMutexLock l(&data_lock_);
-  return TableData::CreateTableData(bfrt_info_, table_id, action_id);
+  return TableData::CreateTableData(bfrt_info_, table_data_pool_.get(),
+                                    table_id, action_id);
 }
 
 //  Packetio
@@ -1968,7 +2042,7 @@ BfSdeWrapper::CreateTableData(int table_id, int action_id) {
 }
 
 ::util::Status BfSdeWrapper::RegisterPacketReceiveWriter(
-    int device, std::unique_ptr<ChannelWriter<std::string>> writer) {
+    int device, std::unique_ptr<ChannelWriter<PacketBuffer>> writer) {
   absl::WriterMutexLock l(&packet_rx_callback_lock_);
   device_to_packet_rx_writer_[device] = std::move(writer);
   return ::util::OkStatus();
@@ -1987,13 +2061,15 @@ BfSdeWrapper::CreateTableData(int table_id, int action_id) {
   RET_CHECK(rx_writer) << "No Rx callback registered for device id " << device
                        << ".";
 
-  std::string buffer(reinterpret_cast<const char*>(bf_pkt_get_pkt_data(pkt)),
-                     bf_pkt_get_pkt_size(pkt));
-  ::util::Status status = (*rx_writer)->TryWrite(buffer);
+  PacketBuffer buffer = packet_rx_buffer_pool_->Acquire();
+  buffer.mutable_data()->assign(
+      reinterpret_cast<const char*>(bf_pkt_get_pkt_data(pkt)),
+      bf_pkt_get_pkt_size(pkt));
+  VLOG(1) << "Received " << buffer.data().size() << " byte packet from CPU "
+          << StringToHex(buffer.data());
+  ::util::Status status = (*rx_writer)->TryWrite(std::move(buffer));
   LOG_IF_EVERY_N(INFO, !status.ok(), 500)
       << "Dropped packet received from CPU: " << status;
-  VLOG(1) << "Received " << buffer.size() << " byte packet from CPU "
-          << StringToHex(buffer);
 
   return ::util::OkStatus();
 }
@@ -2211,10 +2287,10 @@ namespace {
   RETURN_IF_BFRT_ERROR(table->tableUsageGet(
       *real_session->bfrt_session_, bf_dev_tgt,
       bfrt::BfRtTable::BfRtTableGetFlag::GET_FROM_SW, &usage));
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
   uint32 id = usage;
   for (size_t _ = 0; _ < table_size; ++_) {
     // Key: $MULTICAST_NODE_ID
@@ -2249,10 +2325,10 @@ namespace {
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPreNodeTable, &table));
   RETURN_IF_BFRT_ERROR(table->tableIdGet(&table_id));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
 
   auto bf_dev_tgt = GetDeviceTarget(device);
 
@@ -2286,10 +2362,10 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPreMgidTable, &table));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
   // Key: $MGID
   RETURN_IF_ERROR(SetField(table_key.get(), kMgid, group_id));
   RETURN_IF_BFRT_ERROR(table->tableEntryGet(
@@ -2317,8 +2393,8 @@ namespace {
 
   // TODO(max): handle partial delete failures
   for (const auto& mc_node_id : mc_node_ids) {
-    std::unique_ptr<bfrt::BfRtTableKey> table_key;
-    RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+    ASSIGN_OR_RETURN(auto table_key,
+                     AllocateTableKey(table, table_key_pool_.get()));
     RETURN_IF_ERROR(SetField(table_key.get(), kMcNodeId, mc_node_id));
     RETURN_IF_BFRT_ERROR(table->tableEntryDel(*real_session->bfrt_session_,
                                               bf_dev_tgt, *table_key));
@@ -2344,10 +2420,10 @@ namespace {
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPreNodeTable, &table));
   RETURN_IF_BFRT_ERROR(table->tableIdGet(&table_id));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
   // Key: $MULTICAST_NODE_ID
   RETURN_IF_ERROR(SetField(table_key.get(), kMcNodeId, mc_node_id));
   RETURN_IF_BFRT_ERROR(table->tableEntryGet(
@@ -2379,10 +2455,10 @@ namespace {
   bf_rt_id_t table_id;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPreMgidTable, &table));
   RETURN_IF_BFRT_ERROR(table->tableIdGet(&table_id));
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
 
   std::vector<uint32> mc_node_list;
   std::vector<bool> l1_xid_valid_list;
@@ -2439,8 +2515,8 @@ namespace {
   auto bf_dev_tgt = GetDeviceTarget(device);
   const bfrt::BfRtTable* table;  // PRE MGID table.
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPreMgidTable, &table));
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
   // Key: $MGID
   RETURN_IF_ERROR(SetField(table_key.get(), kMgid, group_id));
   RETURN_IF_BFRT_ERROR(table->tableEntryDel(*real_session->bfrt_session_,
@@ -2512,12 +2588,12 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(
       bfrt_info_->bfrtTableFromNameGet(kMirrorConfigTable, &table));
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
   bf_rt_id_t action_id;
   RETURN_IF_BFRT_ERROR(table->actionIdGet("$normal", &action_id));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(action_id, &table_data));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, action_id, table_data_pool_.get()));
 
   // Key: $sid
   RETURN_IF_ERROR(SetField(table_key.get(), "$sid", session_id));
@@ -2579,12 +2655,12 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(
       bfrt_info_->bfrtTableFromNameGet(kMirrorConfigTable, &table));
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
   bf_rt_id_t action_id;
   RETURN_IF_BFRT_ERROR(table->actionIdGet("$normal", &action_id));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(action_id, &table_data));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, action_id, table_data_pool_.get()));
   // Key: $sid
   RETURN_IF_ERROR(SetField(table_key.get(), "$sid", session_id));
 
@@ -2686,10 +2762,10 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(counter_id, &table));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
 
   // Counter key: $COUNTER_INDEX
   RETURN_IF_ERROR(SetField(table_key.get(), kCounterIndex, counter_index));
@@ -2714,6 +2790,8 @@ namespace {
   auto bf_dev_tgt = GetDeviceTarget(device);
   RETURN_IF_BFRT_ERROR(table->tableEntryMod(
       *real_session->bfrt_session_, bf_dev_tgt, *table_key, *table_data));
+  // Written counters must not be served from the last sync.
+  counter_sync_cache_.Invalidate(device, counter_id);
 
   return ::util::OkStatus();
 }
@@ -2724,7 +2802,7 @@ namespace {
     std::vector<uint32>* counter_indices,
     std::vector<absl::optional<uint64>>* byte_counts,
     std::vector<absl::optional<uint64>>* packet_counts,
-    absl::Duration timeout) {
+    absl::Duration timeout, absl::Duration max_staleness) {
   RET_CHECK(counter_indices);
   RET_CHECK(byte_counts);
   RET_CHECK(packet_counts);
@@ -2738,7 +2816,8 @@ namespace {
   std::vector<std::unique_ptr<bfrt::BfRtTableKey>> keys;
   std::vector<std::unique_ptr<bfrt::BfRtTableData>> datums;
 
-  RETURN_IF_ERROR(DoSynchronizeCounters(device, session, counter_id, timeout));
+  RETURN_IF_ERROR(DoSynchronizeCounters(device, session, counter_id, timeout,
+                                        max_staleness));
 
   // Is this a wildcard read?
   if (counter_index) {
@@ -2834,10 +2913,10 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
 
   // Register data: <register_name>.f1
   // The current bf-p4c compiler emits the fully-qualified field name, including
@@ -2963,10 +3042,10 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
 
   // Meter data: $METER_SPEC_*
   if (in_pps) {
@@ -3132,8 +3211,8 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
 
   auto dump_args = [&]() -> std::string {
     return absl::StrCat(
@@ -3189,8 +3268,8 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
 
   auto dump_args = [&]() -> std::string {
     return absl::StrCat(
@@ -3249,8 +3328,9 @@ namespace {
     RETURN_IF_ERROR(GetField(*keys[i], kActionMemberId, &member_id));
     member_ids->push_back(member_id);
 
-    // Data: action params
-    auto td = absl::make_unique<TableData>(std::move(datums[i]));
+    // Data: action params. The data is recycled into the pool once released.
+    auto td = absl::make_unique<TableData>(
+        table_data_pool_->Adopt(table_id, std::move(datums[i])));
     table_datas->push_back(std::move(td));
   }
 
@@ -3271,10 +3351,10 @@ namespace {
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
 
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  std::unique_ptr<bfrt::BfRtTableData> table_data;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
-  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
+  ASSIGN_OR_RETURN(auto table_data,
+                   AllocateTableData(table, 0, table_data_pool_.get()));
 
   // We have to capture the std::unique_ptrs by reference [&] here.
   auto dump_args = [&]() -> std::string {
@@ -3342,8 +3422,8 @@ namespace {
 
   const bfrt::BfRtTable* table;
   RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
-  std::unique_ptr<bfrt::BfRtTableKey> table_key;
-  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  ASSIGN_OR_RETURN(auto table_key,
+                   AllocateTableKey(table, table_key_pool_.get()));
 
   auto dump_args = [&]() -> std::string {
     return absl::StrCat(
@@ -3465,6 +3545,8 @@ namespace {
       *real_session->bfrt_session_, bf_dev_tgt, *real_table_key->table_key_,
       *real_table_data->table_data_))
       << "Could not add table entry with: " << dump_args();
+  // The entry may carry direct counters.
+  counter_sync_cache_.Invalidate(device, table_id);
 
   return ::util::OkStatus();
 }
@@ -3498,6 +3580,7 @@ namespace {
       *real_session->bfrt_session_, bf_dev_tgt, *real_table_key->table_key_,
       *real_table_data->table_data_))
       << "Could not modify table entry with: " << dump_args();
+  counter_sync_cache_.Invalidate(device, table_id);
 
   return ::util::OkStatus();
 }
@@ -3524,6 +3607,111 @@ namespace {
   RETURN_IF_BFRT_ERROR(table->tableEntryDel(
       *real_session->bfrt_session_, bf_dev_tgt, *real_table_key->table_key_))
       << "Could not delete table entry with: " << dump_args();
+  counter_sync_cache_.Invalidate(device, table_id);
+
+  return ::util::OkStatus();
+}
+
+::util::Status BfSdeWrapper::InsertTableEntries(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+    const std::vector<const TableDataInterface*>& table_datas,
+    std::vector<::util::Status>* results) {
+  return WriteTableEntries(device, session, table_id,
+                           TableWriteOperation::kInsert, table_keys,
+                           table_datas, results);
+}
+
+::util::Status BfSdeWrapper::ModifyTableEntries(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+    const std::vector<const TableDataInterface*>& table_datas,
+    std::vector<::util::Status>* results) {
+  return WriteTableEntries(device, session, table_id,
+                           TableWriteOperation::kModify, table_keys,
+                           table_datas, results);
+}
+
+::util::Status BfSdeWrapper::DeleteTableEntries(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+    std::vector<::util::Status>* results) {
+  return WriteTableEntries(device, session, table_id,
+                           TableWriteOperation::kDelete, table_keys, {},
+                           results);
+}
+
+::util::Status BfSdeWrapper::WriteTableEntries(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 table_id, TableWriteOperation operation,
+    const std::vector<const TableKeyInterface*>& table_keys,
+    const std::vector<const TableDataInterface*>& table_datas,
+    std::vector<::util::Status>* results) {
+  RET_CHECK(results);
+  const bool has_data = operation != TableWriteOperation::kDelete;
+  RET_CHECK(!has_data || table_datas.size() == table_keys.size())
+      << "Got " << table_keys.size() << " keys and " << table_datas.size()
+      << " datas.";
+  ::absl::ReaderMutexLock l(&data_lock_);
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  const bfrt::BfRtTable* table;
+  RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
+  auto bf_dev_tgt = GetDeviceTarget(device);
+
+  auto write_entry = [&](size_t i) -> ::util::Status {
+    auto real_table_key = dynamic_cast<const TableKey*>(table_keys[i]);
+    RET_CHECK(real_table_key);
+    const TableData* real_table_data = nullptr;
+    if (has_data) {
+      real_table_data = dynamic_cast<const TableData*>(table_datas[i]);
+      RET_CHECK(real_table_data);
+    }
+
+    auto dump_args = [&]() -> std::string {
+      std::string args = absl::StrCat(
+          DumpTableMetadata(table).ValueOr("<error reading table>"), ", ",
+          DumpTableKey(real_table_key->table_key_.get())
+              .ValueOr("<error parsing key>"));
+      if (real_table_data) {
+        absl::StrAppend(&args, ", ",
+                        DumpTableData(real_table_data->table_data_.get())
+                            .ValueOr("<error parsing data>"));
+      }
+      return args;
+    };
+
+    switch (operation) {
+      case TableWriteOperation::kInsert:
+        RETURN_IF_BFRT_ERROR(table->tableEntryAdd(
+            *real_session->bfrt_session_, bf_dev_tgt,
+            *real_table_key->table_key_, *real_table_data->table_data_))
+            << "Could not add table entry with: " << dump_args();
+        break;
+      case TableWriteOperation::kModify:
+        RETURN_IF_BFRT_ERROR(table->tableEntryMod(
+            *real_session->bfrt_session_, bf_dev_tgt,
+            *real_table_key->table_key_, *real_table_data->table_data_))
+            << "Could not modify table entry with: " << dump_args();
+        break;
+      case TableWriteOperation::kDelete:
+        RETURN_IF_BFRT_ERROR(
+            table->tableEntryDel(*real_session->bfrt_session_, bf_dev_tgt,
+                                 *real_table_key->table_key_))
+            << "Could not delete table entry with: " << dump_args();
+        break;
+    }
+
+    return ::util::OkStatus();
+  };
+
+  results->clear();
+  results->reserve(table_keys.size());
+  for (size_t i = 0; i < table_keys.size(); ++i) {
+    results->push_back(write_entry(i));
+  }
+  // The entries may carry direct counters.
+  if (!table_keys.empty()) counter_sync_cache_.Invalidate(device, table_id);
 
   return ::util::OkStatus();
 }
@@ -3571,9 +3759,12 @@ namespace {
   table_keys->resize(0);
   table_datas->resize(0);
 
+  // The entries are recycled into the pools once released.
   for (size_t i = 0; i < keys.size(); ++i) {
-    auto tk = absl::make_unique<TableKey>(std::move(keys[i]));
-    auto td = absl::make_unique<TableData>(std::move(datums[i]));
+    auto tk = absl::make_unique<TableKey>(
+        table_key_pool_->Adopt(table_id, std::move(keys[i])));
+    auto td = absl::make_unique<TableData>(
+        table_data_pool_->Adopt(table_id, std::move(datums[i])));
     table_keys->push_back(std::move(tk));
     table_datas->push_back(std::move(td));
   }
@@ -3595,6 +3786,7 @@ namespace {
   auto bf_dev_tgt = GetDeviceTarget(device);
   RETURN_IF_BFRT_ERROR(table->tableDefaultEntrySet(
       *real_session->bfrt_session_, bf_dev_tgt, *real_table_data->table_data_));
+  counter_sync_cache_.Invalidate(device, table_id);
 
   return ::util::OkStatus();
 }
@@ -3611,6 +3803,7 @@ namespace {
   auto bf_dev_tgt = GetDeviceTarget(device);
   RETURN_IF_BFRT_ERROR(
       table->tableDefaultEntryReset(*real_session->bfrt_session_, bf_dev_tgt));
+  counter_sync_cache_.Invalidate(device, table_id);
 
   return ::util::OkStatus();
 }
@@ -3764,12 +3957,25 @@ namespace {
 
 ::util::Status BfSdeWrapper::SynchronizeCounters(
     int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
-    uint32 table_id, absl::Duration timeout) {
+    uint32 table_id, absl::Duration timeout, absl::Duration max_staleness) {
   ::absl::ReaderMutexLock l(&data_lock_);
-  return DoSynchronizeCounters(device, session, table_id, timeout);
+  return DoSynchronizeCounters(device, session, table_id, timeout,
+                               max_staleness);
 }
 
 ::util::Status BfSdeWrapper::DoSynchronizeCounters(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 table_id, absl::Duration timeout, absl::Duration max_staleness) {
+  return counter_sync_cache_.Synchronize(
+      device, table_id, max_staleness, timeout,
+      [this, device, session, table_id, timeout]()
+          SHARED_LOCKS_REQUIRED(data_lock_) {
+            return SyncCountersFromHardware(device, session, table_id,
+                                            timeout);
+          });
+}
+
+::util::Status BfSdeWrapper::SyncCountersFromHardware(
     int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
     uint32 table_id, absl::Duration timeout) {
   auto real_session = std::dynamic_pointer_cast<Session>(session);
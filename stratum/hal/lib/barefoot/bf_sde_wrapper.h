@@ -20,6 +20,8 @@
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/barefoot/bf_counter_sync_cache.h"
+#include "stratum/hal/lib/barefoot/bf_object_pool.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
 #include "stratum/hal/lib/barefoot/bfrt_id_mapper.h"
 #include "stratum/hal/lib/barefoot/macros.h"
@@ -34,9 +36,13 @@ namespace stratum {
 namespace hal {
 namespace barefoot {
 
+// Pools of BfRt table key and data objects, keyed by BfRt table ID.
+using BfRtTableKeyPool = ObjectPool<bfrt::BfRtTableKey>;
+using BfRtTableDataPool = ObjectPool<bfrt::BfRtTableData>;
+
 class TableKey : public BfSdeInterface::TableKeyInterface {
  public:
-  explicit TableKey(std::unique_ptr<bfrt::BfRtTableKey> table_key)
+  explicit TableKey(BfRtTableKeyPool::Handle table_key)
       : table_key_(std::move(table_key)) {}
 
   // TableKeyInterface public methods.
@@ -58,12 +64,14 @@ class TableKey : public BfSdeInterface::TableKeyInterface {
   ::util::Status GetPriority(uint32* priority) const override;
   ::util::Status GetTableId(uint32* table_id) const override;
 
-  // Allocates a new table key object.
+  // Allocates a new table key object, recycled from the pool if possible.
   static ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableKeyInterface>>
-  CreateTableKey(const bfrt::BfRtInfo* bfrt_info_, int table_id);
+  CreateTableKey(const bfrt::BfRtInfo* bfrt_info_, BfRtTableKeyPool* pool,
+                 int table_id);
 
-  // Stores the underlying SDE object.
-  std::unique_ptr<bfrt::BfRtTableKey> table_key_;
+  // Stores the underlying SDE object. It goes back to its pool once the
+  // table key is destroyed.
+  BfRtTableKeyPool::Handle table_key_;
 
  private:
   TableKey() {}
@@ -71,7 +79,7 @@ class TableKey : public BfSdeInterface::TableKeyInterface {
 
 class TableData : public BfSdeInterface::TableDataInterface {
  public:
-  explicit TableData(std::unique_ptr<bfrt::BfRtTableData> table_data)
+  explicit TableData(BfRtTableDataPool::Handle table_data)
       : table_data_(std::move(table_data)) {}
 
   // TableDataInterface public methods.
@@ -86,13 +94,14 @@ class TableData : public BfSdeInterface::TableDataInterface {
   ::util::Status GetActionId(int* action_id) const override;
   ::util::Status Reset(int action_id) override;
 
-  // Allocates a new table data object.
+  // Allocates a new table data object, recycled from the pool if possible.
   static ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableDataInterface>>
-  CreateTableData(const bfrt::BfRtInfo* bfrt_info_, int table_id,
-                  int action_id);
+  CreateTableData(const bfrt::BfRtInfo* bfrt_info_, BfRtTableDataPool* pool,
+                  int table_id, int action_id);
 
-  // Stores the underlying SDE object.
-  std::unique_ptr<bfrt::BfRtTableData> table_data_;
+  // Stores the underlying SDE object. It goes back to its pool once the
+  // table data is destroyed.
+  BfRtTableDataPool::Handle table_data_;
 
  private:
   TableData() {}
@@ -146,6 +155,8 @@ class BfSdeWrapper : public BfSdeInterface {
                                bool run_in_background) override;
   ::util::Status AddDevice(int device,
                            const BfrtDeviceConfig& device_config) override;
+  ::util::Status UpdateP4Info(int device,
+                              const BfrtDeviceConfig& device_config) override;
   ::util::StatusOr<std::shared_ptr<BfSdeInterface::SessionInterface>>
   CreateSession() override;
   ::util::StatusOr<std::unique_ptr<TableKeyInterface>> CreateTableKey(
@@ -192,7 +203,7 @@ class BfSdeWrapper : public BfSdeInterface {
   ::util::Status StartPacketIo(int device) override;
   ::util::Status StopPacketIo(int device) override;
   ::util::Status RegisterPacketReceiveWriter(
-      int device, std::unique_ptr<ChannelWriter<std::string>> writer) override;
+      int device, std::unique_ptr<ChannelWriter<PacketBuffer>> writer) override;
   ::util::Status UnregisterPacketReceiveWriter(int device) override;
   ::util::Status RegisterDigestListWriter(
       int device, std::unique_ptr<ChannelWriter<DigestList>> writer) override
@@ -256,7 +267,8 @@ class BfSdeWrapper : public BfSdeInterface {
       std::vector<uint32>* counter_indices,
       std::vector<absl::optional<uint64>>* byte_counts,
       std::vector<absl::optional<uint64>>* packet_counts,
-      absl::Duration timeout) override LOCKS_EXCLUDED(data_lock_);
+      absl::Duration timeout, absl::Duration max_staleness) override
+      LOCKS_EXCLUDED(data_lock_);
   ::util::Status WriteRegister(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, absl::optional<uint32> register_index,
@@ -319,8 +331,8 @@ class BfSdeWrapper : public BfSdeInterface {
       LOCKS_EXCLUDED(data_lock_);
   ::util::Status SynchronizeCounters(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
-      uint32 table_id, absl::Duration timeout) override
-      LOCKS_EXCLUDED(data_lock_);
+      uint32 table_id, absl::Duration timeout,
+      absl::Duration max_staleness) override LOCKS_EXCLUDED(data_lock_);
   ::util::Status InsertTableEntry(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, const TableKeyInterface* table_key,
@@ -333,6 +345,23 @@ class BfSdeWrapper : public BfSdeInterface {
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, const TableKeyInterface* table_key) override
       LOCKS_EXCLUDED(data_lock_);
+  ::util::Status InsertTableEntries(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+      const std::vector<const TableDataInterface*>& table_datas,
+      std::vector<::util::Status>* results) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyTableEntries(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+      const std::vector<const TableDataInterface*>& table_datas,
+      std::vector<::util::Status>* results) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteTableEntries(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, const std::vector<const TableKeyInterface*>& table_keys,
+      std::vector<::util::Status>* results) override
+      LOCKS_EXCLUDED(data_lock_);
   ::util::Status GetTableEntry(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, const TableKeyInterface* table_key,
@@ -435,6 +464,14 @@ class BfSdeWrapper : public BfSdeInterface {
   // Timeout for Write() operations on port status events.
   static constexpr absl::Duration kWriteTimeout = absl::InfiniteDuration();
 
+  // Number of idle buffers kept for received packets, and capacity reserved
+  // for each of them. Larger packets grow the buffer, which is then recycled.
+  static constexpr size_t kMaxFreePacketRxBuffers = 256;
+  static constexpr size_t kPacketRxBufferCapacity = 2048;
+
+  // Maximum number of idle BfRt table key and data objects kept per table.
+  static constexpr size_t kMaxFreeBfRtObjectsPerTable = 16;
+
   // Private constructor, use CreateSingleton and GetSingleton().
   BfSdeWrapper();
 
@@ -493,6 +530,19 @@ class BfSdeWrapper : public BfSdeInterface {
       const std::vector<bool>& member_status, bool insert)
       SHARED_LOCKS_REQUIRED(data_lock_);
 
+  // Operations of WriteTableEntries().
+  enum class TableWriteOperation { kInsert, kModify, kDelete };
+
+  // Writes a batch of entries of one table with the given operation. The
+  // table is looked up once for the whole batch. table_datas is ignored for
+  // deletes.
+  ::util::Status WriteTableEntries(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, TableWriteOperation operation,
+      const std::vector<const TableKeyInterface*>& table_keys,
+      const std::vector<const TableDataInterface*>& table_datas,
+      std::vector<::util::Status>* results) LOCKS_EXCLUDED(data_lock_);
+
   // Helper function to find, but not allocate, at free multicast node id.
   // This function is not optimized for speed yet.
   ::util::StatusOr<uint32> GetFreeMulticastNodeId(
@@ -512,9 +562,17 @@ class BfSdeWrapper : public BfSdeInterface {
       uint32 table_id, absl::Duration timeout)
       SHARED_LOCKS_REQUIRED(data_lock_);
 
-  // Internal version SynchronizeCounters without locks.
+  // Internal version SynchronizeCounters without locks. Goes through the
+  // counter_sync_cache_.
   // TODO(max): consolidate with SynchronizeRegisters
   ::util::Status DoSynchronizeCounters(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id, absl::Duration timeout, absl::Duration max_staleness)
+      SHARED_LOCKS_REQUIRED(data_lock_);
+
+  // Runs a COUNTER_SYNC operation on the given table and waits for it to
+  // complete.
+  ::util::Status SyncCountersFromHardware(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, absl::Duration timeout)
       SHARED_LOCKS_REQUIRED(data_lock_);
@@ -525,9 +583,15 @@ class BfSdeWrapper : public BfSdeInterface {
       GUARDED_BY(port_status_event_writer_lock_);
 
   // Map from device ID to packet receive writer.
-  absl::flat_hash_map<int, std::unique_ptr<ChannelWriter<std::string>>>
+  absl::flat_hash_map<int, std::unique_ptr<ChannelWriter<PacketBuffer>>>
       device_to_packet_rx_writer_ GUARDED_BY(packet_rx_callback_lock_);
 
+  // Pool of the buffers handed to the packet receive writers.
+  const std::unique_ptr<PacketBufferPool> packet_rx_buffer_pool_;
+
+  // Tracks the counter syncs of all tables, to share and skip them.
+  CounterSyncCache counter_sync_cache_;
+
   // Map from device ID to digest list receive writer.
   absl::flat_hash_map<int, std::unique_ptr<ChannelWriter<DigestList>>>
       device_to_digest_list_writer_ GUARDED_BY(digest_list_callback_lock_);
@@ -543,6 +607,12 @@ class BfSdeWrapper : public BfSdeInterface {
   // Pointer to the current BfR info object. Not owned by this class.
   const bfrt::BfRtInfo* bfrt_info_ GUARDED_BY(data_lock_);
 
+  // Pools of the key and data objects of the tables in bfrt_info_. They are
+  // replaced together with bfrt_info_, so that objects of the previous
+  // pipeline are destroyed instead of recycled.
+  std::shared_ptr<BfRtTableKeyPool> table_key_pool_ GUARDED_BY(data_lock_);
+  std::shared_ptr<BfRtTableDataPool> table_data_pool_ GUARDED_BY(data_lock_);
+
   // Pointer to the bfrt device manager. Not owned by this class.
   bfrt::BfRtDevMgr* bfrt_device_manager_ GUARDED_BY(data_lock_);
 };
@@ -3,13 +3,21 @@
 
 #include "stratum/hal/lib/barefoot/bfrt_counter_manager.h"
 
+#include <algorithm>
+#include <utility>
 #include <vector>
 
 #include "absl/synchronization/notification.h"
 #include "gflags/gflags.h"
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
 
+DEFINE_uint32(bfrt_counter_harvest_interval_ms, 0,
+              "Interval at which all indirect counters are read in the "
+              "background. Counter reads are then served from the latest "
+              "harvest, unless it is older than two intervals. 0 disables "
+              "the harvester.");
 DECLARE_uint32(bfrt_table_sync_timeout_ms);
+DECLARE_uint32(bfrt_counter_sync_max_staleness_ms);
 
 namespace stratum {
 namespace hal {
@@ -25,12 +33,24 @@ std::unique_ptr<BfrtCounterManager> BfrtCounterManager::CreateInstance(
 BfrtCounterManager::BfrtCounterManager(
     BfSdeInterface* bf_sde_interface,
     BfrtP4RuntimeTranslator* bfrt_p4runtime_translator, int device)
-    : bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)),
+    : counter_ids_(),
+      harvester_session_(nullptr),
+      harvester_thread_id_(0),
+      harvester_shutdown_(false),
+      counter_snapshot_(nullptr),
+      last_counter_write_(),
+      bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)),
       bfrt_p4runtime_translator_(ABSL_DIE_IF_NULL(bfrt_p4runtime_translator)),
       device_(device) {}
 
 BfrtCounterManager::BfrtCounterManager()
-    : bf_sde_interface_(nullptr),
+    : counter_ids_(),
+      harvester_session_(nullptr),
+      harvester_thread_id_(0),
+      harvester_shutdown_(false),
+      counter_snapshot_(nullptr),
+      last_counter_write_(),
+      bf_sde_interface_(nullptr),
       bfrt_p4runtime_translator_(nullptr),
       device_(-1) {}
 
@@ -39,14 +59,76 @@ BfrtCounterManager::~BfrtCounterManager() = default;
 ::util::Status BfrtCounterManager::PushForwardingPipelineConfig(
     const BfrtDeviceConfig& config) {
   absl::WriterMutexLock l(&lock_);
+  RET_CHECK(config.programs_size() == 1) << "Only one P4 program is supported.";
+  counter_ids_.clear();
+  for (const auto& counter : config.programs(0).p4info().counters()) {
+    counter_ids_.push_back(counter.preamble().id());
+  }
+  {
+    // Counter table IDs are only valid within a pipeline.
+    absl::MutexLock harvester_lock(&harvester_lock_);
+    counter_snapshot_ = nullptr;
+    last_counter_write_.clear();
+  }
+
+  if (FLAGS_bfrt_counter_harvest_interval_ms == 0) return ::util::OkStatus();
+  ASSIGN_OR_RETURN(harvester_session_, bf_sde_interface_->CreateSession());
+  if (harvester_thread_id_ == 0) {
+    {
+      absl::MutexLock harvester_lock(&harvester_lock_);
+      harvester_shutdown_ = false;
+    }
+    int ret = pthread_create(&harvester_thread_id_, nullptr,
+                             &BfrtCounterManager::CounterHarvesterThreadFunc,
+                             this);
+    if (ret != 0) {
+      harvester_thread_id_ = 0;
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to spawn counter harvester thread for device with ID "
+             << device_ << ". Err: " << ret << ".";
+    }
+  }
+
   return ::util::OkStatus();
 }
 
+::util::Status BfrtCounterManager::Shutdown() {
+  ::util::Status status;
+  {
+    absl::MutexLock l(&harvester_lock_);
+    harvester_shutdown_ = true;
+  }
+  // The harvester acquires lock_ during a pass, so it must not be held while
+  // joining the thread.
+  pthread_t harvester_thread_id;
+  {
+    absl::ReaderMutexLock l(&lock_);
+    harvester_thread_id = harvester_thread_id_;
+  }
+  if (harvester_thread_id != 0 &&
+      pthread_join(harvester_thread_id, nullptr) != 0) {
+    ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                           << "Failed to join thread " << harvester_thread_id;
+    APPEND_STATUS_IF_ERROR(status, error);
+  }
+  {
+    absl::WriterMutexLock l(&lock_);
+    harvester_thread_id_ = 0;
+    harvester_session_.reset();
+  }
+  {
+    absl::MutexLock l(&harvester_lock_);
+    counter_snapshot_ = nullptr;
+  }
+
+  return status;
+}
+
 ::util::Status BfrtCounterManager::WriteIndirectCounterEntry(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
     const ::p4::v1::Update::Type type,
     const ::p4::v1::CounterEntry& counter_entry) {
-  absl::WriterMutexLock l(&lock_);
+  absl::ReaderMutexLock l(&lock_);
   ASSIGN_OR_RETURN(const auto& translated_counter_entry,
                    bfrt_p4runtime_translator_->TranslateCounterEntry(
                        counter_entry, /*to_sdk=*/true));
@@ -73,6 +155,10 @@ BfrtCounterManager::~BfrtCounterManager() = default;
   RETURN_IF_ERROR(bf_sde_interface_->WriteIndirectCounter(
       device_, session, table_id, translated_counter_entry.index().index(),
       byte_count, packet_count));
+  {
+    absl::MutexLock l(&harvester_lock_);
+    last_counter_write_[table_id] = absl::Now();
+  }
 
   return ::util::OkStatus();
 }
@@ -104,10 +190,15 @@ BfrtCounterManager::~BfrtCounterManager() = default;
   std::vector<uint32> counter_indices;
   std::vector<absl::optional<uint64>> byte_counts;
   std::vector<absl::optional<uint64>> packet_counts;
-  RETURN_IF_ERROR(bf_sde_interface_->ReadIndirectCounter(
-      device_, session, table_id, optional_counter_index, &counter_indices,
-      &byte_counts, &packet_counts,
-      absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms)));
+  if (!ReadIndirectCounterFromSnapshot(table_id, optional_counter_index,
+                                       &counter_indices, &byte_counts,
+                                       &packet_counts)) {
+    RETURN_IF_ERROR(bf_sde_interface_->ReadIndirectCounter(
+        device_, session, table_id, optional_counter_index, &counter_indices,
+        &byte_counts, &packet_counts,
+        absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms),
+        absl::Milliseconds(FLAGS_bfrt_counter_sync_max_staleness_ms)));
+  }
 
   ::p4::v1::ReadResponse resp;
   for (size_t i = 0; i < counter_indices.size(); ++i) {
@@ -136,6 +227,160 @@ BfrtCounterManager::~BfrtCounterManager() = default;
   return ::util::OkStatus();
 }
 
+std::shared_ptr<const BfrtCounterManager::CounterSnapshot>
+BfrtCounterManager::GetCounterSnapshot() const {
+  absl::MutexLock l(&harvester_lock_);
+  return counter_snapshot_;
+}
+
+bool BfrtCounterManager::ReadIndirectCounterFromSnapshot(
+    uint32 table_id, absl::optional<uint32> counter_index,
+    std::vector<uint32>* counter_indices,
+    std::vector<absl::optional<uint64>>* byte_counts,
+    std::vector<absl::optional<uint64>>* packet_counts) const {
+  std::shared_ptr<const CounterSnapshot> snapshot;
+  {
+    absl::MutexLock l(&harvester_lock_);
+    if (counter_snapshot_ == nullptr) return false;
+    // Failing or stalled passes do not leave old counters behind.
+    const absl::Duration max_age =
+        2 * absl::Milliseconds(FLAGS_bfrt_counter_harvest_interval_ms);
+    if (absl::Now() > counter_snapshot_->timestamp + max_age) return false;
+    auto it = last_counter_write_.find(table_id);
+    if (it != last_counter_write_.end() &&
+        it->second >= counter_snapshot_->timestamp) {
+      return false;
+    }
+    snapshot = counter_snapshot_;
+  }
+  auto it = snapshot->tables.find(table_id);
+  if (it == snapshot->tables.end()) return false;
+  const CounterSnapshot::Table& table = it->second;
+  uint32 begin = 0;
+  uint32 end = table.size;
+  if (counter_index) {
+    // Out of range indices are left to the SDE to report.
+    if (counter_index.value() >= table.size) return false;
+    begin = counter_index.value();
+    end = begin + 1;
+  }
+
+  counter_indices->clear();
+  byte_counts->clear();
+  packet_counts->clear();
+  for (uint32 i = begin; i < end; ++i) {
+    counter_indices->push_back(i);
+    byte_counts->push_back(table.byte_counts.empty()
+                               ? absl::optional<uint64>()
+                               : table.byte_counts[i]);
+    packet_counts->push_back(table.packet_counts.empty()
+                                 ? absl::optional<uint64>()
+                                 : table.packet_counts[i]);
+  }
+  VLOG(1) << "Served counters of table " << table_id << " from the snapshot "
+          << "taken at " << snapshot->timestamp << ".";
+
+  return true;
+}
+
+void* BfrtCounterManager::CounterHarvesterThreadFunc(void* arg) {
+  BfrtCounterManager* mgr = reinterpret_cast<BfrtCounterManager*>(arg);
+  mgr->HarvestCounters();
+
+  return nullptr;
+}
+
+void BfrtCounterManager::HarvestCounters() {
+  const absl::Duration interval =
+      absl::Milliseconds(FLAGS_bfrt_counter_harvest_interval_ms);
+  // The two snapshot buffers. The spare one is reused once no reader holds on
+  // to it anymore, keeping the allocations of its columns.
+  std::shared_ptr<CounterSnapshot> spare;
+  std::vector<uint32> counter_indices;
+  std::vector<absl::optional<uint64>> byte_counts;
+  std::vector<absl::optional<uint64>> packet_counts;
+  while (true) {
+    const absl::Time next_pass = absl::Now() + interval;
+    if (spare == nullptr || spare.use_count() > 1) {
+      spare = std::make_shared<CounterSnapshot>();
+    }
+    {
+      // The snapshot is published before lock_ is released. Otherwise a
+      // pipeline push in between would clear the snapshot, and the counters
+      // of the previous pipeline would then be published for the new one.
+      absl::ReaderMutexLock l(&lock_);
+      ::util::Status status = HarvestCountersOnce(
+          spare.get(), &counter_indices, &byte_counts, &packet_counts);
+      absl::MutexLock harvester_lock(&harvester_lock_);
+      if (status.ok()) {
+        std::shared_ptr<const CounterSnapshot> previous =
+            std::move(counter_snapshot_);
+        counter_snapshot_ = spare;
+        spare = std::const_pointer_cast<CounterSnapshot>(previous);
+      } else {
+        LOG(ERROR) << "Failed to harvest counters of device " << device_
+                   << ": " << status.error_message();
+      }
+    }
+    absl::MutexLock l(&harvester_lock_);
+    if (harvester_lock_.AwaitWithDeadline(
+            absl::Condition(&harvester_shutdown_), next_pass)) {
+      break;
+    }
+  }
+}
+
+::util::Status BfrtCounterManager::HarvestCountersOnce(
+    CounterSnapshot* snapshot, std::vector<uint32>* counter_indices,
+    std::vector<absl::optional<uint64>>* byte_counts,
+    std::vector<absl::optional<uint64>>* packet_counts) {
+  std::vector<uint32> table_ids;
+  table_ids.reserve(counter_ids_.size());
+  for (const uint32 counter_id : counter_ids_) {
+    ASSIGN_OR_RETURN(uint32 table_id, bf_sde_interface_->GetBfRtId(counter_id));
+    table_ids.push_back(table_id);
+  }
+  // Drop the tables of a previous pipeline, but keep the columns of the
+  // others to avoid reallocating them.
+  for (auto it = snapshot->tables.begin(); it != snapshot->tables.end();) {
+    if (std::find(table_ids.begin(), table_ids.end(), it->first) ==
+        table_ids.end()) {
+      snapshot->tables.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+
+  snapshot->timestamp = absl::Now();
+  for (const uint32 table_id : table_ids) {
+    RETURN_IF_ERROR(bf_sde_interface_->ReadIndirectCounter(
+        device_, harvester_session_, table_id, absl::nullopt, counter_indices,
+        byte_counts, packet_counts,
+        absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms),
+        absl::ZeroDuration()));
+    CounterSnapshot::Table& table = snapshot->tables[table_id];
+    table.size = 0;
+    for (const uint32 counter_index : *counter_indices) {
+      table.size = std::max(table.size, counter_index + 1);
+    }
+    const bool has_bytes = !byte_counts->empty() && byte_counts->front();
+    const bool has_packets = !packet_counts->empty() && packet_counts->front();
+    table.byte_counts.assign(has_bytes ? table.size : 0, 0);
+    table.packet_counts.assign(has_packets ? table.size : 0, 0);
+    for (size_t i = 0; i < counter_indices->size(); ++i) {
+      const uint32 counter_index = (*counter_indices)[i];
+      if (has_bytes) {
+        table.byte_counts[counter_index] = (*byte_counts)[i].value_or(0);
+      }
+      if (has_packets) {
+        table.packet_counts[counter_index] = (*packet_counts)[i].value_or(0);
+      }
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
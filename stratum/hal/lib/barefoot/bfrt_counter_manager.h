@@ -4,10 +4,15 @@
 #ifndef STRATUM_HAL_LIB_BAREFOOT_BFRT_COUNTER_MANAGER_H_
 #define STRATUM_HAL_LIB_BAREFOOT_BFRT_COUNTER_MANAGER_H_
 
+#include <pthread.h>
+
 #include <memory>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
@@ -24,23 +29,52 @@ namespace barefoot {
 
 class BfrtCounterManager {
  public:
+  // A copy of all indirect counters of the pipeline, taken by the counter
+  // harvester in a single pass.
+  struct CounterSnapshot {
+    // The counters of one counter table, in columns indexed by counter index.
+    // A column is empty if the counter does not count that unit.
+    struct Table {
+      uint32 size = 0;
+      std::vector<uint64> byte_counts;
+      std::vector<uint64> packet_counts;
+    };
+    // Time at which the pass started. All values are at least this recent.
+    absl::Time timestamp = absl::InfinitePast();
+    // Map from BfRt counter table ID to its counters.
+    absl::flat_hash_map<uint32, Table> tables;
+  };
+
   virtual ~BfrtCounterManager();
 
-  // Pushes the forwarding pipeline config
+  // Pushes the forwarding pipeline config. Starts the counter harvester on the
+  // first push, if enabled.
   virtual ::util::Status PushForwardingPipelineConfig(
-      const BfrtDeviceConfig& config) LOCKS_EXCLUDED(lock_);
+      const BfrtDeviceConfig& config)
+      LOCKS_EXCLUDED(lock_, harvester_lock_);
+
+  // Stops the counter harvester, if running.
+  virtual ::util::Status Shutdown() LOCKS_EXCLUDED(lock_, harvester_lock_);
 
   // Writes an indrect counter entry.
   virtual ::util::Status WriteIndirectCounterEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
       const ::p4::v1::Update::Type type,
-      const ::p4::v1::CounterEntry& counter_entry) LOCKS_EXCLUDED(lock_);
+      const ::p4::v1::CounterEntry& counter_entry)
+      LOCKS_EXCLUDED(lock_, harvester_lock_);
 
-  // Reads an indirect counter entry.
+  // Reads an indirect counter entry. Served from the latest counter snapshot
+  // if the harvester is running and the snapshot is recent enough.
   virtual ::util::Status ReadIndirectCounterEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
       const ::p4::v1::CounterEntry& counter_entry,
-      WriterInterface<::p4::v1::ReadResponse>* writer) LOCKS_EXCLUDED(lock_);
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      LOCKS_EXCLUDED(lock_, harvester_lock_);
+
+  // Returns the latest counter snapshot, or nullptr if the harvester is
+  // disabled or has not completed a pass yet.
+  virtual std::shared_ptr<const CounterSnapshot> GetCounterSnapshot() const
+      LOCKS_EXCLUDED(harvester_lock_);
 
   // Creates a table manager instance.
   static std::unique_ptr<BfrtCounterManager> CreateInstance(
@@ -58,9 +92,60 @@ class BfrtCounterManager {
       BfSdeInterface* bf_sde_interface_,
       BfrtP4RuntimeTranslator* bfrt_p4runtime_translator, int device);
 
+  // Counter harvester thread function.
+  static void* CounterHarvesterThreadFunc(void* arg);
+
+  // Periodically harvests all counters until the harvester is shut down.
+  void HarvestCounters() LOCKS_EXCLUDED(lock_, harvester_lock_);
+
+  // Reads all indirect counters of the pipeline into the snapshot. The other
+  // arguments are scratch buffers, reused across passes.
+  ::util::Status HarvestCountersOnce(
+      CounterSnapshot* snapshot, std::vector<uint32>* counter_indices,
+      std::vector<absl::optional<uint64>>* byte_counts,
+      std::vector<absl::optional<uint64>>* packet_counts)
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Fills the counter data of the given table from the latest snapshot.
+  // Returns false if the snapshot does not hold the requested counters,
+  // predates the last write to the table or is older than two harvest
+  // intervals.
+  bool ReadIndirectCounterFromSnapshot(
+      uint32 table_id, absl::optional<uint32> counter_index,
+      std::vector<uint32>* counter_indices,
+      std::vector<absl::optional<uint64>>* byte_counts,
+      std::vector<absl::optional<uint64>>* packet_counts) const
+      LOCKS_EXCLUDED(harvester_lock_);
+
   // Reader-writer lock used to protect access to pipeline state.
   mutable absl::Mutex lock_;
 
+  // P4Runtime IDs of the indirect counters of the pipeline.
+  std::vector<uint32> counter_ids_ GUARDED_BY(lock_);
+
+  // Session used by the counter harvester.
+  std::shared_ptr<BfSdeInterface::SessionInterface> harvester_session_
+      GUARDED_BY(lock_);
+
+  // The ID of the counter harvester thread, 0 if not running.
+  pthread_t harvester_thread_id_ GUARDED_BY(lock_);
+
+  // Mutex lock protecting the harvester state and the snapshot.
+  mutable absl::Mutex harvester_lock_;
+
+  // Set to stop the counter harvester.
+  bool harvester_shutdown_ GUARDED_BY(harvester_lock_);
+
+  // The latest counter snapshot. The harvester fills a second snapshot and
+  // swaps it in when complete, so readers never see a partial pass.
+  std::shared_ptr<const CounterSnapshot> counter_snapshot_
+      GUARDED_BY(harvester_lock_);
+
+  // Map from BfRt counter table ID to the time of the last write to it.
+  // Snapshots taken before are not used for reads.
+  absl::flat_hash_map<uint32, absl::Time> last_counter_write_
+      GUARDED_BY(harvester_lock_);
+
   // Pointer to a BfSdeInterface implementation that wraps all the SDE calls.
   BfSdeInterface* bf_sde_interface_ = nullptr;  // not owned by this class.
 
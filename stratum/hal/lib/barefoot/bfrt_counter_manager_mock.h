@@ -24,6 +24,7 @@ class BfrtCounterManagerMock : public BfrtCounterManager {
                ::util::Status(const BfrtDeviceConfig& config));
   MOCK_METHOD1(VerifyForwardingPipelineConfig,
                ::util::Status(const BfrtDeviceConfig& config));
+  MOCK_METHOD0(Shutdown, ::util::Status());
   MOCK_METHOD3(
       WriteIndirectCounterEntry,
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -34,6 +35,8 @@ class BfrtCounterManagerMock : public BfrtCounterManager {
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      const ::p4::v1::CounterEntry& counter_entry,
                      WriterInterface<::p4::v1::ReadResponse>* writer));
+  MOCK_CONST_METHOD0(GetCounterSnapshot,
+                     std::shared_ptr<const CounterSnapshot>());
 };
 
 }  // namespace barefoot
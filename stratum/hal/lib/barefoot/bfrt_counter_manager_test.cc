@@ -7,14 +7,18 @@
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/barefoot/bf_sde_mock.h"
 #include "stratum/hal/lib/barefoot/bfrt_p4runtime_translator_mock.h"
+#include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_uint32(bfrt_counter_harvest_interval_ms);
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -22,10 +26,13 @@ namespace barefoot {
 using test_utils::EqualsProto;
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
+using ::testing::Eq;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
+using ::testing::SetArgPointee;
 
 class BfrtCounterManagerTest : public ::testing::Test {
  protected:
@@ -163,6 +170,216 @@ TEST_F(BfrtCounterManagerTest, RejectIndirectCounterIndexZeroTest) {
               HasSubstr("Counter index must be greater than or equal to zero"));
 }
 
+TEST_F(BfrtCounterManagerTest, CounterHarvesterServesReadsFromSnapshot) {
+  constexpr int kCounterId = 55;
+  constexpr int kBfRtCounterId = 66;
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  FLAGS_bfrt_counter_harvest_interval_ms = 100;
+
+  const std::string kConfigText = R"pb(
+    programs {
+      p4info {
+        counters {
+          preamble {
+            id: 55
+            name: "Ingress.counter"
+          }
+        }
+      }
+    }
+  )pb";
+  BfrtDeviceConfig config;
+  ASSERT_OK(ParseProtoFromString(kConfigText, &config));
+
+  const std::vector<uint32> counter_indices = {0, 1, 2};
+  const std::vector<absl::optional<uint64>> byte_counts = {100, 200, 300};
+  const std::vector<absl::optional<uint64>> packet_counts = {1, 2, 3};
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateSession())
+      .WillOnce(Return(session_mock));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kCounterId))
+      .WillRepeatedly(Return(kBfRtCounterId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ReadIndirectCounter(kDevice1, _, kBfRtCounterId,
+                                  Eq(absl::optional<uint32>()), _, _, _, _, _))
+      .WillRepeatedly(DoAll(SetArgPointee<4>(counter_indices),
+                            SetArgPointee<5>(byte_counts),
+                            SetArgPointee<6>(packet_counts),
+                            Return(::util::OkStatus())));
+  // Single counter reads must not hit the SDE.
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ReadIndirectCounter(kDevice1, _, kBfRtCounterId,
+                                  Eq(absl::optional<uint32>(1)), _, _, _, _, _))
+      .Times(0);
+  ASSERT_OK(bfrt_counter_manager_->PushForwardingPipelineConfig(config));
+
+  std::shared_ptr<const BfrtCounterManager::CounterSnapshot> snapshot;
+  for (int i = 0; i < 500 && snapshot == nullptr; ++i) {
+    absl::SleepFor(absl::Milliseconds(10));
+    snapshot = bfrt_counter_manager_->GetCounterSnapshot();
+  }
+  ASSERT_NE(nullptr, snapshot);
+  ASSERT_EQ(1, snapshot->tables.count(kBfRtCounterId));
+  const auto& table = snapshot->tables.at(kBfRtCounterId);
+  EXPECT_EQ(3, table.size);
+  EXPECT_THAT(table.byte_counts, ElementsAre(100, 200, 300));
+  EXPECT_THAT(table.packet_counts, ElementsAre(1, 2, 3));
+
+  const std::string kIndirectCounterEntryText = R"pb(
+    counter_id: 55
+    index {
+      index: 1
+    }
+  )pb";
+  ::p4::v1::CounterEntry entry;
+  ASSERT_OK(ParseProtoFromString(kIndirectCounterEntryText, &entry));
+  const std::string kResultText = R"pb(
+    counter_id: 55
+    index {
+      index: 1
+    }
+    data {
+      byte_count: 200
+      packet_count: 2
+    }
+  )pb";
+  ::p4::v1::CounterEntry result;
+  ASSERT_OK(ParseProtoFromString(kResultText, &result));
+  ::p4::v1::ReadResponse resp;
+  *resp.add_entities()->mutable_counter_entry() = result;
+
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateCounterEntry(EqualsProto(entry), true))
+      .WillOnce(Return(::util::StatusOr<::p4::v1::CounterEntry>(entry)));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateCounterEntry(EqualsProto(result), false))
+      .WillOnce(Return(::util::StatusOr<::p4::v1::CounterEntry>(result)));
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(resp))).WillOnce(Return(true));
+  EXPECT_OK(bfrt_counter_manager_->ReadIndirectCounterEntry(
+      session_mock, entry, &writer_mock));
+
+  EXPECT_OK(bfrt_counter_manager_->Shutdown());
+  EXPECT_EQ(nullptr, bfrt_counter_manager_->GetCounterSnapshot());
+  FLAGS_bfrt_counter_harvest_interval_ms = 0;
+}
+
+TEST_F(BfrtCounterManagerTest, CounterHarvesterDoesNotServeStaleSnapshots) {
+  constexpr int kCounterId = 55;
+  constexpr int kBfRtCounterId = 66;
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  FLAGS_bfrt_counter_harvest_interval_ms = 10;
+
+  const std::string kConfigText = R"pb(
+    programs {
+      p4info {
+        counters {
+          preamble {
+            id: 55
+            name: "Ingress.counter"
+          }
+        }
+      }
+    }
+  )pb";
+  BfrtDeviceConfig config;
+  ASSERT_OK(ParseProtoFromString(kConfigText, &config));
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateSession())
+      .WillOnce(Return(session_mock));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kCounterId))
+      .WillRepeatedly(Return(kBfRtCounterId));
+  // Only the first pass succeeds, so the snapshot is never refreshed.
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ReadIndirectCounter(kDevice1, _, kBfRtCounterId,
+                                  Eq(absl::optional<uint32>()), _, _, _, _, _))
+      .WillOnce(DoAll(
+          SetArgPointee<4>(std::vector<uint32>{0, 1}),
+          SetArgPointee<5>(std::vector<absl::optional<uint64>>{100, 200}),
+          SetArgPointee<6>(std::vector<absl::optional<uint64>>{1, 2}),
+          Return(::util::OkStatus())))
+      .WillRepeatedly(Return(::util::Status(StratumErrorSpace(), ERR_INTERNAL,
+                                            "Harvest failed.")));
+  // The stale snapshot is not used, the counter is read from the SDE.
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ReadIndirectCounter(kDevice1, _, kBfRtCounterId,
+                                  Eq(absl::optional<uint32>(1)), _, _, _, _, _))
+      .WillOnce(DoAll(
+          SetArgPointee<4>(std::vector<uint32>{1}),
+          SetArgPointee<5>(std::vector<absl::optional<uint64>>{250}),
+          SetArgPointee<6>(std::vector<absl::optional<uint64>>{3}),
+          Return(::util::OkStatus())));
+  ASSERT_OK(bfrt_counter_manager_->PushForwardingPipelineConfig(config));
+
+  std::shared_ptr<const BfrtCounterManager::CounterSnapshot> snapshot;
+  for (int i = 0; i < 500 && snapshot == nullptr; ++i) {
+    absl::SleepFor(absl::Milliseconds(10));
+    snapshot = bfrt_counter_manager_->GetCounterSnapshot();
+  }
+  ASSERT_NE(nullptr, snapshot);
+  // Let the snapshot age beyond two harvest intervals.
+  absl::SleepFor(absl::Milliseconds(50));
+
+  const std::string kIndirectCounterEntryText = R"pb(
+    counter_id: 55
+    index {
+      index: 1
+    }
+  )pb";
+  ::p4::v1::CounterEntry entry;
+  ASSERT_OK(ParseProtoFromString(kIndirectCounterEntryText, &entry));
+  const std::string kResultText = R"pb(
+    counter_id: 55
+    index {
+      index: 1
+    }
+    data {
+      byte_count: 250
+      packet_count: 3
+    }
+  )pb";
+  ::p4::v1::CounterEntry result;
+  ASSERT_OK(ParseProtoFromString(kResultText, &result));
+  ::p4::v1::ReadResponse resp;
+  *resp.add_entities()->mutable_counter_entry() = result;
+
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateCounterEntry(EqualsProto(entry), true))
+      .WillOnce(Return(::util::StatusOr<::p4::v1::CounterEntry>(entry)));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateCounterEntry(EqualsProto(result), false))
+      .WillOnce(Return(::util::StatusOr<::p4::v1::CounterEntry>(result)));
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(resp))).WillOnce(Return(true));
+  EXPECT_OK(bfrt_counter_manager_->ReadIndirectCounterEntry(
+      session_mock, entry, &writer_mock));
+
+  EXPECT_OK(bfrt_counter_manager_->Shutdown());
+  FLAGS_bfrt_counter_harvest_interval_ms = 0;
+}
+
+TEST_F(BfrtCounterManagerTest, CounterHarvesterIsDisabledByDefault) {
+  const std::string kConfigText = R"pb(
+    programs {
+      p4info {
+        counters {
+          preamble {
+            id: 55
+            name: "Ingress.counter"
+          }
+        }
+      }
+    }
+  )pb";
+  BfrtDeviceConfig config;
+  ASSERT_OK(ParseProtoFromString(kConfigText, &config));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateSession()).Times(0);
+  ASSERT_OK(bfrt_counter_manager_->PushForwardingPipelineConfig(config));
+  EXPECT_EQ(nullptr, bfrt_counter_manager_->GetCounterSnapshot());
+  EXPECT_OK(bfrt_counter_manager_->Shutdown());
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
@@ -5,25 +5,112 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "gflags/gflags.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/barefoot/bf_pipeline_utils.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
+#include "stratum/hal/lib/barefoot/bfrt_update_partitioner.h"
+#include "stratum/hal/lib/common/chunked_read_response_writer.h"
 #include "stratum/hal/lib/common/proto_oneof_writer_wrapper.h"
 #include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/p4/p4_info_reconciler.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 #include "stratum/public/proto/error.pb.h"
 
+DEFINE_int32(bfrt_write_parallelism, 1,
+             "Max number of SDE sessions used to apply the updates of a "
+             "single P4Runtime WriteRequest concurrently. Only updates "
+             "touching independent P4 objects are applied concurrently. 1 "
+             "disables concurrent writes.");
+DEFINE_int32(bfrt_parallel_write_min_updates, 1000,
+             "Min number of updates in a P4Runtime WriteRequest for the "
+             "updates to be applied concurrently.");
+DEFINE_int32(bfrt_table_entry_write_batch_size, 256,
+             "Max number of consecutive table entry updates of a P4Runtime "
+             "WriteRequest handed to the SDE in one bulk write. 1 disables "
+             "bulk writes.");
+DEFINE_int32(bfrt_read_parallelism, 1,
+             "Max number of SDE sessions used to read the entities of a "
+             "single P4Runtime ReadRequest concurrently. 1 disables "
+             "concurrent reads.");
+DEFINE_int32(bfrt_parallel_read_min_entities, 16,
+             "Min number of entities in a P4Runtime ReadRequest for the "
+             "entities to be read concurrently.");
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
 
+namespace {
+
+// Serializes the writes of the workers reading the entities of one
+// ReadRequest concurrently.
+class SynchronizedReadResponseWriter
+    : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  explicit SynchronizedReadResponseWriter(
+      WriterInterface<::p4::v1::ReadResponse>* writer)
+      : lock_(), writer_(writer) {}
+
+  bool Write(const ::p4::v1::ReadResponse& msg) override
+      LOCKS_EXCLUDED(lock_) {
+    absl::MutexLock l(&lock_);
+    return writer_->Write(msg);
+  }
+
+ private:
+  absl::Mutex lock_;
+  WriterInterface<::p4::v1::ReadResponse>* writer_;  // not owned
+};
+
+// Builds the internal BfrtDeviceConfig from the given pipeline config.
+::util::Status BuildBfrtDeviceConfig(
+    const ::p4::v1::ForwardingPipelineConfig& config,
+    BfrtDeviceConfig* bfrt_config) {
+  BfPipelineConfig bf_config;
+  RETURN_IF_ERROR(ExtractBfPipelineConfig(config, &bf_config));
+  VLOG(2) << bf_config.DebugString();
+
+  bfrt_config->Clear();
+  auto program = bfrt_config->add_programs();
+  program->set_name(bf_config.p4_name());
+  program->set_bfrt(bf_config.bfruntime_info());
+  *program->mutable_p4info() = config.p4info();
+  for (const auto& profile : bf_config.profiles()) {
+    auto pipeline = program->add_pipelines();
+    pipeline->set_name(profile.profile_name());
+    pipeline->set_context(profile.context());
+    pipeline->set_config(profile.binary());
+    *pipeline->mutable_scope() = profile.pipe_scope();
+  }
+
+  return ::util::OkStatus();
+}
+
+// Returns true if the two configs load the same pipeline, i.e. if they differ
+// at most in their P4Info.
+bool IsSamePipeline(const BfrtDeviceConfig& a, const BfrtDeviceConfig& b) {
+  BfrtDeviceConfig a_pipeline = a;
+  BfrtDeviceConfig b_pipeline = b;
+  for (auto& program : *a_pipeline.mutable_programs()) program.clear_p4info();
+  for (auto& program : *b_pipeline.mutable_programs()) program.clear_p4info();
+
+  return ProtoEqual(a_pipeline, b_pipeline);
+}
+
+}  // namespace
+
 BfrtNode::BfrtNode(BfrtTableManager* bfrt_table_manager,
                    BfrtPacketioManager* bfrt_packetio_manager,
                    BfrtPreManager* bfrt_pre_manager,
@@ -104,23 +191,8 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
   RETURN_IF_ERROR(VerifyForwardingPipelineConfig(config));
-  BfPipelineConfig bf_config;
-  RETURN_IF_ERROR(ExtractBfPipelineConfig(config, &bf_config));
-  VLOG(2) << bf_config.DebugString();
-
-  // Create internal BfrtDeviceConfig.
   BfrtDeviceConfig bfrt_config;
-  auto program = bfrt_config.add_programs();
-  program->set_name(bf_config.p4_name());
-  program->set_bfrt(bf_config.bfruntime_info());
-  *program->mutable_p4info() = config.p4info();
-  for (const auto& profile : bf_config.profiles()) {
-    auto pipeline = program->add_pipelines();
-    pipeline->set_name(profile.profile_name());
-    pipeline->set_context(profile.context());
-    pipeline->set_config(profile.binary());
-    *pipeline->mutable_scope() = profile.pipe_scope();
-  }
+  RETURN_IF_ERROR(BuildBfrtDeviceConfig(config, &bfrt_config));
   bfrt_config_ = bfrt_config;
   VLOG(2) << bfrt_config_.DebugString();
 
@@ -132,12 +204,84 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   if (!initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
+
+  return DoCommitForwardingPipelineConfig();
+}
+
+::util::Status BfrtNode::ReconcileAndCommitForwardingPipelineConfig(
+    const ::p4::v1::ForwardingPipelineConfig& config, bool* pipeline_reloaded) {
+  RET_CHECK(pipeline_reloaded) << "Null pipeline_reloaded.";
+  absl::WriterMutexLock l(&lock_);
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  RETURN_IF_ERROR(VerifyForwardingPipelineConfig(config));
+  BfrtDeviceConfig bfrt_config;
+  RETURN_IF_ERROR(BuildBfrtDeviceConfig(config, &bfrt_config));
+  *pipeline_reloaded = false;
+
+  // Without a pipeline there is no state to preserve.
+  if (!pipeline_initialized_) {
+    bfrt_config_ = bfrt_config;
+    *pipeline_reloaded = true;
+    return DoCommitForwardingPipelineConfig();
+  }
+
+  // Loading a different P4 program resets the device and drops all entries.
+  // Restoring them afterwards would not be hitless, so only P4Info changes
+  // can be reconciled.
+  if (!IsSamePipeline(bfrt_config_, bfrt_config)) {
+    return MAKE_ERROR(ERR_UNIMPLEMENTED)
+           << "RECONCILE_AND_COMMIT on device " << device_id_ << " only "
+           << "supports changes to the P4Info. Changing the P4 program "
+           << "requires reloading the pipeline, use VERIFY_AND_COMMIT and "
+           << "replay the forwarding state instead.";
+  }
+
+  // The programmed state stays in the ASIC, so the new P4Info must accept it.
+  // This is checked on the P4Info objects alone, which spares reading the
+  // whole forwarding state back from the ASIC.
+  const auto& old_p4info = bfrt_config_.programs(0).p4info();
+  ASSIGN_OR_RETURN(
+      auto reconciler,
+      P4InfoReconciler::CreateInstance(old_p4info, config.p4info()));
+  if (!reconciler->KeepsAllObjects()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "RECONCILE_AND_COMMIT on device " << device_id_ << " requires "
+           << "the new P4Info to keep all the objects of the current one, "
+           << "as their entries stay programmed.";
+  }
+
+  // Only the P4Info IDs change. On failure, the old P4Info is pushed back.
+  LOG(INFO) << "Pipeline is unchanged, keeping the forwarding state in place "
+            << "on device " << device_id_ << ".";
+  const BfrtDeviceConfig old_config = bfrt_config_;
+  bfrt_config_ = bfrt_config;
+  ::util::Status status =
+      bf_sde_interface_->UpdateP4Info(device_id_, bfrt_config_);
+  if (status.ok()) status = PushForwardingPipelineConfigToManagers();
+  if (!status.ok()) {
+    bfrt_config_ = old_config;
+    APPEND_STATUS_IF_ERROR(
+        status, bf_sde_interface_->UpdateP4Info(device_id_, bfrt_config_));
+    APPEND_STATUS_IF_ERROR(status, PushForwardingPipelineConfigToManagers());
+  }
+
+  return status;
+}
+
+::util::Status BfrtNode::DoCommitForwardingPipelineConfig() {
   RET_CHECK(bfrt_config_.programs_size() > 0);
 
   // Calling AddDevice() overwrites any previous pipeline.
   RETURN_IF_ERROR(bf_sde_interface_->AddDevice(device_id_, bfrt_config_));
+  RETURN_IF_ERROR(PushForwardingPipelineConfigToManagers());
+  pipeline_initialized_ = true;
 
-  // Push pipeline config to the managers.
+  return ::util::OkStatus();
+}
+
+::util::Status BfrtNode::PushForwardingPipelineConfigToManagers() {
   const auto& p4info = bfrt_config_.programs(0).p4info();
   RETURN_IF_ERROR(
       bfrt_p4runtime_translator_->PushForwardingPipelineConfig(p4info));
@@ -149,7 +293,7 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
       bfrt_pre_manager_->PushForwardingPipelineConfig(bfrt_config_));
   RETURN_IF_ERROR(
       bfrt_counter_manager_->PushForwardingPipelineConfig(bfrt_config_));
-  pipeline_initialized_ = true;
+
   return ::util::OkStatus();
 }
 
@@ -171,7 +315,7 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   APPEND_STATUS_IF_ERROR(status, bfrt_table_manager_->Shutdown());
   APPEND_STATUS_IF_ERROR(status, bfrt_packetio_manager_->Shutdown());
   // APPEND_STATUS_IF_ERROR(status, bfrt_pre_manager_->Shutdown());
-  // APPEND_STATUS_IF_ERROR(status, bfrt_counter_manager_->Shutdown());
+  APPEND_STATUS_IF_ERROR(status, bfrt_counter_manager_->Shutdown());
 
   pipeline_initialized_ = false;
   initialized_ = false;  // Set to false even if there is an error
@@ -185,7 +329,14 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
 
 ::util::Status BfrtNode::WriteForwardingEntries(
     const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
-  absl::WriterMutexLock l(&lock_);
+  // Writes only exclude pipeline changes. Concurrent reads and writes are
+  // isolated by their SDE sessions and ordered per table by the managers.
+  absl::ReaderMutexLock l(&lock_);
+  return DoWriteForwardingEntries(req, results);
+}
+
+::util::Status BfrtNode::DoWriteForwardingEntries(
+    const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
   RET_CHECK(req.device_id() == node_id_)
       << "Request device id must be same as id of this BfrtNode.";
   RET_CHECK(req.atomicity() == ::p4::v1::WriteRequest::CONTINUE_ON_ERROR)
@@ -196,66 +347,31 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
 
+  // Big requests touching independent objects are applied concurrently.
+  std::vector<std::vector<int>> groups;
+  if (FLAGS_bfrt_write_parallelism > 1 &&
+      req.updates_size() >= FLAGS_bfrt_parallel_write_min_updates) {
+    groups = PartitionUpdates(req);
+  }
+  // Updates stay aborted if their batch fails before they are written.
+  const ::util::Status not_written = MAKE_ERROR(ERR_ABORTED).without_logging()
+                                     << "Update not written as its batch "
+                                        "failed.";
+  std::vector<::util::Status> statuses(req.updates_size(), not_written);
+  ::util::Status status;
+  if (groups.size() > 1) {
+    status = WriteForwardingEntitiesInParallel(req, groups, &statuses);
+  } else {
+    std::vector<int> update_indices(req.updates_size());
+    std::iota(update_indices.begin(), update_indices.end(), 0);
+    status = WriteForwardingEntitiesInBatch(req, update_indices, &statuses);
+  }
   bool success = true;
-  ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
-  RETURN_IF_ERROR(session->BeginBatch());
-  for (const auto& update : req.updates()) {
-    ::util::Status status = ::util::OkStatus();
-    switch (update.entity().entity_case()) {
-      case ::p4::v1::Entity::kTableEntry:
-        status = bfrt_table_manager_->WriteTableEntry(
-            session, update.type(), update.entity().table_entry());
-        break;
-      case ::p4::v1::Entity::kExternEntry:
-        status = WriteExternEntry(session, update.type(),
-                                  update.entity().extern_entry());
-        break;
-      case ::p4::v1::Entity::kActionProfileMember:
-        status = bfrt_table_manager_->WriteActionProfileMember(
-            session, update.type(), update.entity().action_profile_member());
-        break;
-      case ::p4::v1::Entity::kActionProfileGroup:
-        status = bfrt_table_manager_->WriteActionProfileGroup(
-            session, update.type(), update.entity().action_profile_group());
-        break;
-      case ::p4::v1::Entity::kPacketReplicationEngineEntry:
-        status = bfrt_pre_manager_->WritePreEntry(
-            session, update.type(),
-            update.entity().packet_replication_engine_entry());
-        break;
-      case ::p4::v1::Entity::kDirectCounterEntry:
-        status = bfrt_table_manager_->WriteDirectCounterEntry(
-            session, update.type(), update.entity().direct_counter_entry());
-        break;
-      case ::p4::v1::Entity::kCounterEntry:
-        status = bfrt_counter_manager_->WriteIndirectCounterEntry(
-            session, update.type(), update.entity().counter_entry());
-        break;
-      case ::p4::v1::Entity::kRegisterEntry: {
-        status = bfrt_table_manager_->WriteRegisterEntry(
-            session, update.type(), update.entity().register_entry());
-        break;
-      }
-      case ::p4::v1::Entity::kMeterEntry: {
-        status = bfrt_table_manager_->WriteMeterEntry(
-            session, update.type(), update.entity().meter_entry());
-        break;
-      }
-      case ::p4::v1::Entity::kDigestEntry:
-        status = bfrt_table_manager_->WriteDigestEntry(
-            session, update.type(), update.entity().digest_entry());
-        break;
-      case ::p4::v1::Entity::kDirectMeterEntry:
-      case ::p4::v1::Entity::kValueSetEntry:
-      default:
-        status = MAKE_ERROR(ERR_UNIMPLEMENTED)
-                 << "Unsupported entity type: " << update.ShortDebugString();
-        break;
-    }
-    success &= status.ok();
-    results->push_back(status);
+  for (const auto& update_status : statuses) {
+    success &= update_status.ok();
+    results->push_back(update_status);
   }
-  RETURN_IF_ERROR(session->EndBatch());
+  RETURN_IF_ERROR(status);
 
   if (!success) {
     return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
@@ -267,6 +383,172 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   return ::util::OkStatus();
 }
 
+::util::Status BfrtNode::WriteForwardingEntity(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::Update& update) {
+  switch (update.entity().entity_case()) {
+    case ::p4::v1::Entity::kTableEntry:
+      return bfrt_table_manager_->WriteTableEntry(
+          session, update.type(), update.entity().table_entry());
+    case ::p4::v1::Entity::kExternEntry:
+      return WriteExternEntry(session, update.type(),
+                              update.entity().extern_entry());
+    case ::p4::v1::Entity::kActionProfileMember:
+      return bfrt_table_manager_->WriteActionProfileMember(
+          session, update.type(), update.entity().action_profile_member());
+    case ::p4::v1::Entity::kActionProfileGroup:
+      return bfrt_table_manager_->WriteActionProfileGroup(
+          session, update.type(), update.entity().action_profile_group());
+    case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+      return bfrt_pre_manager_->WritePreEntry(
+          session, update.type(),
+          update.entity().packet_replication_engine_entry());
+    case ::p4::v1::Entity::kDirectCounterEntry:
+      return bfrt_table_manager_->WriteDirectCounterEntry(
+          session, update.type(), update.entity().direct_counter_entry());
+    case ::p4::v1::Entity::kCounterEntry:
+      return bfrt_counter_manager_->WriteIndirectCounterEntry(
+          session, update.type(), update.entity().counter_entry());
+    case ::p4::v1::Entity::kRegisterEntry:
+      return bfrt_table_manager_->WriteRegisterEntry(
+          session, update.type(), update.entity().register_entry());
+    case ::p4::v1::Entity::kMeterEntry:
+      return bfrt_table_manager_->WriteMeterEntry(
+          session, update.type(), update.entity().meter_entry());
+    case ::p4::v1::Entity::kDigestEntry:
+      return bfrt_table_manager_->WriteDigestEntry(
+          session, update.type(), update.entity().digest_entry());
+    case ::p4::v1::Entity::kDirectMeterEntry:
+    case ::p4::v1::Entity::kValueSetEntry:
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported entity type: " << update.ShortDebugString();
+  }
+}
+
+::util::Status BfrtNode::WriteForwardingEntitiesInBatch(
+    const ::p4::v1::WriteRequest& req, const std::vector<int>& update_indices,
+    std::vector<::util::Status>* results) {
+  ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
+  RETURN_IF_ERROR(session->BeginBatch());
+  const size_t max_bulk_size =
+      std::max(1, FLAGS_bfrt_table_entry_write_batch_size);
+  size_t begin = 0;
+  while (begin < update_indices.size()) {
+    // Consecutive table entry updates of the same type are written in bulk.
+    const ::p4::v1::Update& update = req.updates(update_indices[begin]);
+    size_t end = begin + 1;
+    if (update.entity().has_table_entry()) {
+      while (end < update_indices.size() && end - begin < max_bulk_size &&
+             req.updates(update_indices[end]).type() == update.type() &&
+             req.updates(update_indices[end]).entity().has_table_entry()) {
+        ++end;
+      }
+    }
+    if (end - begin == 1) {
+      (*results)[update_indices[begin]] =
+          WriteForwardingEntity(session, update);
+    } else {
+      std::vector<const ::p4::v1::TableEntry*> table_entries;
+      table_entries.reserve(end - begin);
+      for (size_t i = begin; i < end; ++i) {
+        table_entries.push_back(
+            &req.updates(update_indices[i]).entity().table_entry());
+      }
+      std::vector<::util::Status> statuses;
+      ::util::Status status = bfrt_table_manager_->WriteTableEntries(
+          session, update.type(), table_entries, &statuses);
+      if (status.ok() && statuses.size() != table_entries.size()) {
+        status = MAKE_ERROR(ERR_INTERNAL)
+                 << "Got " << statuses.size() << " results for "
+                 << table_entries.size() << " table entries.";
+      }
+      for (size_t i = begin; i < end; ++i) {
+        (*results)[update_indices[i]] =
+            status.ok() ? statuses[i - begin] : status;
+      }
+    }
+    begin = end;
+  }
+  RETURN_IF_ERROR(session->EndBatch());
+  // The table entries are only visible to shadow reads once committed.
+  for (int index : update_indices) {
+    const ::p4::v1::Update& update = req.updates(index);
+    if (update.entity().has_table_entry() && (*results)[index].ok()) {
+      bfrt_table_manager_->RecordTableEntryWrite(
+          update.type(), update.entity().table_entry());
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status BfrtNode::WriteForwardingEntitiesInParallel(
+    const ::p4::v1::WriteRequest& req,
+    const std::vector<std::vector<int>>& groups,
+    std::vector<::util::Status>* results) {
+  BoundedExecutor* executor;
+  {
+    absl::MutexLock l(&executor_lock_);
+    if (write_executor_ == nullptr) {
+      auto ret = BoundedExecutor::CreateInstance(
+          "BfrtNodeWrite", FLAGS_bfrt_write_parallelism,
+          FLAGS_bfrt_write_parallelism);
+      RETURN_IF_ERROR(ret.status());
+      write_executor_ = ret.ConsumeValueOrDie();
+    }
+    executor = write_executor_.get();
+  }
+
+  // Spread the groups over the workers, biggest first and each to the least
+  // loaded worker. The updates of a worker are written in request order.
+  const int num_workers =
+      std::min<int>(FLAGS_bfrt_write_parallelism, groups.size());
+  std::vector<int> group_order(groups.size());
+  std::iota(group_order.begin(), group_order.end(), 0);
+  std::stable_sort(group_order.begin(), group_order.end(),
+                   [&groups](int a, int b) {
+                     return groups[a].size() > groups[b].size();
+                   });
+  std::vector<std::vector<int>> worker_updates(num_workers);
+  for (int g : group_order) {
+    auto worker = std::min_element(
+        worker_updates.begin(), worker_updates.end(),
+        [](const std::vector<int>& a, const std::vector<int>& b) {
+          return a.size() < b.size();
+        });
+    worker->insert(worker->end(), groups[g].begin(), groups[g].end());
+  }
+  for (auto& updates : worker_updates) {
+    std::sort(updates.begin(), updates.end());
+  }
+  VLOG(1) << "Writing " << req.updates_size() << " updates in "
+          << groups.size() << " independent groups using " << num_workers
+          << " sessions.";
+
+  // The last share is written by the calling thread, as is any share the
+  // executor cannot take.
+  std::vector<::util::Status> batch_statuses(num_workers);
+  absl::BlockingCounter pending(num_workers);
+  for (int w = 0; w < num_workers; ++w) {
+    std::function<void()> task = [this, &req, &worker_updates, &batch_statuses,
+                                  &pending, results, w]() {
+      batch_statuses[w] =
+          WriteForwardingEntitiesInBatch(req, worker_updates[w], results);
+      pending.DecrementCount();
+    };
+    if (w == num_workers - 1 || !executor->Submit(task).ok()) task();
+  }
+  pending.Wait();
+
+  ::util::Status status;
+  for (const auto& batch_status : batch_statuses) {
+    APPEND_STATUS_IF_ERROR(status, batch_status);
+  }
+
+  return status;
+}
+
 ::util::Status BfrtNode::ReadForwardingEntries(
     const ::p4::v1::ReadRequest& req,
     WriterInterface<::p4::v1::ReadResponse>* writer,
@@ -275,102 +557,51 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   RET_CHECK(details) << "Details pointer must be non-null.";
 
   absl::ReaderMutexLock l(&lock_);
+  return DoReadForwardingEntries(req, writer, details);
+}
+
+::util::Status BfrtNode::DoReadForwardingEntries(
+    const ::p4::v1::ReadRequest& req,
+    WriterInterface<::p4::v1::ReadResponse>* writer,
+    std::vector<::util::Status>* details) {
   RET_CHECK(req.device_id() == node_id_)
       << "Request device id must be same as id of this BfrtNode.";
   if (!initialized_ || !pipeline_initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  ::p4::v1::ReadResponse resp;
-  bool success = true;
-  ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
-  for (const auto& entity : req.entities()) {
-    switch (entity.entity_case()) {
-      case ::p4::v1::Entity::kTableEntry: {
-        auto status = bfrt_table_manager_->ReadTableEntry(
-            session, entity.table_entry(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kExternEntry: {
-        auto status = ReadExternEntry(session, entity.extern_entry(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kActionProfileMember: {
-        auto status = bfrt_table_manager_->ReadActionProfileMember(
-            session, entity.action_profile_member(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kActionProfileGroup: {
-        auto status = bfrt_table_manager_->ReadActionProfileGroup(
-            session, entity.action_profile_group(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kPacketReplicationEngineEntry: {
-        auto status = bfrt_pre_manager_->ReadPreEntry(
-            session, entity.packet_replication_engine_entry(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kDirectCounterEntry: {
-        auto status = bfrt_table_manager_->ReadDirectCounterEntry(
-            session, entity.direct_counter_entry());
-        if (!status.ok()) {
-          success = false;
-          details->push_back(status.status());
-          break;
-        }
-        resp.add_entities()->mutable_direct_counter_entry()->CopyFrom(
-            status.ValueOrDie());
-        break;
-      }
-      case ::p4::v1::Entity::kCounterEntry: {
-        auto status = bfrt_counter_manager_->ReadIndirectCounterEntry(
-            session, entity.counter_entry(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kRegisterEntry: {
-        auto status = bfrt_table_manager_->ReadRegisterEntry(
-            session, entity.register_entry(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kMeterEntry: {
-        auto status = bfrt_table_manager_->ReadMeterEntry(
-            session, entity.meter_entry(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kDigestEntry: {
-        auto status = bfrt_table_manager_->ReadDigestEntry(
-            session, entity.digest_entry(), writer);
-        success &= status.ok();
-        details->push_back(status);
-        break;
-      }
-      case ::p4::v1::Entity::kDirectMeterEntry:
-      case ::p4::v1::Entity::kValueSetEntry:
-      default: {
-        success = false;
-        details->push_back(MAKE_ERROR(ERR_UNIMPLEMENTED)
-                           << "Unsupported entity type: "
-                           << entity.ShortDebugString());
-        break;
-      }
+  const int num_workers =
+      FLAGS_bfrt_read_parallelism > 1 &&
+              req.entities_size() >= FLAGS_bfrt_parallel_read_min_entities
+          ? std::min(FLAGS_bfrt_read_parallelism, req.entities_size())
+          : 1;
+  // Concurrent workers share the writer, so their writes are serialized.
+  SynchronizedReadResponseWriter synchronized_writer(writer);
+  if (num_workers > 1) writer = &synchronized_writer;
+  // Entities read here directly are streamed in bounded chunks, together with
+  // a final (possibly empty) response.
+  ChunkedReadResponseWriter chunked_writer(writer);
+  absl::Mutex chunked_writer_lock;
+  const ::util::Status not_read = MAKE_ERROR(ERR_ABORTED).without_logging()
+                                  << "Entity not read as no session was "
+                                     "available.";
+  std::vector<::util::Status> statuses(req.entities_size(), not_read);
+  if (num_workers > 1) {
+    RETURN_IF_ERROR(ReadForwardingEntitiesInParallel(
+        req, num_workers, writer, &chunked_writer, &chunked_writer_lock,
+        &statuses));
+  } else {
+    ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
+    for (int i = 0; i < req.entities_size(); ++i) {
+      statuses[i] = ReadForwardingEntity(session, req.entities(i), writer,
+                                         &chunked_writer, &chunked_writer_lock);
     }
   }
-  RET_CHECK(writer->Write(resp)) << "Write to stream channel failed.";
+  RETURN_IF_ERROR(chunked_writer.Flush());
+  bool success = true;
+  for (const auto& status : statuses) {
+    success &= status.ok();
+    details->push_back(status);
+  }
   if (!success) {
     return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
            << "One or more read operations failed.";
@@ -378,6 +609,149 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   return ::util::OkStatus();
 }
 
+::util::Status BfrtNode::ReadForwardingEntity(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::Entity& entity,
+    WriterInterface<::p4::v1::ReadResponse>* writer,
+    ChunkedReadResponseWriter* chunked_writer,
+    absl::Mutex* chunked_writer_lock) {
+  switch (entity.entity_case()) {
+    case ::p4::v1::Entity::kTableEntry:
+      return bfrt_table_manager_->ReadTableEntry(session, entity.table_entry(),
+                                                 writer);
+    case ::p4::v1::Entity::kExternEntry:
+      return ReadExternEntry(session, entity.extern_entry(), writer);
+    case ::p4::v1::Entity::kActionProfileMember:
+      return bfrt_table_manager_->ReadActionProfileMember(
+          session, entity.action_profile_member(), writer);
+    case ::p4::v1::Entity::kActionProfileGroup:
+      return bfrt_table_manager_->ReadActionProfileGroup(
+          session, entity.action_profile_group(), writer);
+    case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+      return bfrt_pre_manager_->ReadPreEntry(
+          session, entity.packet_replication_engine_entry(), writer);
+    case ::p4::v1::Entity::kDirectCounterEntry: {
+      ASSIGN_OR_RETURN(auto direct_counter_entry,
+                       bfrt_table_manager_->ReadDirectCounterEntry(
+                           session, entity.direct_counter_entry()));
+      absl::MutexLock l(chunked_writer_lock);
+      ASSIGN_OR_RETURN(::p4::v1::Entity* resp_entity,
+                       chunked_writer->AddEntity());
+      *resp_entity->mutable_direct_counter_entry() = direct_counter_entry;
+      return ::util::OkStatus();
+    }
+    case ::p4::v1::Entity::kCounterEntry:
+      return bfrt_counter_manager_->ReadIndirectCounterEntry(
+          session, entity.counter_entry(), writer);
+    case ::p4::v1::Entity::kRegisterEntry:
+      return bfrt_table_manager_->ReadRegisterEntry(
+          session, entity.register_entry(), writer);
+    case ::p4::v1::Entity::kMeterEntry:
+      return bfrt_table_manager_->ReadMeterEntry(session, entity.meter_entry(),
+                                                 writer);
+    case ::p4::v1::Entity::kDigestEntry:
+      return bfrt_table_manager_->ReadDigestEntry(
+          session, entity.digest_entry(), writer);
+    case ::p4::v1::Entity::kDirectMeterEntry:
+    case ::p4::v1::Entity::kValueSetEntry:
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported entity type: " << entity.ShortDebugString();
+  }
+}
+
+::util::Status BfrtNode::ReadForwardingEntitiesInParallel(
+    const ::p4::v1::ReadRequest& req, int num_workers,
+    WriterInterface<::p4::v1::ReadResponse>* writer,
+    ChunkedReadResponseWriter* chunked_writer,
+    absl::Mutex* chunked_writer_lock, std::vector<::util::Status>* statuses) {
+  BoundedExecutor* executor;
+  {
+    absl::MutexLock l(&executor_lock_);
+    if (read_executor_ == nullptr) {
+      auto ret = BoundedExecutor::CreateInstance(
+          "BfrtNodeRead", FLAGS_bfrt_read_parallelism,
+          FLAGS_bfrt_read_parallelism);
+      RETURN_IF_ERROR(ret.status());
+      read_executor_ = ret.ConsumeValueOrDie();
+    }
+    executor = read_executor_.get();
+  }
+  VLOG(1) << "Reading " << req.entities_size() << " entities using up to "
+          << num_workers << " sessions.";
+
+  // Each worker reads on its own session, taking the next unread entity
+  // until none is left, so that a big table does not hold up the others.
+  // The last worker is run by the calling thread. The executor is shared by
+  // all the reads, so a queued worker may only start once the calling thread
+  // has read everything. It then returns right away, and the calling thread
+  // only waits for the workers which started. The state is shared with the
+  // queued workers, as they can outlive this call.
+  struct ReadState {
+    absl::Mutex lock;
+    absl::CondVar worker_done;
+    int next_entity = 0;
+    int num_running = 0;
+    bool closed = false;
+  };
+  auto state = std::make_shared<ReadState>();
+  std::vector<::util::Status> worker_statuses(num_workers);
+  auto read_entities = [this, &req, writer, chunked_writer,
+                        chunked_writer_lock, statuses, &state,
+                        &worker_statuses](int w) {
+    auto ret = bf_sde_interface_->CreateSession();
+    if (!ret.ok()) {
+      worker_statuses[w] = ret.status();
+      return;
+    }
+    auto session = ret.ConsumeValueOrDie();
+    while (true) {
+      int i;
+      {
+        absl::MutexLock l(&state->lock);
+        if (state->next_entity == req.entities_size()) break;
+        i = state->next_entity++;
+      }
+      (*statuses)[i] = ReadForwardingEntity(session, req.entities(i), writer,
+                                            chunked_writer,
+                                            chunked_writer_lock);
+    }
+  };
+  for (int w = 0; w < num_workers - 1; ++w) {
+    std::function<void()> task = [state, &read_entities, w]() {
+      {
+        absl::MutexLock l(&state->lock);
+        if (state->closed) return;
+        ++state->num_running;
+      }
+      read_entities(w);
+      absl::MutexLock l(&state->lock);
+      --state->num_running;
+      state->worker_done.Signal();
+    };
+    // The calling thread reads whatever the executor cannot take.
+    if (!executor->Submit(task).ok()) break;
+  }
+  read_entities(num_workers - 1);
+  int next_entity;
+  {
+    absl::MutexLock l(&state->lock);
+    state->closed = true;
+    while (state->num_running > 0) state->worker_done.Wait(&state->lock);
+    next_entity = state->next_entity;
+  }
+
+  // Entities left unread because no worker got a session fail the read.
+  ::util::Status status;
+  if (next_entity < req.entities_size()) {
+    for (const auto& worker_status : worker_statuses) {
+      APPEND_STATUS_IF_ERROR(status, worker_status);
+    }
+  }
+
+  return status;
+}
+
 ::util::Status BfrtNode::RegisterStreamMessageResponseWriter(
     const std::shared_ptr<WriterInterface<::p4::v1::StreamMessageResponse>>&
         writer) {
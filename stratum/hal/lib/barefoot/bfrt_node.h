@@ -19,8 +19,10 @@
 #include "stratum/hal/lib/barefoot/bfrt_packetio_manager.h"
 #include "stratum/hal/lib/barefoot/bfrt_pre_manager.h"
 #include "stratum/hal/lib/barefoot/bfrt_table_manager.h"
+#include "stratum/hal/lib/common/chunked_read_response_writer.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/lib/bounded_executor.h"
 
 namespace stratum {
 namespace hal {
@@ -44,6 +46,15 @@ class BfrtNode {
   virtual ::util::Status SaveForwardingPipelineConfig(
       const ::p4::v1::ForwardingPipelineConfig& config) LOCKS_EXCLUDED(lock_);
   virtual ::util::Status CommitForwardingPipelineConfig() LOCKS_EXCLUDED(lock_);
+  // Pushes the given pipeline config while preserving the forwarding state of
+  // the node (see SwitchInterface). Only changes to the P4Info which keep all
+  // its objects are supported, as the entries can then stay in place. Returns
+  // ERR_UNIMPLEMENTED, without touching the device, if the P4 program changes. pipeline_reloaded is set
+  // to true if the device was reset, which only happens for the first
+  // pipeline pushed to the node.
+  virtual ::util::Status ReconcileAndCommitForwardingPipelineConfig(
+      const ::p4::v1::ForwardingPipelineConfig& config, bool* pipeline_reloaded)
+      LOCKS_EXCLUDED(lock_);
   virtual ::util::Status VerifyForwardingPipelineConfig(
       const ::p4::v1::ForwardingPipelineConfig& config) const;
   virtual ::util::Status Shutdown() LOCKS_EXCLUDED(chassis_lock, lock_);
@@ -92,6 +103,64 @@ class BfrtNode {
            BfrtP4RuntimeTranslator* bfrt_p4runtime_translator,
            BfSdeInterface* bf_sde_interface, int device_id);
 
+  // Internal versions of the public methods, called with lock_ held.
+  ::util::Status DoCommitForwardingPipelineConfig()
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  ::util::Status DoWriteForwardingEntries(const ::p4::v1::WriteRequest& req,
+                                          std::vector<::util::Status>* results)
+      SHARED_LOCKS_REQUIRED(lock_);
+  ::util::Status DoReadForwardingEntries(
+      const ::p4::v1::ReadRequest& req,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      std::vector<::util::Status>* details) SHARED_LOCKS_REQUIRED(lock_);
+
+  // Pushes bfrt_config_ to the managers, without touching the device.
+  ::util::Status PushForwardingPipelineConfigToManagers()
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads a single entity of a ReadRequest. Entities read by the managers are
+  // written to writer, the others are added to chunked_writer under
+  // chunked_writer_lock.
+  ::util::Status ReadForwardingEntity(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::Entity& entity,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      ChunkedReadResponseWriter* chunked_writer,
+      absl::Mutex* chunked_writer_lock);
+
+  // Reads the entities of a ReadRequest concurrently on num_workers sessions,
+  // storing the result of each entity at its index in statuses. Responses are
+  // streamed as soon as they are read, so their order does not follow the
+  // request. The given writer must be safe to use concurrently.
+  ::util::Status ReadForwardingEntitiesInParallel(
+      const ::p4::v1::ReadRequest& req, int num_workers,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      ChunkedReadResponseWriter* chunked_writer,
+      absl::Mutex* chunked_writer_lock, std::vector<::util::Status>* statuses)
+      SHARED_LOCKS_REQUIRED(lock_) LOCKS_EXCLUDED(executor_lock_);
+
+  // Writes a single update of a WriteRequest.
+  ::util::Status WriteForwardingEntity(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::Update& update);
+
+  // Writes the given updates of a WriteRequest in a single batch of a new
+  // session, storing the result of each update at its index in results. Runs
+  // of consecutive table entry updates of the same type are handed to the
+  // table manager in bulk. Can be called concurrently for disjoint sets of
+  // updates.
+  ::util::Status WriteForwardingEntitiesInBatch(
+      const ::p4::v1::WriteRequest& req, const std::vector<int>& update_indices,
+      std::vector<::util::Status>* results);
+
+  // Writes the given groups of non-conflicting updates of a WriteRequest
+  // concurrently, in batches of several sessions.
+  ::util::Status WriteForwardingEntitiesInParallel(
+      const ::p4::v1::WriteRequest& req,
+      const std::vector<std::vector<int>>& groups,
+      std::vector<::util::Status>* results) SHARED_LOCKS_REQUIRED(lock_)
+      LOCKS_EXCLUDED(executor_lock_);
+
   // Write extern entries like ActionProfile, DirectCounter, PortMetadata
   ::util::Status WriteExternEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -107,7 +176,9 @@ class BfrtNode {
   friend void StreamMessageCb(uint64 node_id,
                               p4::v1::StreamMessageResponse* msg, void* cookie);
 
-  // Reader-writer lock used to protect access to node-specific state.
+  // Reader-writer lock used to protect access to node-specific state. Only
+  // config and pipeline changes hold it exclusively; reads and writes of
+  // forwarding entities hold it shared and may run concurrently.
   mutable absl::Mutex lock_;
 
   // Mutex used for exclusive access to rx_writer_.
@@ -145,6 +216,18 @@ class BfrtNode {
   // managed by this class instance. Assigned in the class constructor.
   const int device_id_;
 
+  // Mutex protecting the thread pools, which are created by concurrent
+  // readers and writers of forwarding entities.
+  absl::Mutex executor_lock_;
+
+  // Thread pool used to apply the updates of big WriteRequests concurrently.
+  // Created on first use.
+  std::unique_ptr<BoundedExecutor> write_executor_ GUARDED_BY(executor_lock_);
+
+  // Thread pool used to read the entities of ReadRequests concurrently.
+  // Created on first use.
+  std::unique_ptr<BoundedExecutor> read_executor_ GUARDED_BY(executor_lock_);
+
   friend class BfrtNodeTest;
 };
 
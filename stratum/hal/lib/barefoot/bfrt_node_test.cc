@@ -5,9 +5,13 @@
 #include "stratum/hal/lib/barefoot/bfrt_node.h"
 
 #include <string>
+#include <thread>  // NOLINT
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/canonical_errors.h"
@@ -22,16 +26,24 @@
 #include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_int32(bfrt_write_parallelism);
+DECLARE_int32(bfrt_parallel_write_min_updates);
+DECLARE_int32(bfrt_table_entry_write_batch_size);
+DECLARE_int32(bfrt_read_parallelism);
+DECLARE_int32(bfrt_parallel_read_min_entities);
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
 
 using ::testing::_;
+using ::testing::Between;
 using ::testing::DoAll;
 using ::testing::Eq;
 using ::testing::HasSubstr;
 using ::testing::InSequence;
 using ::testing::Invoke;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
 using ::testing::WithArgs;
 
@@ -791,6 +803,8 @@ TEST_F(BfrtNodeTest, ShutdownSuccess) {
     InSequence sequence;  // The order of the calls are important. Enforce it.
     EXPECT_CALL(*bfrt_packetio_manager_mock_, Shutdown())
         .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_counter_manager_mock_, Shutdown())
+        .WillOnce(Return(::util::OkStatus()));
     // EXPECT_CALL(*bcm_tunnel_manager_mock_, Shutdown())
     //     .WillOnce(Return(::util::OkStatus()));
     // EXPECT_CALL(*bcm_acl_manager_mock_, Shutdown())
@@ -969,12 +983,40 @@ TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry) {
               WriteTableEntry(session_mock, ::p4::v1::Update::INSERT,
                               EqualsProto(*table_entry)))
       .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              RecordTableEntryWrite(::p4::v1::Update::INSERT,
+                                    EqualsProto(*table_entry)));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BfrtNodeTest, WriteForwardingEntriesFailure_EndBatchNotRecorded) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  auto* table_entry = SetupTableEntryToInsert(&req, kNodeId);
+
+  // The batch fails to commit, the written entry must not reach the shadow.
+  auto session = std::make_shared<SessionMock>();
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock = session;
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
+  EXPECT_CALL(*session, BeginBatch()).WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*session, EndBatch()).WillOnce(Return(DefaultError()));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(session_mock, ::p4::v1::Update::INSERT,
+                              EqualsProto(*table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_table_manager_mock_, RecordTableEntryWrite(_, _))
+      .Times(0);
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(DefaultError().error_code(), status.error_code());
+}
+
 TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_ModifyTableEntry) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
   ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
@@ -1389,6 +1431,98 @@ TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_InsertMeterEntry) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_ParallelWrite) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+  gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_write_parallelism = 2;
+  FLAGS_bfrt_parallel_write_min_updates = 1;
+  FLAGS_bfrt_table_entry_write_batch_size = 1;
+
+  // Entries of two tables, applied in two concurrent sessions.
+  ::p4::v1::WriteRequest req;
+  for (int i = 0; i < 4; ++i) {
+    auto* table_entry = SetupTableEntryToInsert(&req, kNodeId);
+    table_entry->set_table_id(i % 2 == 0 ? 1 : 2);
+    table_entry->set_priority(i + 1);
+  }
+  std::vector<::util::Status> results = {};
+
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession())
+      .Times(2)
+      .WillRepeatedly(Return(session_mock));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(session_mock, ::p4::v1::Update::INSERT, _))
+      .Times(4)
+      .WillRepeatedly(WithArgs<2>(
+          Invoke([](const ::p4::v1::TableEntry& table_entry) {
+            if (table_entry.priority() == 4) {
+              return ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                    "Some error");
+            }
+            return ::util::OkStatus();
+          })));
+
+  ::util::Status status = WriteForwardingEntries(req, &results);
+
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  // Results are reported in request order.
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_OK(results[1]);
+  EXPECT_OK(results[2]);
+  EXPECT_EQ(ERR_INVALID_PARAM, results[3].error_code());
+}
+
+TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_BulkTableEntries) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  // Three inserts written in bulk, followed by a single delete.
+  ::p4::v1::WriteRequest req;
+  for (int i = 0; i < 3; ++i) {
+    SetupTableEntryToInsert(&req, kNodeId)->set_priority(i + 1);
+  }
+  auto* table_entry = SetupTableEntryToDelete(&req, kNodeId);
+  std::vector<::util::Status> results = {};
+
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntries(session_mock, ::p4::v1::Update::INSERT, _, _))
+      .WillOnce(
+          Invoke([](std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                    const ::p4::v1::Update::Type type,
+                    const std::vector<const ::p4::v1::TableEntry*>& entries,
+                    std::vector<::util::Status>* statuses) {
+            EXPECT_EQ(3U, entries.size());
+            for (const auto* entry : entries) {
+              statuses->push_back(
+                  entry->priority() == 2
+                      ? ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                       "Some error")
+                      : ::util::OkStatus());
+            }
+            return ::util::OkStatus();
+          }));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(session_mock, ::p4::v1::Update::DELETE,
+                              EqualsProto(*table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::util::Status status = WriteForwardingEntries(req, &results);
+
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_INVALID_PARAM, results[1].error_code());
+  EXPECT_OK(results[2]);
+  EXPECT_OK(results[3]);
+}
+
 TEST_F(BfrtNodeTest, ReadForwardingEntriesSuccess_TableEntry) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
   ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
@@ -1410,6 +1544,182 @@ TEST_F(BfrtNodeTest, ReadForwardingEntriesSuccess_TableEntry) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BfrtNodeTest, ReadForwardingEntriesSuccess_ParallelRead) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+  gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_read_parallelism = 2;
+  FLAGS_bfrt_parallel_read_min_entities = 2;
+
+  // Entries of three tables and an unsupported entity, read in up to two
+  // concurrent sessions. The second session is not created when the calling
+  // thread reads everything before the queued worker starts.
+  ::p4::v1::ReadRequest req;
+  for (int i = 0; i < 3; ++i) {
+    SetupTableEntryToRead(&req, kNodeId)->set_table_id(i + 1);
+  }
+  req.add_entities()->mutable_value_set_entry();
+
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(_)).WillRepeatedly(Return(true));
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession())
+      .Times(Between(1, 2))
+      .WillRepeatedly(Return(session_mock));
+  EXPECT_CALL(*bfrt_table_manager_mock_, ReadTableEntry(session_mock, _, _))
+      .Times(3)
+      .WillRepeatedly(Invoke(
+          [](std::shared_ptr<BfSdeInterface::SessionInterface> session,
+             const ::p4::v1::TableEntry& table_entry,
+             WriterInterface<::p4::v1::ReadResponse>* writer) {
+            ::p4::v1::ReadResponse resp;
+            *resp.add_entities()->mutable_table_entry() = table_entry;
+            writer->Write(resp);
+            if (table_entry.table_id() == 2) {
+              return ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                    "Some error");
+            }
+            return ::util::OkStatus();
+          }));
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = ReadForwardingEntries(req, &writer_mock, &results);
+
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  // Details are reported in request order.
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_INVALID_PARAM, results[1].error_code());
+  EXPECT_OK(results[2]);
+  EXPECT_EQ(ERR_UNIMPLEMENTED, results[3].error_code());
+}
+
+// Reads should not wait for a concurrent write to finish.
+TEST_F(BfrtNodeTest, ReadForwardingEntriesDuringWrite) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::WriteRequest write_req;
+  SetupTableEntryToInsert(&write_req, kNodeId);
+  ::p4::v1::ReadRequest read_req;
+  SetupTableEntryToRead(&read_req, kNodeId);
+
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession())
+      .Times(2)
+      .WillRepeatedly(Return(session_mock));
+  absl::Notification write_started;
+  absl::Notification read_done;
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(session_mock, ::p4::v1::Update::INSERT, _))
+      .WillOnce(InvokeWithoutArgs([&write_started, &read_done]() {
+        write_started.Notify();
+        EXPECT_TRUE(read_done.WaitForNotificationWithTimeout(absl::Seconds(5)));
+        return ::util::OkStatus();
+      }));
+  EXPECT_CALL(*bfrt_table_manager_mock_, ReadTableEntry(session_mock, _, _))
+      .WillOnce(Return(::util::OkStatus()));
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(_)).WillOnce(Return(true));
+
+  std::thread writer_thread([this, &write_req]() {
+    std::vector<::util::Status> results = {};
+    EXPECT_OK(WriteForwardingEntries(write_req, &results));
+  });
+  write_started.WaitForNotification();
+  std::vector<::util::Status> details = {};
+  EXPECT_OK(ReadForwardingEntries(read_req, &writer_mock, &details));
+  read_done.Notify();
+  writer_thread.join();
+}
+
+// ReconcileAndCommitForwardingPipelineConfig() should keep the programmed
+// state in place if only the P4Info changes.
+TEST_F(BfrtNodeTest, ReconcileAndCommitForwardingPipelineConfigKeepsPipeline) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::ForwardingPipelineConfig config =
+      GetDefaultForwardingPipelineConfig();
+  config.mutable_p4info()->mutable_tables(0)->mutable_preamble()->set_id(
+      33583784);
+  EXPECT_CALL(*bfrt_table_manager_mock_, VerifyForwardingPipelineConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  // The forwarding state is not read back from the ASIC.
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, AddDevice(_, _)).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, UpdateP4Info(kDeviceId, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              PushForwardingPipelineConfig(EqualsProto(config.p4info())))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_packetio_manager_mock_, PushForwardingPipelineConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_table_manager_mock_, PushForwardingPipelineConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_pre_manager_mock_, PushForwardingPipelineConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_counter_manager_mock_, PushForwardingPipelineConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+
+  bool pipeline_reloaded = true;
+  EXPECT_OK(bfrt_node_->ReconcileAndCommitForwardingPipelineConfig(
+      config, &pipeline_reloaded));
+  EXPECT_FALSE(pipeline_reloaded);
+}
+
+// ReconcileAndCommitForwardingPipelineConfig() should reject a new P4 program,
+// which would reset the device, without touching the device or reading the
+// forwarding state.
+TEST_F(BfrtNodeTest,
+       ReconcileAndCommitForwardingPipelineConfigRejectsNewProgram) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::ForwardingPipelineConfig config =
+      GetDefaultForwardingPipelineConfig();
+  BfPipelineConfig bf_config;
+  ASSERT_OK(ParseProtoFromString(kBfConfigPipelineString, &bf_config));
+  bf_config.mutable_profiles(0)->set_binary("<new raw bin>");
+  ASSERT_TRUE(bf_config.SerializeToString(config.mutable_p4_device_config()));
+
+  EXPECT_CALL(*bfrt_table_manager_mock_, VerifyForwardingPipelineConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, AddDevice(_, _)).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, UpdateP4Info(_, _)).Times(0);
+
+  bool pipeline_reloaded = true;
+  ::util::Status status = bfrt_node_->ReconcileAndCommitForwardingPipelineConfig(
+      config, &pipeline_reloaded);
+  EXPECT_EQ(ERR_UNIMPLEMENTED, status.error_code());
+  EXPECT_FALSE(pipeline_reloaded);
+}
+
+// ReconcileAndCommitForwardingPipelineConfig() should reject a P4Info which
+// removes objects whose entries would stay programmed.
+TEST_F(BfrtNodeTest,
+       ReconcileAndCommitForwardingPipelineConfigRejectsRemovedObjects) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::ForwardingPipelineConfig config =
+      GetDefaultForwardingPipelineConfig();
+  config.mutable_p4info()->mutable_tables()->RemoveLast();
+  EXPECT_CALL(*bfrt_table_manager_mock_, VerifyForwardingPipelineConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, UpdateP4Info(_, _)).Times(0);
+
+  bool pipeline_reloaded = true;
+  ::util::Status status = bfrt_node_->ReconcileAndCommitForwardingPipelineConfig(
+      config, &pipeline_reloaded);
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_FALSE(pipeline_reloaded);
+}
+
 // RegisterStreamMessageResponseWriter() should forward the call to
 // BfrtPacketioManager and return success or error based on the returned result.
 TEST_F(BfrtNodeTest, RegisterStreamMessageResponseWriter) {
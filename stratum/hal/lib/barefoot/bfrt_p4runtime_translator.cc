@@ -90,56 +90,56 @@ namespace barefoot {
   // Types that support P4Runtime translation:
   // Table.MatchField, Action.Param, ControllerPacketMetadata.Metadata
   // Counter, Meter, Register (index)
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, std::string>>
-      table_to_field_to_type_uri;
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, std::string>>
-      action_to_param_to_type_uri;
+  // For tables and actions, the mapping is compiled into translation plans so
+  // that translating an entry does not need any lookup by type or URI.
+  absl::flat_hash_map<uint32, TableTranslationPlan> table_to_plan;
+  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, ValueTranslation>>
+      action_to_param_to_translation;
   absl::flat_hash_map<uint32, std::string> packet_in_meta_to_type_uri;
   absl::flat_hash_map<uint32, std::string> packet_out_meta_to_type_uri;
   absl::flat_hash_map<uint32, std::string> counter_to_type_uri;
   absl::flat_hash_map<uint32, std::string> meter_to_type_uri;
   absl::flat_hash_map<uint32, std::string> register_to_type_uri;
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, int32>>
-      table_to_field_to_bit_width;
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, int32>>
-      action_to_param_to_bit_width;
   absl::flat_hash_map<uint32, int32> packet_in_meta_to_bit_width;
   absl::flat_hash_map<uint32, int32> packet_out_meta_to_bit_width;
 
-  for (const auto& table : p4info.tables()) {
-    for (const auto& match_field : table.match_fields()) {
-      if (match_field.has_type_name()) {
-        const auto& type_name = match_field.type_name().name();
-        const auto& table_id = table.preamble().id();
-        const auto& match_field_id = match_field.id();
+  for (const auto& action : p4info.actions()) {
+    for (const auto& param : action.params()) {
+      if (param.has_type_name()) {
+        const auto& type_name = param.type_name().name();
         std::string* uri = gtl::FindOrNull(type_name_to_uri, type_name);
-        if (uri) {
-          RET_CHECK(kUriToBitWidth.contains(*uri));
-          table_to_field_to_type_uri[table_id][match_field_id] = *uri;
-        }
         int32* bit_width = gtl::FindOrNull(type_name_to_bit_width, type_name);
-        if (bit_width) {
-          table_to_field_to_bit_width[table_id][match_field_id] = *bit_width;
+        if (uri && bit_width) {
+          ASSIGN_OR_RETURN(
+              action_to_param_to_translation[action.preamble().id()]
+                                            [param.id()],
+              BuildValueTranslation(*uri, *bit_width));
         }
       }
     }
   }
-  for (const auto& action : p4info.actions()) {
-    for (const auto& param : action.params()) {
-      if (param.has_type_name()) {
-        const auto& type_name = param.type_name().name();
-        const auto& action_id = action.preamble().id();
-        const auto& param_id = param.id();
+  for (const auto& table : p4info.tables()) {
+    TableTranslationPlan plan;
+    for (const auto& match_field : table.match_fields()) {
+      if (match_field.has_type_name()) {
+        const auto& type_name = match_field.type_name().name();
         std::string* uri = gtl::FindOrNull(type_name_to_uri, type_name);
-        if (uri) {
-          action_to_param_to_type_uri[action_id][param_id] = *uri;
-        }
         int32* bit_width = gtl::FindOrNull(type_name_to_bit_width, type_name);
-        if (bit_width) {
-          action_to_param_to_bit_width[action_id][param_id] = *bit_width;
+        if (uri && bit_width) {
+          ASSIGN_OR_RETURN(plan.match_fields[match_field.id()],
+                           BuildValueTranslation(*uri, *bit_width));
         }
       }
     }
+    for (const auto& action_ref : table.action_refs()) {
+      if (action_to_param_to_translation.contains(action_ref.id())) {
+        plan.translate_actions = true;
+        break;
+      }
+    }
+    if (!plan.match_fields.empty() || plan.translate_actions) {
+      table_to_plan[table.preamble().id()] = std::move(plan);
+    }
   }
   for (const auto& pkt_md : p4info.controller_packet_metadata()) {
     const auto& ctrl_hdr_name = pkt_md.preamble().name();
@@ -201,141 +201,176 @@ namespace barefoot {
       }
     }
   }
-  table_to_field_to_type_uri_ = table_to_field_to_type_uri;
-  action_to_param_to_type_uri_ = action_to_param_to_type_uri;
+  table_to_plan_ = std::move(table_to_plan);
+  action_to_param_to_translation_ = std::move(action_to_param_to_translation);
   packet_in_meta_to_type_uri_ = packet_in_meta_to_type_uri;
   packet_out_meta_to_type_uri_ = packet_out_meta_to_type_uri;
   counter_to_type_uri_ = counter_to_type_uri;
   meter_to_type_uri_ = meter_to_type_uri;
   register_to_type_uri_ = register_to_type_uri;
-  table_to_field_to_bit_width_ = table_to_field_to_bit_width;
-  action_to_param_to_bit_width_ = action_to_param_to_bit_width;
   packet_in_meta_to_bit_width_ = packet_in_meta_to_bit_width;
   packet_out_meta_to_bit_width_ = packet_out_meta_to_bit_width;
   pipeline_require_translation_ = true;
   return ::util::OkStatus();
 }
 
+::util::StatusOr<BfrtP4RuntimeTranslator::ValueTranslation>
+BfrtP4RuntimeTranslator::BuildValueTranslation(const std::string& uri,
+                                               int32 sdn_bit_width) {
+  ValueTranslation translation;
+  translation.uri = uri;
+  if (uri == kUriTnaPortId) {
+    translation.translate_func = &BfrtP4RuntimeTranslator::TranslateTnaPortId;
+  } else {
+    return MAKE_ERROR(ERR_UNIMPLEMENTED) << "Unsupported URI: " << uri;
+  }
+  translation.sdn_bit_width = sdn_bit_width;
+  translation.sdk_bit_width = gtl::FindWithDefault(kUriToBitWidth, uri, 0);
+  RET_CHECK(translation.sdn_bit_width > 0 && translation.sdk_bit_width > 0)
+      << "Invalid bit width for URI " << uri << ".";
+  translation.sdn_all_ones_mask = AllOnesByteString(translation.sdn_bit_width);
+  translation.sdk_all_ones_mask = AllOnesByteString(translation.sdk_bit_width);
+
+  return translation;
+}
+
 ::util::StatusOr<::p4::v1::TableEntry>
 BfrtP4RuntimeTranslator::TranslateTableEntry(const ::p4::v1::TableEntry& entry,
                                              bool to_sdk) {
   absl::ReaderMutexLock l(&lock_);
+  ::p4::v1::TableEntry translated_entry(entry);
+  if (pipeline_require_translation_) {
+    RETURN_IF_ERROR(TranslateTableEntryInternal(&translated_entry, to_sdk));
+  }
+  return translated_entry;
+}
+
+::util::Status BfrtP4RuntimeTranslator::TranslateTableEntryInPlace(
+    ::p4::v1::TableEntry* entry, bool to_sdk) {
+  absl::ReaderMutexLock l(&lock_);
   if (!pipeline_require_translation_) {
-    return entry;
+    return ::util::OkStatus();
   }
   return TranslateTableEntryInternal(entry, to_sdk);
 }
 
-::util::StatusOr<::p4::v1::TableEntry>
-BfrtP4RuntimeTranslator::TranslateTableEntryInternal(
-    const ::p4::v1::TableEntry& entry, bool to_sdk) {
-  ::p4::v1::TableEntry translated_entry(entry);
-  const auto& table_id = translated_entry.table_id();
-  if (table_to_field_to_type_uri_.contains(table_id) &&
-      table_to_field_to_bit_width_.contains(table_id)) {
-    for (::p4::v1::FieldMatch& field_match :
-         *translated_entry.mutable_match()) {
-      const auto& field_id = field_match.field_id();
-      std::string* uri =
-          gtl::FindOrNull(table_to_field_to_type_uri_[table_id], field_id);
-      if (!uri) {
-        continue;
-      }
-      int32 from_bit_width = 0;
-      int32 to_bit_width = 0;
-      if (to_sdk) {
-        from_bit_width = gtl::FindWithDefault(
-            table_to_field_to_bit_width_[table_id], field_id, 0);
-        to_bit_width = gtl::FindWithDefault(kUriToBitWidth, *uri, 0);
-      } else {
-        from_bit_width = gtl::FindWithDefault(kUriToBitWidth, *uri, 0);
-        to_bit_width = gtl::FindWithDefault(
-            table_to_field_to_bit_width_[table_id], field_id, 0);
-      }
-      if (!from_bit_width || !to_bit_width) {
-        continue;
-      }
-      switch (field_match.field_match_type_case()) {
-        case ::p4::v1::FieldMatch::kExact: {
-          ASSIGN_OR_RETURN(const std::string& new_val,
-                           TranslateValue(field_match.exact().value(), *uri,
-                                          to_sdk, to_bit_width));
-          field_match.mutable_exact()->set_value(new_val);
-          break;
-        }
-        case ::p4::v1::FieldMatch::kTernary: {
-          // We only allow the "exact" type of ternary match, which means
-          // all bits from mask must be one.
-          RET_CHECK(field_match.ternary().mask() ==
-                    AllOnesByteString(from_bit_width));
-          // New mask with bit width.
-          ASSIGN_OR_RETURN(const std::string& new_val,
-                           TranslateValue(field_match.ternary().value(), *uri,
-                                          to_sdk, to_bit_width));
-          field_match.mutable_ternary()->set_value(new_val);
-          field_match.mutable_ternary()->set_mask(
-              AllOnesByteString(to_bit_width));
-          break;
-        }
-        case ::p4::v1::FieldMatch::kLpm: {
-          // Only accept "exact match" LPM value, which means the prefix
-          // length must same as the bit width of the field.
-          RET_CHECK(field_match.lpm().prefix_len() == from_bit_width);
-          ASSIGN_OR_RETURN(const std::string& new_val,
-                           TranslateValue(field_match.lpm().value(), *uri,
-                                          to_sdk, to_bit_width));
-          field_match.mutable_lpm()->set_value(new_val);
-          field_match.mutable_lpm()->set_prefix_len(to_bit_width);
-          break;
-        }
-        case ::p4::v1::FieldMatch::kRange: {
-          // Only accept "exact match" range value, which means both low
-          // and high value must be the same.
-          RET_CHECK(field_match.range().low() == field_match.range().high());
-          ASSIGN_OR_RETURN(const std::string& new_val,
-                           TranslateValue(field_match.range().low(), *uri,
-                                          to_sdk, to_bit_width));
-          field_match.mutable_range()->set_low(new_val);
-          field_match.mutable_range()->set_high(new_val);
-          break;
-        }
-        case ::p4::v1::FieldMatch::kOptional: {
-          ASSIGN_OR_RETURN(const std::string& new_val,
-                           TranslateValue(field_match.optional().value(), *uri,
-                                          to_sdk, to_bit_width));
-          field_match.mutable_optional()->set_value(new_val);
-          break;
-        }
-        default:
-          return MAKE_ERROR(ERR_UNIMPLEMENTED)
-                 << "Unsupported field match type: "
-                 << field_match.ShortDebugString();
+bool BfrtP4RuntimeTranslator::TableEntryRequiresTranslation(
+    const ::p4::v1::TableEntry& entry) {
+  absl::ReaderMutexLock l(&lock_);
+  return pipeline_require_translation_ &&
+         table_to_plan_.contains(entry.table_id());
+}
+
+::util::Status BfrtP4RuntimeTranslator::TranslateTableEntryInternal(
+    ::p4::v1::TableEntry* entry, bool to_sdk) {
+  const TableTranslationPlan* plan =
+      gtl::FindOrNull(table_to_plan_, entry->table_id());
+  if (plan == nullptr) {
+    return ::util::OkStatus();
+  }
+  if (!plan->match_fields.empty()) {
+    for (::p4::v1::FieldMatch& field_match : *entry->mutable_match()) {
+      const ValueTranslation* translation =
+          gtl::FindOrNull(plan->match_fields, field_match.field_id());
+      if (translation) {
+        RETURN_IF_ERROR(
+            TranslateFieldMatch(*translation, &field_match, to_sdk));
       }
     }
   }
+  if (!plan->translate_actions) {
+    return ::util::OkStatus();
+  }
 
-  switch (translated_entry.action().type_case()) {
+  switch (entry->action().type_case()) {
     case ::p4::v1::TableAction::kAction: {
-      ASSIGN_OR_RETURN(
-          *(translated_entry.mutable_action()->mutable_action()),
-          TranslateAction(translated_entry.action().action(), to_sdk));
+      RETURN_IF_ERROR(
+          TranslateAction(entry->mutable_action()->mutable_action(), to_sdk));
       break;
     }
     case ::p4::v1::TableAction::kActionProfileActionSet: {
-      auto* action_set = translated_entry.mutable_action()
-                             ->mutable_action_profile_action_set();
+      auto* action_set =
+          entry->mutable_action()->mutable_action_profile_action_set();
       for (::p4::v1::ActionProfileAction& action_profile_action :
            *action_set->mutable_action_profile_actions()) {
-        ASSIGN_OR_RETURN(
-            *(action_profile_action.mutable_action()),
-            TranslateAction(action_profile_action.action(), to_sdk));
+        RETURN_IF_ERROR(
+            TranslateAction(action_profile_action.mutable_action(), to_sdk));
       }
       break;
     }
     default:
       break;
   }
-  return translated_entry;
+  return ::util::OkStatus();
+}
+
+::util::Status BfrtP4RuntimeTranslator::TranslateFieldMatch(
+    const ValueTranslation& translation, ::p4::v1::FieldMatch* field_match,
+    bool to_sdk) {
+  const int32 from_bit_width =
+      to_sdk ? translation.sdn_bit_width : translation.sdk_bit_width;
+  const int32 to_bit_width =
+      to_sdk ? translation.sdk_bit_width : translation.sdn_bit_width;
+  switch (field_match->field_match_type_case()) {
+    case ::p4::v1::FieldMatch::kExact: {
+      ASSIGN_OR_RETURN(
+          *field_match->mutable_exact()->mutable_value(),
+          (this->*translation.translate_func)(field_match->exact().value(),
+                                              to_sdk, to_bit_width));
+      break;
+    }
+    case ::p4::v1::FieldMatch::kTernary: {
+      // We only allow the "exact" type of ternary match, which means
+      // all bits from mask must be one.
+      const std::string& from_all_ones_mask =
+          to_sdk ? translation.sdn_all_ones_mask
+                 : translation.sdk_all_ones_mask;
+      RET_CHECK(field_match->ternary().mask() == from_all_ones_mask);
+      // New mask with bit width.
+      ASSIGN_OR_RETURN(
+          *field_match->mutable_ternary()->mutable_value(),
+          (this->*translation.translate_func)(field_match->ternary().value(),
+                                              to_sdk, to_bit_width));
+      field_match->mutable_ternary()->set_mask(
+          to_sdk ? translation.sdk_all_ones_mask
+                 : translation.sdn_all_ones_mask);
+      break;
+    }
+    case ::p4::v1::FieldMatch::kLpm: {
+      // Only accept "exact match" LPM value, which means the prefix
+      // length must same as the bit width of the field.
+      RET_CHECK(field_match->lpm().prefix_len() == from_bit_width);
+      ASSIGN_OR_RETURN(
+          *field_match->mutable_lpm()->mutable_value(),
+          (this->*translation.translate_func)(field_match->lpm().value(),
+                                              to_sdk, to_bit_width));
+      field_match->mutable_lpm()->set_prefix_len(to_bit_width);
+      break;
+    }
+    case ::p4::v1::FieldMatch::kRange: {
+      // Only accept "exact match" range value, which means both low
+      // and high value must be the same.
+      RET_CHECK(field_match->range().low() == field_match->range().high());
+      ASSIGN_OR_RETURN(
+          *field_match->mutable_range()->mutable_low(),
+          (this->*translation.translate_func)(field_match->range().low(),
+                                              to_sdk, to_bit_width));
+      field_match->mutable_range()->set_high(field_match->range().low());
+      break;
+    }
+    case ::p4::v1::FieldMatch::kOptional: {
+      ASSIGN_OR_RETURN(
+          *field_match->mutable_optional()->mutable_value(),
+          (this->*translation.translate_func)(field_match->optional().value(),
+                                              to_sdk, to_bit_width));
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Unsupported field match type: "
+             << field_match->ShortDebugString();
+  }
+  return ::util::OkStatus();
 }
 
 ::util::StatusOr<::p4::v1::ActionProfileMember>
@@ -345,12 +380,8 @@ BfrtP4RuntimeTranslator::TranslateActionProfileMember(
   if (!pipeline_require_translation_) {
     return act_prof_mem;
   }
-  ::p4::v1::ActionProfileMember translated_apm;
-  translated_apm.CopyFrom(act_prof_mem);
-  const auto& action_profile_id = act_prof_mem.action_profile_id();
-  const auto& member_id = act_prof_mem.member_id();
-  ASSIGN_OR_RETURN(*(translated_apm.mutable_action()),
-                   TranslateAction(translated_apm.action(), to_sdk));
+  ::p4::v1::ActionProfileMember translated_apm(act_prof_mem);
+  RETURN_IF_ERROR(TranslateAction(translated_apm.mutable_action(), to_sdk));
   return translated_apm;
 }
 
@@ -378,8 +409,8 @@ BfrtP4RuntimeTranslator::TranslateDirectMeterEntry(
     return entry;
   }
   ::p4::v1::DirectMeterEntry translated_entry(entry);
-  ASSIGN_OR_RETURN(*translated_entry.mutable_table_entry(),
-                   TranslateTableEntryInternal(entry.table_entry(), to_sdk));
+  RETURN_IF_ERROR(TranslateTableEntryInternal(
+      translated_entry.mutable_table_entry(), to_sdk));
   return translated_entry;
 }
 
@@ -433,8 +464,8 @@ BfrtP4RuntimeTranslator::TranslateDirectCounterEntry(
     return entry;
   }
   ::p4::v1::DirectCounterEntry translated_entry(entry);
-  ASSIGN_OR_RETURN(*translated_entry.mutable_table_entry(),
-                   TranslateTableEntryInternal(entry.table_entry(), to_sdk));
+  RETURN_IF_ERROR(TranslateTableEntryInternal(
+      translated_entry.mutable_table_entry(), to_sdk));
   return translated_entry;
 }
 
@@ -522,22 +553,35 @@ BfrtP4RuntimeTranslator::TranslatePacketMetadata(
 
 ::util::StatusOr<::p4::v1::PacketIn> BfrtP4RuntimeTranslator::TranslatePacketIn(
     const ::p4::v1::PacketIn& packet_in) {
+  ::p4::v1::PacketIn translated_packet_in(packet_in);
+  RETURN_IF_ERROR(TranslatePacketInInPlace(&translated_packet_in));
+  return translated_packet_in;
+}
+
+::util::Status BfrtP4RuntimeTranslator::TranslatePacketInInPlace(
+    ::p4::v1::PacketIn* packet_in) {
   absl::ReaderMutexLock l(&lock_);
   if (!pipeline_require_translation_) {
-    return packet_in;
+    return ::util::OkStatus();
   }
-  ::p4::v1::PacketIn translated_packet_in(packet_in);
-  for (auto& md : *translated_packet_in.mutable_metadata()) {
+  for (auto& md : *packet_in->mutable_metadata()) {
     const std::string* uri =
         gtl::FindOrNull(packet_in_meta_to_type_uri_, md.metadata_id());
     const int32* bit_width =
         gtl::FindOrNull(packet_in_meta_to_bit_width_, md.metadata_id());
     if (uri && bit_width) {
       ASSIGN_OR_RETURN(
-          md, TranslatePacketMetadata(md, *uri, *bit_width, /*to_sdk=*/false))
+          *md.mutable_value(),
+          TranslateValue(md.value(), *uri, /*to_sdk=*/false, *bit_width));
     }
   }
-  return translated_packet_in;
+  return ::util::OkStatus();
+}
+
+bool BfrtP4RuntimeTranslator::PacketOutRequiresTranslation() {
+  absl::ReaderMutexLock l(&lock_);
+  return pipeline_require_translation_ &&
+         !packet_out_meta_to_type_uri_.empty();
 }
 
 ::util::StatusOr<::p4::v1::PacketOut>
@@ -637,34 +681,27 @@ BfrtP4RuntimeTranslator::TranslateP4Info(
   return translated_p4info;
 }
 
-::util::StatusOr<::p4::v1::Action> BfrtP4RuntimeTranslator::TranslateAction(
-    const ::p4::v1::Action& action, bool to_sdk) {
-  ::p4::v1::Action translated_action;
-  translated_action.CopyFrom(action);
-  const auto& action_id = action.action_id();
-  if (action_to_param_to_type_uri_.contains(action_id) &&
-      action_to_param_to_bit_width_.contains(action_id)) {
-    for (::p4::v1::Action_Param& param : *translated_action.mutable_params()) {
-      const auto& param_id = param.param_id();
-      std::string* uri =
-          gtl::FindOrNull(action_to_param_to_type_uri_[action_id], param_id);
-      int32 to_bit_width = 0;
-      if (to_sdk && uri) {
-        to_bit_width = gtl::FindWithDefault(kUriToBitWidth, *uri, 0);
-      } else {
-        to_bit_width = gtl::FindWithDefault(
-            action_to_param_to_bit_width_[action_id], param_id, 0);
-      }
-      if (uri && to_bit_width) {
-        ASSIGN_OR_RETURN(
-            const std::string& new_val,
-            TranslateValue(param.value(), *uri, to_sdk, to_bit_width));
-        param.set_value(new_val);
-      }  // else, we don't modify the value if it doesn't need to be
-         // translated.
-    }
+::util::Status BfrtP4RuntimeTranslator::TranslateAction(
+    ::p4::v1::Action* action, bool to_sdk) {
+  const auto* param_to_translation =
+      gtl::FindOrNull(action_to_param_to_translation_, action->action_id());
+  if (param_to_translation == nullptr) {
+    return ::util::OkStatus();
   }
-  return translated_action;
+  for (::p4::v1::Action_Param& param : *action->mutable_params()) {
+    const ValueTranslation* translation =
+        gtl::FindOrNull(*param_to_translation, param.param_id());
+    if (translation) {
+      ASSIGN_OR_RETURN(
+          *param.mutable_value(),
+          (this->*translation->translate_func)(
+              param.value(), to_sdk,
+              to_sdk ? translation->sdk_bit_width
+                     : translation->sdn_bit_width));
+    }  // else, we don't modify the value if it doesn't need to be
+       // translated.
+  }
+  return ::util::OkStatus();
 }
 
 ::util::StatusOr<std::string> BfrtP4RuntimeTranslator::TranslateValue(
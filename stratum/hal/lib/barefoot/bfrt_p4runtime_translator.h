@@ -42,6 +42,16 @@ class BfrtP4RuntimeTranslator {
       const ::p4::config::v1::P4Info& p4info) LOCKS_EXCLUDED(lock_);
   virtual ::util::StatusOr<::p4::v1::TableEntry> TranslateTableEntry(
       const ::p4::v1::TableEntry& entry, bool to_sdk) LOCKS_EXCLUDED(lock_);
+  // Translates the given table entry in place. Entries of tables which do not
+  // use any translated type are left untouched.
+  virtual ::util::Status TranslateTableEntryInPlace(::p4::v1::TableEntry* entry,
+                                                    bool to_sdk)
+      LOCKS_EXCLUDED(lock_);
+  // Returns true if the given table entry belongs to a table which uses a
+  // translated type, i.e. if TranslateTableEntry() may modify it. Callers can
+  // use this to skip the copy made by TranslateTableEntry().
+  virtual bool TableEntryRequiresTranslation(const ::p4::v1::TableEntry& entry)
+      LOCKS_EXCLUDED(lock_);
   virtual ::util::StatusOr<::p4::v1::ActionProfileMember>
   TranslateActionProfileMember(const ::p4::v1::ActionProfileMember& entry,
                                bool to_sdk) LOCKS_EXCLUDED(lock_);
@@ -65,6 +75,13 @@ class BfrtP4RuntimeTranslator {
       const ::p4::v1::PacketIn& packet_in) LOCKS_EXCLUDED(lock_);
   virtual ::util::StatusOr<::p4::v1::PacketOut> TranslatePacketOut(
       const ::p4::v1::PacketOut& packet_out) LOCKS_EXCLUDED(lock_);
+  // Translates the metadata of the given PacketIn in place. The payload is
+  // never copied.
+  virtual ::util::Status TranslatePacketInInPlace(::p4::v1::PacketIn* packet_in)
+      LOCKS_EXCLUDED(lock_);
+  // Returns true if PacketOuts of the current pipeline carry metadata of a
+  // translated type, i.e. if TranslatePacketOut() may modify them.
+  virtual bool PacketOutRequiresTranslation() LOCKS_EXCLUDED(lock_);
   // A helper function which removes custom type from the P4Info.
   // Which is useful for some components that requires the original spec from
   // the P4 code.
@@ -97,17 +114,53 @@ class BfrtP4RuntimeTranslator {
         pipeline_require_translation_(false),
         bf_sde_interface_(bf_sde_interface),
         device_id_(device_id) {}
-  virtual ::util::StatusOr<::p4::v1::TableEntry> TranslateTableEntryInternal(
-      const ::p4::v1::TableEntry& entry, bool to_sdk)
-      SHARED_LOCKS_REQUIRED(lock_);
+  // Signature of the functions translating a value of a given URI.
+  typedef ::util::StatusOr<std::string> (BfrtP4RuntimeTranslator::*
+                                             ValueTranslationFunc)(
+      const std::string& value, bool to_sdk, int32 bit_width);
+
+  // Translation of a single match field or action parameter, resolved when
+  // the pipeline is pushed.
+  struct ValueTranslation {
+    std::string uri;
+    ValueTranslationFunc translate_func;
+    // Bit widths of the value on the SDN (controller) and SDK sides.
+    int32 sdn_bit_width;
+    int32 sdk_bit_width;
+    // All-ones ternary masks for both bit widths, precomputed to avoid
+    // building them for every entry.
+    std::string sdn_all_ones_mask;
+    std::string sdk_all_ones_mask;
+  };
+
+  // Per-table translation plan. Tables without a plan do not use any
+  // translated type and their entries are passed through untouched.
+  struct TableTranslationPlan {
+    // Match fields which need translation, keyed by match field ID.
+    absl::flat_hash_map<uint32, ValueTranslation> match_fields;
+    // True if some actions of the table have parameters which need
+    // translation.
+    bool translate_actions;
+    TableTranslationPlan() : translate_actions(false) {}
+  };
+
+  // Builds the translation of a value of the given URI. Returns an error if
+  // the URI is not supported.
+  static ::util::StatusOr<ValueTranslation> BuildValueTranslation(
+      const std::string& uri, int32 sdn_bit_width);
+  virtual ::util::Status TranslateTableEntryInternal(
+      ::p4::v1::TableEntry* entry, bool to_sdk) SHARED_LOCKS_REQUIRED(lock_);
+  virtual ::util::Status TranslateFieldMatch(
+      const ValueTranslation& translation, ::p4::v1::FieldMatch* field_match,
+      bool to_sdk) SHARED_LOCKS_REQUIRED(lock_);
   virtual ::util::StatusOr<::p4::v1::PacketMetadata> TranslatePacketMetadata(
       const p4::v1::PacketMetadata& packet_metadata, const std::string& uri,
       int32 bit_width, bool to_sdk) SHARED_LOCKS_REQUIRED(lock_);
   virtual ::util::StatusOr<::p4::v1::Replica> TranslateReplica(
       const ::p4::v1::Replica& replica, bool to_sdk)
       SHARED_LOCKS_REQUIRED(lock_);
-  virtual ::util::StatusOr<::p4::v1::Action> TranslateAction(
-      const ::p4::v1::Action& action, bool to_sdk) SHARED_LOCKS_REQUIRED(lock_);
+  virtual ::util::Status TranslateAction(::p4::v1::Action* action, bool to_sdk)
+      SHARED_LOCKS_REQUIRED(lock_);
   virtual ::util::StatusOr<::p4::v1::Index> TranslateIndex(
       const ::p4::v1::Index& index, const std::string& uri, bool to_sdk)
       SHARED_LOCKS_REQUIRED(lock_);
@@ -141,10 +194,12 @@ class BfrtP4RuntimeTranslator {
       GUARDED_BY(lock_);
 
   // P4Runtime translation information
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, std::string>>
-      table_to_field_to_type_uri_ GUARDED_BY(lock_);
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, std::string>>
-      action_to_param_to_type_uri_ GUARDED_BY(lock_);
+  // Translation plans of the tables and action parameters using translated
+  // types, compiled when the pipeline is pushed.
+  absl::flat_hash_map<uint32, TableTranslationPlan> table_to_plan_
+      GUARDED_BY(lock_);
+  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, ValueTranslation>>
+      action_to_param_to_translation_ GUARDED_BY(lock_);
   absl::flat_hash_map<uint32, std::string> packet_in_meta_to_type_uri_
       GUARDED_BY(lock_);
   absl::flat_hash_map<uint32, std::string> packet_out_meta_to_type_uri_
@@ -154,10 +209,6 @@ class BfrtP4RuntimeTranslator {
   absl::flat_hash_map<uint32, std::string> meter_to_type_uri_ GUARDED_BY(lock_);
   absl::flat_hash_map<uint32, std::string> register_to_type_uri_
       GUARDED_BY(lock_);
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, int32>>
-      table_to_field_to_bit_width_ GUARDED_BY(lock_);
-  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, int32>>
-      action_to_param_to_bit_width_ GUARDED_BY(lock_);
   absl::flat_hash_map<uint32, int32> packet_in_meta_to_bit_width_
       GUARDED_BY(lock_);
   absl::flat_hash_map<uint32, int32> packet_out_meta_to_bit_width_
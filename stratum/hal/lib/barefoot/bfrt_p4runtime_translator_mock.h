@@ -22,6 +22,10 @@ class BfrtP4RuntimeTranslatorMock : public BfrtP4RuntimeTranslator {
   MOCK_METHOD2(TranslateTableEntry,
                ::util::StatusOr<::p4::v1::TableEntry>(
                    const ::p4::v1::TableEntry& entry, bool to_sdk));
+  MOCK_METHOD2(TranslateTableEntryInPlace,
+               ::util::Status(::p4::v1::TableEntry* entry, bool to_sdk));
+  MOCK_METHOD1(TableEntryRequiresTranslation,
+               bool(const ::p4::v1::TableEntry& entry));
   MOCK_METHOD2(TranslateActionProfileMember,
                ::util::StatusOr<::p4::v1::ActionProfileMember>(
                    const ::p4::v1::ActionProfileMember& entry, bool to_sdk));
@@ -49,6 +53,9 @@ class BfrtP4RuntimeTranslatorMock : public BfrtP4RuntimeTranslator {
                                       const ::p4::v1::PacketIn& packet_in));
   MOCK_METHOD1(TranslatePacketOut, ::util::StatusOr<::p4::v1::PacketOut>(
                                        const ::p4::v1::PacketOut& packet_out));
+  MOCK_METHOD1(TranslatePacketInInPlace,
+               ::util::Status(::p4::v1::PacketIn* packet_in));
+  MOCK_METHOD0(PacketOutRequiresTranslation, bool());
   MOCK_METHOD1(TranslateP4Info, ::util::StatusOr<::p4::config::v1::P4Info>(
                                     const ::p4::config::v1::P4Info& p4info));
 };
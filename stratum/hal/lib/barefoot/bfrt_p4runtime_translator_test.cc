@@ -827,6 +827,77 @@ TEST_F(BfrtP4RuntimeTranslatorTest, ReadTableEntry_ActionProfileActionSet) {
                        &BfrtP4RuntimeTranslator::TranslateTableEntry);
 }
 
+TEST_F(BfrtP4RuntimeTranslatorTest, TranslateTableEntryInPlace) {
+  EXPECT_OK(PushChassisConfig());
+  EXPECT_OK(PushForwardingPipelineConfig());
+  constexpr char table_entry_str[] = R"pb(
+    table_id: 33583783
+    match {
+      field_id: 1
+      exact { value: "\x01\x2C" }
+    }
+    action {
+      action {
+        action_id: 16794911
+        params { param_id: 1 value: "\x01\x2C" }
+      }
+    }
+  )pb";
+  constexpr char expected_table_entry_str[] = R"pb(
+    table_id: 33583783
+    match {
+      field_id: 1
+      exact { value: "\x01" }
+    }
+    action {
+      action {
+        action_id: 16794911
+        params { param_id: 1 value: "\x01" }
+      }
+    }
+  )pb";
+  ::p4::v1::TableEntry table_entry;
+  ::p4::v1::TableEntry expected_table_entry;
+  ASSERT_OK(ParseProtoFromString(table_entry_str, &table_entry));
+  ASSERT_OK(
+      ParseProtoFromString(expected_table_entry_str, &expected_table_entry));
+  EXPECT_TRUE(
+      bfrt_p4runtime_translator_->TableEntryRequiresTranslation(table_entry));
+  EXPECT_OK(bfrt_p4runtime_translator_->TranslateTableEntryInPlace(
+      &table_entry, /*to_sdk=*/false));
+  EXPECT_THAT(table_entry, EqualsProto(expected_table_entry));
+}
+
+TEST_F(BfrtP4RuntimeTranslatorTest, TableWithoutTranslatedTypes) {
+  EXPECT_OK(PushChassisConfig());
+  EXPECT_OK(PushForwardingPipelineConfig());
+  // Entries of tables not using any translated type are passed through, even
+  // if their actions would need translation in another table.
+  constexpr char table_entry_str[] = R"pb(
+    table_id: 33554433
+    match {
+      field_id: 1
+      exact { value: "\x01" }
+    }
+    action {
+      action {
+        action_id: 16794911
+        params { param_id: 1 value: "\x01" }
+      }
+    }
+  )pb";
+  ::p4::v1::TableEntry table_entry;
+  ASSERT_OK(ParseProtoFromString(table_entry_str, &table_entry));
+  const ::p4::v1::TableEntry original_table_entry = table_entry;
+  EXPECT_FALSE(
+      bfrt_p4runtime_translator_->TableEntryRequiresTranslation(table_entry));
+  EXPECT_OK(bfrt_p4runtime_translator_->TranslateTableEntryInPlace(
+      &table_entry, /*to_sdk=*/true));
+  EXPECT_THAT(table_entry, EqualsProto(original_table_entry));
+  TestEntryTranslation(table_entry_str, table_entry_str, true,
+                       &BfrtP4RuntimeTranslator::TranslateTableEntry);
+}
+
 TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_InvalidTernary) {
   EXPECT_OK(PushChassisConfig());
   EXPECT_OK(PushForwardingPipelineConfig());
@@ -845,8 +916,8 @@ TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_InvalidTernary) {
                   .status(),
               DerivedFromStatus(::util::Status(
                   StratumErrorSpace(), ERR_INVALID_PARAM,
-                  "'field_match.ternary().mask() == "
-                  "AllOnesByteString(from_bit_width)' is false.")));
+                  "'field_match->ternary().mask() == "
+                  "from_all_ones_mask' is false.")));
 }
 
 TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_InvalidRange) {
@@ -867,8 +938,8 @@ TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_InvalidRange) {
                   .status(),
               DerivedFromStatus(
                   ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM,
-                                 "'field_match.range().low() == "
-                                 "field_match.range().high()' is false.")));
+                                 "'field_match->range().low() == "
+                                 "field_match->range().high()' is false.")));
 }
 
 TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_InvalidLpm) {
@@ -890,7 +961,7 @@ TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_InvalidLpm) {
           .status(),
       DerivedFromStatus(::util::Status(
           StratumErrorSpace(), ERR_INVALID_PARAM,
-          "'field_match.lpm().prefix_len() == from_bit_width' is false.")));
+          "'field_match->lpm().prefix_len() == from_bit_width' is false.")));
 }
 
 // Action profile member
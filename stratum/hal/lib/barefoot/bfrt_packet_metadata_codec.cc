@@ -0,0 +1,216 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_packet_metadata_codec.h"
+
+#include <endian.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "absl/container/inlined_vector.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+constexpr int BfrtPacketMetadataCodec::kMaxSegmentBitWidth;
+constexpr uint32 BfrtPacketMetadataCodec::kMaxDenseMetadataId;
+
+namespace {
+
+// Returns the bit_width (<= 56) bits at bit_offset in the header.
+inline uint64 LoadBits(const char* header, size_t header_size,
+                       size_t bit_offset, int bit_width) {
+  const size_t first_byte = bit_offset / 8;
+  const int shift = bit_offset % 8;
+  uint64 word = 0;
+  if (first_byte + sizeof(word) <= header_size) {
+    memcpy(&word, header + first_byte, sizeof(word));
+    word = be64toh(word);
+  } else {
+    // Near the end of the header, never read past it.
+    const int num_bytes = (shift + bit_width + 7) / 8;
+    for (int i = 0; i < num_bytes; ++i) {
+      word |= static_cast<uint64>(static_cast<uint8>(header[first_byte + i]))
+              << (56 - 8 * i);
+    }
+  }
+
+  return (word << shift) >> (64 - bit_width);
+}
+
+// ORs the bit_width (<= 56) bits of value at bit_offset in the header.
+inline void StoreBits(char* header, size_t header_size, size_t bit_offset,
+                      int bit_width, uint64 value) {
+  const size_t first_byte = bit_offset / 8;
+  const int shift = bit_offset % 8;
+  const uint64 bits = value << (64 - bit_width - shift);
+  if (first_byte + sizeof(bits) <= header_size) {
+    uint64 word;
+    memcpy(&word, header + first_byte, sizeof(word));
+    word = htobe64(be64toh(word) | bits);
+    memcpy(header + first_byte, &word, sizeof(word));
+  } else {
+    const int num_bytes = (shift + bit_width + 7) / 8;
+    for (int i = 0; i < num_bytes; ++i) {
+      header[first_byte + i] |= static_cast<char>(bits >> (56 - 8 * i));
+    }
+  }
+}
+
+inline uint64 LowBitsMask(int bit_width) {
+  return bit_width >= 64 ? ~0ULL : (1ULL << bit_width) - 1;
+}
+
+}  // namespace
+
+BfrtPacketMetadataCodec::BfrtPacketMetadataCodec()
+    : fields_(),
+      segments_(),
+      dense_id_to_field_(),
+      sparse_id_to_field_(),
+      header_size_(0) {}
+
+::util::StatusOr<BfrtPacketMetadataCodec> BfrtPacketMetadataCodec::Create(
+    const std::vector<std::pair<uint32, int>>& header) {
+  BfrtPacketMetadataCodec codec;
+  size_t bit_offset = 0;
+  for (const auto& p : header) {
+    const uint32 id = p.first;
+    const int bit_width = p.second;
+    RET_CHECK(bit_width > 0) << "Invalid bit width " << bit_width
+                             << " for metadata with Id " << id << ".";
+    RET_CHECK(codec.FindField(id) == -1)
+        << "Duplicate metadata with Id " << id << ".";
+    Field field;
+    field.id = id;
+    field.bit_width = bit_width;
+    field.num_bytes = (bit_width + 7) / 8;
+    field.first_segment = codec.segments_.size();
+    // Split the field into segments, starting from the least significant bits.
+    for (int low_bit = 0; low_bit < bit_width;
+         low_bit += kMaxSegmentBitWidth) {
+      Segment segment;
+      segment.bit_width = std::min(kMaxSegmentBitWidth, bit_width - low_bit);
+      segment.bit_offset =
+          bit_offset + bit_width - low_bit - segment.bit_width;
+      segment.value_byte_offset = low_bit / 8;
+      codec.segments_.push_back(segment);
+    }
+    field.num_segments = codec.segments_.size() - field.first_segment;
+    const int index = codec.fields_.size();
+    codec.fields_.push_back(field);
+    if (id < kMaxDenseMetadataId) {
+      if (codec.dense_id_to_field_.size() <= id) {
+        codec.dense_id_to_field_.resize(id + 1, -1);
+      }
+      codec.dense_id_to_field_[id] = index;
+    } else {
+      codec.sparse_id_to_field_[id] = index;
+    }
+    bit_offset += bit_width;
+  }
+  RET_CHECK(bit_offset % 8 == 0)
+      << "Header size must be multiple of 8 bits, got " << bit_offset << ".";
+  codec.header_size_ = bit_offset / 8;
+
+  return codec;
+}
+
+int BfrtPacketMetadataCodec::FindField(uint32 id) const {
+  if (id < dense_id_to_field_.size()) return dense_id_to_field_[id];
+  if (id < kMaxDenseMetadataId) return -1;
+  auto it = sparse_id_to_field_.find(id);
+  return it == sparse_id_to_field_.end() ? -1 : it->second;
+}
+
+::util::Status BfrtPacketMetadataCodec::Encode(
+    const ::google::protobuf::RepeatedPtrField<::p4::v1::PacketMetadata>&
+        metadata,
+    char* header) const {
+  // Slot of each field, in header order. Inline storage covers all the
+  // headers we have seen, so there is no allocation per packet.
+  absl::InlinedVector<const ::p4::v1::PacketMetadata*, 16> slots(
+      fields_.size(), nullptr);
+  for (const auto& md : metadata) {
+    const int index = FindField(md.metadata_id());
+    // The first metadata with a given id wins.
+    if (index >= 0 && slots[index] == nullptr) slots[index] = &md;
+  }
+
+  memset(header, 0, header_size_);
+  for (size_t i = 0; i < fields_.size(); ++i) {
+    const Field& field = fields_[i];
+    if (slots[i] == nullptr) {
+      return MAKE_ERROR(ERR_INTERNAL) << "Missing metadata with Id "
+                                      << field.id;
+    }
+    const std::string& value = slots[i]->value();
+    const int value_size = value.size();
+    // Reject values which do not fit the field.
+    if (value_size > field.num_bytes ||
+        (value_size == field.num_bytes && field.bit_width % 8 != 0 &&
+         static_cast<uint8>(value[0]) >> (field.bit_width % 8) != 0)) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Bytestring " << StringToHex(value) << " overflows bit width "
+             << field.bit_width << " of metadata with Id " << field.id;
+    }
+    for (size_t s = 0; s < field.num_segments; ++s) {
+      const Segment& segment = segments_[field.first_segment + s];
+      // Gather the value bytes of this segment, big-endian.
+      const int end = value_size - segment.value_byte_offset;
+      const int begin = std::max(0, end - (kMaxSegmentBitWidth / 8));
+      uint64 bits = 0;
+      for (int b = begin; b < end; ++b) {
+        bits = (bits << 8) | static_cast<uint8>(value[b]);
+      }
+      bits &= LowBitsMask(segment.bit_width);
+      if (bits) {
+        StoreBits(header, header_size_, segment.bit_offset, segment.bit_width,
+                  bits);
+      }
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+void BfrtPacketMetadataCodec::Decode(
+    const char* header,
+    ::google::protobuf::RepeatedPtrField<::p4::v1::PacketMetadata>* metadata)
+    const {
+  for (const Field& field : fields_) {
+    ::p4::v1::PacketMetadata* md = metadata->Add();
+    md->set_metadata_id(field.id);
+    std::string* value = md->mutable_value();
+    value->resize(field.num_bytes);
+    for (size_t s = 0; s < field.num_segments; ++s) {
+      const Segment& segment = segments_[field.first_segment + s];
+      uint64 bits = LoadBits(header, header_size_, segment.bit_offset,
+                             segment.bit_width);
+      // Scatter the bits to the value bytes of this segment, big-endian.
+      const int end = field.num_bytes - segment.value_byte_offset;
+      const int begin = end - (segment.bit_width + 7) / 8;
+      for (int b = end - 1; b >= begin; --b) {
+        (*value)[b] = static_cast<char>(bits & 0xff);
+        bits >>= 8;
+      }
+    }
+    // Canonical P4Runtime byte string: no leading zeros, at least one byte.
+    size_t first_non_zero = 0;
+    while (first_non_zero + 1 < value->size() &&
+           (*value)[first_non_zero] == 0) {
+      ++first_non_zero;
+    }
+    if (first_non_zero) value->erase(0, first_non_zero);
+  }
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
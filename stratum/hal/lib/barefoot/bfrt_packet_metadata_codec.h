@@ -0,0 +1,102 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BFRT_PACKET_METADATA_CODEC_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BFRT_PACKET_METADATA_CODEC_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "google/protobuf/repeated_field.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// The "BfrtPacketMetadataCodec" class encodes and decodes the controller
+// packet metadata header (packet_in or packet_out) in front of the packets
+// exchanged with the CPU port. It is compiled once per pipeline from the list
+// of (metadata id, bit width) pairs of the header: the bit offset of every
+// field is precomputed and fields are moved with 64-bit shift and mask
+// operations, directly from and to the packet buffer.
+class BfrtPacketMetadataCodec {
+ public:
+  // Creates an empty codec, with a zero-length header.
+  BfrtPacketMetadataCodec();
+
+  // Compiles a codec for the given header. The fields are laid out in the
+  // given order, the first one in the most significant bits of the first byte.
+  // Returns an error if the header is not a whole number of bytes.
+  static ::util::StatusOr<BfrtPacketMetadataCodec> Create(
+      const std::vector<std::pair<uint32, int>>& header);
+
+  // Size of the encoded header in bytes.
+  size_t header_size() const { return header_size_; }
+
+  // Encodes the given metadata into the header_size() bytes at 'header'. Each
+  // field of the header must have a matching metadata. Metadata which are not
+  // part of the header are ignored.
+  ::util::Status Encode(
+      const ::google::protobuf::RepeatedPtrField<::p4::v1::PacketMetadata>&
+          metadata,
+      char* header) const;
+
+  // Decodes the header_size() bytes at 'header', appending one metadata per
+  // field of the header. Values are canonical P4Runtime byte strings.
+  void Decode(const char* header,
+              ::google::protobuf::RepeatedPtrField<::p4::v1::PacketMetadata>*
+                  metadata) const;
+
+ private:
+  // Part of a field fitting in a 64-bit word wherever it is in the header.
+  // Fields wider than kMaxSegmentBitWidth are split in several segments, from
+  // the least significant bits.
+  struct Segment {
+    // Offset of the segment in the header, in bits.
+    size_t bit_offset;
+    int bit_width;
+    // Number of value bytes on the right of the segment.
+    int value_byte_offset;
+  };
+
+  struct Field {
+    uint32 id;
+    int bit_width;
+    // Size of the field in bytes.
+    int num_bytes;
+    // Range of the segments of this field in segments_.
+    size_t first_segment;
+    size_t num_segments;
+  };
+
+  // Max number of bits per segment. With any bit alignment, a segment covers
+  // at most 8 bytes of the header.
+  static constexpr int kMaxSegmentBitWidth = 56;
+
+  // Metadata ids below this value are looked up in a dense table. P4 compilers
+  // assign ids from 1, so only unusual P4Infos use the sparse map.
+  static constexpr uint32 kMaxDenseMetadataId = 256;
+
+  // Returns the index of the field with the given id in fields_, -1 if the
+  // header has no such field.
+  int FindField(uint32 id) const;
+
+  std::vector<Field> fields_;
+  std::vector<Segment> segments_;
+  // Map from metadata id to index in fields_, -1 for unknown ids.
+  std::vector<int> dense_id_to_field_;
+  absl::flat_hash_map<uint32, int> sparse_id_to_field_;
+  size_t header_size_;
+};
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BFRT_PACKET_METADATA_CODEC_H_
@@ -0,0 +1,202 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_packet_metadata_codec.h"
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/p4/utils.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+using ::testing::HasSubstr;
+
+namespace {
+
+::p4::v1::PacketOut MakePacketOut(
+    const std::vector<std::pair<uint32, std::string>>& metadata) {
+  ::p4::v1::PacketOut packet;
+  for (const auto& md : metadata) {
+    auto* m = packet.add_metadata();
+    m->set_metadata_id(md.first);
+    m->set_value(md.second);
+  }
+  return packet;
+}
+
+// Reference encoder, one bit at a time.
+std::string EncodeBitByBit(const std::vector<std::pair<uint32, int>>& header,
+                           const std::vector<std::string>& values) {
+  std::vector<bool> bits;
+  for (size_t i = 0; i < header.size(); ++i) {
+    const int bit_width = header[i].second;
+    const std::string& value = values[i];
+    for (int bit = bit_width - 1; bit >= 0; --bit) {
+      const int byte = value.size() - 1 - bit / 8;
+      bits.push_back(byte >= 0 && (static_cast<uint8>(value[byte]) >>
+                                   (bit % 8)) & 1);
+    }
+  }
+  std::string out(bits.size() / 8, '\0');
+  for (size_t i = 0; i < bits.size(); ++i) {
+    if (bits[i]) out[i / 8] |= 0x80 >> (i % 8);
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(BfrtPacketMetadataCodecTest, EncodeAndDecode) {
+  // Same layout as the fabric packet_out header.
+  const std::vector<std::pair<uint32, int>> header = {
+      {1, 9}, {2, 2}, {3, 85}, {4, 16}};
+  auto ret = BfrtPacketMetadataCodec::Create(header);
+  ASSERT_OK(ret.status());
+  const BfrtPacketMetadataCodec codec = ret.ConsumeValueOrDie();
+  EXPECT_EQ(14U, codec.header_size());
+
+  // Metadata order does not matter, unknown metadata is ignored.
+  const ::p4::v1::PacketOut packet = MakePacketOut(
+      {{4, "\xbf\x01"}, {99, "\x12"}, {1, "\x01"}, {2, ""}, {3, "\x00"}});
+  std::string buffer(codec.header_size(), '\xff');
+  ASSERT_OK(codec.Encode(packet.metadata(), &buffer[0]));
+  EXPECT_EQ(std::string("\0\x80\0\0\0\0\0\0\0\0\0\0\xbf\x01", 14), buffer);
+
+  ::p4::v1::PacketIn packet_in;
+  codec.Decode(buffer.data(), packet_in.mutable_metadata());
+  ASSERT_EQ(4, packet_in.metadata_size());
+  EXPECT_EQ(1U, packet_in.metadata(0).metadata_id());
+  EXPECT_EQ("\x01", packet_in.metadata(0).value());
+  EXPECT_EQ(2U, packet_in.metadata(1).metadata_id());
+  EXPECT_EQ(std::string("\0", 1), packet_in.metadata(1).value());
+  EXPECT_EQ(3U, packet_in.metadata(2).metadata_id());
+  EXPECT_EQ(std::string("\0", 1), packet_in.metadata(2).value());
+  EXPECT_EQ(4U, packet_in.metadata(3).metadata_id());
+  EXPECT_EQ("\xbf\x01", packet_in.metadata(3).value());
+}
+
+TEST(BfrtPacketMetadataCodecTest, DecodeReusesClearedMessage) {
+  auto ret = BfrtPacketMetadataCodec::Create({{1, 9}, {2, 103}});
+  ASSERT_OK(ret.status());
+  const BfrtPacketMetadataCodec codec = ret.ConsumeValueOrDie();
+  const std::string header(codec.header_size(), '\x5a');
+
+  ::p4::v1::PacketIn packet_in;
+  codec.Decode(header.data(), packet_in.mutable_metadata());
+  ASSERT_EQ(2, packet_in.metadata_size());
+  const ::p4::v1::PacketMetadata* metadata = &packet_in.metadata(1);
+  const char* value = packet_in.metadata(1).value().data();
+
+  // A cleared PacketIn keeps its metadata messages and value storage.
+  packet_in.Clear();
+  codec.Decode(header.data(), packet_in.mutable_metadata());
+  ASSERT_EQ(2, packet_in.metadata_size());
+  EXPECT_EQ(metadata, &packet_in.metadata(1));
+  EXPECT_EQ(value, packet_in.metadata(1).value().data());
+}
+
+TEST(BfrtPacketMetadataCodecTest, RoundTripMatchesBitByBitEncoding) {
+  std::mt19937 gen(42);
+  for (int iteration = 0; iteration < 200; ++iteration) {
+    // Random header layout, padded to a whole number of bytes. Some ids are
+    // large enough to use the sparse id lookup.
+    std::vector<std::pair<uint32, int>> header;
+    int total_bits = 0;
+    const int num_fields = 1 + gen() % 8;
+    for (int i = 0; i < num_fields; ++i) {
+      const int bit_width = 1 + gen() % 130;
+      header.push_back(std::make_pair(i % 2 ? i + 1 : 1000 + i, bit_width));
+      total_bits += bit_width;
+    }
+    if (total_bits % 8) {
+      header.push_back(std::make_pair(500, 8 - total_bits % 8));
+    }
+    auto ret = BfrtPacketMetadataCodec::Create(header);
+    ASSERT_OK(ret.status());
+    const BfrtPacketMetadataCodec codec = ret.ConsumeValueOrDie();
+
+    // Random values, in canonical P4Runtime form.
+    std::vector<std::string> values;
+    ::p4::v1::PacketOut packet;
+    for (const auto& field : header) {
+      std::string value((field.second + 7) / 8, '\0');
+      for (auto& c : value) c = static_cast<char>(gen());
+      if (field.second % 8) {
+        value[0] &= (1 << (field.second % 8)) - 1;
+      }
+      value = ByteStringToP4RuntimeByteString(value);
+      values.push_back(value);
+      auto* md = packet.add_metadata();
+      md->set_metadata_id(field.first);
+      md->set_value(value);
+    }
+
+    std::string buffer(codec.header_size(), '\0');
+    ASSERT_OK(codec.Encode(packet.metadata(), &buffer[0]));
+    EXPECT_EQ(EncodeBitByBit(header, values), buffer);
+
+    ::p4::v1::PacketIn packet_in;
+    codec.Decode(buffer.data(), packet_in.mutable_metadata());
+    ASSERT_EQ(static_cast<int>(header.size()), packet_in.metadata_size());
+    for (size_t i = 0; i < header.size(); ++i) {
+      EXPECT_EQ(header[i].first, packet_in.metadata(i).metadata_id());
+      EXPECT_EQ(values[i], packet_in.metadata(i).value());
+    }
+  }
+}
+
+TEST(BfrtPacketMetadataCodecTest, EncodeFailsForMissingMetadata) {
+  auto ret = BfrtPacketMetadataCodec::Create({{1, 9}, {2, 7}});
+  ASSERT_OK(ret.status());
+  const BfrtPacketMetadataCodec codec = ret.ConsumeValueOrDie();
+  const ::p4::v1::PacketOut packet = MakePacketOut({{1, "\x01"}});
+  std::string buffer(codec.header_size(), '\0');
+  ::util::Status status = codec.Encode(packet.metadata(), &buffer[0]);
+  EXPECT_EQ(ERR_INTERNAL, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Missing metadata with Id 2"));
+}
+
+TEST(BfrtPacketMetadataCodecTest, EncodeFailsForOverflowingValue) {
+  auto ret = BfrtPacketMetadataCodec::Create({{1, 9}, {2, 7}});
+  ASSERT_OK(ret.status());
+  const BfrtPacketMetadataCodec codec = ret.ConsumeValueOrDie();
+  std::string buffer(codec.header_size(), '\0');
+  for (const std::string& value :
+       {std::string("\x02\x00", 2), std::string("\x00\x00\x01", 3)}) {
+    const ::p4::v1::PacketOut packet = MakePacketOut({{1, value}, {2, ""}});
+    ::util::Status status = codec.Encode(packet.metadata(), &buffer[0]);
+    EXPECT_EQ(ERR_INTERNAL, status.error_code());
+    EXPECT_THAT(status.error_message(), HasSubstr("overflows bit width 9"));
+  }
+}
+
+TEST(BfrtPacketMetadataCodecTest, CreateFailsForInvalidHeader) {
+  EXPECT_FALSE(BfrtPacketMetadataCodec::Create({{1, 9}}).ok());
+  EXPECT_FALSE(BfrtPacketMetadataCodec::Create({{1, 8}, {1, 8}}).ok());
+  EXPECT_FALSE(BfrtPacketMetadataCodec::Create({{1, 0}, {2, 8}}).ok());
+}
+
+TEST(BfrtPacketMetadataCodecTest, EmptyHeader) {
+  BfrtPacketMetadataCodec codec;
+  EXPECT_EQ(0U, codec.header_size());
+  std::string buffer;
+  const ::p4::v1::PacketOut packet = MakePacketOut({{1, "\x01"}});
+  EXPECT_OK(codec.Encode(packet.metadata(), &buffer[0]));
+  ::p4::v1::PacketIn packet_in;
+  codec.Decode(buffer.data(), packet_in.mutable_metadata());
+  EXPECT_EQ(0, packet_in.metadata_size());
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -17,9 +17,13 @@
 #include <linux/if_tun.h>
 #include <sys/epoll.h>
 
-#include <deque>
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "absl/cleanup/cleanup.h"
+#include "absl/strings/str_cat.h"
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/hal/lib/common/constants.h"
 #include "stratum/hal/lib/p4/utils.h"
@@ -35,13 +39,27 @@ DEFINE_string(
     "interface are delivered verbatim to the pipeline over the PCIe CPU port.");
 DEFINE_int32(experimental_tap_rx_poll_timeout_ms, 100,
              "Polling timeout to check incoming packets from TAP RX sockets.");
+DEFINE_int32(experimental_tap_num_queues, 1,
+             "Number of queues of the virtual CPU interface. With more than "
+             "one queue, the TAP interface is created with IFF_MULTI_QUEUE "
+             "and each queue is served by its own RX thread.");
+DEFINE_int32(experimental_tap_rx_burst_size, 32,
+             "Max number of packets read from a virtual CPU interface queue "
+             "per wakeup of its RX thread.");
 
 namespace stratum {
 namespace hal {
 namespace barefoot {
 
 namespace {
-::util::StatusOr<int> CreateOrOpenTapIntf(std::string name) {
+// Number of idle PacketOut buffers kept in the pool, and capacity reserved for
+// each of them.
+constexpr size_t kMaxFreePacketTxBuffers = 32;
+constexpr size_t kPacketTxBufferCapacity = 2048;
+
+// Opens one queue of the TAP interface with the given name, creating the
+// interface if needed. The returned file descriptor is non-blocking.
+::util::StatusOr<int> OpenTapQueue(const std::string& name, bool multi_queue) {
   // Note: During development we noticed that the canonical TUN device at
   //       /dev/net/tun fails to open. The SDE team created a copy of the tun
   //       driver, bf_tun, which is loaded by default and does work correctly.
@@ -53,15 +71,16 @@ namespace {
   int fd = -1;
   if (PathExists(barefoot_tun_device_path)) {
     // We're on a Tofino switch. Use the patched TUN/TAP driver.
-    fd = open(barefoot_tun_device_path, O_RDWR);
+    fd = open(barefoot_tun_device_path, O_RDWR | O_NONBLOCK);
   } else {
     // We're on a normal UNIX device. Use canonical TUN/TAP driver.
-    fd = open(canonical_tun_device_path, O_RDWR);
+    fd = open(canonical_tun_device_path, O_RDWR | O_NONBLOCK);
   }
 
   RET_CHECK(fd >= 0) << "Failed to open: " << strerror(errno);
   struct ifreq ifr = {};
   ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  if (multi_queue) ifr.ifr_flags |= IFF_MULTI_QUEUE;
   strncpy(ifr.ifr_name, name.c_str(), IFNAMSIZ);
   if (ioctl(fd, TUNSETIFF, &ifr) == -1) {
     close(fd);
@@ -69,17 +88,36 @@ namespace {
            << "Couldn't create TAP interface " << ifr.ifr_name << ": "
            << strerror(errno) << ".";
   }
-
-  LOG(INFO) << "Created or opened TAP interface with name " << ifr.ifr_name
-            << ".";
   CHECK_EQ(ifr.ifr_name, name) << "Actual and requested TAP intf name differ.";
 
+  return fd;
+}
+
+// Creates or opens the TAP interface with the given name and returns the file
+// descriptors of its queues. More than one queue requires IFF_MULTI_QUEUE,
+// which lets the kernel spread the packets sent to the interface over the
+// queues.
+::util::StatusOr<std::vector<int>> CreateOrOpenTapIntf(const std::string& name,
+                                                       int num_queues) {
+  RET_CHECK(num_queues > 0) << "Invalid number of TAP queues " << num_queues
+                            << ".";
+  std::vector<int> fds;
+  auto fds_closer = absl::MakeCleanup([&fds]() {
+    for (int fd : fds) close(fd);
+  });
+  for (int i = 0; i < num_queues; ++i) {
+    ASSIGN_OR_RETURN(int fd, OpenTapQueue(name, num_queues > 1));
+    fds.push_back(fd);
+  }
+  LOG(INFO) << "Created or opened TAP interface with name " << name << " and "
+            << num_queues << " queue(s).";
+
   // Configure the new TAP interface.
   // We use a dummy socket and IOCTL to setup the interface.
   int sock = socket(AF_INET, SOCK_DGRAM, 0);
 
   // Set MAC address.
-  memset(&ifr, 0, sizeof(ifr));
+  struct ifreq ifr = {};
   strncpy(ifr.ifr_name, name.c_str(), IFNAMSIZ);
   ifr.ifr_hwaddr.sa_family = ARPHRD_ETHER;
   const uint8 mac[6] = {'\x00', '\x00', '\x00', '\x33', '\x33', '\x33'};
@@ -108,8 +146,9 @@ namespace {
            << strerror(errno) << ".";
   }
   close(sock);
+  std::move(fds_closer).Cancel();
 
-  return fd;
+  return fds;
 }
 
 ::util::Status SetOwnThreadName(std::string name) {
@@ -124,14 +163,14 @@ BfrtPacketioManager::BfrtPacketioManager(
     BfrtP4RuntimeTranslator* bfrt_p4runtime_translator, int device)
     : initialized_(false),
       rx_writer_(nullptr),
-      packetin_header_(),
-      packetout_header_(),
-      packetin_header_size_(),
-      packetout_header_size_(),
+      packetin_codec_(),
+      packetout_codec_(),
       packet_receive_channel_(nullptr),
-      tap_intf_fd_(-1),
+      tap_queues_(),
       sde_rx_thread_id_(),
-      virtual_cpu_intf_rx_thread_id_(),
+      virtual_cpu_intf_stats_(),
+      packet_tx_buffer_pool_(PacketBufferPool::Create(
+          kMaxFreePacketTxBuffers, kPacketTxBufferCapacity)),
       bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)),
       bfrt_p4runtime_translator_(ABSL_DIE_IF_NULL(bfrt_p4runtime_translator)),
       device_(device) {}
@@ -139,14 +178,14 @@ BfrtPacketioManager::BfrtPacketioManager(
 BfrtPacketioManager::BfrtPacketioManager()
     : initialized_(false),
       rx_writer_(nullptr),
-      packetin_header_(),
-      packetout_header_(),
-      packetin_header_size_(),
-      packetout_header_size_(),
+      packetin_codec_(),
+      packetout_codec_(),
       packet_receive_channel_(nullptr),
-      tap_intf_fd_(-1),
+      tap_queues_(),
       sde_rx_thread_id_(),
-      virtual_cpu_intf_rx_thread_id_(),
+      virtual_cpu_intf_stats_(),
+      packet_tx_buffer_pool_(PacketBufferPool::Create(
+          kMaxFreePacketTxBuffers, kPacketTxBufferCapacity)),
       bf_sde_interface_(nullptr),
       device_(-1) {}
 
@@ -176,7 +215,7 @@ std::unique_ptr<BfrtPacketioManager> BfrtPacketioManager::CreateInstance(
   // PushForwardingPipelineConfig resets the bf_pkt driver.
   RETURN_IF_ERROR(bf_sde_interface_->StartPacketIo(device_));
   if (!initialized_) {
-    packet_receive_channel_ = Channel<std::string>::Create(128);
+    packet_receive_channel_ = Channel<PacketBuffer>::Create(128);
     if (sde_rx_thread_id_ == 0) {
       int ret = pthread_create(&sde_rx_thread_id_, nullptr,
                                &BfrtPacketioManager::SdeRxThreadFunc, this);
@@ -187,21 +226,35 @@ std::unique_ptr<BfrtPacketioManager> BfrtPacketioManager::CreateInstance(
       }
     }
     RETURN_IF_ERROR(bf_sde_interface_->RegisterPacketReceiveWriter(
-        device_, ChannelWriter<std::string>::Create(packet_receive_channel_)));
-    // Bind to provided interface and start rx/tx handler.
+        device_,
+        ChannelWriter<PacketBuffer>::Create(packet_receive_channel_)));
+    // Bind to provided interface and start rx/tx handler. The queues are only
+    // opened here if they were not set up before, e.g. by tests.
     if (!FLAGS_experimental_bfrt_tofino_virtual_cpu_interface_name.empty()) {
-      ASSIGN_OR_RETURN(
-          tap_intf_fd_,
-          CreateOrOpenTapIntf(
-              FLAGS_experimental_bfrt_tofino_virtual_cpu_interface_name));
-      if (virtual_cpu_intf_rx_thread_id_ == 0) {
+      if (tap_queues_.empty()) {
+        ASSIGN_OR_RETURN(
+            const std::vector<int> fds,
+            CreateOrOpenTapIntf(
+                FLAGS_experimental_bfrt_tofino_virtual_cpu_interface_name,
+                FLAGS_experimental_tap_num_queues));
+        for (size_t i = 0; i < fds.size(); ++i) {
+          auto queue = absl::make_unique<TapQueue>();
+          queue->manager = this;
+          queue->index = i;
+          queue->fd = fds[i];
+          queue->rx_thread_id = 0;
+          tap_queues_.push_back(std::move(queue));
+        }
+      }
+      for (const auto& queue : tap_queues_) {
         int ret = pthread_create(
-            &virtual_cpu_intf_rx_thread_id_, nullptr,
-            &BfrtPacketioManager::VirtualCpuIntfRxThreadFunc, this);
+            &queue->rx_thread_id, nullptr,
+            &BfrtPacketioManager::VirtualCpuIntfRxThreadFunc, queue.get());
         if (ret != 0) {
           return MAKE_ERROR(ERR_INTERNAL)
                  << "Failed to spawn RX thread for virtual CPU interface "
-                 << "for device with ID " << device_ << ". Err: " << ret << ".";
+                 << "queue " << queue->index << " for device with ID "
+                 << device_ << ". Err: " << ret << ".";
         }
       }
     }
@@ -235,10 +288,8 @@ std::unique_ptr<BfrtPacketioManager> BfrtPacketioManager::CreateInstance(
         APPEND_STATUS_IF_ERROR(status, error);
       }
     }
-    packetin_header_.clear();
-    packetout_header_.clear();
-    packetin_header_size_ = 0;
-    packetout_header_size_ = 0;
+    packetin_codec_ = BfrtPacketMetadataCodec();
+    packetout_codec_ = BfrtPacketMetadataCodec();
     packet_receive_channel_.reset();
     initialized_ = false;
   }
@@ -253,26 +304,29 @@ std::unique_ptr<BfrtPacketioManager> BfrtPacketioManager::CreateInstance(
                              << "Failed to join thread " << sde_rx_thread_id_;
       APPEND_STATUS_IF_ERROR(status, error);
     }
-    if (!FLAGS_experimental_bfrt_tofino_virtual_cpu_interface_name.empty()) {
-      if (virtual_cpu_intf_rx_thread_id_ != 0 &&
-          pthread_join(virtual_cpu_intf_rx_thread_id_, nullptr) != 0) {
+    for (const auto& queue : tap_queues_) {
+      if (queue->rx_thread_id != 0 &&
+          pthread_join(queue->rx_thread_id, nullptr) != 0) {
         ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
                                << "Failed to join thread "
-                               << virtual_cpu_intf_rx_thread_id_;
+                               << queue->rx_thread_id;
         APPEND_STATUS_IF_ERROR(status, error);
       }
-      // Only close the interface after the threads have been joined. Otherwise
-      // this is a race condition.
-      if (tap_intf_fd_ != -1) {
-        close(tap_intf_fd_);
-        VLOG(1) << "Closed TAP interface.";
-      }
+    }
+    // Only close the interface after the threads have been joined. Otherwise
+    // this is a race condition.
+    for (const auto& queue : tap_queues_) {
+      close(queue->fd);
+    }
+    if (!tap_queues_.empty()) {
+      LOG(INFO) << "Closed TAP interface. Virtual CPU interface stats: "
+                << GetVirtualCpuIntfStats().ToString();
     }
   }
   {
     absl::WriterMutexLock l(&data_lock_);
     sde_rx_thread_id_ = 0;
-    virtual_cpu_intf_rx_thread_id_ = 0;
+    tap_queues_.clear();
   }
   return ::util::OkStatus();
 }
@@ -290,109 +344,19 @@ std::unique_ptr<BfrtPacketioManager> BfrtPacketioManager::CreateInstance(
   return ::util::OkStatus();
 }
 
-namespace {
-// BitBuffer implements a helper class for parsing and deparsing packet headers.
-class BitBuffer {
- public:
-  BitBuffer() = default;
-
-  // Add a bytestring to the back of the buffer.
-  ::util::Status PushBack(const std::string& bytestring, size_t bitwidth) {
-    RET_CHECK(bytestring.size() <= (bitwidth + kBitsPerByte - 1) / kBitsPerByte)
-        << "Bytestring " << StringToHex(bytestring) << " overflows bit width "
-        << bitwidth << ".";
-
-    // Push all bits to a new buffer.
-    std::deque<uint8> new_bits;
-    for (const uint8 c : bytestring) {
-      new_bits.push_back((c >> 7) & 1u);
-      new_bits.push_back((c >> 6) & 1u);
-      new_bits.push_back((c >> 5) & 1u);
-      new_bits.push_back((c >> 4) & 1u);
-      new_bits.push_back((c >> 3) & 1u);
-      new_bits.push_back((c >> 2) & 1u);
-      new_bits.push_back((c >> 1) & 1u);
-      new_bits.push_back((c >> 0) & 1u);
-    }
-    // Remove bits from partial byte at the front.
-    while (new_bits.size() > bitwidth) {
-      RET_CHECK(new_bits.front() == 0)
-          << "Bytestring " << StringToHex(bytestring) << " overflows bit width "
-          << bitwidth << ".";
-      new_bits.pop_front();
-    }
-    // Pad to full width.
-    while (new_bits.size() < bitwidth) {
-      new_bits.push_front(0);
-    }
-    // Append to internal buffer.
-    bits_.insert(bits_.end(), new_bits.begin(), new_bits.end());
-
-    return ::util::OkStatus();
-  }
-
-  // Removes and returns a field from the front of the buffer.
-  std::string PopField(size_t bitwidth) {
-    CHECK_LE(bitwidth, bits_.size());
-    std::string out;
-    uint8 byte_val = 0;
-    for (int bit = bitwidth - 1; bit >= 0; --bit) {
-      byte_val <<= 1;
-      byte_val |= bits_.front();
-      bits_.pop_front();
-      if (!(bit % 8)) {
-        out.push_back(byte_val);
-        byte_val = 0;
-      }
-    }
-    return out;
-  }
-
-  // Returns and empties the entire buffer.
-  std::string PopAll(void) {
-    CHECK_EQ(bits_.size() % 8, 0);
-    return PopField(bits_.size());
-  }
-
-  // Returns a human-readable representation of the buffer.
-  std::string ToString() {
-    std::string ret;
-    for (size_t i = 0; i < bits_.size(); ++i) {
-      if (i % 8 == 0) ret += " ";
-      ret += std::to_string(static_cast<uint16>(bits_[i]));
-    }
-    return ret;
-  }
-
- private:
-  const int kBitsPerByte = 8;
-  std::deque<uint8> bits_;
-};
-}  // namespace
-
 ::util::Status BfrtPacketioManager::DeparsePacketOut(
     const ::p4::v1::PacketOut& packet, std::string* buffer) {
   absl::ReaderMutexLock l(&data_lock_);
-  BitBuffer bit_buf;
-  for (const auto& p : packetout_header_) {
-    const auto id = p.first;
-    const auto bitwidth = p.second;
-    auto it = std::find_if(packet.metadata().begin(), packet.metadata().end(),
-                           [&id](::p4::v1::PacketMetadata metadata) {
-                             return metadata.metadata_id() == id;
-                           });
-    RET_CHECK(it != packet.metadata().end())
-        << "Missing metadata with Id " << id << " in PacketOut "
-        << packet.ShortDebugString();
-    RETURN_IF_ERROR(bit_buf.PushBack(it->value(), bitwidth));
-    VLOG(1) << "Encoded PacketOut metadata field with id " << id << " bitwidth "
-            << bitwidth << " value 0x" << StringToHex(it->value());
+  const size_t header_size = packetout_codec_.header_size();
+  buffer->reserve(header_size + packet.payload().size());
+  buffer->resize(header_size);
+  ::util::Status status =
+      packetout_codec_.Encode(packet.metadata(), &(*buffer)[0]);
+  if (!status.ok()) {
+    return APPEND_ERROR(status).without_logging()
+           << " in PacketOut " << packet.ShortDebugString() << ".";
   }
-  auto hdr_buf = bit_buf.PopAll();
-  buffer->resize(0);
-  buffer->insert(buffer->end(), hdr_buf.begin(), hdr_buf.end());
-  buffer->insert(buffer->end(), packet.payload().begin(),
-                 packet.payload().end());
+  buffer->append(packet.payload());
 
   return ::util::OkStatus();
 }
@@ -400,23 +364,11 @@ class BitBuffer {
 ::util::Status BfrtPacketioManager::ParsePacketIn(const std::string& buffer,
                                                   ::p4::v1::PacketIn* packet) {
   absl::ReaderMutexLock l(&data_lock_);
-  RET_CHECK(buffer.size() >= packetin_header_size_)
-      << "Received packet is too small.";
-
-  BitBuffer bit_buf;
-  RETURN_IF_ERROR(bit_buf.PushBack(buffer.substr(0, packetin_header_size_),
-                                   packetin_header_size_ * 8));
-  for (const auto& p : packetin_header_) {
-    auto metadata = packet->add_metadata();
-    metadata->set_metadata_id(p.first);
-    metadata->set_value(
-        ByteStringToP4RuntimeByteString(bit_buf.PopField(p.second)));
-    VLOG(1) << "Encoded PacketIn metadata field with id " << p.first
-            << " bitwidth " << p.second << " value 0x"
-            << StringToHex(metadata->value());
-  }
-  packet->set_payload(buffer.data() + packetin_header_size_,
-                      buffer.size() - packetin_header_size_);
+  const size_t header_size = packetin_codec_.header_size();
+  RET_CHECK(buffer.size() >= header_size) << "Received packet is too small.";
+  packetin_codec_.Decode(buffer.data(), packet->mutable_metadata());
+  packet->set_payload(buffer.data() + header_size,
+                      buffer.size() - header_size);
 
   return ::util::OkStatus();
 }
@@ -428,37 +380,40 @@ class BitBuffer {
     if (!initialized_)
       return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized.";
   }
-  ASSIGN_OR_RETURN(const auto& translated_packet_out,
-                   bfrt_p4runtime_translator_->TranslatePacketOut(packet));
-  std::string buf;
-  RETURN_IF_ERROR(DeparsePacketOut(translated_packet_out, &buf));
+  // The buffer goes back to the pool when it goes out of scope.
+  PacketBuffer buffer = packet_tx_buffer_pool_->Acquire();
+  if (bfrt_p4runtime_translator_->PacketOutRequiresTranslation()) {
+    ASSIGN_OR_RETURN(const auto& translated_packet_out,
+                     bfrt_p4runtime_translator_->TranslatePacketOut(packet));
+    RETURN_IF_ERROR(
+        DeparsePacketOut(translated_packet_out, buffer.mutable_data()));
+  } else {
+    RETURN_IF_ERROR(DeparsePacketOut(packet, buffer.mutable_data()));
+  }
 
-  RETURN_IF_ERROR(bf_sde_interface_->TxPacket(device_, buf));
+  RETURN_IF_ERROR(bf_sde_interface_->TxPacket(device_, buffer.data()));
 
   return ::util::OkStatus();
 }
 
 namespace {
 
-::util::Status HasPacketInMagicBytes(const std::string& buffer) {
-  if (buffer.length() < 14) {
-    return MAKE_ERROR(ERR_INVALID_PARAM) << "Packet too short.";
-  }
-  if (static_cast<uint8>(buffer[12]) == 0xbf &&
-      static_cast<uint8>(buffer[13]) == 0x01) {
-    return ::util::OkStatus();
-  }
-
-  return MAKE_ERROR(ERR_INVALID_PARAM).without_logging() << "Normal traffic.";
+// Returns true if the packet starts with a PacketIn metadata header, false for
+// normal traffic. This runs for every received packet, so it does not build
+// a status.
+bool HasPacketInMagicBytes(const std::string& buffer) {
+  return buffer.length() >= 14 && static_cast<uint8>(buffer[12]) == 0xbf &&
+         static_cast<uint8>(buffer[13]) == 0x01;
 }
 
 }  // namespace
 
-::util::Status BfrtPacketioManager::HandleVirtualCpuIntfPacketRx() {
-  SetOwnThreadName("HndlTapPktRx");
+::util::Status BfrtPacketioManager::HandleVirtualCpuIntfPacketRx(
+    int queue_index, int fd) {
+  SetOwnThreadName(absl::StrCat("HndlTapPktRx", queue_index));
   static constexpr size_t kMaxRxBufferSize = 32768;
+  const int burst_size = std::max(1, FLAGS_experimental_tap_rx_burst_size);
 
-  int fd = -1;  // Copy the fd to avoid locking the mutex inside the loop.
   {
     absl::ReaderMutexLock l(&data_lock_);
     if (!initialized_)
@@ -467,8 +422,7 @@ namespace {
       return MAKE_ERROR(ERR_FEATURE_UNAVAILABLE)
              << "Virtual CPU interface not enabled.";
     }
-    RET_CHECK(tap_intf_fd_ > 0) << "TAP interface not initialized";
-    fd = tap_intf_fd_;
+    RET_CHECK(fd > 0) << "TAP interface not initialized";
   }
 
   // Use the newest linux poll mechanism (epoll) to detect whether we have
@@ -479,6 +433,7 @@ namespace {
     return MAKE_ERROR(ERR_INTERNAL)
            << "epoll_create1() failed. errno: " << errno << ".";
   }
+  auto efd_closer = absl::MakeCleanup([efd]() { close(efd); });
   event.data.fd = fd;  // not even used.
   event.events = EPOLLIN;
   if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &event) != 0) {
@@ -486,7 +441,11 @@ namespace {
            << "epoll_ctl() failed. errno: " << errno << ".";
   }
 
-  std::string buf;
+  // Packets are read into a fixed buffer, then copied into a string which
+  // keeps its capacity. Nothing is allocated or zeroed per packet.
+  std::unique_ptr<char[]> rx_buffer(new char[kMaxRxBufferSize]);
+  std::string packet;
+  packet.reserve(kMaxRxBufferSize);
   while (true) {
     // This is the graceful shutdown check.
     {
@@ -501,26 +460,44 @@ namespace {
       VLOG(1) << "Error in epoll_wait(). errno: " << errno << ".";
       continue;  // let it retry
     } else if (ret > 0 && pevents[0].events & EPOLLIN) {
-      buf.resize(kMaxRxBufferSize);  // Pad with zeros.
-      ret = read(fd, &buf[0], buf.size());
-      if (ret < 0) {
-        LOG(ERROR) << "Read from TAP interface failed: " << strerror(errno)
-                   << ".";
-        continue;
+      // Drain up to a burst of packets from the non-blocking queue. Packets
+      // left over wake up epoll_wait() again.
+      uint64 num_packets = 0;
+      uint64 num_bytes = 0;
+      uint64 num_errors = 0;
+      while (num_packets < static_cast<uint64>(burst_size)) {
+        ssize_t len = read(fd, rx_buffer.get(), kMaxRxBufferSize);
+        if (len < 0) {
+          if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG(ERROR) << "Read from TAP interface failed: " << strerror(errno)
+                       << ".";
+            ++num_errors;
+          }
+          break;
+        }
+        if (len == 0) {
+          LOG(ERROR) << "Read zero bytes TAP interface?";
+          break;
+        }
+        packet.assign(rx_buffer.get(), len);
+        RETURN_IF_ERROR(bf_sde_interface_->TxPacket(device_, packet));
+        ++num_packets;
+        num_bytes += len;
       }
-      if (ret == 0) {
-        LOG(ERROR) << "Read zero bytes TAP interface?";
-        continue;
+      {
+        absl::MutexLock l(&stats_lock_);
+        if (num_packets > 0) ++virtual_cpu_intf_stats_.bursts_from_tap;
+        virtual_cpu_intf_stats_.packets_from_tap += num_packets;
+        virtual_cpu_intf_stats_.bytes_from_tap += num_bytes;
+        virtual_cpu_intf_stats_.errors_from_tap += num_errors;
       }
-      buf.resize(ret);  // Trim trailing zero bytes.
-      RETURN_IF_ERROR(bf_sde_interface_->TxPacket(device_, buf));
-      VLOG(1)
-          << "Read " << ret
-          << " byte packet from TAP interface and sent it to PCIe CPU port.";
+      VLOG(1) << "Read " << num_packets << " packet(s) from TAP queue "
+              << queue_index << " and sent them to PCIe CPU port.";
     }
   }
 
-  LOG(INFO) << "Stopped RX thread for virtual CPU interface.";
+  LOG(INFO) << "Stopped RX thread for virtual CPU interface queue "
+            << queue_index << ".";
 
   return ::util::OkStatus();
 }
@@ -532,69 +509,107 @@ namespace {
   const bool virtual_cpu_interface_enabled =
       !FLAGS_experimental_bfrt_tofino_virtual_cpu_interface_name.empty();
 
-  std::unique_ptr<ChannelReader<std::string>> reader;
+  std::unique_ptr<ChannelReader<PacketBuffer>> reader;
   int fd = -1;  // Copy the fd to avoid locking the mutex inside the loop.
   {
     absl::ReaderMutexLock l(&data_lock_);
     if (!initialized_)
       return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized.";
-    reader = ChannelReader<std::string>::Create(packet_receive_channel_);
+    reader = ChannelReader<PacketBuffer>::Create(packet_receive_channel_);
     if (!reader) return MAKE_ERROR(ERR_INTERNAL) << "Failed to create reader.";
     if (virtual_cpu_interface_enabled) {
-      RET_CHECK(tap_intf_fd_ > 0) << "TAP interface not initialized";
-      fd = tap_intf_fd_;
+      // All queues of a multi-queue TAP interface inject the packets written
+      // to them into the same kernel network interface, so this single thread
+      // always writes to the first queue. The other queues only matter for
+      // the packets read from the TAP, which the kernel spreads over them.
+      RET_CHECK(!tap_queues_.empty() && tap_queues_[0]->fd > 0)
+          << "TAP interface not initialized";
+      fd = tap_queues_[0]->fd;
     }
   }
 
+  // The buffers and the PacketIn are reused for every packet: buffer storage
+  // goes back to the SDE buffer pool when the next burst is read, and a
+  // cleared PacketIn keeps its metadata and payload storage.
+  std::vector<PacketBuffer> packet_buffers(1);
+  std::vector<PacketBuffer> more_packet_buffers;
+  ::p4::v1::PacketIn packet_in;
   while (true) {
     {
       absl::ReaderMutexLock l(&chassis_lock);
       if (shutdown) break;
     }
-    std::string buffer;
-    int code = reader->Read(&buffer, absl::InfiniteDuration()).error_code();
+    // Block for one packet, then drain whatever else is queued in one go.
+    packet_buffers.resize(1);
+    int code =
+        reader->Read(&packet_buffers[0], absl::InfiniteDuration()).error_code();
     if (code == ERR_CANCELLED) break;
     if (code == ERR_ENTRY_NOT_FOUND) {
       LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
       continue;
     }
+    if (reader->ReadAll(&more_packet_buffers).ok()) {
+      for (auto& packet_buffer : more_packet_buffers) {
+        packet_buffers.push_back(std::move(packet_buffer));
+      }
+    }
 
-    // Check if this packet is to be forwarded to the virtual CPU interface.
-    if (virtual_cpu_interface_enabled && !HasPacketInMagicBytes(buffer).ok()) {
-      int ret = write(fd, buffer.data(), buffer.size());
-      if (ret < 0) {
-        LOG(ERROR) << "Write to TAP interface failed: " << ret;
+    uint64 num_packets_to_tap = 0;
+    uint64 num_bytes_to_tap = 0;
+    uint64 num_errors_to_tap = 0;
+    for (const PacketBuffer& packet_buffer : packet_buffers) {
+      const std::string& buffer = packet_buffer.data();
+
+      // Check if this packet is to be forwarded to the virtual CPU interface.
+      if (virtual_cpu_interface_enabled && !HasPacketInMagicBytes(buffer)) {
+        int ret = write(fd, buffer.data(), buffer.size());
+        if (ret < 0) {
+          LOG(ERROR) << "Write to TAP interface failed: " << ret;
+          ++num_errors_to_tap;
+          continue;
+        }
+        ++num_packets_to_tap;
+        num_bytes_to_tap += buffer.size();
         continue;
       }
-      VLOG(1)
-          << "Read " << buffer.size()
-          << " byte packet from PCIe CPU port and sent it to TAP interface.";
-      continue;
-    }
 
-    ::p4::v1::PacketIn packet_in;
-    ::util::Status status = ParsePacketIn(buffer, &packet_in);
-    if (!status.ok()) {
-      LOG(ERROR) << "ParsePacketIn failed: " << status;
-      continue;
-    }
-    const auto& translated_packet_in =
-        bfrt_p4runtime_translator_->TranslatePacketIn(packet_in);
-    if (!translated_packet_in.ok()) {
-      LOG(ERROR) << "TranslatePacketIn failed: " << status;
-      continue;
+      packet_in.Clear();
+      ::util::Status status = ParsePacketIn(buffer, &packet_in);
+      if (!status.ok()) {
+        LOG(ERROR) << "ParsePacketIn failed: " << status;
+        continue;
+      }
+      status =
+          bfrt_p4runtime_translator_->TranslatePacketInInPlace(&packet_in);
+      if (!status.ok()) {
+        LOG(ERROR) << "TranslatePacketIn failed: " << status;
+        continue;
+      }
+      {
+        absl::WriterMutexLock l(&rx_writer_lock_);
+        if (rx_writer_ != nullptr) rx_writer_->Write(packet_in);
+      }
+      VLOG(1) << "Handled PacketIn: " << packet_in.ShortDebugString();
     }
-    {
-      absl::WriterMutexLock l(&rx_writer_lock_);
-      if (rx_writer_ != nullptr)
-        rx_writer_->Write(translated_packet_in.ValueOrDie());
+    if (virtual_cpu_interface_enabled) {
+      absl::MutexLock l(&stats_lock_);
+      virtual_cpu_intf_stats_.packets_to_tap += num_packets_to_tap;
+      virtual_cpu_intf_stats_.bytes_to_tap += num_bytes_to_tap;
+      virtual_cpu_intf_stats_.errors_to_tap += num_errors_to_tap;
+      VLOG(1) << "Sent " << num_packets_to_tap
+              << " packet(s) from PCIe CPU port to TAP interface.";
     }
-    VLOG(1) << "Handled PacketIn: " << packet_in.ShortDebugString();
   }
 
   return ::util::OkStatus();
 }
 
+BfrtPacketioManager::VirtualCpuIntfStats
+BfrtPacketioManager::GetVirtualCpuIntfStats() const {
+  absl::MutexLock l(&stats_lock_);
+  return virtual_cpu_intf_stats_;
+}
+
 // This function is based on P4TableMapper and implements a subset of its
 // functionality.
 // TODO(max): Check and reject if a mapping cannot be handled at runtime
@@ -630,10 +645,10 @@ namespace {
       << "PacketIn header size must be multiple of 8 bits.";
   RET_CHECK(packetout_bits % 8 == 0)
       << "PacketOut header size must be multiple of 8 bits.";
-  packetin_header_ = std::move(packetin_header);
-  packetout_header_ = std::move(packetout_header);
-  packetin_header_size_ = packetin_bits / 8;
-  packetout_header_size_ = packetout_bits / 8;
+  ASSIGN_OR_RETURN(packetin_codec_,
+                   BfrtPacketMetadataCodec::Create(packetin_header));
+  ASSIGN_OR_RETURN(packetout_codec_,
+                   BfrtPacketMetadataCodec::Create(packetout_header));
 
   return ::util::OkStatus();
 }
@@ -649,8 +664,9 @@ void* BfrtPacketioManager::SdeRxThreadFunc(void* arg) {
 }
 
 void* BfrtPacketioManager::VirtualCpuIntfRxThreadFunc(void* arg) {
-  BfrtPacketioManager* mgr = reinterpret_cast<BfrtPacketioManager*>(arg);
-  ::util::Status status = mgr->HandleVirtualCpuIntfPacketRx();
+  TapQueue* queue = reinterpret_cast<TapQueue*>(arg);
+  ::util::Status status =
+      queue->manager->HandleVirtualCpuIntfPacketRx(queue->index, queue->fd);
   if (!status.ok()) {
     LOG(ERROR) << "Non-OK exit of RX thread for virtual CPU interface.";
   }
@@ -12,12 +12,15 @@
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/hal/lib/barefoot/bf.pb.h"
 #include "stratum/hal/lib/barefoot/bf_global_vars.h"
+#include "stratum/hal/lib/barefoot/bf_packet_buffer_pool.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
+#include "stratum/hal/lib/barefoot/bfrt_packet_metadata_codec.h"
 #include "stratum/hal/lib/barefoot/bfrt_p4runtime_translator.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/writer_interface.h"
@@ -29,6 +32,31 @@ namespace barefoot {
 
 class BfrtPacketioManager {
  public:
+  // Counters of the virtual CPU interface, i.e. of the traffic bridged between
+  // the TAP interface and the PCIe CPU port.
+  struct VirtualCpuIntfStats {
+    // Packets read from the TAP queues and sent to the PCIe CPU port.
+    uint64 packets_from_tap = 0;
+    uint64 bytes_from_tap = 0;
+    // Number of RX thread wakeups which read at least one packet. The average
+    // burst size is packets_from_tap / bursts_from_tap.
+    uint64 bursts_from_tap = 0;
+    uint64 errors_from_tap = 0;
+    // Packets received from the PCIe CPU port and written to the TAP.
+    uint64 packets_to_tap = 0;
+    uint64 bytes_to_tap = 0;
+    uint64 errors_to_tap = 0;
+    std::string ToString() const {
+      return absl::StrCat(
+          "(packets_from_tap:", packets_from_tap,
+          ", bytes_from_tap:", bytes_from_tap,
+          ", bursts_from_tap:", bursts_from_tap,
+          ", errors_from_tap:", errors_from_tap,
+          ", packets_to_tap:", packets_to_tap, ", bytes_to_tap:", bytes_to_tap,
+          ", errors_to_tap:", errors_to_tap, ")");
+    }
+  };
+
   virtual ~BfrtPacketioManager();
 
   // Pushes the parts of the given ChassisConfig proto that this class cares
@@ -52,7 +80,7 @@ class BfrtPacketioManager {
   // Performs coldboot shutdown. Note that there is no public Initialize().
   // Initialization is done as part of PushChassisConfig() if the class is not
   // initialized by the time we push config.
-  virtual ::util::Status Shutdown() LOCKS_EXCLUDED(data_lock_);
+  virtual ::util::Status Shutdown() LOCKS_EXCLUDED(data_lock_, stats_lock_);
 
   // Registers a writer to be invoked when we capture a packet on a PCIe
   // interface.
@@ -67,6 +95,11 @@ class BfrtPacketioManager {
   virtual ::util::Status TransmitPacket(const ::p4::v1::PacketOut& packet)
       LOCKS_EXCLUDED(data_lock_);
 
+  // Returns the counters of the virtual CPU interface. They are also logged
+  // when the interface is closed on Shutdown().
+  virtual VirtualCpuIntfStats GetVirtualCpuIntfStats() const
+      LOCKS_EXCLUDED(stats_lock_);
+
   // Factory function for creating the instance of the class.
   static std::unique_ptr<BfrtPacketioManager> CreateInstance(
       BfSdeInterface* bf_sde_interface,
@@ -97,24 +130,37 @@ class BfrtPacketioManager {
                                   std::string* buffer)
       LOCKS_EXCLUDED(data_lock_);
 
-  // Parses a binary string into a PacketIn, filling the metadata fields.
+  // Parses a binary string into a PacketIn, filling the metadata fields. The
+  // PacketIn is expected to be empty; a cleared message can be reused to avoid
+  // allocations.
   ::util::Status ParsePacketIn(const std::string& buffer,
                                ::p4::v1::PacketIn* packet)
       LOCKS_EXCLUDED(data_lock_);
 
   // Handles a received packets and hands it over the registered receive writer.
   ::util::Status HandleSdePacketRx()
-      LOCKS_EXCLUDED(data_lock_, rx_writer_lock_);
+      LOCKS_EXCLUDED(data_lock_, rx_writer_lock_, stats_lock_);
 
-  // Handles a received packets and hands it over the registered receive writer.
-  ::util::Status HandleVirtualCpuIntfPacketRx() LOCKS_EXCLUDED(data_lock_);
+  // Handles the packets received on a queue of the virtual CPU interface and
+  // sends them to the PCIe CPU port.
+  ::util::Status HandleVirtualCpuIntfPacketRx(int queue_index, int fd)
+      LOCKS_EXCLUDED(data_lock_, stats_lock_);
 
   // SDE CPU interface RX thread function.
   static void* SdeRxThreadFunc(void* arg);
 
-  // Virtual CPU interface RX thread function.
+  // Virtual CPU interface RX thread function. The argument is the TapQueue
+  // served by the thread.
   static void* VirtualCpuIntfRxThreadFunc(void* arg);
 
+  // A queue of the virtual CPU interface, served by its own RX thread.
+  struct TapQueue {
+    BfrtPacketioManager* manager;
+    int index;
+    int fd;
+    pthread_t rx_thread_id;
+  };
+
   // Mutex lock for protecting rx_writer_.
   mutable absl::Mutex rx_writer_lock_;
 
@@ -128,26 +174,31 @@ class BfrtPacketioManager {
   std::shared_ptr<WriterInterface<::p4::v1::PacketIn>> rx_writer_
       GUARDED_BY(rx_writer_lock_);
 
-  // List of metadata id and bitwidth pairs. Stores the size and structure of
-  // the CPU packet headers.
-  std::vector<std::pair<uint32, int>> packetin_header_ GUARDED_BY(data_lock_);
-  std::vector<std::pair<uint32, int>> packetout_header_ GUARDED_BY(data_lock_);
-  size_t packetin_header_size_ GUARDED_BY(data_lock_);
-  size_t packetout_header_size_ GUARDED_BY(data_lock_);
+  // Codecs for the CPU packet headers, compiled from the controller packet
+  // metadata of the P4Info when the pipeline is pushed.
+  BfrtPacketMetadataCodec packetin_codec_ GUARDED_BY(data_lock_);
+  BfrtPacketMetadataCodec packetout_codec_ GUARDED_BY(data_lock_);
 
   // Buffer channel for packets coming from the SDE to this manager.
-  std::shared_ptr<Channel<std::string>> packet_receive_channel_
+  std::shared_ptr<Channel<PacketBuffer>> packet_receive_channel_
       GUARDED_BY(data_lock_);
 
-  // File descriptor of the virtual TAP port used to simulate a CPU port.
-  int tap_intf_fd_ GUARDED_BY(data_lock_);
+  // Queues of the virtual TAP port used to simulate a CPU port. Empty if the
+  // virtual CPU interface is disabled. Packets from the SDE are all written to
+  // the first queue, see HandleSdePacketRx().
+  std::vector<std::unique_ptr<TapQueue>> tap_queues_ GUARDED_BY(data_lock_);
 
   // The ID of the RX thread which handles receiving packets from the SDE.
   pthread_t sde_rx_thread_id_ GUARDED_BY(data_lock_);
 
-  // The ID of the RX thread which handles receiving packets from the virtual
-  // CPU interface.
-  pthread_t virtual_cpu_intf_rx_thread_id_ GUARDED_BY(data_lock_);
+  // Mutex lock for protecting virtual_cpu_intf_stats_.
+  mutable absl::Mutex stats_lock_;
+
+  // Counters of the virtual CPU interface, updated once per burst.
+  VirtualCpuIntfStats virtual_cpu_intf_stats_ GUARDED_BY(stats_lock_);
+
+  // Pool of the buffers used to deparse PacketOuts.
+  const std::unique_ptr<PacketBufferPool> packet_tx_buffer_pool_;
 
   // Pointer to a BfSdeInterface implementation that wraps all the SDE calls.
   BfSdeInterface* bf_sde_interface_ = nullptr;  // not owned by this class.
@@ -29,6 +29,7 @@ class BfrtPacketioManagerMock : public BfrtPacketioManager {
   MOCK_METHOD0(UnregisterPacketReceiveWriter, ::util::Status());
   MOCK_METHOD1(TransmitPacket,
                ::util::Status(const ::p4::v1::PacketOut& packet));
+  MOCK_CONST_METHOD0(GetVirtualCpuIntfStats, VirtualCpuIntfStats());
 };
 
 }  // namespace barefoot
@@ -3,18 +3,59 @@
 
 #include "stratum/hal/lib/barefoot/bfrt_packetio_manager.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
 #include "absl/memory/memory.h"
 #include "absl/synchronization/notification.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/barefoot/bf_sde_mock.h"
+#include "stratum/hal/lib/barefoot/bf_packet_buffer_pool.h"
+#include "stratum/hal/lib/barefoot/bfrt_p4runtime_translator.h"
 #include "stratum/hal/lib/barefoot/bfrt_p4runtime_translator_mock.h"
+#include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_string(experimental_bfrt_tofino_virtual_cpu_interface_name);
+DECLARE_int32(experimental_tap_rx_burst_size);
+
+namespace {
+
+// Allocation counting for a single thread, the SDE RX thread of the manager
+// under test.
+std::atomic<bool> count_allocations(false);
+pthread_t counted_thread;
+std::atomic<int> num_allocations(0);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (count_allocations.load(std::memory_order_acquire) &&
+      pthread_equal(pthread_self(), counted_thread)) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* ptr = malloc(size ? size : 1);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -26,8 +67,9 @@ using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::InvokeWithoutArgs;
+using ::testing::Pointee;
 using ::testing::Return;
-using ::testing::ReturnArg;
+using ::testing::UnorderedElementsAre;
 
 class BfrtPacketioManagerTest : public ::testing::Test {
  protected:
@@ -69,8 +111,13 @@ class BfrtPacketioManagerTest : public ::testing::Test {
     return status;
   }
 
+  void TearDown() override {
+    for (int fd : tap_peer_fds_) close(fd);
+  }
+
   ::util::Status Shutdown() {
     // Make sure everything like Rx threads will be cleaned up.
+    bool has_tap_queues = false;
     {
       absl::WriterMutexLock l(&bfrt_packetio_manager_->data_lock_);
       if (bfrt_packetio_manager_->initialized_) {
@@ -80,20 +127,85 @@ class BfrtPacketioManagerTest : public ::testing::Test {
                     UnregisterPacketReceiveWriter(kDevice1))
             .WillOnce(Return(util::OkStatus()));
       }
+      has_tap_queues = !bfrt_packetio_manager_->tap_queues_.empty();
     }
     packet_rx_writer.reset();
-    return bfrt_packetio_manager_->Shutdown();
+    // The RX threads of the virtual CPU interface run until switch shutdown.
+    if (has_tap_queues) SetSwitchShutdown(true);
+    ::util::Status status = bfrt_packetio_manager_->Shutdown();
+    SetSwitchShutdown(false);
+    return status;
+  }
+
+  static void SetSwitchShutdown(bool value) {
+    absl::WriterMutexLock l(&chassis_lock);
+    shutdown = value;
+  }
+
+  // Enables the virtual CPU interface with the given number of queues. The
+  // queues are backed by datagram socket pairs instead of a TAP interface, and
+  // the peer ends of the sockets are kept in tap_peer_fds_.
+  void SetUpVirtualCpuIntfQueues(int num_queues) {
+    FLAGS_experimental_bfrt_tofino_virtual_cpu_interface_name = "tap-test";
+    absl::WriterMutexLock l(&bfrt_packetio_manager_->data_lock_);
+    for (int i = 0; i < num_queues; ++i) {
+      int fds[2];
+      ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+      ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+      auto queue = absl::make_unique<BfrtPacketioManager::TapQueue>();
+      queue->manager = bfrt_packetio_manager_.get();
+      queue->index = i;
+      queue->fd = fds[0];
+      queue->rx_thread_id = 0;
+      bfrt_packetio_manager_->tap_queues_.push_back(std::move(queue));
+      tap_peer_fds_.push_back(fds[1]);
+    }
+  }
+
+  // Waits until the given condition on the virtual CPU interface counters
+  // holds, for at most one second.
+  template <typename Predicate>
+  bool WaitForVirtualCpuIntfStats(Predicate predicate) {
+    const absl::Time deadline = absl::Now() + absl::Seconds(1);
+    while (!predicate(bfrt_packetio_manager_->GetVirtualCpuIntfStats())) {
+      if (absl::Now() > deadline) return false;
+      absl::SleepFor(absl::Milliseconds(1));
+    }
+    return true;
   }
 
   // The mock method which help us to initialize a mock packet receive writer
   // so we can use it later.
   ::util::Status RegisterPacketReceiveWriter(
-      int device, std::unique_ptr<ChannelWriter<std::string>> writer) {
+      int device, std::unique_ptr<ChannelWriter<PacketBuffer>> writer) {
     EXPECT_EQ(device, kDevice1);
     packet_rx_writer = std::move(writer);
     return ::util::OkStatus();
   }
 
+  // Returns a buffer holding the given packet, as received from the SDE.
+  static PacketBuffer MakePacketBuffer(const std::string& packet) {
+    PacketBuffer buffer;
+    buffer.mutable_data()->assign(packet);
+    return buffer;
+  }
+
+  // Starts counting the heap allocations of the SDE RX thread.
+  void StartCountingRxAllocations() {
+    {
+      absl::ReaderMutexLock l(&bfrt_packetio_manager_->data_lock_);
+      counted_thread = bfrt_packetio_manager_->sde_rx_thread_id_;
+    }
+    num_allocations = 0;
+    count_allocations.store(true, std::memory_order_release);
+  }
+
+  // Stops counting and returns the number of RX thread allocations.
+  int StopCountingRxAllocations() {
+    count_allocations.store(false, std::memory_order_release);
+    return num_allocations.load();
+  }
+
   static constexpr int kDevice1 = 0;
   static constexpr char kP4Info[] = R"pb(
     controller_packet_metadata {
@@ -148,12 +260,33 @@ class BfrtPacketioManagerTest : public ::testing::Test {
   std::unique_ptr<BfSdeMock> bf_sde_wrapper_mock_;
   std::unique_ptr<BfrtP4RuntimeTranslatorMock> bfrt_p4runtime_translator_mock_;
   std::unique_ptr<BfrtPacketioManager> bfrt_packetio_manager_;
-  std::unique_ptr<ChannelWriter<std::string>> packet_rx_writer;
+  std::unique_ptr<ChannelWriter<PacketBuffer>> packet_rx_writer;
+  std::vector<int> tap_peer_fds_;
+  gflags::FlagSaver flag_saver_;  // Reverts the virtual CPU interface flags.
 };
 
 constexpr int BfrtPacketioManagerTest::kDevice1;
 constexpr char BfrtPacketioManagerTest::kP4Info[];
 
+namespace {
+
+// A PacketIn writer which only counts the packets, so that it does not
+// allocate on the RX thread like a mock does.
+class CountingPacketInWriter : public WriterInterface<::p4::v1::PacketIn> {
+ public:
+  CountingPacketInWriter() : num_packets_(0) {}
+  bool Write(const ::p4::v1::PacketIn& msg) override {
+    num_packets_.fetch_add(1);
+    return true;
+  }
+  int num_packets() const { return num_packets_.load(); }
+
+ private:
+  std::atomic<int> num_packets_;
+};
+
+}  // namespace
+
 // TODO(Yi Tseng): These two methods will always return OK status
 // We can add tests for these methods if we modify them.
 // TEST_F(BfrtPacketioManagerTest, PushChassisConfig) {}
@@ -273,6 +406,8 @@ TEST_F(BfrtPacketioManagerTest, TransmitPacketAfterPipelineConfigPush) {
       "\0\x80\0\0\0\0\0\0\0\0\0\0\xBF\x01"
       "abcde",
       19);
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, PacketOutRequiresTranslation())
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslatePacketOut(EqualsProto(packet_out)))
       .WillOnce(Return(::util::StatusOr<::p4::v1::PacketOut>(packet_out)));
@@ -282,6 +417,47 @@ TEST_F(BfrtPacketioManagerTest, TransmitPacketAfterPipelineConfigPush) {
   EXPECT_OK(Shutdown());
 }
 
+TEST_F(BfrtPacketioManagerTest, TransmitPacketWithoutTranslation) {
+  EXPECT_OK(PushPipelineConfig());
+  p4::v1::PacketOut packet_out;
+  const char packet_out_str[] = R"pb(
+    payload: "abcde"
+    metadata {
+      metadata_id: 1
+      value: "\x1"
+    }
+    metadata {
+      metadata_id: 2
+      value: "\x0"
+    }
+    metadata {
+      metadata_id: 3
+      value: "\x0"
+    }
+    metadata {
+      metadata_id: 4
+      value: "\xbf\x01"
+    }
+  )pb";
+  EXPECT_OK(ParseProtoFromString(packet_out_str, &packet_out));
+  const std::string expected_packet(
+      "\0\x80\0\0\0\0\0\0\0\0\0\0\xBF\x01"
+      "abcde",
+      19);
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, PacketOutRequiresTranslation())
+      .Times(2)
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, TranslatePacketOut(_))
+      .Times(0);
+  // The buffer is recycled for the second packet.
+  EXPECT_CALL(*bf_sde_wrapper_mock_, TxPacket(kDevice1, expected_packet))
+      .Times(2)
+      .WillRepeatedly(Return(util::OkStatus()));
+  EXPECT_OK(bfrt_packetio_manager_->TransmitPacket(packet_out));
+  EXPECT_OK(bfrt_packetio_manager_->TransmitPacket(packet_out));
+  EXPECT_OK(Shutdown());
+}
+
 TEST_F(BfrtPacketioManagerTest, TransmitInvalidPacketAfterPipelineConfigPush) {
   EXPECT_OK(PushPipelineConfig());
   p4::v1::PacketOut packet_out;
@@ -302,6 +478,8 @@ TEST_F(BfrtPacketioManagerTest, TransmitInvalidPacketAfterPipelineConfigPush) {
     }
   )pb";
   EXPECT_OK(ParseProtoFromString(packet_out_str, &packet_out));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, PacketOutRequiresTranslation())
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslatePacketOut(EqualsProto(packet_out)))
       .WillOnce(Return(::util::StatusOr<::p4::v1::PacketOut>(packet_out)));
@@ -347,11 +525,12 @@ TEST_F(BfrtPacketioManagerTest, TestPacketIn) {
               return false;
             }
           }));
-  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
-              TranslatePacketIn(EqualsProto(expected_packet_in)))
-      .WillOnce(
-          Return(::util::StatusOr<::p4::v1::PacketIn>(expected_packet_in)));
-  EXPECT_OK(packet_rx_writer->Write(packet_from_asic, absl::Milliseconds(100)));
+  EXPECT_CALL(
+      *bfrt_p4runtime_translator_mock_,
+      TranslatePacketInInPlace(Pointee(EqualsProto(expected_packet_in))))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(packet_rx_writer->Write(MakePacketBuffer(packet_from_asic),
+                                    absl::Milliseconds(100)));
 
   // Here we need to wait until we receive and verify the packet from the mock
   // packet-in writer.
@@ -377,8 +556,8 @@ TEST_F(BfrtPacketioManagerTest, MalformedPacketInShouldNotStopRxThread) {
           return false;
         }
       }));
-  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, TranslatePacketIn(_))
-      .WillRepeatedly(ReturnArg<0>());
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_, TranslatePacketInInPlace(_))
+      .WillRepeatedly(Return(::util::OkStatus()));
   const std::string malformed_packet_from_asic("\0",  // metadata too short
                                                1);
   const std::string valid_packet_from_asic(
@@ -388,10 +567,11 @@ TEST_F(BfrtPacketioManagerTest, MalformedPacketInShouldNotStopRxThread) {
 
   // Send malformed packet first, then a valid one. This verifies that
   // processing continues after previous errors.
-  EXPECT_OK(packet_rx_writer->Write(malformed_packet_from_asic,
-                                    absl::Milliseconds(100)));
   EXPECT_OK(
-      packet_rx_writer->Write(valid_packet_from_asic, absl::Milliseconds(100)));
+      packet_rx_writer->Write(MakePacketBuffer(malformed_packet_from_asic),
+                              absl::Milliseconds(100)));
+  EXPECT_OK(packet_rx_writer->Write(MakePacketBuffer(valid_packet_from_asic),
+                                    absl::Milliseconds(100)));
 
   // Here we wait until we receive the valid packet from the mock packet-in
   // writer.
@@ -401,6 +581,135 @@ TEST_F(BfrtPacketioManagerTest, MalformedPacketInShouldNotStopRxThread) {
   EXPECT_OK(Shutdown());
 }
 
+TEST_F(BfrtPacketioManagerTest, VirtualCpuIntfQueuesAreDrainedInBursts) {
+  FLAGS_experimental_tap_rx_burst_size = 2;
+  SetUpVirtualCpuIntfQueues(3);
+  // The packets are queued before the RX threads start, so every thread finds
+  // all packets of its queue at its first wakeup.
+  ASSERT_EQ(2, write(tap_peer_fds_[0], "ab", 2));
+  ASSERT_EQ(2, write(tap_peer_fds_[0], "cd", 2));
+  ASSERT_EQ(3, write(tap_peer_fds_[2], "efg", 3));
+  ASSERT_EQ(2, write(tap_peer_fds_[2], "hi", 2));
+  ASSERT_EQ(1, write(tap_peer_fds_[2], "j", 1));
+  absl::Mutex lock;
+  std::vector<std::string> sent;
+  EXPECT_CALL(*bf_sde_wrapper_mock_, TxPacket(kDevice1, _))
+      .Times(5)
+      .WillRepeatedly(Invoke([&lock, &sent](int device,
+                                            const std::string& packet) {
+        absl::MutexLock l(&lock);
+        sent.push_back(packet);
+        return ::util::OkStatus();
+      }));
+  EXPECT_OK(PushPipelineConfig());
+
+  // Each queue is served by its own RX thread. Queue 0 is drained in one
+  // burst, queue 2 needs two bursts of at most 2 packets.
+  EXPECT_TRUE(WaitForVirtualCpuIntfStats(
+      [](const BfrtPacketioManager::VirtualCpuIntfStats& stats) {
+        return stats.packets_from_tap == 5;
+      }));
+  BfrtPacketioManager::VirtualCpuIntfStats stats =
+      bfrt_packetio_manager_->GetVirtualCpuIntfStats();
+  EXPECT_EQ(10U, stats.bytes_from_tap);
+  EXPECT_EQ(3U, stats.bursts_from_tap);
+  EXPECT_EQ(0U, stats.errors_from_tap);
+  {
+    absl::MutexLock l(&lock);
+    EXPECT_THAT(sent, UnorderedElementsAre("ab", "cd", "efg", "hi", "j"));
+  }
+  EXPECT_OK(Shutdown());
+}
+
+TEST_F(BfrtPacketioManagerTest, NonPacketInsAreSentToFirstVirtualCpuIntfQueue) {
+  SetUpVirtualCpuIntfQueues(2);
+  EXPECT_OK(PushPipelineConfig());
+  // A plain Ethernet frame, without the 0xBF01 PacketIn magic ether type.
+  const std::string packet_from_asic(
+      "\x00\x00\x00\x33\x33\x33\x00\x00\x00\x00\x00\x01\x08\x00"
+      "abcde",
+      19);
+  EXPECT_OK(packet_rx_writer->Write(MakePacketBuffer(packet_from_asic),
+                                    absl::Milliseconds(100)));
+
+  struct pollfd pfd = {};
+  pfd.fd = tap_peer_fds_[0];
+  pfd.events = POLLIN;
+  ASSERT_EQ(1, poll(&pfd, 1, 1000));
+  char buffer[64];
+  ssize_t len = read(tap_peer_fds_[0], buffer, sizeof(buffer));
+  ASSERT_EQ(19, len);
+  EXPECT_EQ(packet_from_asic, std::string(buffer, len));
+  EXPECT_EQ(-1, recv(tap_peer_fds_[1], buffer, sizeof(buffer), MSG_DONTWAIT));
+  EXPECT_TRUE(WaitForVirtualCpuIntfStats(
+      [](const BfrtPacketioManager::VirtualCpuIntfStats& stats) {
+        return stats.packets_to_tap == 1;
+      }));
+  BfrtPacketioManager::VirtualCpuIntfStats stats =
+      bfrt_packetio_manager_->GetVirtualCpuIntfStats();
+  EXPECT_EQ(19U, stats.bytes_to_tap);
+  EXPECT_EQ(0U, stats.errors_to_tap);
+  EXPECT_EQ(0U, stats.packets_from_tap);
+  EXPECT_OK(Shutdown());
+}
+
+// The SDE RX path reuses its packet buffers and PacketIn message, so once warm
+// it handles packets without heap allocations. This uses the real translator
+// with translation disabled, as the mock allocates on every call.
+TEST_F(BfrtPacketioManagerTest, PacketInDoesNotAllocateOnRxThread) {
+  auto translator = BfrtP4RuntimeTranslator::CreateInstance(
+      false, bf_sde_wrapper_mock_.get(), kDevice1);
+  bfrt_packetio_manager_ = BfrtPacketioManager::CreateInstance(
+      bf_sde_wrapper_mock_.get(), translator.get(), kDevice1);
+  BfrtDeviceConfig config;
+  ASSERT_OK(
+      ParseProtoFromString(kP4Info, config.add_programs()->mutable_p4info()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, StartPacketIo(kDevice1))
+      .WillOnce(Return(util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, RegisterPacketReceiveWriter(kDevice1, _))
+      .WillOnce(
+          Invoke(this, &BfrtPacketioManagerTest::RegisterPacketReceiveWriter));
+  ASSERT_OK(bfrt_packetio_manager_->PushForwardingPipelineConfig(config));
+  auto writer = std::make_shared<CountingPacketInWriter>();
+  ASSERT_OK(bfrt_packetio_manager_->RegisterPacketReceiveWriter(writer));
+
+  auto pool = PacketBufferPool::Create(4, 2048);
+  const std::string packet_from_asic(
+      "\0\x80"
+      "abcde",
+      7);
+  // Sends one packet and waits until the RX thread has handled it, so that
+  // the RX thread never blocks on a half-written channel.
+  auto send_packet = [&]() {
+    const int expected_packets = writer->num_packets() + 1;
+    PacketBuffer buffer = pool->Acquire();
+    buffer.mutable_data()->assign(packet_from_asic);
+    EXPECT_OK(
+        packet_rx_writer->Write(std::move(buffer), absl::Milliseconds(100)));
+    const absl::Time deadline = absl::Now() + absl::Seconds(1);
+    while (writer->num_packets() < expected_packets) {
+      if (absl::Now() > deadline) return false;
+      absl::SleepFor(absl::Microseconds(10));
+    }
+    return true;
+  };
+
+  constexpr int kNumWarmUpPackets = 100;
+  constexpr int kNumPackets = 1000;
+  for (int i = 0; i < kNumWarmUpPackets; ++i) ASSERT_TRUE(send_packet());
+  StartCountingRxAllocations();
+  for (int i = 0; i < kNumPackets; ++i) {
+    if (!send_packet()) break;
+  }
+  EXPECT_EQ(0, StopCountingRxAllocations());
+  EXPECT_EQ(kNumWarmUpPackets + kNumPackets, writer->num_packets());
+
+  EXPECT_OK(bfrt_packetio_manager_->UnregisterPacketReceiveWriter());
+  EXPECT_OK(Shutdown());
+  // The manager must not outlive the translator.
+  bfrt_packetio_manager_.reset();
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
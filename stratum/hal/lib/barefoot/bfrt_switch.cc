@@ -105,6 +105,28 @@ BfrtSwitch::~BfrtSwitch() {}
   return ::util::OkStatus();
 }
 
+::util::Status BfrtSwitch::ReconcileAndCommitForwardingPipelineConfig(
+    uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
+  absl::WriterMutexLock l(&chassis_lock);
+  RETURN_IF_ERROR(DoVerifyForwardingPipelineConfig(node_id, config));
+  ASSIGN_OR_RETURN(auto* bfrt_node, GetBfrtNodeFromNodeId(node_id));
+  bool pipeline_reloaded = false;
+  ::util::Status status = bfrt_node->ReconcileAndCommitForwardingPipelineConfig(
+      config, &pipeline_reloaded);
+  // Ports only need to be replayed if the device was reset, i.e. if this was
+  // the first pipeline pushed to the node.
+  if (pipeline_reloaded) {
+    APPEND_STATUS_IF_ERROR(status,
+                           bf_chassis_manager_->ReplayChassisConfig(node_id));
+  }
+  RETURN_IF_ERROR(status);
+
+  LOG(INFO) << "P4-based forwarding pipeline config reconciled and committed "
+            << "successfully to node with ID " << node_id << ".";
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BfrtSwitch::VerifyForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   // TODO(max): This should be a ReaderMutexLock?
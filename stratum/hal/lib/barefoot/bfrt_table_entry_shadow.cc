@@ -0,0 +1,152 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_table_entry_shadow.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "stratum/hal/lib/p4/utils.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+namespace {
+
+// Appends a length-prefixed canonical byte string to the key.
+void AppendValue(const std::string& value, std::string* key) {
+  const std::string canonical = ByteStringToP4RuntimeByteString(value);
+  absl::StrAppend(key, canonical.size(), ":", canonical);
+}
+
+}  // namespace
+
+TableEntryShadow::TableEntryShadow() : lock_(), tables_() {}
+
+std::string TableEntryShadow::MatchKey(const ::p4::v1::TableEntry& entry) {
+  std::vector<const ::p4::v1::FieldMatch*> matches;
+  matches.reserve(entry.match_size());
+  for (const auto& match : entry.match()) matches.push_back(&match);
+  std::sort(matches.begin(), matches.end(),
+            [](const ::p4::v1::FieldMatch* a, const ::p4::v1::FieldMatch* b) {
+              return a->field_id() < b->field_id();
+            });
+
+  std::string key = absl::StrCat(entry.priority());
+  for (const auto* match : matches) {
+    absl::StrAppend(&key, "|", match->field_id(), ":",
+                    match->field_match_type_case(), ":");
+    switch (match->field_match_type_case()) {
+      case ::p4::v1::FieldMatch::kExact:
+        AppendValue(match->exact().value(), &key);
+        break;
+      case ::p4::v1::FieldMatch::kTernary:
+        AppendValue(match->ternary().value(), &key);
+        AppendValue(match->ternary().mask(), &key);
+        break;
+      case ::p4::v1::FieldMatch::kLpm:
+        AppendValue(match->lpm().value(), &key);
+        absl::StrAppend(&key, "/", match->lpm().prefix_len());
+        break;
+      case ::p4::v1::FieldMatch::kRange:
+        AppendValue(match->range().low(), &key);
+        AppendValue(match->range().high(), &key);
+        break;
+      case ::p4::v1::FieldMatch::kOptional:
+        AppendValue(match->optional().value(), &key);
+        break;
+      default:
+        // Unknown match types are compared on their serialized form.
+        absl::StrAppend(&key, match->SerializeAsString());
+        break;
+    }
+  }
+
+  return key;
+}
+
+std::shared_ptr<const ::p4::v1::TableEntry> TableEntryShadow::MakeShadowEntry(
+    const ::p4::v1::TableEntry& entry) {
+  auto shadow_entry = std::make_shared<::p4::v1::TableEntry>(entry);
+  // Counter and meter data are always read from the hardware.
+  shadow_entry->clear_counter_data();
+  shadow_entry->clear_meter_config();
+
+  return shadow_entry;
+}
+
+void TableEntryShadow::Clear() {
+  absl::MutexLock l(&lock_);
+  tables_.clear();
+}
+
+void TableEntryShadow::RecordWrite(::p4::v1::Update::Type type,
+                                   const ::p4::v1::TableEntry& entry) {
+  absl::MutexLock l(&lock_);
+  TableShadow& table = tables_[entry.table_id()];
+  ++table.generation;
+  if (!table.seeded) return;
+  switch (type) {
+    case ::p4::v1::Update::INSERT:
+    case ::p4::v1::Update::MODIFY:
+      table.entries[MatchKey(entry)] = MakeShadowEntry(entry);
+      break;
+    case ::p4::v1::Update::DELETE:
+      table.entries.erase(MatchKey(entry));
+      break;
+    default:
+      // Not a valid write, so we can no longer trust the shadow.
+      table.seeded = false;
+      table.entries.clear();
+      break;
+  }
+}
+
+uint64 TableEntryShadow::GetGeneration(uint32 table_id) const {
+  absl::MutexLock l(&lock_);
+  auto it = tables_.find(table_id);
+  return it == tables_.end() ? 0 : it->second.generation;
+}
+
+void TableEntryShadow::Seed(uint32 table_id, uint64 generation,
+                            const std::vector<::p4::v1::TableEntry>& entries) {
+  absl::MutexLock l(&lock_);
+  TableShadow& table = tables_[table_id];
+  if (table.seeded || table.generation != generation) return;
+  table.entries.clear();
+  table.entries.reserve(entries.size());
+  for (const auto& entry : entries) {
+    table.entries[MatchKey(entry)] = MakeShadowEntry(entry);
+  }
+  table.seeded = true;
+}
+
+std::shared_ptr<const ::p4::v1::TableEntry> TableEntryShadow::Lookup(
+    const ::p4::v1::TableEntry& entry) const {
+  const std::string key = MatchKey(entry);
+  absl::MutexLock l(&lock_);
+  auto table_it = tables_.find(entry.table_id());
+  if (table_it == tables_.end() || !table_it->second.seeded) return nullptr;
+  auto it = table_it->second.entries.find(key);
+  if (it == table_it->second.entries.end()) return nullptr;
+
+  return it->second;
+}
+
+bool TableEntryShadow::GetAll(
+    uint32 table_id,
+    std::vector<std::shared_ptr<const ::p4::v1::TableEntry>>* entries) const {
+  absl::MutexLock l(&lock_);
+  auto table_it = tables_.find(table_id);
+  if (table_it == tables_.end() || !table_it->second.seeded) return false;
+  entries->clear();
+  entries->reserve(table_it->second.entries.size());
+  for (const auto& e : table_it->second.entries) entries->push_back(e.second);
+
+  return true;
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
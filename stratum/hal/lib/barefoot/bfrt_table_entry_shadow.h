@@ -0,0 +1,98 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BFRT_TABLE_ENTRY_SHADOW_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BFRT_TABLE_ENTRY_SHADOW_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// A software copy of the table entries programmed through P4Runtime, in the
+// form written by the controller, used to answer reads without going to the
+// SDE. Entries are keyed by table ID and a canonical form of their match.
+//
+// The shadow of a table is only used once it is known to be complete: after
+// a pipeline push the table may already hold entries (e.g. const entries or
+// entries kept across a push), so the first full read of a table goes to the
+// hardware and its result seeds the shadow. Writes keep seeded tables up to
+// date. The class is thread-safe.
+class TableEntryShadow {
+ public:
+  TableEntryShadow();
+
+  // Returns the canonical key of the match of the given entry: the priority
+  // and the match fields ordered by field ID, with their values stripped of
+  // leading zero bytes.
+  static std::string MatchKey(const ::p4::v1::TableEntry& entry);
+
+  // Forgets all entries, e.g. after a pipeline push.
+  void Clear() LOCKS_EXCLUDED(lock_);
+
+  // Records a successful write of a non-default table entry.
+  void RecordWrite(::p4::v1::Update::Type type,
+                   const ::p4::v1::TableEntry& entry) LOCKS_EXCLUDED(lock_);
+
+  // Returns the write generation of the given table, to be passed to Seed()
+  // after reading the table from the hardware.
+  uint64 GetGeneration(uint32 table_id) const LOCKS_EXCLUDED(lock_);
+
+  // Makes the given entries the complete content of the table, unless the
+  // table was written since generation was taken.
+  void Seed(uint32 table_id, uint64 generation,
+            const std::vector<::p4::v1::TableEntry>& entries)
+      LOCKS_EXCLUDED(lock_);
+
+  // Looks up the entry matching the given one. Returns nullptr if the table
+  // is not seeded or holds no such entry.
+  std::shared_ptr<const ::p4::v1::TableEntry> Lookup(
+      const ::p4::v1::TableEntry& entry) const LOCKS_EXCLUDED(lock_);
+
+  // Copies the entries of the given table into entries. Returns false if the
+  // table is not seeded.
+  bool GetAll(uint32 table_id,
+              std::vector<std::shared_ptr<const ::p4::v1::TableEntry>>*
+                  entries) const LOCKS_EXCLUDED(lock_);
+
+  // TableEntryShadow is neither copyable nor movable.
+  TableEntryShadow(const TableEntryShadow&) = delete;
+  TableEntryShadow& operator=(const TableEntryShadow&) = delete;
+
+ private:
+  struct TableShadow {
+    // Whether the entries are known to be all entries of the table.
+    bool seeded = false;
+    // Incremented on every write to the table.
+    uint64 generation = 0;
+    // Map from canonical match key to the entry. Entries are shared with
+    // readers streaming them out.
+    absl::flat_hash_map<std::string,
+                        std::shared_ptr<const ::p4::v1::TableEntry>>
+        entries;
+  };
+
+  // Returns a copy of the entry without the parts which are not stored.
+  static std::shared_ptr<const ::p4::v1::TableEntry> MakeShadowEntry(
+      const ::p4::v1::TableEntry& entry);
+
+  mutable absl::Mutex lock_;
+
+  // Map from P4Runtime table ID to its shadow.
+  absl::flat_hash_map<uint32, TableShadow> tables_ GUARDED_BY(lock_);
+};
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BFRT_TABLE_ENTRY_SHADOW_H_
@@ -0,0 +1,140 @@
+// Copyright 2022-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_table_entry_shadow.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+using test_utils::EqualsProto;
+
+namespace {
+
+constexpr uint32 kTableId = 33583783;
+
+constexpr char kTableEntryText[] = R"pb(
+  table_id: 33583783
+  match {
+    field_id: 1
+    exact {
+      value: "\001"
+    }
+  }
+  match {
+    field_id: 2
+    ternary {
+      value: "\211B"
+      mask: "\377\377"
+    }
+  }
+  action {
+    action {
+      action_id: 16794911
+      params {
+        param_id: 1
+        value: "\001"
+      }
+    }
+  }
+  priority: 10
+  metadata: "cookie"
+)pb";
+
+::p4::v1::TableEntry ParseTableEntry(const std::string& text) {
+  ::p4::v1::TableEntry entry;
+  CHECK_OK(ParseProtoFromString(text, &entry));
+  return entry;
+}
+
+}  // namespace
+
+TEST(TableEntryShadowTest, MatchKeyIsCanonical) {
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kTableEntryText);
+  // Same match with the fields in a different order and a padded value.
+  ::p4::v1::TableEntry other = entry;
+  other.mutable_match()->SwapElements(0, 1);
+  other.mutable_match(1)->mutable_exact()->set_value(std::string("\0\001", 2));
+  other.clear_action();
+  EXPECT_EQ(TableEntryShadow::MatchKey(entry),
+            TableEntryShadow::MatchKey(other));
+
+  other.set_priority(20);
+  EXPECT_NE(TableEntryShadow::MatchKey(entry),
+            TableEntryShadow::MatchKey(other));
+}
+
+TEST(TableEntryShadowTest, UnseededTableIsNotServed) {
+  TableEntryShadow shadow;
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kTableEntryText);
+  shadow.RecordWrite(::p4::v1::Update::INSERT, entry);
+  EXPECT_EQ(nullptr, shadow.Lookup(entry));
+  std::vector<std::shared_ptr<const ::p4::v1::TableEntry>> entries;
+  EXPECT_FALSE(shadow.GetAll(kTableId, &entries));
+}
+
+TEST(TableEntryShadowTest, WritesUpdateSeededTable) {
+  TableEntryShadow shadow;
+  shadow.Seed(kTableId, shadow.GetGeneration(kTableId), {});
+  std::vector<std::shared_ptr<const ::p4::v1::TableEntry>> entries;
+  ASSERT_TRUE(shadow.GetAll(kTableId, &entries));
+  EXPECT_TRUE(entries.empty());
+
+  ::p4::v1::TableEntry entry = ParseTableEntry(kTableEntryText);
+  entry.mutable_counter_data()->set_packet_count(5);
+  shadow.RecordWrite(::p4::v1::Update::INSERT, entry);
+  entry.clear_counter_data();
+  auto result = shadow.Lookup(entry);
+  ASSERT_NE(nullptr, result);
+  EXPECT_THAT(*result, EqualsProto(entry));
+
+  entry.mutable_action()->mutable_action()->mutable_params(0)->set_value(
+      "\002");
+  shadow.RecordWrite(::p4::v1::Update::MODIFY, entry);
+  ASSERT_TRUE(shadow.GetAll(kTableId, &entries));
+  ASSERT_EQ(1, entries.size());
+  EXPECT_THAT(*entries[0], EqualsProto(entry));
+
+  shadow.RecordWrite(::p4::v1::Update::DELETE, entry);
+  EXPECT_EQ(nullptr, shadow.Lookup(entry));
+  ASSERT_TRUE(shadow.GetAll(kTableId, &entries));
+  EXPECT_TRUE(entries.empty());
+}
+
+TEST(TableEntryShadowTest, SeedIsDroppedAfterConcurrentWrite) {
+  TableEntryShadow shadow;
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kTableEntryText);
+  const uint64 generation = shadow.GetGeneration(kTableId);
+  // The write happens while the table is read from the hardware.
+  shadow.RecordWrite(::p4::v1::Update::INSERT, entry);
+  shadow.Seed(kTableId, generation, {});
+  std::vector<std::shared_ptr<const ::p4::v1::TableEntry>> entries;
+  EXPECT_FALSE(shadow.GetAll(kTableId, &entries));
+
+  shadow.Seed(kTableId, shadow.GetGeneration(kTableId), {entry});
+  ASSERT_TRUE(shadow.GetAll(kTableId, &entries));
+  EXPECT_EQ(1, entries.size());
+}
+
+TEST(TableEntryShadowTest, ClearForgetsAllTables) {
+  TableEntryShadow shadow;
+  const ::p4::v1::TableEntry entry = ParseTableEntry(kTableEntryText);
+  shadow.Seed(kTableId, shadow.GetGeneration(kTableId), {entry});
+  ASSERT_NE(nullptr, shadow.Lookup(entry));
+  shadow.Clear();
+  EXPECT_EQ(nullptr, shadow.Lookup(entry));
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -15,6 +15,7 @@
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
 #include "stratum/hal/lib/barefoot/utils.h"
+#include "stratum/hal/lib/common/chunked_read_response_writer.h"
 #include "stratum/hal/lib/p4/utils.h"
 #include "stratum/lib/utils.h"
 
@@ -22,6 +23,13 @@ DEFINE_uint32(
     bfrt_table_sync_timeout_ms,
     stratum::hal::barefoot::kDefaultSyncTimeout / absl::Milliseconds(1),
     "The timeout for table sync operation like counters and registers.");
+DEFINE_bool(bfrt_table_entry_shadow, false,
+            "Keep a software copy of the written table entries and serve "
+            "reads not asking for counter or meter data from it.");
+DEFINE_uint32(bfrt_counter_sync_max_staleness_ms, 0,
+              "Counters are not synced from the hardware again if the last "
+              "sync of the table is at most this old. Concurrent reads of a "
+              "table always share a single sync.");
 
 namespace stratum {
 namespace hal {
@@ -35,6 +43,8 @@ BfrtTableManager::BfrtTableManager(
       bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)),
       bfrt_p4runtime_translator_(ABSL_DIE_IF_NULL(bfrt_p4runtime_translator)),
       p4_info_manager_(nullptr),
+      table_entry_shadow_(),
+      table_write_locks_(),
       device_(device) {}
 
 BfrtTableManager::BfrtTableManager()
@@ -43,10 +53,14 @@ BfrtTableManager::BfrtTableManager()
       bf_sde_interface_(nullptr),
       bfrt_p4runtime_translator_(nullptr),
       p4_info_manager_(nullptr),
+      table_entry_shadow_(),
+      table_write_locks_(),
       device_(-1) {}
 
 BfrtTableManager::~BfrtTableManager() = default;
 
+constexpr int BfrtTableManager::kNumTableWriteLocks;
+
 std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
     OperationMode mode, BfSdeInterface* bf_sde_interface,
     BfrtP4RuntimeTranslator* bfrt_p4runtime_translator, int device) {
@@ -64,6 +78,8 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
       absl::make_unique<P4InfoManager>(p4_info);
   RETURN_IF_ERROR(p4_info_manager->InitializeAndVerify());
   p4_info_manager_ = std::move(p4_info_manager);
+  // The table content and the P4Info IDs may have changed.
+  table_entry_shadow_.Clear();
 
   if (digest_rx_thread_id_ == 0) {
     digest_list_receive_channel_ =
@@ -140,6 +156,20 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   return status;
 }
 
+::util::StatusOr<const ::p4::v1::TableEntry*>
+BfrtTableManager::TranslateTableEntryToSdk(
+    const ::p4::v1::TableEntry& table_entry,
+    ::p4::v1::TableEntry* translated_entry) {
+  if (!bfrt_p4runtime_translator_->TableEntryRequiresTranslation(
+          table_entry)) {
+    return &table_entry;
+  }
+  ASSIGN_OR_RETURN(*translated_entry,
+                   bfrt_p4runtime_translator_->TranslateTableEntry(
+                       table_entry, /*to_sdk=*/true));
+  return translated_entry;
+}
+
 ::util::Status BfrtTableManager::BuildTableKey(
     const ::p4::v1::TableEntry& table_entry,
     BfSdeInterface::TableKeyInterface* table_key) {
@@ -315,71 +345,204 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   RET_CHECK(type != ::p4::v1::Update::UNSPECIFIED)
       << "Invalid update type " << type;
   absl::ReaderMutexLock l(&lock_);
-  ASSIGN_OR_RETURN(const auto& translated_table_entry,
-                   bfrt_p4runtime_translator_->TranslateTableEntry(
-                       table_entry, /*to_sdk=*/true));
+  absl::MutexLock table_lock(TableWriteLock(table_entry.table_id()));
+  if (table_entry.is_default_action()) {
+    return WriteDefaultTableEntry(session, type, table_entry);
+  }
+
+  ASSIGN_OR_RETURN(auto prepared, PrepareTableEntryWrite(type, table_entry));
+  switch (type) {
+    case ::p4::v1::Update::INSERT:
+      RETURN_IF_ERROR(bf_sde_interface_->InsertTableEntry(
+          device_, session, prepared.table_id, prepared.table_key.get(),
+          prepared.table_data.get()));
+      break;
+    case ::p4::v1::Update::MODIFY:
+      RETURN_IF_ERROR(bf_sde_interface_->ModifyTableEntry(
+          device_, session, prepared.table_id, prepared.table_key.get(),
+          prepared.table_data.get()));
+      break;
+    case ::p4::v1::Update::DELETE:
+      RETURN_IF_ERROR(bf_sde_interface_->DeleteTableEntry(
+          device_, session, prepared.table_id, prepared.table_key.get()));
+      break;
+    default:
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Unsupported update type: " << type << " in table entry "
+             << table_entry.ShortDebugString() << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status BfrtTableManager::WriteTableEntries(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const std::vector<const ::p4::v1::TableEntry*>& table_entries,
+    std::vector<::util::Status>* results) {
+  RET_CHECK(type != ::p4::v1::Update::UNSPECIFIED)
+      << "Invalid update type " << type;
+  RET_CHECK(results);
+  absl::ReaderMutexLock l(&lock_);
+  results->assign(table_entries.size(), ::util::OkStatus());
+  size_t i = 0;
+  while (i < table_entries.size()) {
+    absl::MutexLock table_lock(TableWriteLock(table_entries[i]->table_id()));
+    if (table_entries[i]->is_default_action()) {
+      (*results)[i] = WriteDefaultTableEntry(session, type, *table_entries[i]);
+      ++i;
+      continue;
+    }
+    // Collect the run of non-default entries of the same table. Entries
+    // which cannot be prepared fail on their own, without ending the run.
+    const uint32 p4_table_id = table_entries[i]->table_id();
+    std::vector<PreparedTableEntry> batch;
+    std::vector<size_t> batch_indices;
+    for (; i < table_entries.size() &&
+           !table_entries[i]->is_default_action() &&
+           table_entries[i]->table_id() == p4_table_id;
+         ++i) {
+      auto prepared = PrepareTableEntryWrite(type, *table_entries[i]);
+      if (!prepared.ok()) {
+        (*results)[i] = prepared.status();
+        continue;
+      }
+      batch.push_back(prepared.ConsumeValueOrDie());
+      batch_indices.push_back(i);
+    }
+
+    std::vector<::util::Status> batch_results;
+    ::util::Status status =
+        WriteTableEntryBatch(session, type, batch, &batch_results);
+    if (status.ok() && batch_results.size() != batch.size()) {
+      status = MAKE_ERROR(ERR_INTERNAL)
+               << "Got " << batch_results.size() << " results for a batch of "
+               << batch.size() << " table entries.";
+    }
+    for (size_t j = 0; j < batch_indices.size(); ++j) {
+      const size_t index = batch_indices[j];
+      (*results)[index] = status.ok() ? batch_results[j] : status;
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+void BfrtTableManager::RecordTableEntryWrite(
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::TableEntry& table_entry) {
+  if (!FLAGS_bfrt_table_entry_shadow || table_entry.is_default_action()) {
+    return;
+  }
+  table_entry_shadow_.RecordWrite(type, table_entry);
+}
+
+absl::Mutex* BfrtTableManager::TableWriteLock(uint32 p4_id) const {
+  return &table_write_locks_[p4_id % kNumTableWriteLocks];
+}
+
+::util::StatusOr<BfrtTableManager::PreparedTableEntry>
+BfrtTableManager::PrepareTableEntryWrite(
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::TableEntry& table_entry) {
+  ::p4::v1::TableEntry translated_entry_storage;
+  ASSIGN_OR_RETURN(
+      const ::p4::v1::TableEntry* translated_entry_ptr,
+      TranslateTableEntryToSdk(table_entry, &translated_entry_storage));
+  const auto& translated_table_entry = *translated_entry_ptr;
+  RET_CHECK(!translated_table_entry.is_default_action());
 
   ASSIGN_OR_RETURN(auto table, p4_info_manager_->FindTableByID(
                                    translated_table_entry.table_id()));
+  PreparedTableEntry prepared;
+  ASSIGN_OR_RETURN(prepared.table_id, bf_sde_interface_->GetBfRtId(
+                                          translated_table_entry.table_id()));
+  if (table.is_const_table()) {
+    return MAKE_ERROR(ERR_PERMISSION_DENIED)
+           << "Can't write to const table " << table.preamble().name()
+           << " because it has const entries.";
+  }
+  ASSIGN_OR_RETURN(prepared.table_key,
+                   bf_sde_interface_->CreateTableKey(prepared.table_id));
+  RETURN_IF_ERROR(
+      BuildTableKey(translated_table_entry, prepared.table_key.get()));
+
+  ASSIGN_OR_RETURN(
+      prepared.table_data,
+      bf_sde_interface_->CreateTableData(
+          prepared.table_id,
+          translated_table_entry.action().action().action_id()));
+  if (type == ::p4::v1::Update::INSERT || type == ::p4::v1::Update::MODIFY) {
+    RETURN_IF_ERROR(
+        BuildTableData(translated_table_entry, prepared.table_data.get()));
+  }
+
+  return prepared;
+}
+
+::util::Status BfrtTableManager::WriteTableEntryBatch(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const std::vector<PreparedTableEntry>& batch,
+    std::vector<::util::Status>* results) {
+  results->clear();
+  if (batch.empty()) return ::util::OkStatus();
+  std::vector<const BfSdeInterface::TableKeyInterface*> table_keys;
+  std::vector<const BfSdeInterface::TableDataInterface*> table_datas;
+  table_keys.reserve(batch.size());
+  table_datas.reserve(batch.size());
+  for (const auto& prepared : batch) {
+    table_keys.push_back(prepared.table_key.get());
+    table_datas.push_back(prepared.table_data.get());
+  }
+
+  const uint32 table_id = batch.front().table_id;
+  switch (type) {
+    case ::p4::v1::Update::INSERT:
+      return bf_sde_interface_->InsertTableEntries(
+          device_, session, table_id, table_keys, table_datas, results);
+    case ::p4::v1::Update::MODIFY:
+      return bf_sde_interface_->ModifyTableEntries(
+          device_, session, table_id, table_keys, table_datas, results);
+    case ::p4::v1::Update::DELETE:
+      return bf_sde_interface_->DeleteTableEntries(device_, session, table_id,
+                                                   table_keys, results);
+    default:
+      return MAKE_ERROR(ERR_INTERNAL) << "Unsupported update type: " << type
+                                      << " for a batch of table entries.";
+  }
+}
+
+::util::Status BfrtTableManager::WriteDefaultTableEntry(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::Update::Type type,
+    const ::p4::v1::TableEntry& table_entry) {
+  ::p4::v1::TableEntry translated_entry_storage;
+  ASSIGN_OR_RETURN(
+      const ::p4::v1::TableEntry* translated_entry_ptr,
+      TranslateTableEntryToSdk(table_entry, &translated_entry_storage));
+  const auto& translated_table_entry = *translated_entry_ptr;
   ASSIGN_OR_RETURN(uint32 table_id, bf_sde_interface_->GetBfRtId(
                                         translated_table_entry.table_id()));
 
-  if (!translated_table_entry.is_default_action()) {
-    if (table.is_const_table()) {
-      return MAKE_ERROR(ERR_PERMISSION_DENIED)
-             << "Can't write to const table " << table.preamble().name()
-             << " because it has const entries.";
-    }
-    ASSIGN_OR_RETURN(auto table_key,
-                     bf_sde_interface_->CreateTableKey(table_id));
-    RETURN_IF_ERROR(BuildTableKey(translated_table_entry, table_key.get()));
+  RET_CHECK(type == ::p4::v1::Update::MODIFY)
+      << "The default table entry can only be modified.";
+  RET_CHECK(translated_table_entry.match_size() == 0)
+      << "Default action must not contain match fields.";
+  RET_CHECK(translated_table_entry.priority() == 0)
+      << "Default action must not contain a priority field.";
 
+  if (translated_table_entry.has_action()) {
     ASSIGN_OR_RETURN(
         auto table_data,
         bf_sde_interface_->CreateTableData(
             table_id, translated_table_entry.action().action().action_id()));
-    if (type == ::p4::v1::Update::INSERT || type == ::p4::v1::Update::MODIFY) {
-      RETURN_IF_ERROR(BuildTableData(translated_table_entry, table_data.get()));
-    }
-
-    switch (type) {
-      case ::p4::v1::Update::INSERT:
-        RETURN_IF_ERROR(bf_sde_interface_->InsertTableEntry(
-            device_, session, table_id, table_key.get(), table_data.get()));
-        break;
-      case ::p4::v1::Update::MODIFY:
-        RETURN_IF_ERROR(bf_sde_interface_->ModifyTableEntry(
-            device_, session, table_id, table_key.get(), table_data.get()));
-        break;
-      case ::p4::v1::Update::DELETE:
-        RETURN_IF_ERROR(bf_sde_interface_->DeleteTableEntry(
-            device_, session, table_id, table_key.get()));
-        break;
-      default:
-        return MAKE_ERROR(ERR_INTERNAL)
-               << "Unsupported update type: " << type << " in table entry "
-               << translated_table_entry.ShortDebugString() << ".";
-    }
+    RETURN_IF_ERROR(BuildTableData(translated_table_entry, table_data.get()));
+    RETURN_IF_ERROR(bf_sde_interface_->SetDefaultTableEntry(
+        device_, session, table_id, table_data.get()));
   } else {
-    RET_CHECK(type == ::p4::v1::Update::MODIFY)
-        << "The default table entry can only be modified.";
-    RET_CHECK(translated_table_entry.match_size() == 0)
-        << "Default action must not contain match fields.";
-    RET_CHECK(translated_table_entry.priority() == 0)
-        << "Default action must not contain a priority field.";
-
-    if (translated_table_entry.has_action()) {
-      ASSIGN_OR_RETURN(
-          auto table_data,
-          bf_sde_interface_->CreateTableData(
-              table_id, translated_table_entry.action().action().action_id()));
-      RETURN_IF_ERROR(BuildTableData(translated_table_entry, table_data.get()));
-      RETURN_IF_ERROR(bf_sde_interface_->SetDefaultTableEntry(
-          device_, session, table_id, table_data.get()));
-    } else {
-      RETURN_IF_ERROR(bf_sde_interface_->ResetDefaultTableEntry(
-          device_, session, table_id));
-    }
+    RETURN_IF_ERROR(bf_sde_interface_->ResetDefaultTableEntry(
+        device_, session, table_id));
   }
 
   return ::util::OkStatus();
@@ -554,9 +717,9 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
       ::p4::v1::TableEntry result,
       BuildP4TableEntry(table_entry, table_key.get(), table_data.get()));
   ::p4::v1::ReadResponse resp;
-  ASSIGN_OR_RETURN(*resp.add_entities()->mutable_table_entry(),
-                   bfrt_p4runtime_translator_->TranslateTableEntry(
-                       result, /*to_sdk=*/false));
+  RETURN_IF_ERROR(bfrt_p4runtime_translator_->TranslateTableEntryInPlace(
+      &result, /*to_sdk=*/false));
+  *resp.add_entities()->mutable_table_entry() = std::move(result);
   VLOG(1) << "ReadSingleTableEntry resp " << resp.DebugString();
   if (!writer->Write(resp)) {
     return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
@@ -589,9 +752,9 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   result.clear_match();
 
   ::p4::v1::ReadResponse resp;
-  ASSIGN_OR_RETURN(*resp.add_entities()->mutable_table_entry(),
-                   bfrt_p4runtime_translator_->TranslateTableEntry(
-                       result, /*to_sdk=*/false));
+  RETURN_IF_ERROR(bfrt_p4runtime_translator_->TranslateTableEntryInPlace(
+      &result, /*to_sdk=*/false));
+  *resp.add_entities()->mutable_table_entry() = std::move(result);
   VLOG(1) << "ReadDefaultTableEntry resp " << resp.DebugString();
   if (!writer->Write(resp)) {
     return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
@@ -615,43 +778,79 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   RET_CHECK(table_entry.is_default_action() == false)
       << "Default action filters on wildcard reads are not supported.";
 
+  const bool use_shadow = CanReadFromShadow(table_entry);
+  if (use_shadow) {
+    std::vector<std::shared_ptr<const ::p4::v1::TableEntry>> entries;
+    if (table_entry_shadow_.GetAll(table_entry.table_id(), &entries)) {
+      ChunkedReadResponseWriter chunked_writer(writer);
+      for (const auto& entry : entries) {
+        ASSIGN_OR_RETURN(::p4::v1::Entity* entity, chunked_writer.AddEntity());
+        *entity->mutable_table_entry() = *entry;
+      }
+      RETURN_IF_ERROR(chunked_writer.Flush());
+      VLOG(1) << "ReadAllTableEntries read " << entries.size()
+              << " entries from the shadow of table " << table_entry.table_id()
+              << ".";
+      return ::util::OkStatus();
+    }
+  }
+  // If the shadow of the table is not seeded yet, this read does it.
+  const uint64 shadow_generation =
+      use_shadow ? table_entry_shadow_.GetGeneration(table_entry.table_id())
+                 : 0;
+  std::vector<::p4::v1::TableEntry> shadow_entries;
+
   ASSIGN_OR_RETURN(uint32 table_id,
                    bf_sde_interface_->GetBfRtId(table_entry.table_id()));
   std::vector<std::unique_ptr<BfSdeInterface::TableKeyInterface>> keys;
   std::vector<std::unique_ptr<BfSdeInterface::TableDataInterface>> datas;
   RETURN_IF_ERROR(bf_sde_interface_->GetAllTableEntries(
       device_, session, table_id, &keys, &datas));
-  ::p4::v1::ReadResponse resp;
+  // Stream the entries in bounded chunks, instead of building a single
+  // response holding the whole table.
+  ChunkedReadResponseWriter chunked_writer(writer);
   for (size_t i = 0; i < keys.size(); ++i) {
-    const std::unique_ptr<BfSdeInterface::TableKeyInterface>& table_key =
-        keys[i];
-    const std::unique_ptr<BfSdeInterface::TableDataInterface>& table_data =
-        datas[i];
     ASSIGN_OR_RETURN(
         auto result,
-        BuildP4TableEntry(table_entry, table_key.get(), table_data.get()));
-    ASSIGN_OR_RETURN(*resp.add_entities()->mutable_table_entry(),
-                     bfrt_p4runtime_translator_->TranslateTableEntry(
-                         result, /*to_sdk=*/false));
+        BuildP4TableEntry(table_entry, keys[i].get(), datas[i].get()));
+    // The SDE objects are not needed anymore.
+    keys[i].reset();
+    datas[i].reset();
+    ASSIGN_OR_RETURN(::p4::v1::Entity* entity, chunked_writer.AddEntity());
+    RETURN_IF_ERROR(bfrt_p4runtime_translator_->TranslateTableEntryInPlace(
+        &result, /*to_sdk=*/false));
+    if (use_shadow) shadow_entries.push_back(result);
+    *entity->mutable_table_entry() = std::move(result);
   }
-
-  VLOG(1) << "ReadAllTableEntries resp " << resp.DebugString();
-  if (!writer->Write(resp)) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
+  RETURN_IF_ERROR(chunked_writer.Flush());
+  if (use_shadow) {
+    table_entry_shadow_.Seed(table_entry.table_id(), shadow_generation,
+                             shadow_entries);
   }
+  VLOG(1) << "ReadAllTableEntries read " << keys.size()
+          << " entries from table " << table_entry.table_id() << " in "
+          << chunked_writer.GetNumResponsesWritten() << " responses.";
 
   return ::util::OkStatus();
 }
 
+bool BfrtTableManager::CanReadFromShadow(
+    const ::p4::v1::TableEntry& table_entry) {
+  return FLAGS_bfrt_table_entry_shadow && !table_entry.has_counter_data() &&
+         !table_entry.has_meter_config();
+}
+
 ::util::Status BfrtTableManager::ReadTableEntry(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
     const ::p4::v1::TableEntry& table_entry,
     WriterInterface<::p4::v1::ReadResponse>* writer) {
   RET_CHECK(writer) << "Null writer.";
   absl::ReaderMutexLock l(&lock_);
-  ASSIGN_OR_RETURN(const auto& translated_table_entry,
-                   bfrt_p4runtime_translator_->TranslateTableEntry(
-                       table_entry, /*to_sdk=*/true));
+  ::p4::v1::TableEntry translated_entry_storage;
+  ASSIGN_OR_RETURN(
+      const ::p4::v1::TableEntry* translated_entry_ptr,
+      TranslateTableEntryToSdk(table_entry, &translated_entry_storage));
+  const auto& translated_table_entry = *translated_entry_ptr;
 
   // We have four cases to handle:
   // 1. table id not set: return all table entries from all tables
@@ -682,7 +881,8 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
       for (const auto& wanted_table_entry : wanted_tables) {
         RETURN_IF_ERROR(bf_sde_interface_->SynchronizeCounters(
             device_, session, wanted_table_entry.table_id(),
-            absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms)));
+            absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms),
+            absl::Milliseconds(FLAGS_bfrt_counter_sync_max_staleness_ms)));
       }
     }
     for (const auto& wanted_table_entry : wanted_tables) {
@@ -699,10 +899,23 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
     return ReadDefaultTableEntry(session, translated_table_entry, writer);
   } else {
     // 4.
+    if (CanReadFromShadow(table_entry)) {
+      // Entries missing from the shadow are left to the SDE to report.
+      auto entry = table_entry_shadow_.Lookup(table_entry);
+      if (entry != nullptr) {
+        ::p4::v1::ReadResponse resp;
+        *resp.add_entities()->mutable_table_entry() = *entry;
+        if (!writer->Write(resp)) {
+          return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
+        }
+        return ::util::OkStatus();
+      }
+    }
     if (translated_table_entry.has_counter_data()) {
       RETURN_IF_ERROR(bf_sde_interface_->SynchronizeCounters(
           device_, session, table_entry.table_id(),
-          absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms)));
+          absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms),
+          absl::Milliseconds(FLAGS_bfrt_counter_sync_max_staleness_ms)));
     }
     return ReadSingleTableEntry(session, translated_table_entry, writer);
   }
@@ -730,6 +943,9 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
                    bf_sde_interface_->CreateTableData(table_id, 0));
 
   absl::ReaderMutexLock l(&lock_);
+  // The read-modify-write below must not interleave with other writes to the
+  // same entry, else it would restore their old action data.
+  absl::MutexLock table_lock(TableWriteLock(table_entry.table_id()));
   RETURN_IF_ERROR(BuildTableKey(table_entry, table_key.get()));
 
   // Fetch existing entry with action data. This is needed since the P4RT
@@ -779,7 +995,8 @@ BfrtTableManager::ReadDirectCounterEntry(
   // Sync table counters.
   RETURN_IF_ERROR(bf_sde_interface_->SynchronizeCounters(
       device_, session, table_id,
-      absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms)));
+      absl::Milliseconds(FLAGS_bfrt_table_sync_timeout_ms),
+      absl::Milliseconds(FLAGS_bfrt_counter_sync_max_staleness_ms)));
 
   RETURN_IF_ERROR(bf_sde_interface_->GetTableEntry(
       device_, session, table_id, table_key.get(), table_data.get()));
@@ -867,6 +1084,8 @@ BfrtTableManager::ReadDirectCounterEntry(
       << " must have data.";
   RET_CHECK(register_entry.data().data_case() == ::p4::v1::P4Data::kBitstring)
       << "Only bitstring registers data types are supported.";
+  absl::ReaderMutexLock l(&lock_);
+  absl::MutexLock register_lock(TableWriteLock(register_entry.register_id()));
 
   ASSIGN_OR_RETURN(uint32 table_id,
                    bf_sde_interface_->GetBfRtId(register_entry.register_id()));
@@ -968,6 +1187,8 @@ BfrtTableManager::ReadDirectCounterEntry(
   RET_CHECK(type == ::p4::v1::Update::MODIFY)
       << "Update type of MeterEntry " << meter_entry.ShortDebugString()
       << " must be MODIFY.";
+  absl::ReaderMutexLock l(&lock_);
+  absl::MutexLock meter_lock(TableWriteLock(meter_entry.meter_id()));
   ASSIGN_OR_RETURN(const auto& translated_meter_entry,
                    bfrt_p4runtime_translator_->TranslateMeterEntry(
                        meter_entry, /*to_sdk=*/true));
@@ -976,22 +1197,19 @@ BfrtTableManager::ReadDirectCounterEntry(
       << translated_meter_entry.ShortDebugString() << ".";
 
   bool meter_units_in_packets;  // or bytes
-  {
-    absl::ReaderMutexLock l(&lock_);
-    ASSIGN_OR_RETURN(auto meter, p4_info_manager_->FindMeterByID(
-                                     translated_meter_entry.meter_id()));
-    switch (meter.spec().unit()) {
-      case ::p4::config::v1::MeterSpec::BYTES:
-        meter_units_in_packets = false;
-        break;
-      case ::p4::config::v1::MeterSpec::PACKETS:
-        meter_units_in_packets = true;
-        break;
-      default:
-        return MAKE_ERROR(ERR_INVALID_PARAM)
-               << "Unsupported meter spec on meter " << meter.ShortDebugString()
-               << ".";
-    }
+  ASSIGN_OR_RETURN(auto meter, p4_info_manager_->FindMeterByID(
+                                   translated_meter_entry.meter_id()));
+  switch (meter.spec().unit()) {
+    case ::p4::config::v1::MeterSpec::BYTES:
+      meter_units_in_packets = false;
+      break;
+    case ::p4::config::v1::MeterSpec::PACKETS:
+      meter_units_in_packets = true;
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unsupported meter spec on meter " << meter.ShortDebugString()
+             << ".";
   }
 
   ASSIGN_OR_RETURN(uint32 meter_id, bf_sde_interface_->GetBfRtId(
@@ -1110,7 +1328,9 @@ BfrtTableManager::ReadDirectCounterEntry(
     const ::p4::v1::ActionProfileMember& action_profile_member) {
   RET_CHECK(type != ::p4::v1::Update::UNSPECIFIED)
       << "Invalid update type " << type;
-  absl::WriterMutexLock l(&lock_);
+  absl::ReaderMutexLock l(&lock_);
+  absl::MutexLock action_profile_lock(
+      TableWriteLock(action_profile_member.action_profile_id()));
   ASSIGN_OR_RETURN(const auto& translated_action_profile_member,
                    bfrt_p4runtime_translator_->TranslateActionProfileMember(
                        action_profile_member, /*to_sdk=*/true));
@@ -1222,7 +1442,9 @@ BfrtTableManager::ReadDirectCounterEntry(
   RET_CHECK(type != ::p4::v1::Update::UNSPECIFIED)
       << "Invalid update type " << type;
 
-  absl::WriterMutexLock l(&lock_);
+  absl::ReaderMutexLock l(&lock_);
+  absl::MutexLock action_profile_lock(
+      TableWriteLock(action_profile_group.action_profile_id()));
   ASSIGN_OR_RETURN(
       uint32 bfrt_act_prof_table_id,
       bf_sde_interface_->GetBfRtId(action_profile_group.action_profile_id()));
@@ -17,6 +17,7 @@
 #include "stratum/hal/lib/barefoot/bf_global_vars.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
 #include "stratum/hal/lib/barefoot/bfrt_p4runtime_translator.h"
+#include "stratum/hal/lib/barefoot/bfrt_table_entry_shadow.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/hal/lib/p4/p4_info_manager.h"
@@ -50,6 +51,23 @@ class BfrtTableManager {
       const ::p4::v1::Update::Type type,
       const ::p4::v1::TableEntry& table_entry) LOCKS_EXCLUDED(lock_);
 
+  // Writes the given table entries, all with the same update type, and sets
+  // one status per entry in results. Runs of consecutive non-default entries
+  // of the same table are submitted to the SDE as one batch. An error is only
+  // returned if the entries could not be written at all.
+  virtual ::util::Status WriteTableEntries(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const std::vector<const ::p4::v1::TableEntry*>& table_entries,
+      std::vector<::util::Status>* results) LOCKS_EXCLUDED(lock_);
+
+  // Records a successful table entry write in the shadow of its table. Must
+  // only be called once the SDE committed the write, i.e. after the batch of
+  // the session it was written on ended, so that reads never see entries of a
+  // batch which failed. NOOP if the shadow is disabled.
+  virtual void RecordTableEntryWrite(const ::p4::v1::Update::Type type,
+                                     const ::p4::v1::TableEntry& table_entry);
+
   // Reads the P4 TableEntry(s) matched by the given table entry.
   virtual ::util::Status ReadTableEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -158,6 +176,48 @@ class BfrtTableManager {
                             BfrtP4RuntimeTranslator* bfrt_p4runtime_translator,
                             int device);
 
+  // Number of locks the table write locks are spread over.
+  static constexpr int kNumTableWriteLocks = 64;
+
+  // Returns the lock serializing the writes to the given P4 table, action
+  // profile, register or meter. Writes only hold lock_ as readers and may come
+  // from concurrent requests; this lock keeps the SDE and the table entry
+  // shadow in the same order. Reads do not take it. Objects may share a lock.
+  absl::Mutex* TableWriteLock(uint32 p4_id) const;
+
+  // Translates the given table entry to the SDK, if needed. Returns either the
+  // entry itself, when its table does not use any translated type, or the
+  // translated copy stored in translated_entry.
+  ::util::StatusOr<const ::p4::v1::TableEntry*> TranslateTableEntryToSdk(
+      const ::p4::v1::TableEntry& table_entry,
+      ::p4::v1::TableEntry* translated_entry) SHARED_LOCKS_REQUIRED(lock_);
+
+  // A non-default table entry translated to SDE objects, ready to be written.
+  struct PreparedTableEntry {
+    uint32 table_id;
+    std::unique_ptr<BfSdeInterface::TableKeyInterface> table_key;
+    std::unique_ptr<BfSdeInterface::TableDataInterface> table_data;
+  };
+
+  // Translates and checks a non-default table entry and builds its SDE key
+  // and data. The data is only filled in for inserts and modifications.
+  ::util::StatusOr<PreparedTableEntry> PrepareTableEntryWrite(
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::TableEntry& table_entry) SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes the given prepared entries of one table as one batch.
+  ::util::Status WriteTableEntryBatch(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const std::vector<PreparedTableEntry>& batch,
+      std::vector<::util::Status>* results) SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes the default entry of a table.
+  ::util::Status WriteDefaultTableEntry(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::Update::Type type,
+      const ::p4::v1::TableEntry& table_entry) SHARED_LOCKS_REQUIRED(lock_);
+
   ::util::Status BuildTableKey(const ::p4::v1::TableEntry& table_entry,
                                BfSdeInterface::TableKeyInterface* table_key)
       SHARED_LOCKS_REQUIRED(lock_);
@@ -189,6 +249,11 @@ class BfrtTableManager {
       WriterInterface<::p4::v1::ReadResponse>* writer)
       SHARED_LOCKS_REQUIRED(lock_);
 
+  // Returns true if a read of the given entry can be answered from the table
+  // entry shadow, i.e. if the shadow is enabled and the read does not ask for
+  // counter or meter data.
+  static bool CanReadFromShadow(const ::p4::v1::TableEntry& table_entry);
+
   // Construct a P4RT table entry from a table entry request, table key and
   // table data.
   ::util::StatusOr<::p4::v1::TableEntry> BuildP4TableEntry(
@@ -219,7 +284,8 @@ class BfrtTableManager {
   // afterwards.
   OperationMode mode_;
 
-  // Reader-writer lock used to protect access to pipeline state.
+  // Reader-writer lock used to protect access to pipeline state. Only pipeline
+  // changes hold it exclusively, reads and writes of entities hold it shared.
   mutable absl::Mutex lock_;
 
   // Mutex lock for protecting digest_list_writer.
@@ -253,6 +319,13 @@ class BfrtTableManager {
   // to all feature managers.
   std::unique_ptr<P4InfoManager> p4_info_manager_ GUARDED_BY(lock_);
 
+  // Software copy of the written table entries, used to serve reads when
+  // --bfrt_table_entry_shadow is set.
+  TableEntryShadow table_entry_shadow_;
+
+  // Locks returned by TableWriteLock(), indexed by P4 ID.
+  mutable absl::Mutex table_write_locks_[kNumTableWriteLocks];
+
   // Fixed zero-based Tofino device number corresponding to the node/ASIC
   // managed by this class instance. Assigned in the class constructor.
   const int device_;
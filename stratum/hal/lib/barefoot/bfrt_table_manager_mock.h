@@ -25,11 +25,21 @@ class BfrtTableManagerMock : public BfrtTableManager {
   MOCK_CONST_METHOD1(
       VerifyForwardingPipelineConfig,
       ::util::Status(const ::p4::v1::ForwardingPipelineConfig& config));
+  MOCK_METHOD2(RecordTableEntryWrite,
+               void(const ::p4::v1::Update::Type type,
+                    const ::p4::v1::TableEntry& table_entry));
   MOCK_METHOD3(
       WriteTableEntry,
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      const ::p4::v1::Update::Type type,
                      const ::p4::v1::TableEntry& table_entry));
+  MOCK_METHOD4(
+      WriteTableEntries,
+      ::util::Status(
+          std::shared_ptr<BfSdeInterface::SessionInterface> session,
+          const ::p4::v1::Update::Type type,
+          const std::vector<const ::p4::v1::TableEntry*>& table_entries,
+          std::vector<::util::Status>* results));
   MOCK_METHOD3(
       ReadTableEntry,
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
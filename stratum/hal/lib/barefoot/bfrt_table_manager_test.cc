@@ -17,6 +17,8 @@
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_bool(bfrt_table_entry_shadow);
+
 // FIXME
 DEFINE_string(bfrt_sde_config_dir, "/var/run/stratum/bfrt_config",
               "The dir used by the SDE to load the device configuration.");
@@ -29,6 +31,7 @@ using test_utils::EqualsProto;
 using ::testing::_;
 using ::testing::ByMove;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::InvokeWithoutArgs;
@@ -697,6 +700,9 @@ TEST_F(BfrtTableManagerTest, RejectTableEntryWithDontCareRangeMatch) {
   )pb";
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -732,6 +738,9 @@ TEST_F(BfrtTableManagerTest, WriteTableEntryTest) {
               std::move(table_data_mock)))));
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -740,6 +749,60 @@ TEST_F(BfrtTableManagerTest, WriteTableEntryTest) {
       session_mock, ::p4::v1::Update::INSERT, entry));
 }
 
+TEST_F(BfrtTableManagerTest, WriteTableEntriesTest) {
+  ASSERT_OK(PushTestConfig());
+  constexpr int kP4TableId = 33583783;
+  constexpr int kP4ActionId = 16783057;
+  constexpr int kBfRtTableId = 20;
+  auto table_key_mock1 = absl::make_unique<TableKeyMock>();
+  auto table_key_mock2 = absl::make_unique<TableKeyMock>();
+  auto table_data_mock1 = absl::make_unique<TableDataMock>();
+  auto table_data_mock2 = absl::make_unique<TableDataMock>();
+  auto session_mock = std::make_shared<SessionMock>();
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4TableId))
+      .WillRepeatedly(Return(kBfRtTableId));
+  const std::vector<::util::Status> sde_results = {
+      ::util::OkStatus(),
+      ::util::Status(StratumErrorSpace(), ERR_ENTRY_EXISTS, "Exists")};
+  EXPECT_CALL(
+      *bf_sde_wrapper_mock_,
+      InsertTableEntries(
+          kDevice1, _, kBfRtTableId,
+          ElementsAre(table_key_mock1.get(), table_key_mock2.get()),
+          ElementsAre(table_data_mock1.get(), table_data_mock2.get()), _))
+      .WillOnce(DoAll(SetArgPointee<5>(sde_results),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableKey(kBfRtTableId))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableKeyInterface>>(
+              std::move(table_key_mock1)))))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableKeyInterface>>(
+              std::move(table_key_mock2)))));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableData(kBfRtTableId, kP4ActionId))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableDataInterface>>(
+              std::move(table_data_mock1)))))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableDataInterface>>(
+              std::move(table_data_mock2)))));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(_))
+      .WillRepeatedly(Return(false));
+  ::p4::v1::TableEntry entry1;
+  ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry1));
+  ::p4::v1::TableEntry entry2 = entry1;
+  entry2.set_priority(20);
+
+  std::vector<::util::Status> results;
+  EXPECT_OK(bfrt_table_manager_->WriteTableEntries(
+      session_mock, ::p4::v1::Update::INSERT, {&entry1, &entry2}, &results));
+  ASSERT_EQ(2U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_ENTRY_EXISTS, results[1].error_code());
+}
+
 TEST_F(BfrtTableManagerTest, ModifyTableEntryTest) {
   ASSERT_OK(PushTestConfig());
   constexpr int kP4TableId = 33583783;
@@ -765,6 +828,9 @@ TEST_F(BfrtTableManagerTest, ModifyTableEntryTest) {
               std::move(table_data_mock)))));
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -797,6 +863,9 @@ TEST_F(BfrtTableManagerTest, DeleteTableEntryTest) {
               std::move(table_data_mock)))));
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -805,6 +874,82 @@ TEST_F(BfrtTableManagerTest, DeleteTableEntryTest) {
       session_mock, ::p4::v1::Update::DELETE, entry));
 }
 
+TEST_F(BfrtTableManagerTest, ReadTableEntriesFromShadowTest) {
+  FLAGS_bfrt_table_entry_shadow = true;
+  ASSERT_OK(PushTestConfig());
+  constexpr int kP4TableId = 33583783;
+  constexpr int kP4ActionId = 16783057;
+  constexpr int kBfRtTableId = 20;
+  auto table_key_mock = absl::make_unique<TableKeyMock>();
+  auto table_data_mock = absl::make_unique<TableDataMock>();
+  auto session_mock = std::make_shared<SessionMock>();
+  ::p4::v1::TableEntry entry;
+  ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  ::p4::v1::TableEntry wildcard_entry;
+  wildcard_entry.set_table_id(kP4TableId);
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4TableId))
+      .WillRepeatedly(Return(kBfRtTableId));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(_))
+      .WillRepeatedly(Return(false));
+  // Only the first read of the table goes to the SDE, it finds it empty.
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              GetAllTableEntries(kDevice1, _, kBfRtTableId, _, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetTableEntry(_, _, _, _, _)).Times(0);
+  std::vector<::p4::v1::ReadResponse> responses;
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  EXPECT_CALL(writer_mock, Write(_))
+      .WillRepeatedly(Invoke([&responses](const ::p4::v1::ReadResponse& r) {
+        responses.push_back(r);
+        return true;
+      }));
+  EXPECT_OK(bfrt_table_manager_->ReadTableEntry(session_mock, wildcard_entry,
+                                                &writer_mock));
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertTableEntry(kDevice1, _, kBfRtTableId, table_key_mock.get(),
+                               table_data_mock.get()))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableKey(kBfRtTableId))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableKeyInterface>>(
+              std::move(table_key_mock)))));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableData(kBfRtTableId, kP4ActionId))
+      .WillOnce(Return(ByMove(
+          ::util::StatusOr<std::unique_ptr<BfSdeInterface::TableDataInterface>>(
+              std::move(table_data_mock)))));
+  EXPECT_OK(bfrt_table_manager_->WriteTableEntry(
+      session_mock, ::p4::v1::Update::INSERT, entry));
+
+  // The write is not visible before it is recorded as committed.
+  responses.clear();
+  EXPECT_OK(bfrt_table_manager_->ReadTableEntry(session_mock, wildcard_entry,
+                                                &writer_mock));
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ(0, responses[0].entities_size());
+  bfrt_table_manager_->RecordTableEntryWrite(::p4::v1::Update::INSERT, entry);
+
+  ::p4::v1::ReadResponse expected_resp;
+  *expected_resp.add_entities()->mutable_table_entry() = entry;
+  responses.clear();
+  EXPECT_OK(bfrt_table_manager_->ReadTableEntry(session_mock, wildcard_entry,
+                                                &writer_mock));
+  ASSERT_EQ(1, responses.size());
+  EXPECT_THAT(responses[0], EqualsProto(expected_resp));
+
+  ::p4::v1::TableEntry single_entry = entry;
+  single_entry.clear_action();
+  responses.clear();
+  EXPECT_OK(bfrt_table_manager_->ReadTableEntry(session_mock, single_entry,
+                                                &writer_mock));
+  ASSERT_EQ(1, responses.size());
+  EXPECT_THAT(responses[0], EqualsProto(expected_resp));
+
+  FLAGS_bfrt_table_entry_shadow = false;
+}
+
 TEST_F(BfrtTableManagerTest, RejectWriteTableUnspecifiedTypeTest) {
   ASSERT_OK(PushTestConfig());
   auto session_mock = std::make_shared<SessionMock>();
@@ -844,6 +989,9 @@ TEST_F(BfrtTableManagerTest, RejectWriteTableConstTest) {
   )pb";
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText2, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -872,6 +1020,9 @@ TEST_F(BfrtTableManagerTest, RejectWriteTableDefaultActionTest) {
   )pb";
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText2, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -902,6 +1053,9 @@ TEST_F(BfrtTableManagerTest, RejectModifyTableDefaultActionWithMatchTest) {
   )pb";
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText2, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -932,6 +1086,9 @@ TEST_F(BfrtTableManagerTest, RejectModifyTableDefaultActionWithPriorityTest) {
   )pb";
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText2, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TableEntryRequiresTranslation(EqualsProto(entry)))
+      .WillOnce(Return(true));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
               TranslateTableEntry(EqualsProto(entry), true))
       .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
@@ -0,0 +1,149 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_update_partitioner.h"
+
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "stratum/glue/integral_types.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+namespace {
+
+// The kinds of objects an update can touch.
+enum ObjectKind {
+  kTable,
+  kActionProfile,
+  kCounter,
+  kMeter,
+  kRegister,
+  kDigest,
+  kPre,
+  kExtern,
+  kUnknown,
+};
+
+// Identifies an object touched by an update.
+typedef std::pair<ObjectKind, uint32> ObjectKey;
+
+// Returns the object touched by the given update. Sets *indirect to true if
+// the update may touch or reference members and groups of any action profile,
+// i.e. for table entries with an action profile action and extern entries.
+ObjectKey GetObjectKey(const ::p4::v1::Update& update, bool* indirect) {
+  const auto& entity = update.entity();
+  *indirect = false;
+  switch (entity.entity_case()) {
+    case ::p4::v1::Entity::kTableEntry: {
+      const auto& action = entity.table_entry().action();
+      *indirect =
+          action.type_case() != ::p4::v1::TableAction::kAction &&
+          action.type_case() != ::p4::v1::TableAction::TYPE_NOT_SET;
+      return ObjectKey(kTable, entity.table_entry().table_id());
+    }
+    case ::p4::v1::Entity::kDirectCounterEntry:
+      return ObjectKey(kTable,
+                       entity.direct_counter_entry().table_entry().table_id());
+    case ::p4::v1::Entity::kDirectMeterEntry:
+      return ObjectKey(kTable,
+                       entity.direct_meter_entry().table_entry().table_id());
+    case ::p4::v1::Entity::kActionProfileMember:
+      return ObjectKey(kActionProfile,
+                       entity.action_profile_member().action_profile_id());
+    case ::p4::v1::Entity::kActionProfileGroup:
+      return ObjectKey(kActionProfile,
+                       entity.action_profile_group().action_profile_id());
+    case ::p4::v1::Entity::kCounterEntry:
+      return ObjectKey(kCounter, entity.counter_entry().counter_id());
+    case ::p4::v1::Entity::kMeterEntry:
+      return ObjectKey(kMeter, entity.meter_entry().meter_id());
+    case ::p4::v1::Entity::kRegisterEntry:
+      return ObjectKey(kRegister, entity.register_entry().register_id());
+    case ::p4::v1::Entity::kDigestEntry:
+      return ObjectKey(kDigest, entity.digest_entry().digest_id());
+    // Multicast groups and clone sessions share PRE resources, like nodes.
+    case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+      return ObjectKey(kPre, 0);
+    // Extern entries are TNA action profile members and groups.
+    case ::p4::v1::Entity::kExternEntry:
+      *indirect = true;
+      return ObjectKey(kExtern, 0);
+    default:
+      return ObjectKey(kUnknown, 0);
+  }
+}
+
+// Returns the representative of the set of the given update, compressing the
+// path on the way.
+int FindRoot(std::vector<int>* parents, int i) {
+  while ((*parents)[i] != i) {
+    (*parents)[i] = (*parents)[(*parents)[i]];
+    i = (*parents)[i];
+  }
+  return i;
+}
+
+void Union(std::vector<int>* parents, int i, int j) {
+  i = FindRoot(parents, i);
+  j = FindRoot(parents, j);
+  // Keep the lowest index as root, to keep the groups in request order.
+  if (i < j) {
+    (*parents)[j] = i;
+  } else if (j < i) {
+    (*parents)[i] = j;
+  }
+}
+
+}  // namespace
+
+std::vector<std::vector<int>> PartitionUpdates(
+    const ::p4::v1::WriteRequest& req) {
+  const int num_updates = req.updates_size();
+  std::vector<int> parents(num_updates);
+  for (int i = 0; i < num_updates; ++i) parents[i] = i;
+
+  // Join all the updates touching the same object.
+  absl::flat_hash_map<ObjectKey, int> first_update_by_object;
+  int first_indirect_update = -1;
+  for (int i = 0; i < num_updates; ++i) {
+    bool indirect;
+    ObjectKey key = GetObjectKey(req.updates(i), &indirect);
+    auto ret = first_update_by_object.emplace(key, i);
+    if (!ret.second) Union(&parents, ret.first->second, i);
+    // Indirect updates are joined with each other and with all action profile
+    // updates, as the action profile of a table is not known here.
+    if (indirect) {
+      if (first_indirect_update < 0) first_indirect_update = i;
+      Union(&parents, first_indirect_update, i);
+    }
+  }
+  if (first_indirect_update >= 0) {
+    for (const auto& e : first_update_by_object) {
+      if (e.first.first == kActionProfile) {
+        Union(&parents, first_indirect_update, e.second);
+      }
+    }
+  }
+
+  // Collect the groups. Roots are the first update of their group, so the
+  // groups come out sorted by their first index.
+  std::vector<std::vector<int>> groups;
+  std::vector<int> group_by_root(num_updates, -1);
+  for (int i = 0; i < num_updates; ++i) {
+    int root = FindRoot(&parents, i);
+    if (group_by_root[root] < 0) {
+      group_by_root[root] = groups.size();
+      groups.emplace_back();
+    }
+    groups[group_by_root[root]].push_back(i);
+  }
+
+  return groups;
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,30 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BFRT_UPDATE_PARTITIONER_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BFRT_UPDATE_PARTITIONER_H_
+
+#include <vector>
+
+#include "p4/v1/p4runtime.pb.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// Partitions the updates of a WriteRequest into groups of updates which do not
+// conflict with the updates of any other group, so that the groups can be
+// applied concurrently. Two updates conflict if they touch the same P4 object
+// (table, action profile, counter, meter, register, digest), if one of them
+// may reference objects of the other (e.g. a table entry pointing to an
+// action profile member or group), or if both touch the PRE. Each group is
+// returned as the indices of its updates in the request, in request order, and
+// groups are sorted by their first index.
+std::vector<std::vector<int>> PartitionUpdates(
+    const ::p4::v1::WriteRequest& req);
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BFRT_UPDATE_PARTITIONER_H_
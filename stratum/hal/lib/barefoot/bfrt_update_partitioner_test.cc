@@ -0,0 +1,92 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_update_partitioner.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/utils.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+using ::testing::ElementsAre;
+
+class BfrtUpdatePartitionerTest : public ::testing::Test {
+ protected:
+  // Adds the updates given in text format to the request.
+  void AddUpdates(const std::vector<std::string>& updates) {
+    for (const auto& update : updates) {
+      ASSERT_OK(ParseProtoFromString(update, req_.add_updates()));
+    }
+  }
+
+  ::p4::v1::WriteRequest req_;
+};
+
+TEST_F(BfrtUpdatePartitionerTest, EmptyRequest) {
+  EXPECT_TRUE(PartitionUpdates(req_).empty());
+}
+
+TEST_F(BfrtUpdatePartitionerTest, UpdatesOfSameTableAreGrouped) {
+  ASSERT_NO_FATAL_FAILURE(AddUpdates({
+      "entity { table_entry { table_id: 1 priority: 1 } }",
+      "entity { table_entry { table_id: 2 } }",
+      "entity { table_entry { table_id: 1 priority: 2 } }",
+      "entity { direct_counter_entry { table_entry { table_id: 2 } } }",
+      "entity { counter_entry { counter_id: 1 } }",
+      "entity { meter_entry { meter_id: 1 } }",
+  }));
+
+  EXPECT_THAT(PartitionUpdates(req_),
+              ElementsAre(ElementsAre(0, 2), ElementsAre(1, 3), ElementsAre(4),
+                          ElementsAre(5)));
+}
+
+TEST_F(BfrtUpdatePartitionerTest, IndirectUpdatesAreGroupedWithProfiles) {
+  ASSERT_NO_FATAL_FAILURE(AddUpdates({
+      "entity { action_profile_member { action_profile_id: 1 member_id: 1 } }",
+      "entity { action_profile_member { action_profile_id: 2 member_id: 1 } }",
+      "entity { table_entry { table_id: 3 } }",
+      "entity { action_profile_group { action_profile_id: 1 group_id: 1 } }",
+      "entity { table_entry { table_id: 4 "
+      "         action { action_profile_member_id: 1 } } }",
+      "entity { extern_entry { extern_type_id: 129 } }",
+  }));
+
+  EXPECT_THAT(PartitionUpdates(req_),
+              ElementsAre(ElementsAre(0, 1, 3, 4, 5), ElementsAre(2)));
+}
+
+TEST_F(BfrtUpdatePartitionerTest, ProfilesAreIndependentWithoutIndirect) {
+  ASSERT_NO_FATAL_FAILURE(AddUpdates({
+      "entity { action_profile_member { action_profile_id: 1 member_id: 1 } }",
+      "entity { action_profile_member { action_profile_id: 2 member_id: 1 } }",
+      "entity { action_profile_group { action_profile_id: 1 group_id: 1 } }",
+  }));
+
+  EXPECT_THAT(PartitionUpdates(req_),
+              ElementsAre(ElementsAre(0, 2), ElementsAre(1)));
+}
+
+TEST_F(BfrtUpdatePartitionerTest, PreUpdatesAreGrouped) {
+  ASSERT_NO_FATAL_FAILURE(AddUpdates({
+      "entity { packet_replication_engine_entry { "
+      "         multicast_group_entry { multicast_group_id: 1 } } }",
+      "entity { table_entry { table_id: 1 } }",
+      "entity { packet_replication_engine_entry { "
+      "         clone_session_entry { session_id: 1 } } }",
+  }));
+
+  EXPECT_THAT(PartitionUpdates(req_),
+              ElementsAre(ElementsAre(0, 2), ElementsAre(1)));
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -4,6 +4,8 @@
 
 #include "stratum/hal/lib/bcm/acl_table.h"
 
+#include <utility>
+
 #include "stratum/glue/gtl/map_util.h"
 
 namespace stratum {
@@ -51,12 +53,13 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
 ::util::StatusOr<int> AclTable::BcmAclId(
     const ::p4::v1::TableEntry& entry) const {
   // Search for the entry.
-  const auto iter = bcm_acl_id_map_.find(entry);
+  const TableEntryKey key(entry);
+  const auto iter = bcm_acl_id_map_.find(key);
   if (iter != bcm_acl_id_map_.end()) {
     return iter->second;
   }
   // Check if the table entry exists.
-  if (!HasEntry(entry)) {
+  if (entries_.count(key) == 0) {
     return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
            << TableStr()
            << " does not contain TableEntry: " << entry.ShortDebugString()
@@ -70,13 +73,14 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
 
 ::util::Status AclTable::DryRunInsertEntry(
     const ::p4::v1::TableEntry& entry) const {
-  const auto result = entries_.find(entry);
+  const auto result = entries_.find(TableEntryKey(entry));
   // Duplicate entry check.
   if (result != entries_.end()) {
     return MAKE_ERROR(ERR_ENTRY_EXISTS)
            << TableStr()
            << " contains duplicate of TableEntry: " << entry.ShortDebugString()
-           << ". Matching TableEntry: " << result->ShortDebugString() << ".";
+           << ". Matching TableEntry: " << result->second.ShortDebugString()
+           << ".";
   }
   // Table capacity check.
   if (EntryCount() == max_entries_) {
@@ -95,7 +99,7 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
              << "> from TableEntry: " << entry.ShortDebugString() << ".";
     }
   }
-  return BcmFlowTable::DryRunInsertEntry(entry);
+  return ::util::OkStatus();
 }
 
 ::util::Status AclTable::InsertEntry(const ::p4::v1::TableEntry& entry,
@@ -107,20 +111,20 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
 
 ::util::Status AclTable::SetBcmAclId(const ::p4::v1::TableEntry& entry,
                                      int bcm_acl_id) {
-  if (!HasEntry(entry)) {
+  TableEntryKey key(entry);
+  if (entries_.count(key) == 0) {
     return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
            << TableStr()
            << " does not contain TableEntry: " << entry.ShortDebugString()
            << ".";
   }
-  auto iter = bcm_acl_id_map_.find(entry);
-  if (iter != bcm_acl_id_map_.end()) {
+  auto result = bcm_acl_id_map_.emplace(std::move(key), bcm_acl_id);
+  if (!result.second) {
     return MAKE_ERROR(ERR_INTERNAL)
            << "Unexpected scenario in " << TableStr()
-           << ": Leftover Bcm ACL ID <" << iter->second
+           << ": Leftover Bcm ACL ID <" << result.first->second
            << "> found for TableEntry: " << entry.ShortDebugString() << ".";
   }
-  bcm_acl_id_map_[entry] = bcm_acl_id;
   return ::util::OkStatus();
 }
 
@@ -0,0 +1,95 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/bcm_flow_table.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+// Appends the value in big-endian order, so that keys of fields sort by ID.
+void AppendUint32(uint32 value, std::string* bytes) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    bytes->push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+// Appends the value in big-endian order.
+void AppendUint64(uint64 value, std::string* bytes) {
+  AppendUint32(value >> 32, bytes);
+  AppendUint32(value & 0xffffffff, bytes);
+}
+
+// Appends a length-prefixed byte string.
+void AppendBytes(const std::string& value, std::string* bytes) {
+  AppendUint32(value.size(), bytes);
+  bytes->append(value);
+}
+
+// Appends the packed form of a field match: its ID, its type and its values.
+void AppendFieldMatch(const ::p4::v1::FieldMatch& match, std::string* bytes) {
+  AppendUint32(match.field_id(), bytes);
+  bytes->push_back(static_cast<char>(match.field_match_type_case()));
+  switch (match.field_match_type_case()) {
+    case ::p4::v1::FieldMatch::kExact:
+      AppendBytes(match.exact().value(), bytes);
+      break;
+    case ::p4::v1::FieldMatch::kTernary:
+      AppendBytes(match.ternary().value(), bytes);
+      AppendBytes(match.ternary().mask(), bytes);
+      break;
+    case ::p4::v1::FieldMatch::kLpm:
+      AppendBytes(match.lpm().value(), bytes);
+      AppendUint32(match.lpm().prefix_len(), bytes);
+      break;
+    case ::p4::v1::FieldMatch::kRange:
+      AppendBytes(match.range().low(), bytes);
+      AppendBytes(match.range().high(), bytes);
+      break;
+    default:
+      // Other match types are rare, they are packed in serialized form.
+      AppendBytes(ProtoSerialize(match), bytes);
+      break;
+  }
+}
+
+}  // namespace
+
+TableEntryKey::TableEntryKey(const ::p4::v1::TableEntry& entry) : bytes_() {
+  // Key on the match field combination, not on its permutation.
+  std::vector<const ::p4::v1::FieldMatch*> matches;
+  matches.reserve(entry.match_size());
+  size_t size = 17 + entry.metadata().size();
+  for (const auto& match : entry.match()) {
+    matches.push_back(&match);
+    size += 32;
+  }
+  std::sort(matches.begin(), matches.end(),
+            [](const ::p4::v1::FieldMatch* a, const ::p4::v1::FieldMatch* b) {
+              if (a->field_id() != b->field_id()) {
+                return a->field_id() < b->field_id();
+              }
+              // Field IDs are unique in valid entries. Otherwise order the
+              // fields by content, as the key must not depend on the order.
+              std::string a_bytes, b_bytes;
+              AppendFieldMatch(*a, &a_bytes);
+              AppendFieldMatch(*b, &b_bytes);
+              return a_bytes < b_bytes;
+            });
+
+  bytes_.reserve(size);
+  bytes_.push_back(entry.is_default_action() ? 1 : 0);
+  AppendUint32(entry.priority(), &bytes_);
+  AppendBytes(entry.metadata(), &bytes_);
+  AppendUint64(entry.idle_timeout_ns(), &bytes_);
+  for (const auto* match : matches) AppendFieldMatch(*match, &bytes_);
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -5,11 +5,12 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_FLOW_TABLE_H_
 #define STRATUM_HAL_LIB_BCM_BCM_FLOW_TABLE_H_
 
-#include <algorithm>
+#include <cstddef>
+#include <iterator>
 #include <string>
 #include <utility>
 
-#include "absl/container/node_hash_set.h"
+#include "absl/container/node_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "p4/v1/p4runtime.pb.h"
@@ -24,69 +25,76 @@ namespace stratum {
 namespace hal {
 namespace bcm {
 
-// Custom hash and equal function for P4 TableEntry protos. We need a way
-// to differeniate flows in the following way: If we have 2 flows f1 and f2
-// with f2 being the modified version of f1 as intended by the controller, f1
-// = f2. In any other case they should not.
-struct TableEntryHash {
-  size_t operator()(const ::p4::v1::TableEntry& x) const {
-    // Save a copy of the input proto, clear actions/metadata/counter/meter,
-    // and hash the rest.
-    ::p4::v1::TableEntry a = x;
-    a.clear_table_id();
-    a.clear_action();
-    a.clear_controller_metadata();
-    a.clear_meter_config();
-    a.clear_counter_data();
-    // Hash on match field combination, not on permutation.
-    std::sort(a.mutable_match()->begin(), a.mutable_match()->end(),
-              [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
-                return ProtoSerialize(l) < ProtoSerialize(r);
-              });
-    return std::hash<std::string>()(ProtoSerialize(a));
+// The canonical, compact key of a P4 TableEntry, used to find entries in
+// BcmFlowTable and AclTable. We need a way to differeniate flows in the
+// following way: If we have 2 flows f1 and f2 with f2 being the modified
+// version of f1 as intended by the controller, f1 = f2. In any other case they
+// should not. The key therefore holds the match fields, ordered by field ID,
+// the priority, is_default_action, metadata and idle_timeout_ns, packed into a
+// single byte string. It is computed once per entry, so hashing and comparing
+// keys does not touch the proto.
+class TableEntryKey {
+ public:
+  explicit TableEntryKey(const ::p4::v1::TableEntry& entry);
+
+  bool operator==(const TableEntryKey& other) const {
+    return bytes_ == other.bytes_;
+  }
+  bool operator!=(const TableEntryKey& other) const {
+    return bytes_ != other.bytes_;
   }
-};
 
-struct TableEntryEqual {
-  bool operator()(const ::p4::v1::TableEntry& x,
-                  const ::p4::v1::TableEntry& y) const {
-    // Save copies of the input protos, clear actions/metadata/counter/meter
-    // and compare the rest.
-    ::p4::v1::TableEntry a = x, b = y;
-    a.clear_table_id();
-    a.clear_action();
-    a.clear_controller_metadata();
-    a.clear_meter_config();
-    a.clear_counter_data();
-    b.clear_table_id();
-    b.clear_action();
-    b.clear_controller_metadata();
-    b.clear_meter_config();
-    b.clear_counter_data();
-    // The order of the match fields are not important.
-    if (a.match_size() != b.match_size() ||
-        !std::is_permutation(
-            a.match().begin(), a.match().end(), b.match().begin(),
-            [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
-              return ProtoSerialize(l) == ProtoSerialize(r);
-            })) {
-      return false;
-    }
-    a.clear_match();
-    b.clear_match();
-    return ProtoSerialize(a) == ProtoSerialize(b);
+  template <typename H>
+  friend H AbslHashValue(H h, const TableEntryKey& key) {
+    return H::combine(std::move(h), key.bytes_);
   }
+
+ private:
+  std::string bytes_;
 };
 
-using TableEntrySet =
-    absl::node_hash_set<::p4::v1::TableEntry, TableEntryHash, TableEntryEqual>;
+// Map from key to the entry, as stored in a BcmFlowTable.
+using TableEntryMap = absl::node_hash_map<TableEntryKey, ::p4::v1::TableEntry>;
+
+// Forward iterator over the entries of a BcmFlowTable.
+class TableEntryIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = ::p4::v1::TableEntry;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const ::p4::v1::TableEntry*;
+  using reference = const ::p4::v1::TableEntry&;
+
+  explicit TableEntryIterator(TableEntryMap::const_iterator it) : it_(it) {}
+
+  reference operator*() const { return it_->second; }
+  pointer operator->() const { return &it_->second; }
+  TableEntryIterator& operator++() {
+    ++it_;
+    return *this;
+  }
+  TableEntryIterator operator++(int) {
+    TableEntryIterator copy = *this;
+    ++it_;
+    return copy;
+  }
+  bool operator==(const TableEntryIterator& other) const {
+    return it_ == other.it_;
+  }
+  bool operator!=(const TableEntryIterator& other) const {
+    return it_ != other.it_;
+  }
+
+ private:
+  TableEntryMap::const_iterator it_;
+};
 
 // Class for managing a BCM table.
 class BcmFlowTable {
  public:
   // STL-style types that allow table traversal.
-  using const_iterator = TableEntrySet::const_iterator;
-  using value_type = TableEntrySet::value_type;
+  using const_iterator = TableEntryIterator;
+  using value_type = ::p4::v1::TableEntry;
 
   // Constructors.
   explicit BcmFlowTable(uint32 p4_table_id)
@@ -133,7 +141,7 @@ class BcmFlowTable {
 
   // Returns true if this table already has this entry.
   virtual bool HasEntry(const ::p4::v1::TableEntry& entry) const {
-    return entries_.count(entry) > 0;
+    return entries_.count(TableEntryKey(entry)) > 0;
   }
 
   // Returns the number of entries in this table.
@@ -146,17 +154,17 @@ class BcmFlowTable {
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry is not found.
   virtual ::util::StatusOr<::p4::v1::TableEntry> Lookup(
       const ::p4::v1::TableEntry& key) const {
-    auto lookup = entries_.find(key);
+    auto lookup = entries_.find(TableEntryKey(key));
     if (lookup == entries_.end()) {
       return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
              << TableStr()
              << " does not contain TableEntry: " << key.ShortDebugString();
     }
-    return *lookup;
+    return lookup->second;
   }
 
-  TableEntrySet::const_iterator begin() const { return entries_.begin(); }
-  TableEntrySet::const_iterator end() const { return entries_.end(); }
+  const_iterator begin() const { return const_iterator(entries_.begin()); }
+  const_iterator end() const { return const_iterator(entries_.end()); }
 
   // Returns true if this is a const table.
   virtual bool IsConst() const { return is_const_; }
@@ -173,16 +181,16 @@ class BcmFlowTable {
   // 1) TableEntry.match (all matches)
   // 2) TableEntry.priority
   // 3) is_default_action
+  // 4) TableEntry.metadata and TableEntry.idle_timeout_ns
   //
-  // See TableEntryEqual below.
+  // See TableEntryKey above.
   virtual ::util::Status InsertEntry(const ::p4::v1::TableEntry& entry) {
-    auto result = entries_.insert(entry);
+    auto result = entries_.emplace(TableEntryKey(entry), entry);
     if (!result.second) {
       return MAKE_ERROR(ERR_ENTRY_EXISTS)
              << TableStr() << " contains duplicate of TableEntry: "
-             << entry.ShortDebugString()
-             << ". Matching TableEntry: " << result.first->ShortDebugString()
-             << ".";
+             << entry.ShortDebugString() << ". Matching TableEntry: "
+             << result.first->second.ShortDebugString() << ".";
     }
     return ::util::OkStatus();
   }
@@ -191,12 +199,12 @@ class BcmFlowTable {
   // inserted. If the entry can be inserted, returns ::util::OkStatus().
   virtual ::util::Status DryRunInsertEntry(
       const ::p4::v1::TableEntry& entry) const {
-    const auto result = entries_.find(entry);
+    const auto result = entries_.find(TableEntryKey(entry));
     if (result != entries_.end()) {
       return MAKE_ERROR(ERR_ENTRY_EXISTS)
              << TableStr() << " contains duplicate of TableEntry: "
-             << entry.ShortDebugString()
-             << ". Matching TableEntry: " << result->ShortDebugString() << ".";
+             << entry.ShortDebugString() << ". Matching TableEntry: "
+             << result->second.ShortDebugString() << ".";
     }
     return ::util::OkStatus();
   }
@@ -204,11 +212,19 @@ class BcmFlowTable {
   // Attempts to modify an existing entry in this table. Returns the original
   // entry on success.
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
-  // Returns an error if the entry cannot be added.
+  // Returns an error if the entry cannot be added. The entry is replaced in
+  // place, without going through DeleteEntry().
   virtual ::util::StatusOr<::p4::v1::TableEntry> ModifyEntry(
       const ::p4::v1::TableEntry& entry) {
-    ASSIGN_OR_RETURN(::p4::v1::TableEntry old_entry, DeleteEntry(entry));
-    entries_.insert(entry);
+    auto lookup = entries_.find(TableEntryKey(entry));
+    if (lookup == entries_.end()) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << TableStr()
+             << " does not contain TableEntry: " << entry.ShortDebugString()
+             << ".";
+    }
+    ::p4::v1::TableEntry old_entry = std::move(lookup->second);
+    lookup->second = entry;
     return old_entry;
   }
 
@@ -217,14 +233,14 @@ class BcmFlowTable {
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
   virtual ::util::StatusOr<::p4::v1::TableEntry> DeleteEntry(
       const ::p4::v1::TableEntry& key) {
-    const auto lookup = entries_.find(key);
+    const auto lookup = entries_.find(TableEntryKey(key));
     if (lookup == entries_.end()) {
       return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
              << TableStr()
              << " does not contain TableEntry: " << key.ShortDebugString()
              << ".";
     }
-    ::p4::v1::TableEntry entry = *lookup;
+    ::p4::v1::TableEntry entry = std::move(lookup->second);
     entries_.erase(lookup);
     return entry;
   }
@@ -241,7 +257,7 @@ class BcmFlowTable {
   uint32 id_;
   std::string name_;
   // Keeps track of all entries currently in the table.
-  TableEntrySet entries_;
+  TableEntryMap entries_;
   // True is this is a const table. Const tables can only be modified during
   // SetForwardingPipelineConfig().
   bool is_const_;
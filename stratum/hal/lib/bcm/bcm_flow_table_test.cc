@@ -303,6 +303,51 @@ TEST(BcmFlowTableTest, DeleteMissingEntryFailure) {
   ASSERT_EQ(table.DeleteEntry(mod).status().error_code(), ERR_ENTRY_NOT_FOUND);
 }
 
+// Verify that the key of an entry does not depend on the order of its match
+// fields, and that it only differs for a different match, priority,
+// is_default_action, metadata or idle_timeout_ns.
+TEST(BcmFlowTableTest, TableEntryKeyIsCanonical) {
+  ::p4::v1::TableEntry other = MockTableEntry();
+  other.mutable_match()->SwapElements(0, 2);
+  other.mutable_action()->set_action_profile_member_id(12);
+  other.set_controller_metadata(other.controller_metadata() + 1);
+  EXPECT_EQ(TableEntryKey(MockTableEntry()), TableEntryKey(other));
+
+  other = MockTableEntry();
+  other.mutable_match(2)->mutable_lpm()->set_prefix_len(7);
+  EXPECT_NE(TableEntryKey(MockTableEntry()), TableEntryKey(other));
+  other = MockTableEntry();
+  // Same bytes, split differently between the value and the mask.
+  other.mutable_match(1)->mutable_ternary()->set_value("34");
+  other.mutable_match(1)->mutable_ternary()->set_mask("");
+  EXPECT_NE(TableEntryKey(MockTableEntry()), TableEntryKey(other));
+  other = MockTableEntry();
+  other.set_priority(11);
+  EXPECT_NE(TableEntryKey(MockTableEntry()), TableEntryKey(other));
+  other = MockTableEntry();
+  other.set_is_default_action(true);
+  EXPECT_NE(TableEntryKey(MockTableEntry()), TableEntryKey(other));
+  other = MockTableEntry();
+  other.set_metadata("cookie");
+  EXPECT_NE(TableEntryKey(MockTableEntry()), TableEntryKey(other));
+  other = MockTableEntry();
+  other.set_idle_timeout_ns(1000);
+  EXPECT_NE(TableEntryKey(MockTableEntry()), TableEntryKey(other));
+}
+
+// Verify that iterating over a table yields its entries.
+TEST(BcmFlowTableTest, IterateEntries) {
+  ::p4::v1::TableEntry other = MockTableEntry();
+  other.set_priority(11);
+  BcmFlowTable table(1);
+  ASSERT_OK(table.InsertEntry(MockTableEntry()));
+  ASSERT_OK(table.InsertEntry(other));
+  std::vector<::p4::v1::TableEntry> entries(table.begin(), table.end());
+  EXPECT_THAT(entries,
+              ::testing::UnorderedElementsAre(EqualsProto(MockTableEntry()),
+                                              EqualsProto(other)));
+}
+
 // Verify the properties a BcmFlowTable inherits from a source
 // P4 config Table.
 TEST(BcmFlowTableTest, ConstructFromP4ConfigTable) {
@@ -0,0 +1,159 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/bcm_id_allocator.h"
+
+#include <algorithm>
+
+#include "stratum/lib/macros.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+constexpr int kBitsPerWord = 64;
+constexpr uint64 kFullWord = ~0ULL;
+
+}  // namespace
+
+BcmIdAllocator::BcmIdAllocator() : BcmIdAllocator(0, -1) {}
+
+BcmIdAllocator::BcmIdAllocator(int min_id, int max_id)
+    : min_id_(min_id),
+      capacity_(max_id >= min_id ? max_id - min_id + 1 : 0),
+      num_allocated_(0),
+      max_num_allocated_(0),
+      levels_() {
+  // Build the levels bottom up, until a level fits in a single word. Each
+  // level has one bit per word of the level below.
+  int num_bits = capacity_;
+  do {
+    int num_words = std::max(1, (num_bits + kBitsPerWord - 1) / kBitsPerWord);
+    std::vector<uint64> level(num_words, 0);
+    // Mark the bits past the end as used.
+    for (int i = num_bits; i < num_words * kBitsPerWord; ++i) {
+      level[i / kBitsPerWord] |= 1ULL << (i % kBitsPerWord);
+    }
+    levels_.push_back(std::move(level));
+    num_bits = num_words;
+  } while (num_bits > 1);
+  // Propagate the padding words which are full.
+  for (size_t k = 0; k + 1 < levels_.size(); ++k) {
+    for (size_t i = 0; i < levels_[k].size(); ++i) {
+      if (levels_[k][i] == kFullWord) {
+        levels_[k + 1][i / kBitsPerWord] |= 1ULL << (i % kBitsPerWord);
+      }
+    }
+  }
+}
+
+::util::StatusOr<int> BcmIdAllocator::FindFree() const {
+  if (levels_.back()[0] == kFullWord) {
+    return MAKE_ERROR(ERR_TABLE_FULL).without_logging()
+           << "All " << capacity_ << " IDs are allocated.";
+  }
+  int index = 0;
+  for (int k = levels_.size() - 1; k >= 0; --k) {
+    uint64 word = levels_[k][index];
+    index = index * kBitsPerWord + __builtin_ctzll(~word);
+  }
+
+  return min_id_ + index;
+}
+
+::util::StatusOr<int> BcmIdAllocator::Allocate() {
+  ASSIGN_OR_RETURN(int id, FindFree());
+  RETURN_IF_ERROR(Allocate(id));
+
+  return id;
+}
+
+::util::Status BcmIdAllocator::Allocate(int id) {
+  if (!Contains(id)) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "ID " << id << " is out of the range [" << min_id_ << ", "
+           << min_id_ + capacity_ - 1 << "].";
+  }
+  if (TestBit(id - min_id_)) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS).without_logging()
+           << "ID " << id << " is already allocated.";
+  }
+  SetBit(id - min_id_);
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmIdAllocator::AllocateRange(int first_id, int last_id) {
+  if (first_id > last_id || !Contains(first_id) || !Contains(last_id)) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "ID range [" << first_id << ", " << last_id
+           << "] is not in the range [" << min_id_ << ", "
+           << min_id_ + capacity_ - 1 << "].";
+  }
+  for (int id = first_id; id <= last_id; ++id) {
+    if (TestBit(id - min_id_)) {
+      return MAKE_ERROR(ERR_ENTRY_EXISTS).without_logging()
+             << "ID " << id << " is already allocated.";
+    }
+  }
+  for (int id = first_id; id <= last_id; ++id) SetBit(id - min_id_);
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmIdAllocator::Release(int id) {
+  if (!Contains(id)) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "ID " << id << " is out of the range [" << min_id_ << ", "
+           << min_id_ + capacity_ - 1 << "].";
+  }
+  if (!TestBit(id - min_id_)) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+           << "ID " << id << " is not allocated.";
+  }
+  ClearBit(id - min_id_);
+
+  return ::util::OkStatus();
+}
+
+bool BcmIdAllocator::Contains(int id) const {
+  // Compare in 64 bits, as id - min_id_ may overflow.
+  return static_cast<int64>(id) >= min_id_ &&
+         static_cast<int64>(id) - min_id_ < capacity_;
+}
+
+bool BcmIdAllocator::IsAllocated(int id) const {
+  return Contains(id) && TestBit(id - min_id_);
+}
+
+void BcmIdAllocator::SetBit(int index) {
+  for (size_t k = 0; k < levels_.size(); ++k) {
+    uint64& word = levels_[k][index / kBitsPerWord];
+    word |= 1ULL << (index % kBitsPerWord);
+    if (word != kFullWord) break;
+    index /= kBitsPerWord;
+  }
+  ++num_allocated_;
+  max_num_allocated_ = std::max(max_num_allocated_, num_allocated_);
+}
+
+void BcmIdAllocator::ClearBit(int index) {
+  for (size_t k = 0; k < levels_.size(); ++k) {
+    uint64& word = levels_[k][index / kBitsPerWord];
+    bool was_full = word == kFullWord;
+    word &= ~(1ULL << (index % kBitsPerWord));
+    if (!was_full) break;
+    index /= kBitsPerWord;
+  }
+  --num_allocated_;
+}
+
+bool BcmIdAllocator::TestBit(int index) const {
+  return (levels_[0][index / kBitsPerWord] >> (index % kBitsPerWord)) & 1;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
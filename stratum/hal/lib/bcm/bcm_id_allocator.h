@@ -0,0 +1,104 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_ID_ALLOCATOR_H_
+#define STRATUM_HAL_LIB_BCM_BCM_ID_ALLOCATOR_H_
+
+#include <vector>
+
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// Allocates the IDs of a contiguous range [min_id, max_id], e.g. the indexes
+// of a hardware table. The allocated IDs are kept in a hierarchical bitmap:
+// level 0 has one bit per ID, and each bit of level k+1 is set iff the
+// corresponding 64-bit word of level k is full. Finding the lowest free ID
+// descends from the top word, costing one word per level (i.e. log64 of the
+// range size) regardless of the occupancy. Releasing an ID clears at most one
+// bit per level. The class is not thread-safe.
+class BcmIdAllocator {
+ public:
+  // Creates an allocator without any ID.
+  BcmIdAllocator();
+
+  // Creates an allocator for the IDs in [min_id, max_id], all of them free.
+  // The allocator has no ID if max_id < min_id.
+  BcmIdAllocator(int min_id, int max_id);
+
+  // Returns the lowest free ID, without allocating it. Returns ERR_TABLE_FULL
+  // if all IDs are allocated.
+  ::util::StatusOr<int> FindFree() const;
+
+  // Allocates and returns the lowest free ID. Returns ERR_TABLE_FULL if all
+  // IDs are allocated.
+  ::util::StatusOr<int> Allocate();
+
+  // Allocates the given ID. Returns ERR_INVALID_PARAM if the ID is out of the
+  // range and ERR_ENTRY_EXISTS if it is already allocated.
+  ::util::Status Allocate(int id);
+
+  // Allocates all IDs in [first_id, last_id], e.g. to reserve some indexes
+  // of a table. Returns an error, without allocating any ID, if any of them is
+  // out of the range or already allocated.
+  ::util::Status AllocateRange(int first_id, int last_id);
+
+  // Releases the given ID. Returns ERR_INVALID_PARAM if the ID is out of the
+  // range and ERR_ENTRY_NOT_FOUND if it is not allocated.
+  ::util::Status Release(int id);
+
+  // Returns true if the given ID is in the range of the allocator.
+  bool Contains(int id) const;
+
+  // Returns true if the given ID is in the range and allocated.
+  bool IsAllocated(int id) const;
+
+  // Occupancy stats: the number of IDs in the range, the number of allocated
+  // IDs and the highest number of IDs allocated at once so far.
+  int Capacity() const { return capacity_; }
+  int NumAllocated() const { return num_allocated_; }
+  int MaxNumAllocated() const { return max_num_allocated_; }
+
+  // BcmIdAllocator is copyable and movable.
+  BcmIdAllocator(const BcmIdAllocator&) = default;
+  BcmIdAllocator& operator=(const BcmIdAllocator&) = default;
+  BcmIdAllocator(BcmIdAllocator&&) = default;
+  BcmIdAllocator& operator=(BcmIdAllocator&&) = default;
+
+ private:
+  // Sets the bit of the given index in level 0 and propagates full words up.
+  void SetBit(int index);
+
+  // Clears the bit of the given index in level 0 and propagates up.
+  void ClearBit(int index);
+
+  // Returns true if the bit of the given index is set in level 0.
+  bool TestBit(int index) const;
+
+  // The lowest ID of the range.
+  int min_id_;
+
+  // Number of IDs in the range.
+  int capacity_;
+
+  // Number of allocated IDs.
+  int num_allocated_;
+
+  // The highest value num_allocated_ had.
+  int max_num_allocated_;
+
+  // The levels of the bitmap, level 0 first. The last level has a single
+  // word. The bits past the end of the range are set, so that they are never
+  // found free.
+  std::vector<std::vector<uint64>> levels_;
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_ID_ALLOCATOR_H_
@@ -0,0 +1,83 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/bcm_id_allocator.h"
+
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+TEST(BcmIdAllocatorTest, AllocatesLowestFreeId) {
+  BcmIdAllocator ids(10, 19);
+  EXPECT_EQ(10, ids.Capacity());
+  for (int id = 10; id <= 19; ++id) {
+    ASSERT_OK_AND_ASSIGN(int allocated, ids.Allocate());
+    EXPECT_EQ(id, allocated);
+  }
+  EXPECT_EQ(10, ids.NumAllocated());
+  EXPECT_EQ(ERR_TABLE_FULL, ids.FindFree().status().error_code());
+
+  ASSERT_OK(ids.Release(13));
+  ASSERT_OK(ids.Release(11));
+  EXPECT_FALSE(ids.IsAllocated(11));
+  ASSERT_OK_AND_ASSIGN(int id, ids.FindFree());
+  EXPECT_EQ(11, id);
+  ASSERT_OK_AND_ASSIGN(id, ids.Allocate());
+  EXPECT_EQ(11, id);
+  ASSERT_OK_AND_ASSIGN(id, ids.Allocate());
+  EXPECT_EQ(13, id);
+  EXPECT_EQ(10, ids.MaxNumAllocated());
+}
+
+TEST(BcmIdAllocatorTest, FindsFreeIdsAcrossLevels) {
+  // 64^2 + 5 IDs need three levels.
+  const int kMaxId = 64 * 64 + 4;
+  BcmIdAllocator ids(0, kMaxId);
+  ASSERT_OK(ids.AllocateRange(0, kMaxId - 1));
+  ASSERT_OK_AND_ASSIGN(int id, ids.FindFree());
+  EXPECT_EQ(kMaxId, id);
+  ASSERT_OK(ids.Allocate(kMaxId));
+  EXPECT_EQ(ERR_TABLE_FULL, ids.Allocate().status().error_code());
+
+  // Free IDs in the middle of a full word and of a full subtree.
+  ASSERT_OK(ids.Release(64 * 64 + 1));
+  ASSERT_OK(ids.Release(64 * 3 + 7));
+  ASSERT_OK_AND_ASSIGN(id, ids.Allocate());
+  EXPECT_EQ(64 * 3 + 7, id);
+  ASSERT_OK_AND_ASSIGN(id, ids.Allocate());
+  EXPECT_EQ(64 * 64 + 1, id);
+  EXPECT_EQ(kMaxId + 1, ids.NumAllocated());
+}
+
+TEST(BcmIdAllocatorTest, RejectsInvalidIds) {
+  BcmIdAllocator ids(1, 8);
+  EXPECT_FALSE(ids.Contains(0));
+  EXPECT_TRUE(ids.Contains(8));
+  EXPECT_FALSE(ids.Contains(9));
+  EXPECT_EQ(ERR_INVALID_PARAM, ids.Allocate(0).error_code());
+  EXPECT_EQ(ERR_INVALID_PARAM, ids.Release(9).error_code());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, ids.Release(4).error_code());
+  ASSERT_OK(ids.Allocate(4));
+  EXPECT_EQ(ERR_ENTRY_EXISTS, ids.Allocate(4).error_code());
+
+  // A failed range allocation allocates nothing.
+  EXPECT_EQ(ERR_ENTRY_EXISTS, ids.AllocateRange(2, 6).error_code());
+  EXPECT_EQ(ERR_INVALID_PARAM, ids.AllocateRange(6, 9).error_code());
+  EXPECT_EQ(1, ids.NumAllocated());
+  EXPECT_FALSE(ids.IsAllocated(2));
+}
+
+TEST(BcmIdAllocatorTest, EmptyRange) {
+  BcmIdAllocator ids;
+  EXPECT_EQ(0, ids.Capacity());
+  EXPECT_FALSE(ids.Contains(0));
+  EXPECT_EQ(ERR_TABLE_FULL, ids.Allocate().status().error_code());
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
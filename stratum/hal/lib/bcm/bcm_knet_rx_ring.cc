@@ -0,0 +1,109 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/bcm_knet_rx_ring.h"
+
+#include <errno.h>
+#include <linux/if_packet.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "absl/memory/memory.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+::util::StatusOr<std::unique_ptr<BcmKnetRxRing>> BcmKnetRxRing::Create(
+    int sock, size_t block_size, int num_blocks, int block_timeout_ms) {
+  RET_CHECK(block_size > 0 && block_size % getpagesize() == 0)
+      << "KNET RX ring block size " << block_size
+      << " is not a multiple of the page size.";
+  RET_CHECK(num_blocks > 0) << "Invalid number of KNET RX ring blocks.";
+
+  int version = TPACKET_V3;
+  if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version,
+                 sizeof(version)) < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Couldn't call setsockopt(PACKET_VERSION). errno: " << errno
+           << ".";
+  }
+  // With TPACKET_V3 packets are packed back to back in the blocks, the frame
+  // size only serves as a lower bound for the kernel checks.
+  struct tpacket_req3 req;
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = block_size;
+  req.tp_block_nr = num_blocks;
+  req.tp_frame_size = TPACKET_ALIGNMENT << 7;
+  req.tp_frame_nr = (block_size / req.tp_frame_size) * num_blocks;
+  req.tp_retire_blk_tov = block_timeout_ms;
+  if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Couldn't call setsockopt(PACKET_RX_RING). errno: " << errno
+           << ".";
+  }
+  void* ring = mmap(nullptr, block_size * num_blocks, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_LOCKED, sock, 0);
+  if (ring == MAP_FAILED) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Couldn't map the KNET RX ring. errno: " << errno << ".";
+  }
+
+  return absl::WrapUnique(new BcmKnetRxRing(static_cast<char*>(ring),
+                                            block_size, num_blocks, true));
+}
+
+BcmKnetRxRing::BcmKnetRxRing(char* ring, size_t block_size, int num_blocks,
+                             bool mapped)
+    : ring_(ring),
+      block_size_(block_size),
+      num_blocks_(num_blocks),
+      mapped_(mapped),
+      next_block_(0) {}
+
+BcmKnetRxRing::~BcmKnetRxRing() {
+  if (mapped_) munmap(ring_, block_size_ * num_blocks_);
+}
+
+bool BcmKnetRxRing::ReadBlock(
+    const std::function<void(const BcmKnetRxFrame&)>& handler) {
+  auto* block = reinterpret_cast<struct tpacket_block_desc*>(
+      ring_ + next_block_ * block_size_);
+  // The block status is the handover point between the kernel and us, its
+  // accesses order the accesses to the packets of the block.
+  if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+       TP_STATUS_USER) == 0) {
+    return false;
+  }
+
+  const uint32 num_packets = block->hdr.bh1.num_pkts;
+  const char* packet =
+      reinterpret_cast<const char*>(block) + block->hdr.bh1.offset_to_first_pkt;
+  for (uint32 i = 0; i < num_packets; ++i) {
+    const auto* header = reinterpret_cast<const struct tpacket3_hdr*>(packet);
+    const auto* addr = reinterpret_cast<const struct sockaddr_ll*>(
+        packet + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    BcmKnetRxFrame frame;
+    frame.data = packet + header->tp_mac;
+    frame.size = header->tp_snaplen;
+    frame.original_size = header->tp_len;
+    frame.ifindex = addr->sll_ifindex;
+    frame.pkttype = addr->sll_pkttype;
+    handler(frame);
+    packet += header->tp_next_offset;
+  }
+
+  __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                   __ATOMIC_RELEASE);
+  next_block_ = (next_block_ + 1) % num_blocks_;
+
+  return true;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,87 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_KNET_RX_RING_H_
+#define STRATUM_HAL_LIB_BCM_BCM_KNET_RX_RING_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// A packet received through a BcmKnetRxRing. The data points into the ring and
+// is only valid while the handler given to ReadBlock() runs.
+struct BcmKnetRxFrame {
+  // The captured bytes: the KNET header followed by the packet.
+  const char* data;
+  // Number of captured bytes.
+  size_t size;
+  // Number of bytes of the packet as received, which is bigger than size if
+  // the packet was truncated.
+  size_t original_size;
+  // Index of the interface the packet was received on.
+  int ifindex;
+  // Packet type, e.g. PACKET_OUTGOING (see <netpacket/packet.h>).
+  int pkttype;
+};
+
+// A PACKET_MMAP (TPACKET_V3) RX ring mapped on a KNET RX socket. The kernel
+// writes received packets into blocks of the ring shared with the process,
+// and hands a block over once it is full or its timeout expires. The RX
+// thread then walks the packets of the block in place, without a syscall per
+// packet, and gives the block back to the kernel. The socket becomes readable
+// when a block is handed over. The class is not thread-safe, it is meant to
+// be used by the single RX thread of a KNET interface.
+class BcmKnetRxRing {
+ public:
+  // Sets up a ring of num_blocks blocks of block_size bytes on the given
+  // AF_PACKET socket and maps it. block_size must be a multiple of the page
+  // size. Blocks which are not full are handed over after block_timeout_ms.
+  // Must be called before the socket is bound.
+  static ::util::StatusOr<std::unique_ptr<BcmKnetRxRing>> Create(
+      int sock, size_t block_size, int num_blocks, int block_timeout_ms);
+
+  // Unmaps the ring. The socket is not closed.
+  ~BcmKnetRxRing();
+
+  // If the kernel has handed over the next block of the ring, calls handler
+  // for each of its packets, gives the block back and returns true. Returns
+  // false otherwise.
+  bool ReadBlock(const std::function<void(const BcmKnetRxFrame&)>& handler);
+
+  // BcmKnetRxRing is neither copyable nor movable.
+  BcmKnetRxRing(const BcmKnetRxRing&) = delete;
+  BcmKnetRxRing& operator=(const BcmKnetRxRing&) = delete;
+
+ private:
+  // Private constructor. Use Create() to create an instance of this class.
+  // The ring is unmapped on destruction if mapped is true.
+  BcmKnetRxRing(char* ring, size_t block_size, int num_blocks, bool mapped);
+
+  // Start of the ring.
+  char* const ring_;
+  // Size of a block in bytes.
+  const size_t block_size_;
+  // Number of blocks in the ring.
+  const int num_blocks_;
+  // Whether the ring was mapped by Create().
+  const bool mapped_;
+  // Index of the next block to read.
+  int next_block_;
+
+  friend class BcmKnetRxRingTest;
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_KNET_RX_RING_H_
@@ -0,0 +1,123 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/bcm_knet_rx_ring.h"
+
+#include <linux/if_packet.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// Fills blocks of a ring in memory the way the kernel does.
+class BcmKnetRxRingTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kBlockSize = 4096;
+  static constexpr int kNumBlocks = 2;
+
+  struct Packet {
+    std::string data;
+    size_t original_size;
+    int ifindex;
+  };
+
+  BcmKnetRxRingTest()
+      : memory_(kBlockSize * kNumBlocks / sizeof(uint64) + 1),
+        ring_(new BcmKnetRxRing(reinterpret_cast<char*>(memory_.data()),
+                                kBlockSize, kNumBlocks, false)) {}
+
+  // Writes the packets into the given block and hands it to the user.
+  void FillBlock(int index, const std::vector<Packet>& packets) {
+    char* block = reinterpret_cast<char*>(memory_.data()) + index * kBlockSize;
+    memset(block, 0, kBlockSize);
+    auto* desc = reinterpret_cast<struct tpacket_block_desc*>(block);
+    desc->hdr.bh1.num_pkts = packets.size();
+    desc->hdr.bh1.offset_to_first_pkt =
+        TPACKET_ALIGN(sizeof(struct tpacket_block_desc));
+    char* packet = block + desc->hdr.bh1.offset_to_first_pkt;
+    for (const auto& p : packets) {
+      auto* header = reinterpret_cast<struct tpacket3_hdr*>(packet);
+      auto* addr = reinterpret_cast<struct sockaddr_ll*>(
+          packet + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+      addr->sll_ifindex = p.ifindex;
+      addr->sll_pkttype = PACKET_HOST;
+      header->tp_mac = TPACKET_ALIGN(sizeof(struct tpacket3_hdr) +
+                                     sizeof(struct sockaddr_ll));
+      header->tp_snaplen = p.data.size();
+      header->tp_len = p.original_size;
+      memcpy(packet + header->tp_mac, p.data.data(), p.data.size());
+      header->tp_next_offset = TPACKET_ALIGN(header->tp_mac + p.data.size());
+      packet += header->tp_next_offset;
+    }
+    desc->hdr.bh1.block_status = TP_STATUS_USER;
+  }
+
+  uint32 BlockStatus(int index) {
+    char* block = reinterpret_cast<char*>(memory_.data()) + index * kBlockSize;
+    return reinterpret_cast<struct tpacket_block_desc*>(block)
+        ->hdr.bh1.block_status;
+  }
+
+  // Reads the next block into packets.
+  bool ReadBlock(std::vector<Packet>* packets) {
+    return ring_->ReadBlock([packets](const BcmKnetRxFrame& frame) {
+      EXPECT_EQ(PACKET_HOST, frame.pkttype);
+      packets->push_back({std::string(frame.data, frame.size),
+                          frame.original_size, frame.ifindex});
+    });
+  }
+
+  // Backing memory of the ring, aligned as the kernel would.
+  std::vector<uint64> memory_;
+  std::unique_ptr<BcmKnetRxRing> ring_;
+};
+
+constexpr size_t BcmKnetRxRingTest::kBlockSize;
+constexpr int BcmKnetRxRingTest::kNumBlocks;
+
+TEST_F(BcmKnetRxRingTest, ReadBlockReturnsFalseIfTheKernelOwnsTheBlock) {
+  std::vector<Packet> packets;
+  EXPECT_FALSE(ReadBlock(&packets));
+  EXPECT_TRUE(packets.empty());
+}
+
+TEST_F(BcmKnetRxRingTest, ReadBlockWalksAllPacketsOfTheBlocksInOrder) {
+  FillBlock(0, {{"first", 5, 10}, {"second packet", 100, 11}});
+  FillBlock(1, {{"third", 5, 12}});
+
+  std::vector<Packet> packets;
+  ASSERT_TRUE(ReadBlock(&packets));
+  ASSERT_EQ(2U, packets.size());
+  EXPECT_EQ("first", packets[0].data);
+  EXPECT_EQ(5U, packets[0].original_size);
+  EXPECT_EQ(10, packets[0].ifindex);
+  EXPECT_EQ("second packet", packets[1].data);
+  EXPECT_EQ(100U, packets[1].original_size);
+  EXPECT_EQ(11, packets[1].ifindex);
+  // The block is given back to the kernel.
+  EXPECT_EQ(static_cast<uint32>(TP_STATUS_KERNEL), BlockStatus(0));
+
+  packets.clear();
+  ASSERT_TRUE(ReadBlock(&packets));
+  ASSERT_EQ(1U, packets.size());
+  EXPECT_EQ("third", packets[0].data);
+  EXPECT_EQ(12, packets[0].ifindex);
+
+  // The ring wraps around to the first block, which the kernel owns now.
+  EXPECT_FALSE(ReadBlock(&packets));
+  FillBlock(0, {{"fourth", 6, 13}});
+  packets.clear();
+  ASSERT_TRUE(ReadBlock(&packets));
+  ASSERT_EQ(1U, packets.size());
+  EXPECT_EQ("fourth", packets[0].data);
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
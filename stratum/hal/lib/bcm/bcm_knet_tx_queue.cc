@@ -0,0 +1,62 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/bcm_knet_tx_queue.h"
+
+#include <algorithm>
+
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+BcmKnetTxQueue::BcmKnetTxQueue(size_t capacity)
+    : lock_(), not_empty_(), slots_(capacity), head_(0), size_(0) {
+  CHECK_GT(capacity, 0U);
+}
+
+::util::Status BcmKnetTxQueue::Push(const std::string& header,
+                                    const std::string& payload) {
+  {
+    absl::MutexLock l(&lock_);
+    if (size_ == slots_.size()) {
+      return MAKE_ERROR(ERR_UNAVAILABLE).without_logging()
+             << "KNET TX queue is full (" << slots_.size() << " packets).";
+    }
+    BcmKnetTxPacket& slot = slots_[(head_ + size_) % slots_.size()];
+    slot.header.assign(header);
+    slot.payload.assign(payload);
+    ++size_;
+  }
+  not_empty_.Signal();
+
+  return ::util::OkStatus();
+}
+
+size_t BcmKnetTxQueue::Pop(size_t max_packets, absl::Duration timeout,
+                           std::vector<BcmKnetTxPacket>* packets) {
+  if (packets->size() < max_packets) packets->resize(max_packets);
+  absl::MutexLock l(&lock_);
+  if (size_ == 0) not_empty_.WaitWithTimeout(&lock_, timeout);
+  size_t num_packets = std::min(size_, max_packets);
+  for (size_t i = 0; i < num_packets; ++i) {
+    BcmKnetTxPacket& slot = slots_[head_];
+    (*packets)[i].header.swap(slot.header);
+    (*packets)[i].payload.swap(slot.payload);
+    head_ = (head_ + 1) % slots_.size();
+  }
+  size_ -= num_packets;
+
+  return num_packets;
+}
+
+size_t BcmKnetTxQueue::Size() const {
+  absl::MutexLock l(&lock_);
+  return size_;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,80 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_KNET_TX_QUEUE_H_
+#define STRATUM_HAL_LIB_BCM_BCM_KNET_TX_QUEUE_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// A packet queued for transmission on a KNET interface.
+struct BcmKnetTxPacket {
+  // The KNET header, to be sent in front of the payload.
+  std::string header;
+  // The packet itself.
+  std::string payload;
+};
+
+// A bounded queue of packets to be transmitted on a KNET interface, filled by
+// the callers of TransmitPacket() and drained by the TX thread of the
+// interface. The slots of the queue are preallocated and their buffers are
+// recycled: Push() copies a packet into the buffers of a free slot and Pop()
+// swaps the queued slots with the buffers handed in by the TX thread. Once
+// the buffers have grown to the packet sizes, queuing does not allocate.
+class BcmKnetTxQueue {
+ public:
+  // Creates a queue holding up to capacity packets.
+  explicit BcmKnetTxQueue(size_t capacity);
+
+  // Queues a copy of the given packet. Returns ERR_UNAVAILABLE if the queue
+  // is full, in which case the caller needs to back off.
+  ::util::Status Push(const std::string& header, const std::string& payload)
+      LOCKS_EXCLUDED(lock_);
+
+  // Waits up to timeout for packets to be queued, then dequeues up to
+  // max_packets of them, in order, into the first elements of packets. The
+  // vector is grown to max_packets if it is smaller, and the previous
+  // contents of the dequeued elements are recycled. Returns the number of
+  // dequeued packets.
+  size_t Pop(size_t max_packets, absl::Duration timeout,
+             std::vector<BcmKnetTxPacket>* packets) LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of queued packets.
+  size_t Size() const LOCKS_EXCLUDED(lock_);
+
+  // BcmKnetTxQueue is neither copyable nor movable.
+  BcmKnetTxQueue(const BcmKnetTxQueue&) = delete;
+  BcmKnetTxQueue& operator=(const BcmKnetTxQueue&) = delete;
+
+ private:
+  mutable absl::Mutex lock_;
+
+  // Signaled when a packet is queued.
+  absl::CondVar not_empty_;
+
+  // The slots of the queue, used as a ring.
+  std::vector<BcmKnetTxPacket> slots_ GUARDED_BY(lock_);
+
+  // Index of the oldest queued packet in slots_.
+  size_t head_ GUARDED_BY(lock_);
+
+  // Number of queued packets.
+  size_t size_ GUARDED_BY(lock_);
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_KNET_TX_QUEUE_H_
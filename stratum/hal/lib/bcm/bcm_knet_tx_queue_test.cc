@@ -0,0 +1,79 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/bcm_knet_tx_queue.h"
+
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+TEST(BcmKnetTxQueueTest, PopReturnsPacketsInOrder) {
+  BcmKnetTxQueue queue(4);
+  ASSERT_OK(queue.Push("h1", "p1"));
+  ASSERT_OK(queue.Push("h2", "p2"));
+  ASSERT_OK(queue.Push("h3", "p3"));
+  EXPECT_EQ(3U, queue.Size());
+
+  std::vector<BcmKnetTxPacket> packets;
+  ASSERT_EQ(2U, queue.Pop(2, absl::ZeroDuration(), &packets));
+  EXPECT_EQ("h1", packets[0].header);
+  EXPECT_EQ("p1", packets[0].payload);
+  EXPECT_EQ("h2", packets[1].header);
+  EXPECT_EQ("p2", packets[1].payload);
+
+  // The queue wraps around.
+  ASSERT_OK(queue.Push("h4", "p4"));
+  ASSERT_OK(queue.Push("h5", "p5"));
+  ASSERT_EQ(3U, queue.Pop(8, absl::ZeroDuration(), &packets));
+  EXPECT_EQ("h3", packets[0].header);
+  EXPECT_EQ("h4", packets[1].header);
+  EXPECT_EQ("h5", packets[2].header);
+  EXPECT_EQ("p5", packets[2].payload);
+  EXPECT_EQ(0U, queue.Size());
+}
+
+TEST(BcmKnetTxQueueTest, PushFailsWhenTheQueueIsFull) {
+  BcmKnetTxQueue queue(2);
+  ASSERT_OK(queue.Push("h1", "p1"));
+  ASSERT_OK(queue.Push("h2", "p2"));
+  ::util::Status status = queue.Push("h3", "p3");
+  EXPECT_EQ(ERR_UNAVAILABLE, status.error_code());
+  EXPECT_EQ(2U, queue.Size());
+
+  std::vector<BcmKnetTxPacket> packets;
+  ASSERT_EQ(1U, queue.Pop(1, absl::ZeroDuration(), &packets));
+  EXPECT_OK(queue.Push("h3", "p3"));
+}
+
+TEST(BcmKnetTxQueueTest, PopTimesOutOnEmptyQueue) {
+  BcmKnetTxQueue queue(2);
+  std::vector<BcmKnetTxPacket> packets;
+  EXPECT_EQ(0U, queue.Pop(4, absl::Milliseconds(1), &packets));
+  EXPECT_EQ(4U, packets.size());
+}
+
+TEST(BcmKnetTxQueueTest, PopWaitsForPackets) {
+  BcmKnetTxQueue queue(2);
+  std::thread producer([&queue]() { EXPECT_OK(queue.Push("h1", "p1")); });
+  std::vector<BcmKnetTxPacket> packets;
+  size_t num_packets = 0;
+  while (num_packets == 0) {
+    num_packets = queue.Pop(4, absl::Seconds(10), &packets);
+  }
+  producer.join();
+  ASSERT_EQ(1U, num_packets);
+  EXPECT_EQ("h1", packets[0].header);
+  EXPECT_EQ("p1", packets[0].payload);
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -21,6 +21,9 @@ namespace bcm {
 BcmL3Manager::BcmL3Manager(BcmSdkInterface* bcm_sdk_interface,
                            BcmTableManager* bcm_table_manager, int unit)
     : router_intf_ref_count_(),
+      write_batch_started_(false),
+      write_batch_entries_(),
+      write_batch_index_(0),
       bcm_sdk_interface_(ABSL_DIE_IF_NULL(bcm_sdk_interface)),
       bcm_table_manager_(ABSL_DIE_IF_NULL(bcm_table_manager)),
       node_id_(0),
@@ -29,6 +32,9 @@ BcmL3Manager::BcmL3Manager(BcmSdkInterface* bcm_sdk_interface,
 
 BcmL3Manager::BcmL3Manager()
     : router_intf_ref_count_(),
+      write_batch_started_(false),
+      write_batch_entries_(),
+      write_batch_index_(0),
       bcm_sdk_interface_(nullptr),
       bcm_table_manager_(nullptr),
       node_id_(0),
@@ -329,6 +335,7 @@ BcmL3Manager::~BcmL3Manager() {}
       entry, ::p4::v1::Update::INSERT, &bcm_flow_entry));
   RETURN_IF_ERROR(InsertLpmOrHostFlow(bcm_flow_entry));
   RETURN_IF_ERROR(bcm_table_manager_->AddTableEntry(entry));
+  if (write_batch_started_) write_batch_entries_[write_batch_index_] = entry;
 
   return ::util::OkStatus();
 }
@@ -425,6 +432,71 @@ BcmL3Manager::~BcmL3Manager() {}
   return ::util::OkStatus();
 }
 
+::util::Status BcmL3Manager::StartWriteBatch() {
+  RET_CHECK(!write_batch_started_) << "A batch of writes is already started.";
+  RETURN_IF_ERROR(bcm_sdk_interface_->StartL3WriteBatch(unit_));
+  write_batch_started_ = true;
+  write_batch_index_ = 0;
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmL3Manager::SetWriteBatchIndex(int index) {
+  RET_CHECK(write_batch_started_) << "No batch of writes is started.";
+  RETURN_IF_ERROR(bcm_sdk_interface_->SetL3WriteBatchTag(unit_, index));
+  write_batch_index_ = index;
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmL3Manager::CommitWriteBatch(
+    std::map<int, ::util::Status>* failures) {
+  RET_CHECK(failures != nullptr) << "Failures pointer must be non-null.";
+  RET_CHECK(write_batch_started_) << "No batch of writes is started.";
+  write_batch_started_ = false;
+  std::map<int, ::p4::v1::TableEntry> entries;
+  entries.swap(write_batch_entries_);
+  std::map<int, ::util::Status> sdk_failures;
+  ::util::Status status =
+      bcm_sdk_interface_->CommitL3WriteBatch(unit_, &sdk_failures);
+  if (!status.ok()) {
+    // The SDK commits the queued writes in several transactions along the
+    // way, so any of them may already be in hardware. Delete all the entries
+    // of the batch from the hardware, where found, and from the software
+    // state, so that both agree, and fail their writes.
+    ::util::Status error = MAKE_ERROR(status.error_code()).without_logging()
+                           << "Failed to commit the batched L3 write: "
+                           << status.error_message();
+    for (const auto& e : entries) {
+      BcmFlowEntry bcm_flow_entry;
+      ::util::Status delete_status = bcm_table_manager_->FillBcmFlowEntry(
+          e.second, ::p4::v1::Update::DELETE, &bcm_flow_entry);
+      if (delete_status.ok()) {
+        delete_status = DeleteLpmOrHostFlow(bcm_flow_entry);
+      }
+      if (delete_status.error_code() != ERR_ENTRY_NOT_FOUND) {
+        APPEND_STATUS_IF_ERROR(status, delete_status);
+      }
+      APPEND_STATUS_IF_ERROR(status,
+                             bcm_table_manager_->DeleteTableEntry(e.second));
+      (*failures)[e.first] = error;
+    }
+    return status;
+  }
+  // The entries whose writes failed are not in hardware, drop them from the
+  // software state as well.
+  for (const auto& e : sdk_failures) {
+    const ::p4::v1::TableEntry* entry = gtl::FindOrNull(entries, e.first);
+    if (entry != nullptr) {
+      APPEND_STATUS_IF_ERROR(status,
+                             bcm_table_manager_->DeleteTableEntry(*entry));
+    }
+    (*failures)[e.first] = e.second;
+  }
+
+  return status;
+}
+
 ::util::Status BcmL3Manager::UpdateMultipathGroupsForPort(uint32 port_id) {
   // Generate map from BCM multipath group id to data for all groups which
   // reference the given port.
@@ -5,6 +5,7 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_H_
 #define STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -125,6 +126,24 @@ class BcmL3Manager {
   // not needed).
   virtual ::util::Status DeleteTableEntry(const ::p4::v1::TableEntry& entry);
 
+  // Starts batching the hardware writes of InsertTableEntry(), if supported by
+  // the SDK. Until CommitWriteBatch() is called, the SDK queues the inserted
+  // LPM/Host flows and commits them to hardware in bulk, while the entries are
+  // added to BcmTableManager right away.
+  virtual ::util::Status StartWriteBatch();
+
+  // Sets the index the entries inserted from now on are reported with by
+  // CommitWriteBatch(), e.g. the index of their update in the WriteRequest.
+  virtual ::util::Status SetWriteBatchIndex(int index);
+
+  // Commits the writes queued since StartWriteBatch() and ends the batch. The
+  // entries whose writes failed are removed from BcmTableManager and their
+  // errors are added to failures, keyed by the index they were inserted with.
+  // If the commit itself fails, all the entries of the batch are deleted from
+  // the hardware and BcmTableManager and failed this way.
+  virtual ::util::Status CommitWriteBatch(
+      std::map<int, ::util::Status>* failures);
+
   // Updates any ECMP/WCMP groups which include a member pointing to the given
   // singleton port. Adds or removes the port to or from all groups referencing
   // it based on whether the port is UP or not, respectively. In the case that
@@ -192,6 +211,16 @@ class BcmL3Manager {
   // directly from SDK. Investigate.
   absl::flat_hash_map<int, uint32> router_intf_ref_count_;
 
+  // Whether a batch of writes was started by StartWriteBatch().
+  bool write_batch_started_;
+
+  // The entries inserted in the current batch of writes, keyed by the index
+  // given to SetWriteBatchIndex() before their insertion.
+  std::map<int, ::p4::v1::TableEntry> write_batch_entries_;
+
+  // The index the entries inserted from now on are reported with.
+  int write_batch_index_;
+
   // Pointer to a BcmSdkInterface implementation that wraps all the SDK calls.
   BcmSdkInterface* bcm_sdk_interface_;  // Not owned by this class.
 
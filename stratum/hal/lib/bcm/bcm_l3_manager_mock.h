@@ -5,6 +5,8 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_MOCK_H_
 #define STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_MOCK_H_
 
+#include <map>
+
 #include "gmock/gmock.h"
 #include "stratum/hal/lib/bcm/bcm_l3_manager.h"
 
@@ -38,6 +40,10 @@ class BcmL3ManagerMock : public BcmL3Manager {
   MOCK_METHOD1(DeleteTableEntry,
                ::util::Status(const ::p4::v1::TableEntry& entry));
   MOCK_METHOD1(UpdateMultipathGroupsForPort, ::util::Status(uint32 port_id));
+  MOCK_METHOD0(StartWriteBatch, ::util::Status());
+  MOCK_METHOD1(SetWriteBatchIndex, ::util::Status(int index));
+  MOCK_METHOD1(CommitWriteBatch,
+               ::util::Status(std::map<int, ::util::Status>* failures));
 };
 
 }  // namespace bcm
@@ -1233,6 +1233,125 @@ TEST_F(BcmL3ManagerTest, InsertLpmOrHostFlowSuccessForIpv4HostFlow) {
   ASSERT_OK(bcm_l3_manager_->InsertTableEntry(p4_table_entry));
 }
 
+TEST_F(BcmL3ManagerTest, BatchedInsertLpmOrHostFlowFailureRemovesEntry) {
+  const std::string kBcmFlowEntryText = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV4_HOST
+      fields: {
+        type: IPV4_DST
+        value {
+          u32: 0xc0a00100
+        }
+      }
+      actions: {
+        type: OUTPUT_PORT
+        params {
+          type: EGRESS_INTF_ID
+          value {
+            u32: 100003
+          }
+        }
+      }
+  )";
+
+  // Test BcmFlowEntry.
+  BcmFlowEntry bcm_flow_entry;
+  ASSERT_OK(ParseProtoFromString(kBcmFlowEntryText, &bcm_flow_entry));
+  ::p4::v1::TableEntry p4_table_entry =
+      ExpectFlowConversion(::p4::v1::Update::INSERT, bcm_flow_entry);
+
+  // The SDK queues the write and reports its failure when the batch is
+  // committed.
+  std::map<int, ::util::Status> sdk_failures = {
+      {4, MAKE_ERROR(ERR_ENTRY_EXISTS) << "Entry exists."}};
+  EXPECT_CALL(*bcm_sdk_mock_, StartL3WriteBatch(kUnit))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, SetL3WriteBatchTag(kUnit, 4))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, AddL3HostIpv4(kUnit, 0, 0xc0a00100, -1, 100003))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              AddTableEntry(EqualsProto(p4_table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CommitL3WriteBatch(kUnit, _))
+      .WillOnce(
+          DoAll(SetArgPointee<1>(sdk_failures), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              DeleteTableEntry(EqualsProto(p4_table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ASSERT_OK(bcm_l3_manager_->StartWriteBatch());
+  ASSERT_OK(bcm_l3_manager_->SetWriteBatchIndex(4));
+  ASSERT_OK(bcm_l3_manager_->InsertTableEntry(p4_table_entry));
+  std::map<int, ::util::Status> failures;
+  ASSERT_OK(bcm_l3_manager_->CommitWriteBatch(&failures));
+  ASSERT_EQ(1U, failures.size());
+  EXPECT_EQ(ERR_ENTRY_EXISTS, failures[4].error_code());
+}
+
+TEST_F(BcmL3ManagerTest, BatchedInsertLpmOrHostFlowCommitFailureRemovesEntry) {
+  const std::string kBcmFlowEntryText = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV4_HOST
+      fields: {
+        type: IPV4_DST
+        value {
+          u32: 0xc0a00100
+        }
+      }
+      actions: {
+        type: OUTPUT_PORT
+        params {
+          type: EGRESS_INTF_ID
+          value {
+            u32: 100003
+          }
+        }
+      }
+  )";
+
+  // Test BcmFlowEntry.
+  BcmFlowEntry bcm_flow_entry;
+  ASSERT_OK(ParseProtoFromString(kBcmFlowEntryText, &bcm_flow_entry));
+  ::p4::v1::TableEntry p4_table_entry =
+      ExpectFlowConversion(::p4::v1::Update::INSERT, bcm_flow_entry);
+
+  // The commit of the batch fails as a whole, the entry is rolled back from
+  // the hardware, where it is not found, and from the software state.
+  EXPECT_CALL(*bcm_sdk_mock_, StartL3WriteBatch(kUnit))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, SetL3WriteBatchTag(kUnit, 2))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, AddL3HostIpv4(kUnit, 0, 0xc0a00100, -1, 100003))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              AddTableEntry(EqualsProto(p4_table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CommitL3WriteBatch(kUnit, _))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_HARDWARE_ERROR, "Blah")));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              FillBcmFlowEntry(EqualsProto(p4_table_entry),
+                               ::p4::v1::Update::DELETE, _))
+      .WillOnce(
+          DoAll(SetArgPointee<2>(bcm_flow_entry), Return(util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, DeleteL3HostIpv4(kUnit, 0, 0xc0a00100))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_ENTRY_NOT_FOUND, "Blah")));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              DeleteTableEntry(EqualsProto(p4_table_entry)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ASSERT_OK(bcm_l3_manager_->StartWriteBatch());
+  ASSERT_OK(bcm_l3_manager_->SetWriteBatchIndex(2));
+  ASSERT_OK(bcm_l3_manager_->InsertTableEntry(p4_table_entry));
+  std::map<int, ::util::Status> failures;
+  ::util::Status status = bcm_l3_manager_->CommitWriteBatch(&failures);
+  EXPECT_EQ(ERR_HARDWARE_ERROR, status.error_code());
+  ASSERT_EQ(1U, failures.size());
+  EXPECT_EQ(ERR_HARDWARE_ERROR, failures[2].error_code());
+}
+
 TEST_F(BcmL3ManagerTest,
        InsertLpmOrHostFlowSuccessForIpv6LpmFlowAndMultipathNexthop) {
   const std::string kBcmFlowEntryText = R"(
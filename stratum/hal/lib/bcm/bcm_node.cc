@@ -4,12 +4,14 @@
 
 #include "stratum/hal/lib/bcm/bcm_node.h"
 
+#include <map>
 #include <set>
 #include <utility>
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 #include "gflags/gflags.h"
+#include "stratum/hal/lib/common/chunked_read_response_writer.h"
 #include "stratum/hal/lib/common/proto_oneof_writer_wrapper.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/macros.h"
@@ -19,6 +21,9 @@
 DEFINE_bool(enable_static_table_writes, true,
             "Enables writes of static table "
             "entries from the P4 pipeline config to the hardware tables");
+DEFINE_bool(enable_batched_l3_writes, false,
+            "Enables committing the L3 route writes of a WriteRequest to "
+            "the hardware in bulk, if supported by the SDK.");
 
 namespace stratum {
 namespace hal {
@@ -294,10 +299,11 @@ BcmNode::~BcmNode() {}
       RETURN_IF_ERROR(bcm_acl_manager_->GetTableEntryStats(
           *flow, flow->mutable_counter_data()));
     }
-    if (!writer->Write(resp)) {
-      return MAKE_ERROR(ERR_INTERNAL)
-             << "Write to stream for failed for node " << node_id_ << ".";
-    }
+    // Stream the entries in bounded chunks rather than as a single, possibly
+    // huge, response.
+    ChunkedReadResponseWriter chunked_writer(writer);
+    RETURN_IF_ERROR(chunked_writer.AddEntities(&resp));
+    RETURN_IF_ERROR(chunked_writer.Flush());
   }
   if (action_profile_members_requested) {
     RETURN_IF_ERROR(bcm_table_manager_->ReadActionProfileMembers(
@@ -432,8 +438,29 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
 ::util::Status BcmNode::DoWriteForwardingEntries(
     const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
   bool success = true;
-  for (const auto& update : req.updates()) {
+  // Batch the L3 route writes of the request, if enabled and supported by the
+  // SDK. The errors of the batched writes are only known once the batch is
+  // committed, so their results are filled in afterwards.
+  const size_t first_result = results->size();
+  bool batched = false;
+  if (FLAGS_enable_batched_l3_writes && req.updates_size() > 1) {
+    ::util::Status status = bcm_l3_manager_->StartWriteBatch();
+    if (status.error_code() != ERR_UNIMPLEMENTED) {
+      RETURN_IF_ERROR(status);
+      batched = true;
+    }
+  }
+  for (int i = 0; i < req.updates_size(); ++i) {
+    const auto& update = req.updates(i);
     ::util::Status status = ::util::OkStatus();
+    if (batched) {
+      status = bcm_l3_manager_->SetWriteBatchIndex(i);
+      if (!status.ok()) {
+        success = false;
+        results->push_back(status);
+        continue;
+      }
+    }
     switch (update.entity().entity_case()) {
       case ::p4::v1::Entity::kExternEntry:
         // TODO(unknown): Implement this.
@@ -497,6 +524,19 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
     success &= status.ok();
     results->push_back(status);
   }
+  if (batched) {
+    std::map<int, ::util::Status> failures;
+    ::util::Status status = bcm_l3_manager_->CommitWriteBatch(&failures);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to commit the batched L3 writes of node with ID "
+                 << node_id_ << ": " << status.error_message();
+      success = false;
+    }
+    for (const auto& e : failures) {
+      (*results)[first_result + e.first] = e.second;
+      success = false;
+    }
+  }
 
   if (!success) {
     return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
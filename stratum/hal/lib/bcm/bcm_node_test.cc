@@ -4,10 +4,13 @@
 
 #include "stratum/hal/lib/bcm/bcm_node.h"
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/canonical_errors.h"
@@ -22,6 +25,8 @@
 #include "stratum/hal/lib/p4/p4_table_mapper_mock.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_bool(enable_batched_l3_writes);
+
 namespace stratum {
 namespace hal {
 namespace bcm {
@@ -1620,6 +1625,105 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteMulticastGroupEntry) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BcmNodeTest, WriteForwardingEntriesReportsBatchedL3WriteFailures) {
+  gflags::FlagSaver flag_saver;
+  FLAGS_enable_batched_l3_writes = true;
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  for (int i = 0; i < 3; ++i) {
+    SetupTableEntryToInsert(&req, kNodeId)->set_priority(i + 1);
+  }
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              FillBcmFlowEntry(_, ::p4::v1::Update::INSERT, _))
+      .Times(3)
+      .WillRepeatedly(
+          DoAll(WithArgs<2>(Invoke([](BcmFlowEntry* x) {
+                  x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV4_LPM);
+                })),
+                Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntry(_))
+      .Times(3)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  {
+    InSequence sequence;
+    EXPECT_CALL(*bcm_l3_manager_mock_, StartWriteBatch())
+        .WillOnce(Return(::util::OkStatus()));
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_CALL(*bcm_l3_manager_mock_, SetWriteBatchIndex(i))
+          .WillOnce(Return(::util::OkStatus()));
+    }
+    // The write of the second update only fails when the batch is committed.
+    EXPECT_CALL(*bcm_l3_manager_mock_, CommitWriteBatch(_))
+        .WillOnce(Invoke([this](std::map<int, ::util::Status>* failures) {
+          (*failures)[1] = DefaultError();
+          return ::util::OkStatus();
+        }));
+  }
+
+  // The results of the request are appended after the existing ones.
+  std::vector<::util::Status> results = {::util::OkStatus()};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_OK(results[1]);
+  EXPECT_THAT(results[2], DerivedFromStatus(DefaultError()));
+  EXPECT_OK(results[3]);
+}
+
+TEST_F(BcmNodeTest, WriteForwardingEntriesWithoutL3WriteBatchSupport) {
+  gflags::FlagSaver flag_saver;
+  FLAGS_enable_batched_l3_writes = true;
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  for (int i = 0; i < 2; ++i) {
+    SetupTableEntryToInsert(&req, kNodeId)->set_priority(i + 1);
+  }
+  // The SDK cannot batch the writes, they are done one by one.
+  EXPECT_CALL(*bcm_l3_manager_mock_, StartWriteBatch())
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_UNIMPLEMENTED, kErrorMsg)));
+  EXPECT_CALL(*bcm_l3_manager_mock_, SetWriteBatchIndex(_)).Times(0);
+  EXPECT_CALL(*bcm_l3_manager_mock_, CommitWriteBatch(_)).Times(0);
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              FillBcmFlowEntry(_, ::p4::v1::Update::INSERT, _))
+      .Times(2)
+      .WillRepeatedly(
+          DoAll(WithArgs<2>(Invoke([](BcmFlowEntry* x) {
+                  x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV4_LPM);
+                })),
+                Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntry(_))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+
+  std::vector<::util::Status> results;
+  EXPECT_OK(WriteForwardingEntries(req, &results));
+  EXPECT_EQ(2U, results.size());
+}
+
+TEST_F(BcmNodeTest, WriteForwardingEntriesFailureWhenL3WriteBatchFails) {
+  gflags::FlagSaver flag_saver;
+  FLAGS_enable_batched_l3_writes = true;
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  for (int i = 0; i < 2; ++i) {
+    SetupTableEntryToInsert(&req, kNodeId)->set_priority(i + 1);
+  }
+  // Any other error of the batch start fails the request before any write.
+  EXPECT_CALL(*bcm_l3_manager_mock_, StartWriteBatch())
+      .WillOnce(Return(DefaultError()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntry(_)).Times(0);
+
+  std::vector<::util::Status> results;
+  EXPECT_THAT(WriteForwardingEntries(req, &results),
+              DerivedFromStatus(DefaultError()));
+  EXPECT_TRUE(results.empty());
+}
+
 // RegisterStreamMessageResponseWriter() should forward the call to
 // BcmPacketioManager and return success or error based on the returned result.
 TEST_F(BcmNodeTest, RegisterStreamMessageResponseWriter) {
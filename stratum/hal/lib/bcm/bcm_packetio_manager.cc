@@ -18,12 +18,15 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "gflags/gflags.h"
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/gtl/stl_util.h"
@@ -39,6 +42,28 @@ DEFINE_int32(knet_rx_poll_timeout_ms, 100,
 DEFINE_int32(knet_max_num_packets_to_read_at_once, 8,
              "Determines the number of packets we try to read at once as soon "
              "as the socket FD becomes available.");
+DEFINE_int32(knet_tx_queue_size, 0,
+             "If positive, packets are transmitted on KNET interfaces by a TX "
+             "thread per interface, through a queue of this many packets. "
+             "TransmitPacket() fails if the queue is full. If 0, packets are "
+             "sent synchronously by the caller.");
+DEFINE_int32(knet_max_num_packets_to_send_at_once, 64,
+             "Max number of packets the KNET TX threads send with a single "
+             "sendmmsg() call.");
+DEFINE_int32(knet_tx_poll_timeout_ms, 100,
+             "Polling timeout to check queued packets in KNET TX queues.");
+DEFINE_bool(knet_rx_ring, false,
+            "If true, receive the packets of KNET RX sockets through a "
+            "TPACKET_V3 ring shared with the kernel instead of one recvmsg() "
+            "per packet.");
+DEFINE_int32(knet_rx_ring_block_size, 256 * 1024,
+             "Size in bytes of the blocks of the KNET RX rings. Must be a "
+             "multiple of the page size.");
+DEFINE_int32(knet_rx_ring_num_blocks, 64,
+             "Number of blocks of the KNET RX rings.");
+DEFINE_int32(knet_rx_ring_block_timeout_ms, 10,
+             "Time after which the kernel hands over a KNET RX ring block "
+             "which is not full.");
 
 // TODO(unknown): I really really wish we could use google3 thread libraries.
 namespace stratum {
@@ -57,6 +82,32 @@ constexpr size_t BcmPacketioManager::kMaxRxBufferSize;
 
 namespace {
 
+// Copies a received packet to payload, stripping the VLAN tag if it is one of
+// the VLANs used internally.
+void StripKnownVlanTag(const char* data, size_t size, std::string* payload) {
+  const struct ether_header* ether_header =
+      reinterpret_cast<const struct ether_header*>(data);
+  bool tagged = false;
+  if (size >= sizeof(struct ether_header) + kVlanIdSize &&
+      ntohs(ether_header->ether_type) == ETHERTYPE_VLAN) {
+    uint16 vlan;
+    memcpy(&vlan, data + sizeof(struct ether_header), sizeof(vlan));
+    vlan = ntohs(vlan) & kVlanIdMask;
+    if (vlan == kDefaultVlan || vlan == kArpVlan || vlan == 0) {
+      tagged = true;
+    }
+  }
+
+  if (tagged) {
+    payload->reserve(size - kVlanTagSize);
+    payload->assign(data, ETH_ALEN * 2);
+    payload->append(data + ETH_ALEN * 2 + kVlanTagSize,
+                    size - ETH_ALEN * 2 - kVlanTagSize);
+  } else {
+    payload->assign(data, size);
+  }
+}
+
 // Macros to increment the RX/TX counters for a KNET intf. MUST be called inside
 // the class methods only as it accesses class member variables.
 #define INCREMENT_TX_COUNTER(purpose, counter) \
@@ -291,6 +342,13 @@ BcmPacketioManager::~BcmPacketioManager() {}
                              << entry.second.rx_thread_id;
       APPEND_STATUS_IF_ERROR(status, error);
     }
+    if (entry.second.tx_thread_id > 0 &&
+        pthread_join(entry.second.tx_thread_id, nullptr) != 0) {
+      ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                             << "Failed to join thread "
+                             << entry.second.tx_thread_id;
+      APPEND_STATUS_IF_ERROR(status, error);
+    }
   }
   // Perform the rest of the shutdown. First close the TX/RX sockets and
   // destroy all the KNET filters and KNET interfaces.
@@ -476,17 +534,15 @@ BcmPacketioManager::~BcmPacketioManager() {}
     RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForDirectTx(
         unit_, *logical_port, meta.cos, intf->smac, packet.payload().size(),
         &header));
-    RETURN_IF_ERROR(TxPacket(purpose, intf->tx_sock, intf->vlan,
-                             intf->netif_index, true, header,
-                             packet.payload()));
+    RETURN_IF_ERROR(
+        QueueOrTxPacket(purpose, *intf, true, header, packet.payload()));
     INCREMENT_TX_COUNTER(purpose, tx_accepts_direct);
   } else {
     std::string header = "";
     RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForIngressPipelineTx(
         unit_, intf->smac, packet.payload().size(), &header));
-    RETURN_IF_ERROR(TxPacket(purpose, intf->tx_sock, intf->vlan,
-                             intf->netif_index, false, header,
-                             packet.payload()));
+    RETURN_IF_ERROR(
+        QueueOrTxPacket(purpose, *intf, false, header, packet.payload()));
     INCREMENT_TX_COUNTER(purpose, tx_accepts_ingress_pipeline);
   }
 
@@ -754,6 +810,19 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
               << ", netif_id: " << entry.second.netif_id
               << ", netif_index: " << entry.second.netif_index
               << ", rx_thread_id: " << entry.second.rx_thread_id << ").";
+    if (entry.second.tx_queue == nullptr) continue;
+    data = new KnetIntfRxThreadData(node_id_, entry.first, this);
+    knet_intf_rx_thread_data_.push_back(data);
+    ret = pthread_create(&entry.second.tx_thread_id, nullptr,
+                         &BcmPacketioManager::KnetIntfTxThreadFunc, data);
+    if (ret != 0) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to spawn TX thread for KNET interface "
+             << entry.second.netif_name << " created for node with ID "
+             << node_id_ << " (unit: " << unit_ << ", purpose: "
+             << GoogleConfig::BcmKnetIntfPurpose_Name(entry.first)
+             << "). Err: " << ret << ".";
+    }
   }
 
   return ::util::OkStatus();
@@ -931,6 +1000,29 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
     }
   }
 
+  // Create the TX queue (if enabled by flags). The TX thread draining it is
+  // spawned along with the RX thread.
+  if (FLAGS_knet_tx_queue_size > 0) {
+    intf->tx_queue = std::make_shared<BcmKnetTxQueue>(FLAGS_knet_tx_queue_size);
+  }
+
+  // Map a RX ring on the socket (if enabled by flags). This must be done
+  // before the socket is bound.
+  if (FLAGS_knet_rx_ring) {
+    auto ret = BcmKnetRxRing::Create(
+        intf->rx_sock, FLAGS_knet_rx_ring_block_size,
+        FLAGS_knet_rx_ring_num_blocks, FLAGS_knet_rx_ring_block_timeout_ms);
+    if (!ret.ok()) {
+      close(intf->rx_sock);
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Couldn't set up the RX ring for KNET interface "
+             << intf->netif_name << " (unit " << unit_ << " and purpose "
+             << GoogleConfig::BcmKnetIntfPurpose_Name(purpose)
+             << "): " << ret.status().error_message();
+    }
+    intf->rx_ring = ret.ConsumeValueOrDie();
+  }
+
   // Now bind socket to the interface. To bind to the interface, we do not use
   // setsockopt(SO_BINDTODEVICE). Instead we use bind with netif_index.
   struct sockaddr_ll addr;
@@ -990,12 +1082,14 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   // not expect BcmKnetIntf for this purpose to change at all (if it does,
   // VerifyChassisConfig() will return reboot required).
   int rx_sock = -1, netif_index = -1;
+  BcmKnetRxRing* rx_ring = nullptr;
   {
     absl::ReaderMutexLock l(&chassis_lock);
     if (shutdown) return ::util::OkStatus();
     ASSIGN_OR_RETURN(const BcmKnetIntf* intf, GetBcmKnetIntf(purpose));
     rx_sock = intf->rx_sock;
     netif_index = intf->netif_index;
+    rx_ring = intf->rx_ring.get();
     RET_CHECK(rx_sock > 0)  // MUST NOT HAPPEN!
         << "KNET interface with purpose "
         << GoogleConfig::BcmKnetIntfPurpose_Name(purpose) << " on node with ID "
@@ -1030,6 +1124,18 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
       VLOG(1) << "Error in epoll_wait(). errno: " << errno << ".";
       INCREMENT_RX_COUNTER(purpose, rx_errors_epoll_wait_failures);
       continue;  // let it retry
+    } else if (ret > 0 && pevents[0].events & EPOLLIN && rx_ring != nullptr) {
+      // The kernel handed over at least one block of the RX ring. Read the
+      // blocks handed over so far, checking for exit criteria in between.
+      std::vector<::p4::v1::PacketIn> packets;
+      for (int i = 0; i < FLAGS_knet_rx_ring_num_blocks; ++i) {
+        {
+          absl::ReaderMutexLock l(&chassis_lock);
+          if (shutdown) break;
+          if (!ReadRxRingBlock(purpose, rx_ring, netif_index, &packets)) break;
+        }
+        WritePacketsToRxWriter(purpose, &packets);
+      }
     } else if (ret > 0 && pevents[0].events & EPOLLIN) {
       // We have data to receive. Try to read max of
       // FLAGS_knet_max_num_packets_to_read_at_once packets before we try to
@@ -1047,84 +1153,15 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
         if (!header.empty()) {
           // We received good data. Process it. The parsing errors will not
           // result in RX thread to shutdown.
-          int ingress_logical_port = 0, egress_logical_port = 0;
-          PacketInMetadata meta;
-          ::util::Status status = bcm_sdk_interface_->ParseKnetHeaderForRx(
-              unit_, header, &ingress_logical_port, &egress_logical_port,
-              &meta.cos);
-          if (!status.ok()) {
-            VLOG(1) << "Failed to parse KNET header for a packet on unit "
-                    << unit_ << ": " << status.error_message();
-            INCREMENT_RX_COUNTER(purpose, rx_drops_knet_header_parse_error);
-            continue;  // let it retry
-          }
-          // Find ingress port ID.
-          if (ingress_logical_port == kCpuLogicalPort) {
-            // This means CPU port by default.
-            meta.ingress_port_id = kCpuPortId;
-          } else {
-            uint32* ingress_port_id =
-                gtl::FindOrNull(logical_port_to_port_id_, ingress_logical_port);
-            if (ingress_port_id == nullptr) {
-              VLOG(1) << "Ingress logical port " << ingress_logical_port
-                      << " on unit " << unit_ << " is unknown!";
-              INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_ingress_port);
-              continue;  // let it retry
-            }
-            meta.ingress_port_id = *ingress_port_id;
-            auto ret = bcm_chassis_ro_interface_->GetParentTrunkId(
-                node_id_, *ingress_port_id);
-            if (ret.ok()) {
-              // If status is OK, there is a parent trunk.
-              meta.ingress_trunk_id = ret.ValueOrDie();
-            }
-          }
-          // Find egress port ID.
-          if (egress_logical_port == kCpuLogicalPort) {
-            // This means CPU port by default.
-            meta.egress_port_id = kCpuPortId;
-          } else if (egress_logical_port == 1) {
-            // SDKLT sets egress port to 1 for packets that do not match
-            // MY_STATION table or got dropped by the ASIC?
-            // TODO(unknown): check this and decide what to report upwards
-            meta.egress_port_id = 1;
-          } else {
-            uint32* egress_port_id =
-                gtl::FindOrNull(logical_port_to_port_id_, egress_logical_port);
-            if (egress_port_id == nullptr) {
-              VLOG(1) << "Egress logical port " << egress_logical_port
-                      << " on unit " << unit_ << " is unknown!";
-              INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_egress_port);
-              continue;  // let it retry
-            }
-            meta.egress_port_id = *egress_port_id;
-          }
-          VLOG(1) << "PacketInMetadata.ingress_port_id: "
-                  << meta.ingress_port_id << "\n"
-                  << "PacketInMetadata.ingress_trunk_id: "
-                  << meta.ingress_trunk_id << "\n"
-                  << "PacketInMetadata.egress_port_id: " << meta.egress_port_id
-                  << "\n"
-                  << "PacketInMetadata.cos: " << meta.cos;
-          status = DeparsePacketInMetadata(meta, &packet);
-          if (!status.ok()) {
-            INCREMENT_RX_COUNTER(purpose, rx_drops_metadata_deparse_error);
+          if (!AddPacketInMetadata(purpose, header, &packet).ok()) {
             continue;  // let it retry
           }
           INCREMENT_RX_COUNTER(purpose, rx_accepts);
-          packets.push_back(packet);
+          packets.push_back(std::move(packet));
         }
       }
       // Send the packet to the packet RX writer.
-      if (!packets.empty()) {
-        absl::ReaderMutexLock l(&rx_writer_lock_);
-        auto* writer = gtl::FindOrNull(purpose_to_rx_writer_, purpose);
-        if (writer != nullptr) {
-          for (const auto& p : packets) {
-            (*writer)->Write(p);
-          }
-        }
-      }
+      WritePacketsToRxWriter(purpose, &packets);
     }
   }
 
@@ -1137,6 +1174,135 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   return ::util::OkStatus();
 }
 
+::util::Status BcmPacketioManager::AddPacketInMetadata(
+    GoogleConfig::BcmKnetIntfPurpose purpose, const std::string& header,
+    ::p4::v1::PacketIn* packet) {
+  int ingress_logical_port = 0, egress_logical_port = 0;
+  PacketInMetadata meta;
+  ::util::Status status = bcm_sdk_interface_->ParseKnetHeaderForRx(
+      unit_, header, &ingress_logical_port, &egress_logical_port, &meta.cos);
+  if (!status.ok()) {
+    VLOG(1) << "Failed to parse KNET header for a packet on unit " << unit_
+            << ": " << status.error_message();
+    INCREMENT_RX_COUNTER(purpose, rx_drops_knet_header_parse_error);
+    return status;
+  }
+  // Find ingress port ID.
+  if (ingress_logical_port == kCpuLogicalPort) {
+    // This means CPU port by default.
+    meta.ingress_port_id = kCpuPortId;
+  } else {
+    uint32* ingress_port_id =
+        gtl::FindOrNull(logical_port_to_port_id_, ingress_logical_port);
+    if (ingress_port_id == nullptr) {
+      VLOG(1) << "Ingress logical port " << ingress_logical_port << " on unit "
+              << unit_ << " is unknown!";
+      INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_ingress_port);
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+             << "Unknown ingress logical port " << ingress_logical_port << ".";
+    }
+    meta.ingress_port_id = *ingress_port_id;
+    auto ret = bcm_chassis_ro_interface_->GetParentTrunkId(node_id_,
+                                                           *ingress_port_id);
+    if (ret.ok()) {
+      // If status is OK, there is a parent trunk.
+      meta.ingress_trunk_id = ret.ValueOrDie();
+    }
+  }
+  // Find egress port ID.
+  if (egress_logical_port == kCpuLogicalPort) {
+    // This means CPU port by default.
+    meta.egress_port_id = kCpuPortId;
+  } else if (egress_logical_port == 1) {
+    // SDKLT sets egress port to 1 for packets that do not match
+    // MY_STATION table or got dropped by the ASIC?
+    // TODO(unknown): check this and decide what to report upwards
+    meta.egress_port_id = 1;
+  } else {
+    uint32* egress_port_id =
+        gtl::FindOrNull(logical_port_to_port_id_, egress_logical_port);
+    if (egress_port_id == nullptr) {
+      VLOG(1) << "Egress logical port " << egress_logical_port << " on unit "
+              << unit_ << " is unknown!";
+      INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_egress_port);
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+             << "Unknown egress logical port " << egress_logical_port << ".";
+    }
+    meta.egress_port_id = *egress_port_id;
+  }
+  VLOG(1) << "PacketInMetadata.ingress_port_id: " << meta.ingress_port_id
+          << "\n"
+          << "PacketInMetadata.ingress_trunk_id: " << meta.ingress_trunk_id
+          << "\n"
+          << "PacketInMetadata.egress_port_id: " << meta.egress_port_id << "\n"
+          << "PacketInMetadata.cos: " << meta.cos;
+  status = DeparsePacketInMetadata(meta, packet);
+  if (!status.ok()) {
+    INCREMENT_RX_COUNTER(purpose, rx_drops_metadata_deparse_error);
+    return status;
+  }
+
+  return ::util::OkStatus();
+}
+
+bool BcmPacketioManager::ReadRxRingBlock(
+    GoogleConfig::BcmKnetIntfPurpose purpose, BcmKnetRxRing* rx_ring,
+    int netif_index, std::vector<::p4::v1::PacketIn>* packets) {
+  const size_t header_size = bcm_sdk_interface_->GetKnetHeaderSizeForRx(unit_);
+  // The counters of accepted packets are updated once per block. The drop
+  // counters are updated as the drops happen, drops are not expected to be
+  // frequent.
+  uint64 num_rx = 0, num_accepts = 0;
+  std::string header;
+  bool read = rx_ring->ReadBlock([&](const BcmKnetRxFrame& frame) {
+    ++num_rx;
+    if (frame.size < header_size) {
+      VLOG(1) << "Num of received bytes on netif  " << netif_index
+              << " on unit " << unit_ << " < " << header_size << ".";
+      INCREMENT_RX_COUNTER(purpose, rx_errors_incomplete_read);
+      return;
+    }
+    if (frame.size != frame.original_size || frame.ifindex != netif_index ||
+        frame.pkttype == PACKET_OUTGOING) {
+      VLOG(1) << "Received invalid packet on netif  " << netif_index
+              << " on unit " << unit_ << ".";
+      INCREMENT_RX_COUNTER(purpose, rx_errors_invalid_packet);
+      return;
+    }
+    header.assign(frame.data, header_size);
+    ::p4::v1::PacketIn packet;
+    StripKnownVlanTag(frame.data + header_size, frame.size - header_size,
+                      packet.mutable_payload());
+    if (!AddPacketInMetadata(purpose, header, &packet).ok()) return;
+    ++num_accepts;
+    packets->push_back(std::move(packet));
+  });
+  if (num_rx > 0) {
+    absl::WriterMutexLock l(&rx_stats_lock_);
+    BcmKnetRxStats& stats = purpose_to_rx_stats_[purpose];
+    stats.all_rx += num_rx;
+    stats.rx_accepts += num_accepts;
+  }
+
+  return read;
+}
+
+void BcmPacketioManager::WritePacketsToRxWriter(
+    GoogleConfig::BcmKnetIntfPurpose purpose,
+    std::vector<::p4::v1::PacketIn>* packets) {
+  if (packets->empty()) return;
+  {
+    absl::ReaderMutexLock l(&rx_writer_lock_);
+    auto* writer = gtl::FindOrNull(purpose_to_rx_writer_, purpose);
+    if (writer != nullptr) {
+      for (const auto& p : *packets) {
+        (*writer)->Write(p);
+      }
+    }
+  }
+  packets->clear();
+}
+
 ::util::StatusOr<bool> BcmPacketioManager::RxPacket(
     GoogleConfig::BcmKnetIntfPurpose purpose, int sock, int netif_index,
     std::string* header, std::string* payload) {
@@ -1220,26 +1386,7 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   }
 
   // Strip some known VLAN tags.
-  struct ether_header* ether_header =
-      reinterpret_cast<struct ether_header*>(payload_buffer.get());
-  bool tagged = false;
-  if (payload_size >= sizeof(struct ether_header) + kVlanIdSize &&
-      ntohs(ether_header->ether_type) == ETHERTYPE_VLAN) {
-    auto* pid = reinterpret_cast<uint16*>(payload_buffer.get() +
-                                          sizeof(struct ether_header));
-    uint16 vlan = ntohs(*pid) & kVlanIdMask;
-    if (vlan == kDefaultVlan || vlan == kArpVlan || vlan == 0) {
-      tagged = true;
-    }
-  }
-
-  if (tagged) {
-    payload->assign(payload_buffer.get(), ETH_ALEN * 2);
-    payload->append(payload_buffer.get() + ETH_ALEN * 2 + kVlanTagSize,
-                    payload_size - ETH_ALEN * 2 - kVlanTagSize);
-  } else {
-    payload->assign(payload_buffer.get(), payload_size);
-  }
+  StripKnownVlanTag(payload_buffer.get(), payload_size, payload);
   header->assign(header_buffer.get(), header_size);
 
   return true;
@@ -1320,6 +1467,132 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   return ::util::OkStatus();
 }
 
+::util::Status BcmPacketioManager::QueueOrTxPacket(
+    GoogleConfig::BcmKnetIntfPurpose purpose, const BcmKnetIntf& intf,
+    bool direct_tx, const std::string& header, const std::string& payload) {
+  if (intf.tx_queue == nullptr) {
+    return TxPacket(purpose, intf.tx_sock, intf.vlan, intf.netif_index,
+                    direct_tx, header, payload);
+  }
+  RET_CHECK(payload.length() >= sizeof(struct ether_header));
+  ::util::Status status = intf.tx_queue->Push(header, payload);
+  if (!status.ok()) {
+    INCREMENT_TX_COUNTER(purpose, tx_drops_queue_full);
+    return status;
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmPacketioManager::HandleKnetIntfPacketTx(
+    GoogleConfig::BcmKnetIntfPurpose purpose) {
+  // Same as for the RX thread, the BcmKnetIntf is not expected to change
+  // after the config push.
+  int tx_sock = -1, netif_index = -1;
+  std::shared_ptr<BcmKnetTxQueue> tx_queue;
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    if (shutdown) return ::util::OkStatus();
+    ASSIGN_OR_RETURN(const BcmKnetIntf* intf, GetBcmKnetIntf(purpose));
+    tx_sock = intf->tx_sock;
+    netif_index = intf->netif_index;
+    tx_queue = intf->tx_queue;
+    RET_CHECK(tx_sock > 0 && tx_queue != nullptr)  // MUST NOT HAPPEN!
+        << "KNET interface with purpose "
+        << GoogleConfig::BcmKnetIntfPurpose_Name(purpose) << " on node with ID "
+        << node_id_ << " mapped to unit " << unit_
+        << " does not have a TX socket or queue.";
+  }
+
+  // All the buffers are allocated once and reused for each burst.
+  const size_t max_num_packets =
+      std::max(FLAGS_knet_max_num_packets_to_send_at_once, 1);
+  std::vector<BcmKnetTxPacket> packets;
+  std::vector<struct mmsghdr> msgs(max_num_packets);
+  std::vector<struct iovec> iovs(2 * max_num_packets);
+  // Here sa.sll_addr is left zeroed out, matching what's in rcpu_hdr.
+  struct sockaddr_ll sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sll_family = AF_PACKET;
+  sa.sll_ifindex = netif_index;
+  sa.sll_halen = ETH_ALEN;
+  while (true) {
+    {
+      absl::ReaderMutexLock l(&chassis_lock);
+      if (shutdown) break;
+    }
+    size_t num_packets = tx_queue->Pop(
+        max_num_packets, absl::Milliseconds(FLAGS_knet_tx_poll_timeout_ms),
+        &packets);
+    if (num_packets == 0) continue;
+    for (size_t i = 0; i < num_packets; ++i) {
+      struct iovec* iov = &iovs[2 * i];
+      iov[0].iov_base = const_cast<char*>(packets[i].header.data());
+      iov[0].iov_len = packets[i].header.length();
+      // Add payload without caring about (missing) VLAN tags.
+      iov[1].iov_base = const_cast<char*>(packets[i].payload.data());
+      iov[1].iov_len = packets[i].payload.length();
+      struct msghdr* msg = &msgs[i].msg_hdr;
+      memset(msg, 0, sizeof(*msg));
+      msg->msg_iov = iov;
+      msg->msg_iovlen = 2;
+      msg->msg_name = &sa;
+      msg->msg_namelen = sizeof(sa);
+      msgs[i].msg_len = 0;
+    }
+    TxPackets(purpose, tx_sock, netif_index, msgs.data(), num_packets);
+  }
+
+  LOG(INFO) << "Killed TX thread for KNET interface with purpose "
+            << GoogleConfig::BcmKnetIntfPurpose_Name(purpose)
+            << " on node with ID " << node_id_ << " mapped to unit " << unit_
+            << " (" << tx_queue->Size() << " queued packets discarded).";
+
+  return ::util::OkStatus();
+}
+
+void BcmPacketioManager::TxPackets(GoogleConfig::BcmKnetIntfPurpose purpose,
+                                   int sock, int netif_index,
+                                   struct mmsghdr* msgs, size_t num_msgs) {
+  uint64 num_send_failures = 0, num_incomplete_sends = 0;
+  size_t num_sent = 0;
+  while (num_sent < num_msgs) {
+    int res = sendmmsg(sock, msgs + num_sent, num_msgs - num_sent,
+                       MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (res < 0 && errno == EINTR) {
+      // signal received before we could transmit anything. Need to retry.
+      continue;
+    }
+    if (res <= 0) {
+      // The first message could not be sent. Drop it and go on with the rest.
+      VLOG(1) << "Error when transmitting packet to netif " << netif_index
+              << " on unit " << unit_ << ": " << errno;
+      ++num_send_failures;
+      ++num_sent;
+      continue;
+    }
+    for (size_t i = num_sent; i < num_sent + res; ++i) {
+      const struct msghdr& msg = msgs[i].msg_hdr;
+      size_t tot_len = msg.msg_iov[0].iov_len + msg.msg_iov[1].iov_len;
+      if (msgs[i].msg_len != tot_len) {
+        VLOG(1) << "Incomplete packet transmit on netif  " << netif_index
+                << " on unit " << unit_ << " (" << msgs[i].msg_len
+                << " != " << tot_len << ").";
+        ++num_incomplete_sends;
+      }
+    }
+    num_sent += res;
+  }
+
+  absl::WriterMutexLock l(&tx_stats_lock_);
+  BcmKnetTxStats& stats = purpose_to_tx_stats_[purpose];
+  stats.tx_errors_internal_send_failures += num_send_failures;
+  stats.tx_errors_incomplete_send += num_incomplete_sends;
+  stats.tx_batches++;
+  stats.tx_batched_packets += num_msgs;
+  stats.tx_max_batch_size = std::max<uint64>(stats.tx_max_batch_size, num_msgs);
+}
+
 ::util::Status BcmPacketioManager::TxPacket(
     GoogleConfig::BcmKnetIntfPurpose purpose, int sock, int vlan,
     int netif_index, bool direct_tx, const std::string& header,
@@ -1446,6 +1719,17 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   return ::util::OkStatus();
 }
 
+void* BcmPacketioManager::KnetIntfTxThreadFunc(void* arg) {
+  KnetIntfRxThreadData* data = static_cast<KnetIntfRxThreadData*>(arg);
+  ::util::Status status = data->mgr->HandleKnetIntfPacketTx(data->purpose);
+  if (!status.ok()) {
+    LOG(ERROR) << "Non-OK exit of TX thread for KNET interface with purpose "
+               << GoogleConfig::BcmKnetIntfPurpose_Name(data->purpose)
+               << " on node with ID " << data->node_id << ".";
+  }
+  return nullptr;
+}
+
 void* BcmPacketioManager::KnetIntfRxThreadFunc(void* arg) {
   KnetIntfRxThreadData* data = static_cast<KnetIntfRxThreadData*>(arg);
   ::util::Status status = data->mgr->HandleKnetIntfPacketRx(data->purpose);
@@ -8,6 +8,7 @@
 #include <net/ethernet.h>
 #include <pthread.h>
 #include <signal.h>
+#include <sys/socket.h>
 
 #include <functional>
 #include <map>
@@ -26,6 +27,8 @@
 #include "stratum/hal/lib/bcm/bcm.pb.h"
 #include "stratum/hal/lib/bcm/bcm_chassis_ro_interface.h"
 #include "stratum/hal/lib/bcm/bcm_global_vars.h"
+#include "stratum/hal/lib/bcm/bcm_knet_rx_ring.h"
+#include "stratum/hal/lib/bcm/bcm_knet_tx_queue.h"
 #include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
 #include "stratum/hal/lib/bcm/constants.h"
 #include "stratum/hal/lib/common/common.pb.h"
@@ -41,7 +44,8 @@ namespace bcm {
 class BcmPacketioManager;
 struct BcmKnetIntf;
 
-// Encapsulates the data passed to the RX thread for each KNET interface.
+// Encapsulates the data passed to the RX and TX threads for each KNET
+// interface.
 struct KnetIntfRxThreadData {
   // Node ID of the node hosting the KNET interface.
   uint64 node_id;
@@ -76,6 +80,15 @@ struct BcmKnetTxStats {
   // (Probably valid) TX packets dropped due to egress trunk being down (i.e.
   // all the ports in the trunk were down or trunk was empty).
   uint64 tx_drops_down_trunk;
+  // (Probably valid) TX packets rejected because the TX queue was full.
+  uint64 tx_drops_queue_full;
+  // Num of bursts sent by the TX thread (if the TX queue is enabled).
+  uint64 tx_batches;
+  // TX packets sent by the TX thread. tx_batched_packets / tx_batches is the
+  // average burst size.
+  uint64 tx_batched_packets;
+  // Size of the biggest burst sent by the TX thread.
+  uint64 tx_max_batch_size;
   BcmKnetTxStats()
       : all_tx(0),
         tx_accepts_ingress_pipeline(0),
@@ -85,7 +98,11 @@ struct BcmKnetTxStats {
         tx_drops_metadata_parse_error(0),
         tx_drops_unknown_port(0),
         tx_drops_down_port(0),
-        tx_drops_down_trunk(0) {}
+        tx_drops_down_trunk(0),
+        tx_drops_queue_full(0),
+        tx_batches(0),
+        tx_batched_packets(0),
+        tx_max_batch_size(0) {}
   std::string ToString() const {
     return absl::StrCat(
         "(all_tx:", all_tx,
@@ -96,7 +113,11 @@ struct BcmKnetTxStats {
         ", tx_drops_metadata_parse_error:", tx_drops_metadata_parse_error,
         ", tx_drops_unknown_port:", tx_drops_unknown_port,
         ", tx_drops_down_port:", tx_drops_down_port,
-        ", tx_drops_down_trunk:", tx_drops_down_trunk, ")");
+        ", tx_drops_down_trunk:", tx_drops_down_trunk,
+        ", tx_drops_queue_full:", tx_drops_queue_full,
+        ", tx_batches:", tx_batches,
+        ", tx_batched_packets:", tx_batched_packets,
+        ", tx_max_batch_size:", tx_max_batch_size, ")");
   }
 };
 
@@ -181,8 +202,15 @@ struct BcmKnetIntf {
   int tx_sock;
   // RX socket fd.
   int rx_sock;
+  // The RX ring mapped on the RX socket, if RX rings are enabled.
+  std::shared_ptr<BcmKnetRxRing> rx_ring;
   // The ID of the RX thread which is in charge of receiving the packets.
   pthread_t rx_thread_id;
+  // The queue of packets to transmit, if TX queues are enabled. In that case
+  // the packets are sent by a TX thread instead of the caller.
+  std::shared_ptr<BcmKnetTxQueue> tx_queue;
+  // The ID of the TX thread which is in charge of draining tx_queue.
+  pthread_t tx_thread_id;
   BcmKnetIntf()
       : cpu_queue(-1),
         mtu(0),
@@ -194,7 +222,10 @@ struct BcmKnetIntf {
         filter_ids(),
         tx_sock(-1),
         rx_sock(-1),
-        rx_thread_id() {}
+        rx_ring(),
+        rx_thread_id(),
+        tx_queue(),
+        tx_thread_id() {}
 };
 
 // Metadata we need to parse from each packet received from controller to
@@ -400,6 +431,28 @@ class BcmPacketioManager {
                                   int sock, int netif_index,
                                   std::string* header, std::string* payload);
 
+  // Helper called by HandleKnetIntfPacketRx() to read the next block of the
+  // RX ring of a KNET interface. Appends the accepted packets to 'packets'.
+  // Returns false if the kernel has not handed over the block yet.
+  bool ReadRxRingBlock(GoogleConfig::BcmKnetIntfPurpose purpose,
+                       BcmKnetRxRing* rx_ring, int netif_index,
+                       std::vector<::p4::v1::PacketIn>* packets)
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(rx_stats_lock_);
+
+  // Parses the KNET header of a received packet and adds the corresponding
+  // metadata to the given PacketIn. Returns error, after incrementing the
+  // matching drop counter, if the packet needs to be dropped.
+  ::util::Status AddPacketInMetadata(GoogleConfig::BcmKnetIntfPurpose purpose,
+                                     const std::string& header,
+                                     ::p4::v1::PacketIn* packet)
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(rx_stats_lock_);
+
+  // Sends the given packets to the RX writer registered for the given purpose
+  // (if any) and clears them.
+  void WritePacketsToRxWriter(GoogleConfig::BcmKnetIntfPurpose purpose,
+                              std::vector<::p4::v1::PacketIn>* packets)
+      LOCKS_EXCLUDED(rx_writer_lock_);
+
   // Deparses the given PacketInMetadata to the a set of
   // P4 PacketMetadata protos in the given P4 PacketIn which
   // is then sent to the controller.
@@ -409,6 +462,27 @@ class BcmPacketioManager {
   ::util::Status DeparsePacketOutMetadata(const PacketOutMetadata& meta,
                                           ::p4::v1::PacketOut* packet);
 
+  // Helper called by TransmitPacket() to either queue the packet (KNET
+  // headers + payload) for the TX thread of the KNET interface, if it has a
+  // TX queue, or send it right away.
+  ::util::Status QueueOrTxPacket(GoogleConfig::BcmKnetIntfPurpose purpose,
+                                 const BcmKnetIntf& intf, bool direct_tx,
+                                 const std::string& header,
+                                 const std::string& payload)
+      LOCKS_EXCLUDED(tx_stats_lock_);
+
+  // Called in the context of the KNET interface TX thread. Includes a loop to
+  // drain the TX queue of the given KNET interface in bursts.
+  ::util::Status HandleKnetIntfPacketTx(
+      GoogleConfig::BcmKnetIntfPurpose purpose)
+      LOCKS_EXCLUDED(chassis_lock, tx_stats_lock_);
+
+  // Helper called by HandleKnetIntfPacketTx() to send a burst of messages
+  // with as few sendmmsg() calls as possible.
+  void TxPackets(GoogleConfig::BcmKnetIntfPurpose purpose, int sock,
+                 int netif_index, struct mmsghdr* msgs, size_t num_msgs)
+      LOCKS_EXCLUDED(tx_stats_lock_);
+
   // Helper called by TransmitPacket() to send packet (KNET headers + payload).
   ::util::Status TxPacket(GoogleConfig::BcmKnetIntfPurpose purpose, int sock,
                           int vlan, int netif_index, bool direct_tx,
@@ -427,6 +501,9 @@ class BcmPacketioManager {
   // KNET interface RX thread function.
   static void* KnetIntfRxThreadFunc(void* arg);
 
+  // KNET interface TX thread function.
+  static void* KnetIntfTxThreadFunc(void* arg);
+
   // Determines the mode of operation:
   // - OPERATION_MODE_STANDALONE: when Stratum stack runs independently and
   // therefore needs to do all the SDK initialization itself.
@@ -487,7 +564,7 @@ class BcmPacketioManager {
            std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>>
       purpose_to_rx_writer_ GUARDED_BY(rx_writer_lock_);
 
-  // A vector of KnetIntfRxThreadData pointers.
+  // A vector of KnetIntfRxThreadData pointers, for both RX and TX threads.
   std::vector<KnetIntfRxThreadData*> knet_intf_rx_thread_data_;
 
   // Map from purpose of a KNET intf to its TX stats. The map entries are
@@ -10,6 +10,10 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/status_test_util.h"
@@ -26,6 +30,8 @@
 // #include "util/libcproxy/libcwrapper.h"
 // #include "util/libcproxy/passthrough_proxy.h"
 
+DECLARE_int32(knet_tx_queue_size);
+
 namespace stratum {
 namespace hal {
 namespace bcm {
@@ -86,6 +92,10 @@ class LibcProxyMock : public PassthroughLibcProxy {
   ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags) override {
     return SendMsg(sockfd, msg, flags);
   }
+  int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+               int flags) override {
+    return SendMMsg(sockfd, msgvec, vlen, flags);
+  }
   ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) override {
     return RecvMsg(sockfd, msg, flags);
   }
@@ -112,6 +122,8 @@ class LibcProxyMock : public PassthroughLibcProxy {
                          socklen_t addrlen));
   MOCK_METHOD3(SendMsg,
                ssize_t(int sockfd, const struct msghdr* msg, int flags));
+  MOCK_METHOD4(SendMMsg, int(int sockfd, struct mmsghdr* msgvec,
+                             unsigned int vlen, int flags));
   MOCK_METHOD3(RecvMsg, ssize_t(int sockfd, struct msghdr* msg, int flags));
   MOCK_METHOD1(EpollCreate1, int(int flags));
   MOCK_METHOD4(EpollCtl,
@@ -1946,6 +1958,139 @@ TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
   }
 }
 
+TEST_P(BcmPacketioManagerTest, TransmitPacketThroughTxQueue) {
+  if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+  const int saved_knet_tx_queue_size = FLAGS_knet_tx_queue_size;
+  FLAGS_knet_tx_queue_size = 1;
+
+  //--------------------------------------------------------------
+  // Config push
+  //--------------------------------------------------------------
+
+  ChassisConfig config;
+  std::map<uint32, SdkPort> port_id_to_sdk_port = {};
+  ASSERT_OK(PopulateChassisConfigAndPortMaps(kNodeId1, &config,
+                                             &port_id_to_sdk_port));
+  config.clear_vendor_config();  // default config
+
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortIdToSdkPortMap(kNodeId1))
+      .WillOnce(Return(port_id_to_sdk_port));
+  LibcProxyMock::Instance()->TrackFds({kSocket1, kEfd});
+  EXPECT_CALL(*LibcProxyMock::Instance(), Socket(_, _, _))
+      .Times(3)
+      .WillRepeatedly(Return(kSocket1));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Ioctl(kSocket1, _, _))
+      .Times(4)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1)).WillOnce(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SetSockOpt(kSocket1, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Bind(kSocket1, _, _))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*bcm_sdk_mock_, StartRx(kUnit1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetIntf(kUnit1, kDefaultVlan, _, _))
+      .WillRepeatedly(
+          DoAll(SetArgPointee<3>(kNetifId), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetFilter(kUnit1, _, kFilterTypeCatchAll))
+      .WillOnce(Return(kCatchAllFilterId1));
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollCreate1(0))
+      .WillRepeatedly(Return(kEfd));
+  EXPECT_CALL(*LibcProxyMock::Instance(),
+              EpollCtl(kEfd, EPOLL_CTL_ADD, kSocket1, _))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollWait(kEfd, _, 1, _))
+      .WillRepeatedly(Return(0));  // 0 means no packet
+
+  ASSERT_OK(PushChassisConfig(config, kNodeId1));
+
+  //--------------------------------------------------------------
+  // Packet TX
+  //--------------------------------------------------------------
+
+  // Packets without metadata are sent to the ingress pipeline. The first one
+  // is picked up by the TX thread, which blocks in sendmmsg() until released.
+  // The second one fills up the queue and the third one is rejected.
+  ::p4::v1::PacketOut packet;
+  packet.set_payload(std::string(kTestPacket, sizeof(kTestPacket)));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              GetKnetHeaderForIngressPipelineTx(kUnit1, _, _, _))
+      .Times(3)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  absl::Notification first_send_started, release_first_send, second_send_done;
+  auto send = [](struct mmsghdr* msgs, unsigned int vlen) {
+    for (unsigned int i = 0; i < vlen; ++i) {
+      const struct msghdr& msg = msgs[i].msg_hdr;
+      msgs[i].msg_len = msg.msg_iov[0].iov_len + msg.msg_iov[1].iov_len;
+    }
+    return static_cast<int>(vlen);
+  };
+  EXPECT_CALL(*LibcProxyMock::Instance(), SendMMsg(kSocket1, _, 1, _))
+      .WillOnce(WithArgs<1, 2>(Invoke([&](struct mmsghdr* msgs,
+                                          unsigned int vlen) {
+        first_send_started.Notify();
+        release_first_send.WaitForNotification();
+        return send(msgs, vlen);
+      })))
+      .WillOnce(WithArgs<1, 2>(Invoke([&](struct mmsghdr* msgs,
+                                          unsigned int vlen) {
+        int ret = send(msgs, vlen);
+        second_send_done.Notify();
+        return ret;
+      })));
+
+  ASSERT_OK(
+      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
+  ASSERT_TRUE(
+      first_send_started.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  ASSERT_OK(
+      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
+  ::util::Status status =
+      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet);
+  EXPECT_EQ(ERR_UNAVAILABLE, status.error_code());
+  release_first_send.Notify();
+  ASSERT_TRUE(
+      second_send_done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+
+  // The stats of a burst are updated right after it is sent.
+  BcmKnetTxStats stats;
+  for (int i = 0; i < 1000 && stats.tx_batches < 2; ++i) {
+    auto ret = bcm_packetio_manager_->GetTxStats(
+        GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER);
+    ASSERT_TRUE(ret.ok()) << ret.status();
+    stats = ret.ValueOrDie();
+    if (stats.tx_batches < 2) absl::SleepFor(absl::Milliseconds(10));
+  }
+  EXPECT_EQ(3U, stats.all_tx);
+  EXPECT_EQ(2U, stats.tx_accepts_ingress_pipeline);
+  EXPECT_EQ(1U, stats.tx_drops_queue_full);
+  EXPECT_EQ(0U, stats.tx_errors_internal_send_failures);
+  EXPECT_EQ(0U, stats.tx_errors_incomplete_send);
+  EXPECT_EQ(2U, stats.tx_batches);
+  EXPECT_EQ(2U, stats.tx_batched_packets);
+  EXPECT_EQ(1U, stats.tx_max_batch_size);
+
+  //--------------------------------------------------------------
+  // Shutdown
+  //--------------------------------------------------------------
+
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*bcm_sdk_mock_, StopRx(kUnit1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetFilter(kUnit1, kCatchAllFilterId1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetIntf(kUnit1, kNetifId))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kEfd))
+      .WillRepeatedly(Return(0));
+
+  ASSERT_OK(Shutdown());
+  FLAGS_knet_tx_queue_size = saved_knet_tx_queue_size;
+}
+
 INSTANTIATE_TEST_SUITE_P(BcmPacketioManagerTestWithMode, BcmPacketioManagerTest,
                          ::testing::Values(OPERATION_MODE_STANDALONE,
                                            OPERATION_MODE_COUPLED,
@@ -446,6 +446,24 @@ class BcmSdkInterface {
   virtual ::util::Status DeleteL3HostIpv6(int unit, int vrf,
                                           const std::string& ipv6) = 0;
 
+  // Starts a batch of L3 route and host writes on a given unit. Until
+  // CommitL3WriteBatch() is called, AddL3Route*() and AddL3Host*() validate
+  // their arguments and queue the write instead of committing it, so that the
+  // writes are committed to hardware in bulk. The other L3 route and host
+  // writes are still committed synchronously, after the queued writes. Returns
+  // ERR_UNIMPLEMENTED if the SDK cannot batch writes.
+  virtual ::util::Status StartL3WriteBatch(int unit) = 0;
+
+  // Sets the tag of the writes queued on a given unit from now on, e.g. the
+  // index of the update they come from in a P4 WriteRequest.
+  virtual ::util::Status SetL3WriteBatchTag(int unit, int tag) = 0;
+
+  // Commits all the writes queued on a given unit and ends the batch. The
+  // error of every queued write which failed is added to failures, keyed by
+  // the tag of the write. Returns error if the batch could not be committed.
+  virtual ::util::Status CommitL3WriteBatch(
+      int unit, std::map<int, ::util::Status>* failures) = 0;
+
   // Adds an entry to match the given (vlan, vlan_mask, dst_mac, dst_mac_mask)
   // to the my station TCAM, with the given priority. NOOP if the entry already
   // exists. All the IPv4/IPv6 packets, independent of the src port, will be
@@ -5,6 +5,7 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_SDK_MOCK_H_
 #define STRATUM_HAL_LIB_BCM_BCM_SDK_MOCK_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -121,6 +122,11 @@ class BcmSdkMock : public BcmSdkInterface {
                ::util::Status(int unit, int vrf, uint32 ipv4));
   MOCK_METHOD3(DeleteL3HostIpv6,
                ::util::Status(int unit, int vrf, const std::string& ipv6));
+  MOCK_METHOD1(StartL3WriteBatch, ::util::Status(int unit));
+  MOCK_METHOD2(SetL3WriteBatchTag, ::util::Status(int unit, int tag));
+  MOCK_METHOD2(CommitL3WriteBatch,
+               ::util::Status(int unit,
+                              std::map<int, ::util::Status>* failures));
   MOCK_METHOD6(AddMyStationEntry,
                ::util::StatusOr<int>(int unit, int priority, int vlan,
                                      int vlan_mask, uint64 dst_mac,
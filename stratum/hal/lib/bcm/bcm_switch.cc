@@ -110,6 +110,20 @@ BcmSwitch::~BcmSwitch() {}
          << "CommitForwardingPipelineConfig not implemented for this target";
 }
 
+::util::Status BcmSwitch::ReconcileAndCommitForwardingPipelineConfig(
+    uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
+  absl::ReaderMutexLock l(&chassis_lock);
+  if (shutdown) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Switch is shutdown.";
+  }
+  // TODO(unknown): Keeping the BCM flows in place requires mapping the
+  // stored entries to the new P4Info and reprogramming only the changed ones.
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "ReconcileAndCommitForwardingPipelineConfig not implemented for "
+         << "this target. Use VERIFY_AND_COMMIT and replay the forwarding "
+         << "state instead.";
+}
+
 ::util::Status BcmSwitch::VerifyForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   absl::ReaderMutexLock l(&chassis_lock);
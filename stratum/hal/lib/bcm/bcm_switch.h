@@ -41,6 +41,9 @@ class BcmSwitch : public SwitchInterface {
       LOCKS_EXCLUDED(chassis_lock);
   ::util::Status CommitForwardingPipelineConfig(uint64 node_id) override
       LOCKS_EXCLUDED(chassis_lock);
+  ::util::Status ReconcileAndCommitForwardingPipelineConfig(
+      uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) override
+      LOCKS_EXCLUDED(chassis_lock);
   ::util::Status VerifyForwardingPipelineConfig(
       uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) override
       LOCKS_EXCLUDED(chassis_lock);
@@ -2070,6 +2070,22 @@ void PopulateL3HostAction(int class_id, int egress_intf_id,
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::StartL3WriteBatch(int unit) {
+  return MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+         << "Batched L3 writes are not supported on unit " << unit << ".";
+}
+
+::util::Status BcmSdkWrapper::SetL3WriteBatchTag(int unit, int tag) {
+  return MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+         << "Batched L3 writes are not supported on unit " << unit << ".";
+}
+
+::util::Status BcmSdkWrapper::CommitL3WriteBatch(
+    int unit, std::map<int, ::util::Status>* failures) {
+  return MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+         << "Batched L3 writes are not supported on unit " << unit << ".";
+}
+
 ::util::StatusOr<int> BcmSdkWrapper::AddMyStationEntry(int unit, int priority,
                                                        int vlan, int vlan_mask,
                                                        uint64 dst_mac,
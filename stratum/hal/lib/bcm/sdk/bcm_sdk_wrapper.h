@@ -17,6 +17,7 @@
 #include <pthread.h>
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -209,6 +210,10 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status DeleteL3HostIpv4(int unit, int vrf, uint32 ipv4) override;
   ::util::Status DeleteL3HostIpv6(int unit, int vrf,
                                   const std::string& ipv6) override;
+  ::util::Status StartL3WriteBatch(int unit) override;
+  ::util::Status SetL3WriteBatchTag(int unit, int tag) override;
+  ::util::Status CommitL3WriteBatch(
+      int unit, std::map<int, ::util::Status>* failures) override;
   ::util::StatusOr<int> AddMyStationEntry(int unit, int priority, int vlan,
                                           int vlan_mask, uint64 dst_mac,
                                           uint64 dst_mac_mask) override;
@@ -18,15 +18,19 @@
 #include <algorithm>
 #include <csignal>
 #include <iomanip>
+#include <map>
+#include <memory>
 #include <sstream>  // IWYU pragma: keep
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/cleanup/cleanup.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
@@ -118,6 +122,9 @@ DEFINE_int64(port_counters_interval_in_usec, 100 * 1000,
              "Port counter interval in usecs.");
 DEFINE_int32(max_num_linkscan_writers, 10,
              "Max number of linkscan event Writers supported.");
+DEFINE_int32(l3_write_batch_size, 256,
+             "Max number of batched L3 writes committed to the SDK in a "
+             "single transaction.");
 DECLARE_string(bcm_sdk_checkpoint_dir);
 
 // TODO: There are many RET_CHECK in this file which will
@@ -665,31 +672,22 @@ const typename Collection::key_type* FindIndexOrNull(
 }
 
 // TODO(max): errmsg should not be an argument.
-// TODO: Replace InUseMap with an array or vector, but not std::vector<bool>!
-::util::StatusOr<int> GetFreeSlot(std::map<int, bool>* map,
-                                  std::string ErrMsg) {
-  for (auto& slot : *map) {
-    if (!slot.second) {
-      return slot.first;
-    }
-  }
-  return MAKE_ERROR(ERR_INTERNAL) << ErrMsg;
+::util::StatusOr<int> GetFreeSlot(BcmIdAllocator* ids, std::string ErrMsg) {
+  auto ret = ids->FindFree();
+  if (!ret.ok()) return MAKE_ERROR(ERR_INTERNAL) << ErrMsg;
+  return ret;
 }
 
-void ConsumeSlot(std::map<int, bool>* map, int index) {
-  auto& slot_in_use = gtl::FindOrDie(*map, index);
-  CHECK(!slot_in_use);
-  slot_in_use = true;
+void ConsumeSlot(BcmIdAllocator* ids, int index) {
+  CHECK_OK(ids->Allocate(index));
 }
 
-void ReleaseSlot(std::map<int, bool>* map, int index) {
-  auto& slot_in_use = gtl::FindOrDie(*map, index);
-  CHECK(slot_in_use);
-  slot_in_use = false;
+void ReleaseSlot(BcmIdAllocator* ids, int index) {
+  CHECK_OK(ids->Release(index));
 }
 
-bool SlotExists(std::map<int, bool>* map, int index) {
-  return gtl::ContainsKey(*map, index);
+bool SlotExists(BcmIdAllocator* ids, int index) {
+  return ids->Contains(index);
 }
 
 int bcmlt_custom_entry_commit(bcmlt_entry_handle_t entry_hdl, bcmlt_opcode_t op,
@@ -728,6 +726,209 @@ int bcmlt_custom_entry_commit(bcmlt_entry_handle_t entry_hdl, bcmlt_opcode_t op,
 
 }  // namespace
 
+// A transaction of an L3WriteBatch committed asynchronously, and the state the
+// SDK completion callback reports for it.
+struct L3WriteTransaction {
+  L3WriteTransaction(L3WriteBatch* batch, bcmlt_transaction_hdl_t trans_hdl,
+                     std::vector<int> tags)
+      : batch(batch),
+        trans_hdl(trans_hdl),
+        tags(std::move(tags)),
+        done(false),
+        status(SHR_E_NONE) {}
+
+  // The batch the transaction belongs to.
+  L3WriteBatch* const batch;
+  // The committed transaction.
+  const bcmlt_transaction_hdl_t trans_hdl;
+  // The tags of the writes of the transaction, in order.
+  const std::vector<int> tags;
+  // Whether the SDK is done with the transaction. Protected by batch->lock.
+  bool done;
+  // The SDK status of the transaction as a whole, which is not SHR_E_NONE if
+  // the SDK aborted it. Protected by batch->lock.
+  int status;
+};
+
+// The L3 writes queued on a unit between StartL3WriteBatch() and
+// CommitL3WriteBatch(). The writes are added to a batch transaction, which is
+// committed asynchronously once it holds FLAGS_l3_write_batch_size writes, so
+// that the SDK programs the hardware while the next writes are prepared. Only
+// the thread writing to the unit accesses the batch, apart from the SDK
+// completion callback which only touches the members protected by lock.
+struct L3WriteBatch {
+  explicit L3WriteBatch(int unit)
+      : unit(unit),
+        trans_hdl(),
+        tags(),
+        tag(0),
+        committed(),
+        ipv4_routes(),
+        failures(),
+        lock(),
+        completed(),
+        num_completed(0) {}
+  ~L3WriteBatch();
+
+  // The unit the writes are done on.
+  const int unit;
+  // The transaction the writes are added to. Only valid if tags is not empty.
+  bcmlt_transaction_hdl_t trans_hdl;
+  // The tags of the writes added to trans_hdl, in order.
+  std::vector<int> tags;
+  // The tag of the writes queued from now on.
+  int tag;
+  // The transactions committed asynchronously and not collected yet.
+  std::vector<std::unique_ptr<L3WriteTransaction>> committed;
+  // The IPv4 LPM routes inserted in the batch, keyed by tag. Used to report
+  // their SHR_E_EXISTS errors as AddL3RouteIpv4() does without a batch.
+  std::map<int, l3_route_t> ipv4_routes;
+  // The errors of the failed writes collected so far, keyed by tag.
+  std::map<int, ::util::Status> failures;
+  // Protects num_completed and the completion state of the transactions.
+  absl::Mutex lock;
+  // Signaled when a committed transaction completes.
+  absl::CondVar completed;
+  // Number of transactions in committed which completed.
+  size_t num_completed GUARDED_BY(lock);
+};
+
+namespace {
+
+// Records the error of a failed batched write, unless an earlier write with
+// the same tag failed already. The errors are mapped as for unbatched writes.
+void AddL3WriteFailure(int tag, int rv, L3WriteBatch* batch) {
+  if (batch->failures.count(tag)) return;
+  const l3_route_t* route = gtl::FindOrNull(batch->ipv4_routes, tag);
+  if (rv == SHR_E_EXISTS && route != nullptr) {
+    batch->failures[tag] = MAKE_ERROR(ERR_ENTRY_EXISTS).without_logging()
+                           << "IPv4 L3 LPM route " << PrintL3Route(*route)
+                           << " already exists on unit " << batch->unit
+                           << ".";
+    return;
+  }
+  batch->failures[tag] = MAKE_ERROR(BooleanBcmStatus(rv).error_code())
+                             .without_logging()
+                         << "Batched L3 write failed with error message: "
+                         << FixMessage(bcm_errmsg(rv));
+}
+
+// Called by the SDK with the progress of a transaction committed by
+// CommitL3WriteBatchTransaction(). Only the last notification of the
+// transaction completes it: either the hardware is done with it, or the SDK
+// aborted it, in which case there is no hardware notification.
+void L3WriteBatchTransactionDone(bcmlt_notif_option_t event,
+                                 bcmlt_transaction_info_t* trans_info,
+                                 void* user_data) {
+  L3WriteTransaction* transaction =
+      static_cast<L3WriteTransaction*>(user_data);
+  const int rv = trans_info != nullptr ? trans_info->status : SHR_E_NONE;
+  if (event != BCMLT_NOTIF_OPTION_HW && rv == SHR_E_NONE) return;
+  L3WriteBatch* batch = transaction->batch;
+  absl::MutexLock l(&batch->lock);
+  if (transaction->done) return;
+  transaction->done = true;
+  transaction->status = rv;
+  ++batch->num_completed;
+  batch->completed.Signal();
+}
+
+// Asynchronously commits the current transaction of the batch, if any.
+void CommitL3WriteBatchTransaction(L3WriteBatch* batch) {
+  if (batch->tags.empty()) return;
+  auto transaction = absl::make_unique<L3WriteTransaction>(
+      batch, batch->trans_hdl, std::move(batch->tags));
+  batch->tags.clear();
+  int rv = bcmlt_transaction_commit_async(
+      transaction->trans_hdl, BCMLT_NOTIF_OPTION_HW, transaction.get(),
+      &L3WriteBatchTransactionDone, BCMLT_PRIORITY_NORMAL);
+  if (rv == SHR_E_NONE) {
+    batch->committed.push_back(std::move(transaction));
+  } else {
+    // Nothing was committed.
+    for (int tag : transaction->tags) AddL3WriteFailure(tag, rv, batch);
+    bcmlt_transaction_free(transaction->trans_hdl);
+  }
+}
+
+// Commits the queued writes of the batch and waits for all of them to be done
+// with the hardware. The errors of the failed writes are added to the batch
+// failures. NOOP if batch is nullptr.
+void FlushL3WriteBatch(L3WriteBatch* batch) {
+  if (batch == nullptr) return;
+  CommitL3WriteBatchTransaction(batch);
+  {
+    absl::MutexLock l(&batch->lock);
+    while (batch->num_completed < batch->committed.size()) {
+      batch->completed.Wait(&batch->lock);
+    }
+    batch->num_completed = 0;
+  }
+  for (const auto& transaction : batch->committed) {
+    int trans_rv;
+    {
+      absl::MutexLock l(&batch->lock);
+      trans_rv = transaction->status;
+    }
+    for (size_t i = 0; i < transaction->tags.size(); ++i) {
+      bcmlt_entry_info_t entry_info;
+      int rv = bcmlt_transaction_entry_num_get(transaction->trans_hdl, i,
+                                               &entry_info);
+      if (rv == SHR_E_NONE) rv = entry_info.status;
+      // The writes of an aborted transaction fail, even those the SDK did not
+      // report an error for.
+      if (rv == SHR_E_NONE) rv = trans_rv;
+      if (rv != SHR_E_NONE) {
+        AddL3WriteFailure(transaction->tags[i], rv, batch);
+      }
+    }
+    // Frees the entries of the transaction as well.
+    bcmlt_transaction_free(transaction->trans_hdl);
+  }
+  batch->committed.clear();
+}
+
+// Commits the given L3 entry with the given opcode, or queues it in the batch
+// if batch is not nullptr. The entry is freed (or owned by the batch) after
+// the call. Returns the SDK error code of the commit, which is always
+// SHR_E_NONE for a queued entry.
+int CommitOrQueueL3Entry(L3WriteBatch* batch, bcmlt_entry_handle_t entry_hdl,
+                         bcmlt_opcode_t opcode) {
+  int rv;
+  if (batch == nullptr) {
+    rv = bcmlt_custom_entry_commit(entry_hdl, opcode, BCMLT_PRIORITY_NORMAL);
+    int free_rv = bcmlt_entry_free(entry_hdl);
+    return rv != SHR_E_NONE ? rv : free_rv;
+  }
+  if (batch->tags.empty()) {
+    rv = bcmlt_transaction_allocate(BCMLT_TRANS_TYPE_BATCH, &batch->trans_hdl);
+    if (rv != SHR_E_NONE) {
+      bcmlt_entry_free(entry_hdl);
+      return rv;
+    }
+  }
+  rv = bcmlt_transaction_entry_add(batch->trans_hdl, opcode, entry_hdl);
+  if (rv != SHR_E_NONE) {
+    bcmlt_entry_free(entry_hdl);
+    if (batch->tags.empty()) bcmlt_transaction_free(batch->trans_hdl);
+    return rv;
+  }
+  batch->tags.push_back(batch->tag);
+  if (batch->tags.size() >= static_cast<size_t>(FLAGS_l3_write_batch_size)) {
+    CommitL3WriteBatchTransaction(batch);
+  }
+
+  return SHR_E_NONE;
+}
+
+}  // namespace
+
+L3WriteBatch::~L3WriteBatch() {
+  // Wait for the SDK to be done with the pending transactions, which refer to
+  // this batch.
+  FlushL3WriteBatch(this);
+}
+
 BcmSdkWrapper* BcmSdkWrapper::singleton_ = nullptr;
 ABSL_CONST_INIT absl::Mutex BcmSdkWrapper::init_lock_(absl::kConstInit);
 
@@ -768,6 +969,7 @@ BcmSdkWrapper::BcmSdkWrapper(BcmDiagShell* bcm_diag_shell)
       fp_acl_ids_(),
       unit_to_udf_chunk_ids_(),
       unit_to_chunk_ids_(),
+      unit_to_l3_write_batch_(),
       bcm_diag_shell_(bcm_diag_shell),
       linkscan_event_writers_() {
   // TODO(BRCM): check if any initialization is needed.
@@ -1156,19 +1358,12 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   unit_to_l3_intf_max_limit_[unit] = table_max;
   l3_interface_ids_[unit] = {};
 
-  InUseMap l3_egress_intf;
   RETURN_IF_ERROR(GetTableLimits(unit, L3_UC_NHOPs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    l3_egress_intf.emplace(i, false);
-  }
-  l3_egress_interface_ids_[unit] = l3_egress_intf;
+  l3_egress_interface_ids_[unit] = BcmIdAllocator(table_min, table_max);
 
-  InUseMap l3_ecmp_egress_intf;
   RETURN_IF_ERROR(GetTableLimits(unit, ECMPs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    l3_ecmp_egress_intf.emplace(i + 1, false);
-  }
-  l3_ecmp_egress_interface_ids_[unit] = l3_ecmp_egress_intf;
+  l3_ecmp_egress_interface_ids_[unit] =
+      BcmIdAllocator(table_min + 1, table_max + 1);
 
   fp_group_ids_[unit] = new AclGroupIds();
   int max_fp_groups = 0;
@@ -1176,31 +1371,19 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   // IFP - group
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_ING_GRP_TEMPLATEs, &table_min, &table_max));
-  InUseMap ifp_groups;
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_groups.emplace(i, false);
-  }
-  ifp_group_ids_[unit] = ifp_groups;
+  ifp_group_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_groups += table_max;
 
   // VFP - group
-  InUseMap vfp_groups;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_VLAN_GRP_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_groups.emplace(i, false);
-  }
-  vfp_group_ids_[unit] = vfp_groups;
+  vfp_group_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_groups += table_max;
 
   // EFP - group
-  InUseMap efp_groups;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_EGR_GRP_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_groups.emplace(i, false);
-  }
-  efp_group_ids_[unit] = efp_groups;
+  efp_group_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_groups += table_max;
 
   unit_to_fp_groups_max_limit_[unit] = max_fp_groups;
@@ -1208,33 +1391,21 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   fp_rule_ids_[unit] = new AclRuleIds();
   int max_fp_rules = 0;
   // IFP - rules
-  InUseMap ifp_rules;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_ING_RULE_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_rules.emplace(i, false);
-  }
-  ifp_rule_ids_[unit] = ifp_rules;
+  ifp_rule_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_rules += table_max;
 
   // VFP - rules
-  InUseMap vfp_rules;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_VLAN_RULE_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_rules.emplace(i, false);
-  }
-  vfp_rule_ids_[unit] = vfp_rules;
+  vfp_rule_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_rules += table_max;
 
   // EFP - rules
-  InUseMap efp_rules;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_EGR_RULE_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_rules.emplace(i, false);
-  }
-  efp_rule_ids_[unit] = efp_rules;
+  efp_rule_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_rules += table_max;
 
   unit_to_fp_rules_max_limit_[unit] = max_fp_rules;
@@ -1242,33 +1413,21 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   fp_policy_ids_[unit] = new AclPolicyIds();
   int max_fp_policies = 0;
   // IFP - policies
-  InUseMap ifp_policies;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_ING_POLICY_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_policies.emplace(i, false);
-  }
-  ifp_policy_ids_[unit] = ifp_policies;
+  ifp_policy_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_policies += table_max;
 
   // VFP - policies
-  InUseMap vfp_policies;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_VLAN_POLICY_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_policies.emplace(i, false);
-  }
-  vfp_policy_ids_[unit] = vfp_policies;
+  vfp_policy_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_policies += table_max;
 
   // EFP - policies
-  InUseMap efp_policies;
   RETURN_IF_ERROR(
       GetTableLimits(unit, FP_EGR_POLICY_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_policies.emplace(i, false);
-  }
-  efp_policy_ids_[unit] = efp_policies;
+  efp_policy_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_policies += table_max;
 
   unit_to_fp_policy_max_limit_[unit] = max_fp_policies;
@@ -1276,23 +1435,15 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   fp_meter_ids_[unit] = new AclMeterIds();
   int max_fp_meters = 0;
   // IFP - Meters
-  InUseMap ifp_meters;
   RETURN_IF_ERROR(
       GetTableLimits(unit, METER_FP_ING_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_meters.emplace(i, false);
-  }
-  ifp_meter_ids_[unit] = ifp_meters;
+  ifp_meter_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_meters += table_max;
 
   // EFP - Meters
-  InUseMap efp_meters;
   RETURN_IF_ERROR(
       GetTableLimits(unit, METER_FP_EGR_TEMPLATEs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_meters.emplace(i, false);
-  }
-  efp_meter_ids_[unit] = efp_meters;
+  efp_meter_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_meters += table_max;
 
   unit_to_fp_meter_max_limit_[unit] = max_fp_meters;
@@ -1301,40 +1452,24 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   fp_acl_ids_[unit] = new AclIds();
   int max_fp_acls = 0;
   // IFP Acls
-  InUseMap ifp_acls;
   RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_ENTRYs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_acls.emplace(i, false);
-  }
-  ifp_acl_ids_[unit] = ifp_acls;
+  ifp_acl_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_acls += table_max;
 
   // VFP Acls
-  InUseMap vfp_acls;
   RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_ENTRYs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_acls.emplace(i, false);
-  }
-  vfp_acl_ids_[unit] = vfp_acls;
+  vfp_acl_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_acls += table_max;
 
   // EFP Acls
-  InUseMap efp_acls;
   RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_ENTRYs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_acls.emplace(i, false);
-  }
-  efp_acl_ids_[unit] = efp_acls;
+  efp_acl_ids_[unit] = BcmIdAllocator(table_min, table_max);
   max_fp_acls += table_max;
 
   unit_to_fp_max_limit_[unit] = max_fp_acls;
 
   // UDF Chunks
-  InUseMap udf_chunks;
-  for (auto i = 0; i <= kUdfMaxChunks; i++) {
-    udf_chunks.emplace(i, false);
-  }
-  unit_to_udf_chunk_ids_[unit] = udf_chunks;
+  unit_to_udf_chunk_ids_[unit] = BcmIdAllocator(0, kUdfMaxChunks);
   unit_to_chunk_ids_[unit] = new ChunkIds();
 
   // Disable port level MAC address learning
@@ -2367,7 +2502,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   int egress_intf_id = 0;
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
-  InUseMap* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_intfs != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // get next free slot
@@ -2411,7 +2546,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << static_cast<int>(min) << " - " << static_cast<int>(max) << ".";
   }
 
-  InUseMap* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   auto unit_to_l3_intf = gtl::FindOrNull(l3_interface_ids_, unit);
   RET_CHECK(l3_intfs != nullptr && unit_to_l3_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
@@ -2485,7 +2620,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << "Invalid trunk (" << trunk << "), valid trunk range is "
            << static_cast<int>(min) << " - " << static_cast<int>(max) << ".";
   }
-  InUseMap* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   auto unit_to_l3_intf = gtl::FindOrNull(l3_interface_ids_, unit);
   RET_CHECK(l3_intfs != nullptr && unit_to_l3_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
@@ -2527,7 +2662,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   int egress_intf_id = 0;
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
-  InUseMap* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_intfs = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_intfs != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // get next free slot
@@ -2555,7 +2690,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
                                                     int egress_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
   bcmlt_entry_info_t entry_info;
-  InUseMap::iterator it;
   uint64_t l3_eif_id;
   uint64_t mac_da;
   uint64_t vlan_id;
@@ -2566,13 +2700,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
 
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -2626,7 +2760,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
                                                      int port, int vlan,
                                                      int router_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
-  InUseMap::iterator it;
   bool found;
   uint64_t max;
   uint64_t min;
@@ -2642,15 +2775,15 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << static_cast<int>(min) << " - " << static_cast<int>(max) << ".";
   }
   auto unit_to_l3_intf = gtl::FindOrNull(l3_interface_ids_, unit);
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr && unit_to_l3_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if port is valid
   RETURN_IF_BCM_ERROR(CheckIfPortExists(unit, port));
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -2697,7 +2830,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
                                                       int trunk, int vlan,
                                                       int router_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
-  InUseMap::iterator it;
   bool found;
   uint64_t max;
   uint64_t min;
@@ -2719,14 +2851,14 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << "Invalid trunk (" << trunk << "), valid trunk range is "
            << static_cast<int>(min) << " - " << static_cast<int>(max) << ".";
   }
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   auto unit_to_l3_intf = gtl::FindOrNull(l3_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr && unit_to_l3_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -2772,7 +2904,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
 ::util::Status BcmSdkWrapper::ModifyL3DropIntf(int unit, int egress_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
   bcmlt_entry_info_t entry_info;
-  InUseMap::iterator it;
   uint64_t l3_eif_id;
   uint64_t mac_da;
   uint64_t vlan_id;
@@ -2782,13 +2913,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
 
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -2839,16 +2970,15 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
 
 ::util::Status BcmSdkWrapper::DeleteL3EgressIntf(int unit, int egress_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
-  InUseMap::iterator it;
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -2872,7 +3002,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
     int unit, int egress_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
   bcmlt_entry_info_t entry_info;
-  InUseMap::iterator it;
   uint64_t l3_eif_id;
   uint64_t mac_da;
   uint64_t copy_to_cpu;
@@ -2880,13 +3009,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
 
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -2931,7 +3060,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   }
   int members_count = static_cast<int>(member_ids.size());
 
-  InUseMap* ecmp_intfs = gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
+  BcmIdAllocator* ecmp_intfs =
+      gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
   RET_CHECK(ecmp_intfs != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // get next free slot
@@ -2960,7 +3090,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
 ::util::Status BcmSdkWrapper::ModifyEcmpEgressIntf(
     int unit, int egress_intf_id, const std::vector<int>& member_ids) {
   bcmlt_entry_handle_t entry_hdl;
-  InUseMap::iterator it;
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
 
@@ -2970,13 +3099,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   }
   int members_count = static_cast<int>(member_ids.size());
 
-  InUseMap* ecmp_intfs = gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
+  BcmIdAllocator* ecmp_intfs =
+      gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
   RET_CHECK(ecmp_intfs != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = ecmp_intfs->find(egress_intf_id);
-  if (it != ecmp_intfs->end()) {
-    if (!it->second) {
+  if (ecmp_intfs->Contains(egress_intf_id)) {
+    if (!ecmp_intfs->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL) << "ECMP egress interface "
                                       << egress_intf_id << " is not created.";
     }
@@ -3006,16 +3135,15 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
 ::util::Status BcmSdkWrapper::DeleteEcmpEgressIntf(int unit,
                                                    int egress_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
-  InUseMap::iterator it;
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
-  InUseMap* ecmp_intfs = gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
+  BcmIdAllocator* ecmp_intfs =
+      gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
   RET_CHECK(ecmp_intfs != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = ecmp_intfs->find(egress_intf_id);
-  if (it != ecmp_intfs->end()) {
-    if (!it->second) {
+  if (ecmp_intfs->Contains(egress_intf_id)) {
+    if (!ecmp_intfs->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INTERNAL) << "ECMP egress interface "
                                       << egress_intf_id << " is not created.";
     }
@@ -3044,7 +3172,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   uint64_t max;
   uint64_t min;
   int rv;
-  InUseMap::iterator it;
   l3_route_t route = {false,  vrf,  class_id, egress_intf_id,
                       subnet, mask, "",       ""};
   RET_CHECK(egress_intf_id > 0);
@@ -3068,13 +3195,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
              << static_cast<int>(max) << ".";
     }
   }
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -3100,14 +3227,15 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
     RETURN_IF_BCM_ERROR(
         bcmlt_entry_field_add(entry_hdl, NHOP_IDs, egress_intf_id));
   }
-  rv = bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
-                                 BCMLT_PRIORITY_NORMAL);
-  RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
+  L3WriteBatch* batch = FindL3WriteBatch(unit);
+  if (batch != nullptr) batch->ipv4_routes[batch->tag] = route;
+  rv = CommitOrQueueL3Entry(batch, entry_hdl, BCMLT_OPCODE_INSERT);
   if (rv == SHR_E_EXISTS) {
     return MAKE_ERROR(ERR_ENTRY_EXISTS)
            << "IPv4 L3 LPM route " << PrintL3Route(route)
            << " already exists on unit " << unit << ".";
   }
+  RETURN_IF_BCM_ERROR(rv);
   VLOG(1) << "Added IPv4 L3 LPM route " << PrintL3Route(route) << " on unit "
           << unit << ".";
   return ::util::OkStatus();
@@ -3121,7 +3249,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   bcmlt_entry_handle_t entry_hdl;
   uint64_t max;
   uint64_t min;
-  InUseMap::iterator it;
   l3_route_t route = {true, vrf, class_id, egress_intf_id, 0, 0, "", ""};
 
   RET_CHECK(egress_intf_id > 0);
@@ -3151,13 +3278,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
              << static_cast<int>(max) << ".";
     }
   }
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -3192,9 +3319,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
     RETURN_IF_BCM_ERROR(
         bcmlt_entry_field_add(entry_hdl, NHOP_IDs, egress_intf_id));
   }
-  RETURN_IF_BCM_ERROR(bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
-                                                BCMLT_PRIORITY_NORMAL));
-  RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
+  RETURN_IF_BCM_ERROR(CommitOrQueueL3Entry(FindL3WriteBatch(unit), entry_hdl,
+                                           BCMLT_OPCODE_INSERT));
 
   VLOG(1) << "Added IPv6 L3 LPM route " << PrintL3Route(route) << " on unit "
           << unit << ".";
@@ -3239,9 +3365,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, ECMP_NHOPs, 0));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_field_add(entry_hdl, NHOP_IDs, egress_intf_id));
-  RETURN_IF_BCM_ERROR(bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
-                                                BCMLT_PRIORITY_NORMAL));
-  RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
+  RETURN_IF_BCM_ERROR(CommitOrQueueL3Entry(FindL3WriteBatch(unit), entry_hdl,
+                                           BCMLT_OPCODE_INSERT));
 
   VLOG(1) << "Added IPv4 L3 host route " << PrintL3Host(host) << " on unit "
           << unit << ".";
@@ -3295,9 +3420,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, ECMP_NHOPs, 0));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_field_add(entry_hdl, NHOP_IDs, egress_intf_id));
-  RETURN_IF_BCM_ERROR(bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
-                                                BCMLT_PRIORITY_NORMAL));
-  RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
+  RETURN_IF_BCM_ERROR(CommitOrQueueL3Entry(FindL3WriteBatch(unit), entry_hdl,
+                                           BCMLT_OPCODE_INSERT));
 
   VLOG(1) << "Added IPv6 L3 host route " << PrintL3Host(host) << " on unit "
           << unit << ".";
@@ -3315,7 +3439,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   uint64_t max;
   uint64_t min;
   bool entry_updated = false;
-  InUseMap::iterator it;
   l3_route_t route = {false,  vrf,  class_id, egress_intf_id,
                       subnet, mask, "",       ""};
   RET_CHECK(egress_intf_id > 0);
@@ -3339,13 +3462,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
              << static_cast<int>(max) << ".";
     }
   }
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -3353,6 +3476,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
     return MAKE_ERROR(ERR_INVALID_PARAM)
            << "Invalid L3 Egress interface " << egress_intf_id << ".";
   }
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_allocate(unit, L3_IPV4_UC_ROUTE_VRFs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
@@ -3404,7 +3529,6 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   uint64_t max;
   uint64_t min;
   bool entry_updated = false;
-  InUseMap::iterator it;
   // TODO(BRCM): fix ipv6, convert string to ipv6 address
   l3_route_t route = {true, vrf, class_id, egress_intf_id, 0, 0, subnet, mask};
   RET_CHECK(egress_intf_id > 0);
@@ -3435,13 +3559,13 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
              << static_cast<int>(max) << ".";
     }
   }
-  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  BcmIdAllocator* l3_egress_intf =
+      gtl::FindOrNull(l3_egress_interface_ids_, unit);
   RET_CHECK(l3_egress_intf != nullptr)
       << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
   // Check if egress interface is valid
-  it = l3_egress_intf->find(egress_intf_id);
-  if (it != l3_egress_intf->end()) {
-    if (!it->second) {
+  if (l3_egress_intf->Contains(egress_intf_id)) {
+    if (!l3_egress_intf->IsAllocated(egress_intf_id)) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "L3 Egress interface " << egress_intf_id << " is not created.";
     }
@@ -3451,6 +3575,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   }
 
   // TODO(BRCM): fix ipv6, convert string to upper and lower ipv6 addres
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_allocate(unit, L3_IPV6_UC_ROUTE_VRFs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
@@ -3522,6 +3648,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << "), valid next hop id range is " << static_cast<int>(min) << " - "
            << static_cast<int>(max) << ".";
   }
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(bcmlt_entry_allocate(unit, L3_IPV4_UC_HOSTs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, IPV4s, ipv4));
@@ -3590,6 +3718,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   }
 
   // TODO(BRCM): fix ipv6, convert string to upper and lower ipv6 address
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(bcmlt_entry_allocate(unit, L3_IPV6_UC_HOSTs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
   RETURN_IF_BCM_ERROR(
@@ -3642,6 +3772,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << "Invalid vrf (" << vrf << "), valid vrf range is "
            << static_cast<int>(min) << " - " << static_cast<int>(max) << ".";
   }
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_allocate(unit, L3_IPV4_UC_ROUTE_VRFs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
@@ -3707,6 +3839,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
 
   // TODO(BRCM): fix ipv6, convert string to upper and lower ipv6 addres
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_allocate(unit, L3_IPV6_UC_ROUTE_VRFs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
@@ -3768,6 +3902,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
 
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(bcmlt_entry_allocate(unit, L3_IPV4_UC_HOSTs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, IPV4s, ipv4));
@@ -3827,6 +3963,8 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   // Check if the unit is valid
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
 
+  // The lookup below needs to see the queued writes, commit them first.
+  FlushL3WriteBatch(FindL3WriteBatch(unit));
   RETURN_IF_BCM_ERROR(bcmlt_entry_allocate(unit, L3_IPV6_UC_HOSTs, &entry_hdl));
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, vrf));
   RETURN_IF_BCM_ERROR(
@@ -3864,6 +4002,53 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::StartL3WriteBatch(int unit) {
+  RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
+  absl::WriterMutexLock l(&data_lock_);
+  if (unit_to_l3_write_batch_.count(unit)) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "A batch of L3 writes is already started on unit " << unit
+           << ".";
+  }
+  unit_to_l3_write_batch_[unit] = absl::make_unique<L3WriteBatch>(unit);
+  VLOG(1) << "Started a batch of L3 writes on unit " << unit << ".";
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkWrapper::SetL3WriteBatchTag(int unit, int tag) {
+  L3WriteBatch* batch = FindL3WriteBatch(unit);
+  if (batch == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "No batch of L3 writes is started on unit " << unit << ".";
+  }
+  batch->tag = tag;
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmSdkWrapper::CommitL3WriteBatch(
+    int unit, std::map<int, ::util::Status>* failures) {
+  RET_CHECK(failures != nullptr) << "Failures pointer must be non-null.";
+  std::unique_ptr<L3WriteBatch> batch;
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    auto it = unit_to_l3_write_batch_.find(unit);
+    if (it == unit_to_l3_write_batch_.end()) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "No batch of L3 writes is started on unit " << unit << ".";
+    }
+    batch = std::move(it->second);
+    unit_to_l3_write_batch_.erase(it);
+  }
+  FlushL3WriteBatch(batch.get());
+  failures->insert(batch->failures.begin(), batch->failures.end());
+  VLOG(1) << "Committed a batch of L3 writes on unit " << unit << " with "
+          << batch->failures.size() << " failed write(s).";
+
+  return ::util::OkStatus();
+}
+
 ::util::StatusOr<int> BcmSdkWrapper::AddMyStationEntry(int unit, int priority,
                                                        int vlan, int vlan_mask,
                                                        uint64 dst_mac,
@@ -6153,7 +6338,7 @@ std::string HalAclFieldToBcm(BcmAclStage stage, BcmField::Type field) {
                                                     const BcmAclTable& table) {
   int stage_id;
   int table_id;
-  InUseMap* group_ids;
+  BcmIdAllocator* group_ids;
 
   // check if unit exist
   RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
@@ -6195,7 +6380,7 @@ std::string HalAclFieldToBcm(BcmAclStage stage, BcmField::Type field) {
 ::util::Status BcmSdkWrapper::DestroyAclTable(int unit, int table_id) {
   bool found;
   int rv;
-  std::map<int, bool>* group_ids;
+  BcmIdAllocator* group_ids;
   std::pair<BcmAclStage, int> entry;
   bcmlt_entry_handle_t entry_hdl;
   bool entry_deleted = false;
@@ -7138,10 +7323,10 @@ namespace {
   int policy_table_id = 0;
   int meter_table_id = 0;
   int acl_table_id = 0;
-  InUseMap* rule_ids;
-  InUseMap* policy_ids;
-  InUseMap* meter_ids;
-  InUseMap* acl_ids;
+  BcmIdAllocator* rule_ids;
+  BcmIdAllocator* policy_ids;
+  BcmIdAllocator* meter_ids;
+  BcmIdAllocator* acl_ids;
   bool found;
 
   // check if unit is valid
@@ -7555,9 +7740,9 @@ namespace {
   int meter_id = 0;
   int meter_table_id = 0;
   auto* fp_meters = gtl::FindPtrOrNull(fp_meter_ids_, unit);
-  std::map<int, bool>* ifp_meter_ids = gtl::FindOrNull(ifp_meter_ids_, unit);
+  BcmIdAllocator* ifp_meter_ids = gtl::FindOrNull(ifp_meter_ids_, unit);
   ;
-  std::map<int, bool>* efp_meter_ids = gtl::FindOrNull(efp_meter_ids_, unit);
+  BcmIdAllocator* efp_meter_ids = gtl::FindOrNull(efp_meter_ids_, unit);
   ;
 
   // Add policer if meter config is specified.
@@ -7690,10 +7875,10 @@ namespace {
   int rule_id;
   int policy_id;
   int meter_id;
-  std::map<int, bool>* rule_ids = nullptr;
-  std::map<int, bool>* policy_ids = nullptr;
-  std::map<int, bool>* meter_ids = nullptr;
-  std::map<int, bool>* entry_ids = nullptr;
+  BcmIdAllocator* rule_ids = nullptr;
+  BcmIdAllocator* policy_ids = nullptr;
+  BcmIdAllocator* meter_ids = nullptr;
+  BcmIdAllocator* entry_ids = nullptr;
   auto* fp_rules = gtl::FindPtrOrNull(fp_rule_ids_, unit);
   auto* fp_policies = gtl::FindPtrOrNull(fp_policy_ids_, unit);
   auto* fp_meters = gtl::FindPtrOrNull(fp_meter_ids_, unit);
@@ -7789,9 +7974,9 @@ namespace {
   int policy_id = 0;
   int meter_id = 0;
   auto* fp_meters = gtl::FindPtrOrNull(fp_meter_ids_, unit);
-  std::map<int, bool>* ifp_meter_ids = gtl::FindOrNull(ifp_meter_ids_, unit);
+  BcmIdAllocator* ifp_meter_ids = gtl::FindOrNull(ifp_meter_ids_, unit);
   ;
-  std::map<int, bool>* efp_meter_ids = gtl::FindOrNull(efp_meter_ids_, unit);
+  BcmIdAllocator* efp_meter_ids = gtl::FindOrNull(efp_meter_ids_, unit);
   ;
   int maxMeters = unit_to_fp_meter_max_limit_[unit];
   int meter_table_id = 0;
@@ -8285,6 +8470,12 @@ int BcmSdkWrapper::CheckIfPortExists(int unit, int port) {
   }
 }
 
+L3WriteBatch* BcmSdkWrapper::FindL3WriteBatch(int unit) {
+  absl::ReaderMutexLock l(&data_lock_);
+  auto it = unit_to_l3_write_batch_.find(unit);
+  return it == unit_to_l3_write_batch_.end() ? nullptr : it->second.get();
+}
+
 int BcmSdkWrapper::CheckIfUnitExists(int unit) {
   if (!bcmdrd_dev_exists(unit)) {
     LOG(ERROR) << "Unit " << unit << " is not found.";
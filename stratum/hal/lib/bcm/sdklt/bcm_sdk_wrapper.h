@@ -22,6 +22,7 @@
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/bcm/bcm_diag_shell.h"
+#include "stratum/hal/lib/bcm/bcm_id_allocator.h"
 #include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
 #include "stratum/hal/lib/common/constants.h"
 
@@ -60,6 +61,10 @@ struct BcmLinkscanEventWriterComp {
   }
 };
 
+// The L3 writes queued on a unit between StartL3WriteBatch() and
+// CommitL3WriteBatch(). Defined in the .cc file, as it holds SDK types.
+struct L3WriteBatch;
+
 // The "BcmSdkWrapper" is an implementation of BcmSdkInterface which is used
 // on real hardware to talk to BCM ASIC.
 class BcmSdkWrapper : public BcmSdkInterface {
@@ -177,6 +182,10 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status DeleteL3HostIpv4(int unit, int vrf, uint32 ipv4) override;
   ::util::Status DeleteL3HostIpv6(int unit, int vrf,
                                   const std::string& ipv6) override;
+  ::util::Status StartL3WriteBatch(int unit) override;
+  ::util::Status SetL3WriteBatchTag(int unit, int tag) override;
+  ::util::Status CommitL3WriteBatch(
+      int unit, std::map<int, ::util::Status>* failures) override;
   ::util::StatusOr<int> AddMyStationEntry(int unit, int priority, int vlan,
                                           int vlan_mask, uint64 dst_mac,
                                           uint64 dst_mac_mask) override;
@@ -354,6 +363,10 @@ class BcmSdkWrapper : public BcmSdkInterface {
   // This should work because PC_PHYS_PORT is a R/O table.
   ::util::StatusOr<int> GetPanelPort(int unit, int port);
 
+  // Helper to find the batch of L3 writes started on a unit. Returns nullptr
+  // if there is none.
+  L3WriteBatch* FindL3WriteBatch(int unit) LOCKS_EXCLUDED(data_lock_);
+
   // Helper to check if a unit exists.
   int CheckIfUnitExists(int unit);
 
@@ -376,9 +389,6 @@ class BcmSdkWrapper : public BcmSdkInterface {
   absl::flat_hash_map<int, BcmSocDevice*> unit_to_soc_device_
       GUARDED_BY(data_lock_);
 
-  // Map from index to usage flag
-  typedef std::map<int, bool> InUseMap;
-
   // Map from pair of Acl stage, correspoding logical table id, and
   // software maintained table id
   typedef std::map<std::pair<BcmAclStage, int>, int> AclIds;
@@ -487,11 +497,11 @@ class BcmSdkWrapper : public BcmSdkInterface {
       GUARDED_BY(data_lock_);
 
   // Map from unit number to l3 egress interfaces
-  absl::flat_hash_map<int, InUseMap> l3_egress_interface_ids_
+  absl::flat_hash_map<int, BcmIdAllocator> l3_egress_interface_ids_
       GUARDED_BY(data_lock_);
 
   // Map from unit number to ecmp interfaces
-  absl::flat_hash_map<int, InUseMap> l3_ecmp_egress_interface_ids_
+  absl::flat_hash_map<int, BcmIdAllocator> l3_ecmp_egress_interface_ids_
       GUARDED_BY(data_lock_);
 
   // Map from unit number to max ACL Groups supported
@@ -499,13 +509,16 @@ class BcmSdkWrapper : public BcmSdkInterface {
       GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of IFP group
-  absl::flat_hash_map<int, InUseMap> ifp_group_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> ifp_group_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of EFP group
-  absl::flat_hash_map<int, InUseMap> efp_group_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> efp_group_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of VFP group
-  absl::flat_hash_map<int, InUseMap> vfp_group_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> vfp_group_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to ACL groups
   absl::flat_hash_map<int, AclGroupIds*> fp_group_ids_ GUARDED_BY(data_lock_);
@@ -515,13 +528,13 @@ class BcmSdkWrapper : public BcmSdkInterface {
       GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of IFP rules
-  absl::flat_hash_map<int, InUseMap> ifp_rule_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> ifp_rule_ids_ GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of EFP rules
-  absl::flat_hash_map<int, InUseMap> efp_rule_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> efp_rule_ids_ GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of VFP rules
-  absl::flat_hash_map<int, InUseMap> vfp_rule_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> vfp_rule_ids_ GUARDED_BY(data_lock_);
 
   // Map from unit number to ACL rules
   absl::flat_hash_map<int, AclRuleIds*> fp_rule_ids_ GUARDED_BY(data_lock_);
@@ -531,13 +544,16 @@ class BcmSdkWrapper : public BcmSdkInterface {
       GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of IFP policies
-  absl::flat_hash_map<int, InUseMap> ifp_policy_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> ifp_policy_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of EFP policies
-  absl::flat_hash_map<int, InUseMap> efp_policy_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> efp_policy_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of VFP policies
-  absl::flat_hash_map<int, InUseMap> vfp_policy_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> vfp_policy_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to ACL policies
   absl::flat_hash_map<int, AclPolicyIds*> fp_policy_ids_ GUARDED_BY(data_lock_);
@@ -547,10 +563,12 @@ class BcmSdkWrapper : public BcmSdkInterface {
       GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of IFP meters
-  absl::flat_hash_map<int, InUseMap> ifp_meter_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> ifp_meter_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of EFP meters
-  absl::flat_hash_map<int, InUseMap> efp_meter_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> efp_meter_ids_
+      GUARDED_BY(data_lock_);
 
   // Map from unit number to ACL meters
   absl::flat_hash_map<int, AclMeterIds*> fp_meter_ids_ GUARDED_BY(data_lock_);
@@ -559,13 +577,13 @@ class BcmSdkWrapper : public BcmSdkInterface {
   absl::flat_hash_map<int, int> unit_to_fp_max_limit_ GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of IFP ACLs
-  absl::flat_hash_map<int, InUseMap> ifp_acl_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> ifp_acl_ids_ GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of EFP ACLs
-  absl::flat_hash_map<int, InUseMap> efp_acl_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> efp_acl_ids_ GUARDED_BY(data_lock_);
 
   // Map from unit number to logical table indexes of VFP ACLs
-  absl::flat_hash_map<int, InUseMap> vfp_acl_ids_ GUARDED_BY(data_lock_);
+  absl::flat_hash_map<int, BcmIdAllocator> vfp_acl_ids_ GUARDED_BY(data_lock_);
 
   // Map from unit number to ACLs
   absl::flat_hash_map<int, AclIds*> fp_acl_ids_ GUARDED_BY(data_lock_);
@@ -574,12 +592,16 @@ class BcmSdkWrapper : public BcmSdkInterface {
   static constexpr int kUdfMaxChunks = 16;
 
   // Map from unit number to logical table indexes of UDF
-  absl::flat_hash_map<int, InUseMap> unit_to_udf_chunk_ids_
+  absl::flat_hash_map<int, BcmIdAllocator> unit_to_udf_chunk_ids_
       GUARDED_BY(data_lock_);
 
   // Map from unit number to UDF chunks
   absl::flat_hash_map<int, ChunkIds*> unit_to_chunk_ids_ GUARDED_BY(data_lock_);
 
+  // Map from unit number to the batch of L3 writes started on the unit.
+  absl::flat_hash_map<int, std::unique_ptr<L3WriteBatch>>
+      unit_to_l3_write_batch_ GUARDED_BY(data_lock_);
+
   // Pointer to BcmDiagShell singleton instance. Not owned by this class.
   BcmDiagShell* bcm_diag_shell_;
 
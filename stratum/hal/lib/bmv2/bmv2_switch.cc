@@ -98,6 +98,14 @@ Bmv2Switch::~Bmv2Switch() {}
   return ::util::OkStatus();
 }
 
+::util::Status Bmv2Switch::ReconcileAndCommitForwardingPipelineConfig(
+    uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
+  RETURN_IF_ERROR(GetPINodeFromNodeId(node_id).status());
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "ReconcileAndCommitForwardingPipelineConfig not implemented for "
+         << "this target";
+}
+
 ::util::Status Bmv2Switch::VerifyForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   ASSIGN_OR_RETURN(auto* pi_node, GetPINodeFromNodeId(node_id));
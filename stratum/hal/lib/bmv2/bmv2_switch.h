@@ -33,6 +33,9 @@ class Bmv2Switch : public SwitchInterface {
       uint64 node_id,
       const ::p4::v1::ForwardingPipelineConfig& config) override;
   ::util::Status CommitForwardingPipelineConfig(uint64 node_id) override;
+  ::util::Status ReconcileAndCommitForwardingPipelineConfig(
+      uint64 node_id,
+      const ::p4::v1::ForwardingPipelineConfig& config) override;
   ::util::Status VerifyForwardingPipelineConfig(
       uint64 node_id,
       const ::p4::v1::ForwardingPipelineConfig& config) override;
@@ -0,0 +1,90 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/chunked_read_response_writer.h"
+
+#include <algorithm>
+
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+DEFINE_int32(p4_read_response_max_entities, 1000,
+             "Max number of entities in a single P4Runtime ReadResponse. "
+             "Bigger reads are streamed as multiple responses. 0 means no "
+             "limit.");
+DEFINE_int32(p4_read_response_max_bytes, 4 * 1024 * 1024,
+             "Approximate max size in bytes of a single P4Runtime "
+             "ReadResponse. Bigger reads are streamed as multiple responses. "
+             "Must be well below --grpc_max_send_msg_size. 0 means no limit.");
+
+namespace stratum {
+namespace hal {
+
+ChunkedReadResponseWriter::ChunkedReadResponseWriter(
+    WriterInterface<::p4::v1::ReadResponse>* writer)
+    : ChunkedReadResponseWriter(
+          writer, std::max(FLAGS_p4_read_response_max_entities, 0),
+          std::max(FLAGS_p4_read_response_max_bytes, 0)) {}
+
+ChunkedReadResponseWriter::ChunkedReadResponseWriter(
+    WriterInterface<::p4::v1::ReadResponse>* writer, size_t max_entities,
+    size_t max_bytes)
+    : writer_(ABSL_DIE_IF_NULL(writer)),
+      max_entities_(max_entities),
+      max_bytes_(max_bytes),
+      chunk_(),
+      chunk_bytes_(0),
+      num_responses_written_(0) {}
+
+::util::StatusOr<::p4::v1::Entity*> ChunkedReadResponseWriter::AddEntity() {
+  const size_t num_entities = chunk_.entities_size();
+  if (num_entities > 0) {
+    // The previous entity is complete now.
+    chunk_bytes_ += chunk_.entities(num_entities - 1).ByteSizeLong();
+    if ((max_entities_ > 0 && num_entities >= max_entities_) ||
+        (max_bytes_ > 0 && chunk_bytes_ >= max_bytes_)) {
+      RETURN_IF_ERROR(WriteChunk());
+    }
+  }
+
+  return chunk_.add_entities();
+}
+
+::util::Status ChunkedReadResponseWriter::AddEntities(
+    ::p4::v1::ReadResponse* resp) {
+  RET_CHECK(resp != nullptr);
+  for (auto& entity : *resp->mutable_entities()) {
+    ASSIGN_OR_RETURN(::p4::v1::Entity* e, AddEntity());
+    e->Swap(&entity);
+  }
+  resp->Clear();
+
+  return ::util::OkStatus();
+}
+
+::util::Status ChunkedReadResponseWriter::Flush() {
+  if (chunk_.entities_size() == 0 && num_responses_written_ > 0) {
+    return ::util::OkStatus();
+  }
+
+  return WriteChunk();
+}
+
+::util::Status ChunkedReadResponseWriter::WriteChunk() {
+  VLOG(1) << "Writing ReadResponse chunk with " << chunk_.entities_size()
+          << " entities.";
+  if (!writer_->Write(chunk_)) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream failed.";
+  }
+  ++num_responses_written_;
+  chunk_.Clear();
+  chunk_bytes_ = 0;
+
+  return ::util::OkStatus();
+}
+
+}  // namespace hal
+}  // namespace stratum
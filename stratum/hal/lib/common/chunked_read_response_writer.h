@@ -0,0 +1,92 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_CHUNKED_READ_RESPONSE_WRITER_H_
+#define STRATUM_HAL_LIB_COMMON_CHUNKED_READ_RESPONSE_WRITER_H_
+
+#include <stddef.h>
+
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+
+namespace stratum {
+namespace hal {
+
+// The "ChunkedReadResponseWriter" class streams the entities of a P4Runtime
+// read as a sequence of ReadResponse messages of bounded size, instead of one
+// single message holding all of them. Entities are built in place in the
+// current chunk, which is written out as soon as it holds max_entities
+// entities or max_bytes bytes. The memory used by a read is therefore bounded
+// by the chunk size, regardless of the number of entities read, and the
+// messages stay below the gRPC max message size.
+//
+// Usage:
+//   ChunkedReadResponseWriter chunked_writer(writer);
+//   for (...) {
+//     ASSIGN_OR_RETURN(::p4::v1::Entity* entity, chunked_writer.AddEntity());
+//     *entity->mutable_table_entry() = ...;
+//   }
+//   RETURN_IF_ERROR(chunked_writer.Flush());
+class ChunkedReadResponseWriter {
+ public:
+  // Uses the limits given by the --p4_read_response_max_entities and
+  // --p4_read_response_max_bytes flags.
+  explicit ChunkedReadResponseWriter(
+      WriterInterface<::p4::v1::ReadResponse>* writer);
+  // A limit of 0 means no limit.
+  ChunkedReadResponseWriter(WriterInterface<::p4::v1::ReadResponse>* writer,
+                            size_t max_entities, size_t max_bytes);
+
+  // Returns a new empty entity in the current chunk, to be filled in by the
+  // caller before the next call to AddEntity() or Flush(). Writes the current
+  // chunk first if it is full.
+  ::util::StatusOr<::p4::v1::Entity*> AddEntity();
+
+  // Moves all the entities of the given response into the chunks, leaving the
+  // response empty. Used for backends that can only produce the whole read
+  // response at once, to still stream it in bounded messages.
+  ::util::Status AddEntities(::p4::v1::ReadResponse* resp);
+
+  // Writes the entities added since the last chunk was written. If nothing has
+  // been written so far, an empty response is written, so that each read is
+  // answered with at least one response.
+  ::util::Status Flush();
+
+  // Returns the number of responses written so far.
+  size_t GetNumResponsesWritten() const { return num_responses_written_; }
+
+  // ChunkedReadResponseWriter is neither copyable nor movable.
+  ChunkedReadResponseWriter(const ChunkedReadResponseWriter&) = delete;
+  ChunkedReadResponseWriter& operator=(const ChunkedReadResponseWriter&) =
+      delete;
+
+ private:
+  // Writes the current chunk and clears it.
+  ::util::Status WriteChunk();
+
+  // The writer receiving the chunks. Not owned by this class.
+  WriterInterface<::p4::v1::ReadResponse>* writer_;
+
+  // Max number of entities and max size in bytes of a chunk. 0 means no
+  // limit.
+  const size_t max_entities_;
+  const size_t max_bytes_;
+
+  // The chunk being built. Cleared, but not deallocated, after each write so
+  // that the entity objects are reused by the next chunk.
+  ::p4::v1::ReadResponse chunk_;
+
+  // Size in bytes of all the entities of the chunk but the last one, which may
+  // still be filled in by the caller.
+  size_t chunk_bytes_;
+
+  // Number of responses written so far.
+  size_t num_responses_written_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_CHUNKED_READ_RESPONSE_WRITER_H_
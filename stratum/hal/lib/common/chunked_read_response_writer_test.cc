@@ -0,0 +1,134 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/chunked_read_response_writer.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+class ChunkedReadResponseWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ON_CALL(writer_mock_, Write(_))
+        .WillByDefault(Invoke([this](const ::p4::v1::ReadResponse& resp) {
+          responses_.push_back(resp);
+          return true;
+        }));
+  }
+
+  static ::util::Status AddTableEntries(ChunkedReadResponseWriter* writer,
+                                        int num_entries) {
+    for (int i = 0; i < num_entries; ++i) {
+      ASSIGN_OR_RETURN(::p4::v1::Entity* entity, writer->AddEntity());
+      entity->mutable_table_entry()->set_table_id(kTableId);
+      entity->mutable_table_entry()->set_priority(i + 1);
+    }
+    return ::util::OkStatus();
+  }
+
+  static constexpr uint32 kTableId = 33554433;
+
+  WriterMock<::p4::v1::ReadResponse> writer_mock_;
+  std::vector<::p4::v1::ReadResponse> responses_;
+};
+
+constexpr uint32 ChunkedReadResponseWriterTest::kTableId;
+
+TEST_F(ChunkedReadResponseWriterTest, EntitiesAreChunkedByCount) {
+  EXPECT_CALL(writer_mock_, Write(_)).Times(4);
+  ChunkedReadResponseWriter writer(&writer_mock_, 3, 0);
+
+  ASSERT_OK(AddTableEntries(&writer, 10));
+  ASSERT_OK(writer.Flush());
+
+  ASSERT_EQ(4U, responses_.size());
+  EXPECT_EQ(3, responses_[0].entities_size());
+  EXPECT_EQ(3, responses_[1].entities_size());
+  EXPECT_EQ(3, responses_[2].entities_size());
+  EXPECT_EQ(1, responses_[3].entities_size());
+  EXPECT_EQ(1, responses_[0].entities(0).table_entry().priority());
+  EXPECT_EQ(10, responses_[3].entities(0).table_entry().priority());
+  EXPECT_EQ(4U, writer.GetNumResponsesWritten());
+}
+
+TEST_F(ChunkedReadResponseWriterTest, EntitiesAreChunkedBySize) {
+  ::p4::v1::Entity entity;
+  entity.mutable_table_entry()->set_table_id(kTableId);
+  entity.mutable_table_entry()->set_priority(1);
+  const size_t entity_size = entity.ByteSizeLong();
+  EXPECT_CALL(writer_mock_, Write(_)).Times(2);
+  ChunkedReadResponseWriter writer(&writer_mock_, 0, 2 * entity_size);
+
+  ASSERT_OK(AddTableEntries(&writer, 3));
+  ASSERT_OK(writer.Flush());
+
+  ASSERT_EQ(2U, responses_.size());
+  EXPECT_EQ(2, responses_[0].entities_size());
+  EXPECT_EQ(1, responses_[1].entities_size());
+}
+
+TEST_F(ChunkedReadResponseWriterTest, EmptyReadWritesOneEmptyResponse) {
+  EXPECT_CALL(writer_mock_, Write(_)).Times(1);
+  ChunkedReadResponseWriter writer(&writer_mock_, 3, 0);
+
+  ASSERT_OK(writer.Flush());
+
+  ASSERT_EQ(1U, responses_.size());
+  EXPECT_EQ(0, responses_[0].entities_size());
+}
+
+TEST_F(ChunkedReadResponseWriterTest, FlushAfterFullChunkWritesNothing) {
+  EXPECT_CALL(writer_mock_, Write(_)).Times(1);
+  ChunkedReadResponseWriter writer(&writer_mock_, 3, 0);
+
+  ASSERT_OK(AddTableEntries(&writer, 3));
+  ASSERT_OK(writer.Flush());
+  ASSERT_OK(writer.Flush());
+
+  ASSERT_EQ(1U, responses_.size());
+  EXPECT_EQ(3, responses_[0].entities_size());
+}
+
+TEST_F(ChunkedReadResponseWriterTest, AddEntitiesMovesAllEntities) {
+  EXPECT_CALL(writer_mock_, Write(_)).Times(2);
+  ChunkedReadResponseWriter writer(&writer_mock_, 4, 0);
+  ::p4::v1::ReadResponse resp;
+  for (int i = 0; i < 5; ++i) {
+    resp.add_entities()->mutable_table_entry()->set_priority(i + 1);
+  }
+
+  ASSERT_OK(writer.AddEntities(&resp));
+  ASSERT_OK(writer.Flush());
+
+  EXPECT_EQ(0, resp.entities_size());
+  ASSERT_EQ(2U, responses_.size());
+  EXPECT_EQ(4, responses_[0].entities_size());
+  EXPECT_EQ(1, responses_[1].entities_size());
+  EXPECT_EQ(5, responses_[1].entities(0).table_entry().priority());
+}
+
+TEST_F(ChunkedReadResponseWriterTest, WriteFailureIsReported) {
+  EXPECT_CALL(writer_mock_, Write(_)).WillOnce(Return(false));
+  ChunkedReadResponseWriter writer(&writer_mock_, 1, 0);
+
+  ::util::Status status = AddTableEntries(&writer, 2);
+
+  EXPECT_EQ(ERR_INTERNAL, status.error_code());
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,151 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/config_file_saver.h"
+
+#include <stdio.h>
+
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+ConfigFileSaver::ConfigFileSaver(ErrorBuffer* error_buffer)
+    : pending_(),
+      num_scheduled_(0),
+      num_handled_(0),
+      error_(::util::OkStatus()),
+      shutdown_(false),
+      saver_tid_(0),
+      error_buffer_(error_buffer) {}
+
+ConfigFileSaver::~ConfigFileSaver() { Shutdown(); }
+
+::util::StatusOr<std::unique_ptr<ConfigFileSaver>>
+ConfigFileSaver::CreateInstance(ErrorBuffer* error_buffer) {
+  auto saver = absl::WrapUnique(new ConfigFileSaver(error_buffer));
+  int ret = pthread_create(&saver->saver_tid_, nullptr,
+                           &ConfigFileSaver::SaverThreadFunc, saver.get());
+  if (ret != 0) {
+    saver->saver_tid_ = 0;
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to spawn the config file saver thread. Err: " << ret
+           << ".";
+  }
+
+  return std::move(saver);
+}
+
+void ConfigFileSaver::Save(
+    const std::string& file_path,
+    std::shared_ptr<const ::google::protobuf::Message> message) {
+  absl::MutexLock l(&lock_);
+  if (shutdown_) {
+    LOG(ERROR) << "Config file saver is shut down. Dropped the save of "
+               << file_path << ".";
+    return;
+  }
+  pending_[file_path] = std::move(message);
+  ++num_scheduled_;
+  pending_not_empty_.Signal();
+}
+
+::util::Status ConfigFileSaver::Flush() {
+  absl::MutexLock l(&lock_);
+  const uint64 target = num_scheduled_;
+  while (num_handled_ < target && !(shutdown_ && saver_tid_ == 0)) {
+    batch_saved_.Wait(&lock_);
+  }
+  ::util::Status error = error_;
+  error_ = ::util::OkStatus();
+
+  return error;
+}
+
+void ConfigFileSaver::Shutdown() {
+  {
+    absl::MutexLock l(&lock_);
+    if (shutdown_) return;
+    shutdown_ = true;
+    pending_not_empty_.Signal();
+  }
+  if (saver_tid_ != 0) {
+    int ret = pthread_join(saver_tid_, nullptr);
+    if (ret != 0) {
+      LOG(ERROR) << "Failed to join the config file saver thread with error "
+                 << ret << ".";
+    }
+    absl::MutexLock l(&lock_);
+    saver_tid_ = 0;
+    batch_saved_.SignalAll();
+  }
+}
+
+void* ConfigFileSaver::SaverThreadFunc(void* arg) {
+  ConfigFileSaver* saver = static_cast<ConfigFileSaver*>(arg);
+  saver->SaverLoop();
+  return nullptr;
+}
+
+void ConfigFileSaver::SaverLoop() {
+  while (true) {
+    std::map<std::string, std::shared_ptr<const ::google::protobuf::Message>>
+        batch;
+    uint64 batch_end;
+    {
+      absl::MutexLock l(&lock_);
+      while (!shutdown_ && pending_.empty()) {
+        pending_not_empty_.Wait(&lock_);
+      }
+      if (pending_.empty()) break;  // Shutting down, nothing left to save.
+      batch.swap(pending_);
+      batch_end = num_scheduled_;
+    }
+    // No lock held while formatting and writing.
+    ::util::Status status = ::util::OkStatus();
+    for (const auto& e : batch) {
+      ::util::Status error = SaveToFile(e.first, *e.second);
+      if (!error.ok()) {
+        LOG(ERROR) << "Failed to save config file " << e.first << ": "
+                   << error.error_message();
+        if (error_buffer_) {
+          error_buffer_->AddError(
+              error, absl::StrCat("Failed to save config file ", e.first, ": "),
+              GTL_LOC);
+        }
+      }
+      APPEND_STATUS_IF_ERROR(status, error);
+    }
+    {
+      absl::MutexLock l(&lock_);
+      APPEND_STATUS_IF_ERROR(error_, status);
+      num_handled_ = batch_end;
+      batch_saved_.SignalAll();
+    }
+  }
+}
+
+::util::Status ConfigFileSaver::SaveToFile(
+    const std::string& file_path, const ::google::protobuf::Message& message) {
+  const std::string tmp_file_path = file_path + ".tmp";
+  RETURN_IF_ERROR(WriteProtoToTextFile(message, tmp_file_path));
+  if (rename(tmp_file_path.c_str(), file_path.c_str()) != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to rename " << tmp_file_path << " to " << file_path
+           << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,110 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_CONFIG_FILE_SAVER_H_
+#define STRATUM_HAL_LIB_COMMON_CONFIG_FILE_SAVER_H_
+
+#include <pthread.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/message.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/error_buffer.h"
+
+namespace stratum {
+namespace hal {
+
+// The "ConfigFileSaver" class saves protos to text files from a background
+// thread, so that the callers (typically RPC threads) do not wait for the
+// formatting and file I/O of possibly large configs. Only the latest proto
+// scheduled for a file is written: if a file is saved several times while the
+// thread is busy, the intermediate versions are skipped. Files are replaced
+// atomically, a crash in the middle of a save leaves the previous version of
+// the file intact. Failed saves are logged and added to the ErrorBuffer given
+// at creation, as they happen, instead of being returned to the caller of an
+// unrelated later Save().
+class ConfigFileSaver {
+ public:
+  virtual ~ConfigFileSaver();
+
+  // Schedules the given proto to be saved in text format to file_path. The
+  // proto is shared with the caller and must not be modified afterwards.
+  void Save(const std::string& file_path,
+            std::shared_ptr<const ::google::protobuf::Message> message)
+      LOCKS_EXCLUDED(lock_);
+
+  // Blocks until all the protos scheduled before this call have been saved.
+  // Returns the errors of the saves done since the last call to Flush(), if
+  // any.
+  ::util::Status Flush() LOCKS_EXCLUDED(lock_);
+
+  // Saves all the pending protos and stops the background thread. Protos
+  // scheduled afterwards are dropped. Called by the destructor.
+  void Shutdown() LOCKS_EXCLUDED(lock_);
+
+  // Creates a saver and starts its background thread. The errors of failed
+  // saves are added to error_buffer, unless it is nullptr.
+  static ::util::StatusOr<std::unique_ptr<ConfigFileSaver>> CreateInstance(
+      ErrorBuffer* error_buffer);
+
+  // ConfigFileSaver is neither copyable nor movable.
+  ConfigFileSaver(const ConfigFileSaver&) = delete;
+  ConfigFileSaver& operator=(const ConfigFileSaver&) = delete;
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance.
+  explicit ConfigFileSaver(ErrorBuffer* error_buffer);
+
+  // Thread function for the background saver.
+  static void* SaverThreadFunc(void* arg);
+
+  // Main loop of the background saver.
+  void SaverLoop() LOCKS_EXCLUDED(lock_);
+
+  // Writes the proto to a temporary file and renames it to file_path.
+  static ::util::Status SaveToFile(const std::string& file_path,
+                                   const ::google::protobuf::Message& message);
+
+  // Protects all the state below. Never held while doing file I/O.
+  mutable absl::Mutex lock_;
+
+  // Signaled when a new proto is scheduled or on shutdown.
+  absl::CondVar pending_not_empty_;
+
+  // Signaled by the saver thread after saving a batch of protos.
+  absl::CondVar batch_saved_;
+
+  // Map from file path to the latest proto scheduled for it.
+  std::map<std::string, std::shared_ptr<const ::google::protobuf::Message>>
+      pending_ GUARDED_BY(lock_);
+
+  // Number of calls to Save() and number of those handled by the saver
+  // thread. Used by Flush().
+  uint64 num_scheduled_ GUARDED_BY(lock_);
+  uint64 num_handled_ GUARDED_BY(lock_);
+
+  // Errors of the saves done since the last call to Flush().
+  ::util::Status error_ GUARDED_BY(lock_);
+
+  // Set to true when the saver is shutting down.
+  bool shutdown_ GUARDED_BY(lock_);
+
+  // The background saver thread id, 0 if not running.
+  pthread_t saver_tid_;
+
+  // Pointer to ErrorBuffer to save the errors of failed saves. Not owned by
+  // this class, may be nullptr.
+  ErrorBuffer* error_buffer_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_CONFIG_FILE_SAVER_H_
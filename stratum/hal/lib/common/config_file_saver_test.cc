@@ -0,0 +1,106 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/config_file_saver.h"
+
+#include <memory>
+#include <string>
+
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/error_buffer.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+namespace hal {
+
+class ConfigFileSaverTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    file_path_ = FLAGS_test_tmpdir + "/config_file_saver_test.pb.txt";
+    if (PathExists(file_path_)) {
+      ASSERT_OK(RemoveFile(file_path_));
+    }
+    error_buffer_ = absl::make_unique<ErrorBuffer>();
+    auto ret = ConfigFileSaver::CreateInstance(error_buffer_.get());
+    ASSERT_OK(ret.status());
+    saver_ = ret.ConsumeValueOrDie();
+  }
+
+  static std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig> MakeConfig(
+      uint64 cookie) {
+    auto config = std::make_shared<::p4::v1::ForwardingPipelineConfig>();
+    config->set_p4_device_config("\x01\x02\x03");
+    config->mutable_cookie()->set_cookie(cookie);
+    return config;
+  }
+
+  std::string file_path_;
+  std::unique_ptr<ErrorBuffer> error_buffer_;
+  std::unique_ptr<ConfigFileSaver> saver_;
+};
+
+TEST_F(ConfigFileSaverTest, FlushWaitsForSave) {
+  saver_->Save(file_path_, MakeConfig(1));
+  ASSERT_OK(saver_->Flush());
+
+  ::p4::v1::ForwardingPipelineConfig config;
+  ASSERT_OK(ReadProtoFromTextFile(file_path_, &config));
+  EXPECT_TRUE(ProtoEqual(*MakeConfig(1), config));
+  EXPECT_FALSE(PathExists(file_path_ + ".tmp"));
+}
+
+TEST_F(ConfigFileSaverTest, LatestConfigWins) {
+  for (uint64 cookie = 1; cookie <= 100; ++cookie) {
+    saver_->Save(file_path_, MakeConfig(cookie));
+  }
+  ASSERT_OK(saver_->Flush());
+
+  ::p4::v1::ForwardingPipelineConfig config;
+  ASSERT_OK(ReadProtoFromTextFile(file_path_, &config));
+  EXPECT_EQ(100U, config.cookie().cookie());
+}
+
+TEST_F(ConfigFileSaverTest, ShutdownSavesPendingConfigs) {
+  saver_->Save(file_path_, MakeConfig(7));
+  saver_->Shutdown();
+
+  ::p4::v1::ForwardingPipelineConfig config;
+  ASSERT_OK(ReadProtoFromTextFile(file_path_, &config));
+  EXPECT_EQ(7U, config.cookie().cookie());
+
+  // Saves after shutdown are dropped.
+  saver_->Save(file_path_, MakeConfig(8));
+  EXPECT_OK(saver_->Flush());
+  ASSERT_OK(ReadProtoFromTextFile(file_path_, &config));
+  EXPECT_EQ(7U, config.cookie().cookie());
+}
+
+TEST_F(ConfigFileSaverTest, FlushReportsErrors) {
+  saver_->Save(FLAGS_test_tmpdir + "/non/existing/dir/file.pb.txt",
+               MakeConfig(1));
+  EXPECT_FALSE(saver_->Flush().ok());
+  // Errors are only reported once.
+  EXPECT_OK(saver_->Flush());
+}
+
+TEST_F(ConfigFileSaverTest, ErrorsAreAddedToErrorBuffer) {
+  EXPECT_FALSE(error_buffer_->ErrorExists());
+  saver_->Save(FLAGS_test_tmpdir + "/non/existing/dir/file.pb.txt",
+               MakeConfig(1));
+  saver_->Shutdown();
+  const auto& errors = error_buffer_->GetErrors();
+  ASSERT_EQ(1U, errors.size());
+  EXPECT_THAT(errors[0].error_message(),
+              ::testing::HasSubstr("Failed to save config file"));
+}
+
+}  // namespace hal
+}  // namespace stratum
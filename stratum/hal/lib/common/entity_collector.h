@@ -0,0 +1,37 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_ENTITY_COLLECTOR_H_
+#define STRATUM_HAL_LIB_COMMON_ENTITY_COLLECTOR_H_
+
+#include <vector>
+
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+
+namespace stratum {
+namespace hal {
+
+// ReadResponse writer which collects the entities of all the responses written
+// to it, e.g. to take a snapshot of the forwarding state of a node through its
+// regular read path. Not thread-safe.
+class EntityCollector : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  EntityCollector() {}
+  bool Write(const ::p4::v1::ReadResponse& resp) override {
+    entities_.insert(entities_.end(), resp.entities().begin(),
+                     resp.entities().end());
+    return true;
+  }
+
+  // Returns the entities collected so far, in the order they were written.
+  const std::vector<::p4::v1::Entity>& entities() const { return entities_; }
+
+ private:
+  std::vector<::p4::v1::Entity> entities_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_ENTITY_COLLECTOR_H_
@@ -38,6 +38,20 @@ DEFINE_uint32(grpc_max_recv_msg_size, 256 * 1024 * 1024,
               "grpc server max receive message size (0 = gRPC default).");
 DEFINE_uint32(grpc_max_send_msg_size, 0,
               "grpc server max send message size (0 = gRPC default).");
+DEFINE_bool(p4runtime_async_write_read, false,
+            "If true, the P4Runtime Write and Read RPCs are served using the "
+            "gRPC async API, with a fixed number of threads, instead of one "
+            "gRPC server thread per RPC in flight.");
+DEFINE_int32(p4runtime_async_num_cq_threads, 2,
+             "Number of completion queue polling threads for the P4Runtime "
+             "Write and Read RPCs in async mode.");
+DEFINE_int32(p4runtime_async_num_executor_threads, 8,
+             "Number of threads running the P4Runtime Write and Read RPCs in "
+             "async mode.");
+DEFINE_int32(p4runtime_async_max_pending_requests, 256,
+             "Max number of P4Runtime Write and Read RPCs waiting for an "
+             "executor thread in async mode. Further RPCs are rejected with "
+             "RESOURCE_EXHAUSTED.");
 
 namespace stratum {
 namespace hal {
@@ -94,6 +108,7 @@ Hal::Hal(OperationMode mode, SwitchInterface* switch_interface,
       diag_service_(nullptr),
       file_service_(nullptr),
       external_server_(nullptr),
+      p4_async_rpc_handler_(nullptr),
       old_signal_handlers_(),
       signal_waiter_tid_() {}
 
@@ -205,6 +220,16 @@ Hal::~Hal() {
     if (FLAGS_grpc_max_send_msg_size > 0) {
       builder.SetMaxSendMessageSize(FLAGS_grpc_max_send_msg_size);
     }
+    if (FLAGS_p4runtime_async_write_read) {
+      // Needs to be done before P4Service is registered below.
+      P4AsyncRpcHandler::Options options;
+      options.num_cq_threads = FLAGS_p4runtime_async_num_cq_threads;
+      options.num_executor_threads = FLAGS_p4runtime_async_num_executor_threads;
+      options.max_pending_requests = FLAGS_p4runtime_async_max_pending_requests;
+      ASSIGN_OR_RETURN(p4_async_rpc_handler_,
+                       P4AsyncRpcHandler::CreateInstance(p4_service_.get(),
+                                                         &builder, options));
+    }
     builder.RegisterService(config_monitoring_service_.get());
     builder.RegisterService(p4_service_.get());
     builder.RegisterService(admin_service_.get());
@@ -220,10 +245,22 @@ Hal::~Hal() {
     LOG(ERROR) << "Stratum external facing services are listening to "
                << absl::StrJoin(external_stratum_urls, ", ") << ", "
                << FLAGS_local_stratum_url << "...";
+    if (p4_async_rpc_handler_) {
+      ::util::Status status = p4_async_rpc_handler_->Start();
+      if (!status.ok()) {
+        // Stop serving and join the polling threads which did start, the same
+        // way as the regular shutdown below.
+        external_server_->Shutdown(absl::ToChronoTime(absl::Now()));
+        p4_async_rpc_handler_->Shutdown();
+        APPEND_STATUS_IF_ERROR(status, Teardown());
+        return status;
+      }
+    }
   }
 
   external_server_->Wait();  // blocking until external_server_->Shutdown()
                              // is called. We dont wait on internal_service.
+  if (p4_async_rpc_handler_) p4_async_rpc_handler_->Shutdown();
   return Teardown();
 }
 
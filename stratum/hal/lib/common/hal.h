@@ -26,6 +26,7 @@
 #include "stratum/hal/lib/common/diag_service.h"
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/file_service.h"
+#include "stratum/hal/lib/common/p4_async_rpc_handler.h"
 #include "stratum/hal/lib/common/p4_service.h"
 #include "stratum/hal/lib/common/switch_interface.h"
 #include "stratum/lib/security/auth_policy_checker.h"
@@ -151,6 +152,11 @@ class Hal final {
   // serviced by ConfigMonitoringService and P4Service. Owned by the class.
   std::unique_ptr<::grpc::Server> external_server_;
 
+  // Serves the P4Runtime Write and Read RPCs on completion queues when the
+  // async mode is enabled, nullptr otherwise. Created in Run() and shut down
+  // after external_server_.
+  std::unique_ptr<P4AsyncRpcHandler> p4_async_rpc_handler_;
+
   // Map from signals for which we registered handlers to their old handlers.
   // This map is used to restore the signal handlers to their previous state
   // in the class destructor.
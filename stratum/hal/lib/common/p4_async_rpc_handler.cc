@@ -0,0 +1,270 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/p4_async_rpc_handler.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+// Common state of a Write or Read call. A call object is created to request a
+// new call from the server and deletes itself on the last event of the call
+// on its completion queue.
+class P4AsyncRpcHandler::Call : public P4AsyncRpcHandler::Tag {
+ public:
+  Call(P4AsyncRpcHandler* handler, ::grpc::ServerCompletionQueue* cq)
+      : handler_(handler), cq_(cq), context_(), finishing_(false) {}
+  ~Call() override {}
+
+  // Handles the arrival of the call and the completion of Finish().
+  void OnCompletion(bool ok) override {
+    // A failed arrival means that the server is shutting down.
+    if (!ok || finishing_ || !handler_->StartCall(this)) delete this;
+  }
+
+  // Requests a new call of the same type on the same completion queue.
+  virtual void RequestNext() = 0;
+
+  // Serves the call on an executor thread and finishes it.
+  virtual void Run() = 0;
+
+  // Finishes the call with the given status without serving it.
+  virtual void Fail(const ::grpc::Status& status) = 0;
+
+ protected:
+  P4AsyncRpcHandler* handler_;  // not owned by the class.
+  ::grpc::ServerCompletionQueue* cq_;  // not owned by the class.
+  ::grpc::ServerContext context_;
+  // Set right before finishing the call, so that the next event deletes it.
+  // Written and read through the completion queue, which orders the accesses.
+  bool finishing_;
+};
+
+class P4AsyncRpcHandler::WriteCall : public P4AsyncRpcHandler::Call {
+ public:
+  WriteCall(P4AsyncRpcHandler* handler, ::grpc::ServerCompletionQueue* cq)
+      : Call(handler, cq),
+        req_(std::make_shared<::p4::v1::WriteRequest>()),
+        resp_(),
+        responder_(&context_) {
+    handler_->p4_service_->RequestWrite(&context_, req_.get(), &responder_,
+                                        cq_, cq_, this);
+  }
+
+  void RequestNext() override { new WriteCall(handler_, cq_); }
+
+  void Run() override {
+    ::grpc::Status status =
+        handler_->p4_service_->DoWrite(&context_, req_.get(), req_, &resp_);
+    finishing_ = true;
+    responder_.Finish(resp_, status, this);
+  }
+
+  void Fail(const ::grpc::Status& status) override {
+    finishing_ = true;
+    responder_.FinishWithError(status, this);
+  }
+
+ private:
+  // Shared with the request logger, which may log it after the call is gone.
+  std::shared_ptr<::p4::v1::WriteRequest> req_;
+  ::p4::v1::WriteResponse resp_;
+  ::grpc::ServerAsyncResponseWriter<::p4::v1::WriteResponse> responder_;
+};
+
+class P4AsyncRpcHandler::ReadCall
+    : public P4AsyncRpcHandler::Call,
+      public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  ReadCall(P4AsyncRpcHandler* handler, ::grpc::ServerCompletionQueue* cq)
+      : Call(handler, cq),
+        req_(std::make_shared<::p4::v1::ReadRequest>()),
+        writer_(&context_),
+        write_done_tag_(this),
+        write_done_(false),
+        write_ok_(false) {
+    handler_->p4_service_->RequestRead(&context_, req_.get(), &writer_, cq_,
+                                       cq_, this);
+  }
+
+  void RequestNext() override { new ReadCall(handler_, cq_); }
+
+  void Run() override {
+    ::grpc::Status status =
+        handler_->p4_service_->DoRead(&context_, req_.get(), req_, this);
+    finishing_ = true;
+    writer_.Finish(status, this);
+  }
+
+  void Fail(const ::grpc::Status& status) override {
+    finishing_ = true;
+    writer_.Finish(status, this);
+  }
+
+  // Streams a response to the client. Called by the executor thread running
+  // the Read RPC. Blocks until the response is sent, which both keeps at most
+  // one outstanding write on the stream (as required by gRPC) and pushes back
+  // on the switch when the client is slow.
+  bool Write(const ::p4::v1::ReadResponse& msg) override
+      LOCKS_EXCLUDED(write_lock_) {
+    absl::MutexLock l(&write_lock_);
+    write_done_ = false;
+    writer_.Write(msg, &write_done_tag_);
+    while (!write_done_) write_done_cond_.Wait(&write_lock_);
+    return write_ok_;
+  }
+
+ private:
+  // The tag for the completion of a Write() on the stream.
+  class WriteDoneTag : public Tag {
+   public:
+    explicit WriteDoneTag(ReadCall* call) : call_(call) {}
+    void OnCompletion(bool ok) override {
+      absl::MutexLock l(&call_->write_lock_);
+      call_->write_ok_ = ok;
+      call_->write_done_ = true;
+      call_->write_done_cond_.Signal();
+    }
+
+   private:
+    ReadCall* call_;  // not owned by the class.
+  };
+
+  // Shared with the request logger, which may log it after the call is gone.
+  std::shared_ptr<::p4::v1::ReadRequest> req_;
+  ::grpc::ServerAsyncWriter<::p4::v1::ReadResponse> writer_;
+  WriteDoneTag write_done_tag_;
+  absl::Mutex write_lock_;
+  absl::CondVar write_done_cond_;
+  bool write_done_ GUARDED_BY(write_lock_);
+  bool write_ok_ GUARDED_BY(write_lock_);
+};
+
+P4AsyncRpcHandler::P4AsyncRpcHandler(P4Service* p4_service,
+                                     std::unique_ptr<BoundedExecutor> executor)
+    : p4_service_(p4_service),
+      executor_(std::move(executor)),
+      cqs_(),
+      started_(false),
+      shutdown_(false),
+      poller_tids_() {}
+
+P4AsyncRpcHandler::~P4AsyncRpcHandler() { Shutdown(); }
+
+::util::StatusOr<std::unique_ptr<P4AsyncRpcHandler>>
+P4AsyncRpcHandler::CreateInstance(P4Service* p4_service,
+                                  ::grpc::ServerBuilder* builder,
+                                  const Options& options) {
+  RET_CHECK(p4_service != nullptr);
+  RET_CHECK(builder != nullptr);
+  RET_CHECK(options.num_cq_threads > 0)
+      << "Number of completion queue threads must be positive.";
+  std::unique_ptr<BoundedExecutor> executor;
+  ASSIGN_OR_RETURN(executor, BoundedExecutor::CreateInstance(
+                                 "P4AsyncRpcHandler",
+                                 options.num_executor_threads,
+                                 options.max_pending_requests));
+  auto handler = absl::WrapUnique(
+      new P4AsyncRpcHandler(p4_service, std::move(executor)));
+  p4_service->EnableAsyncWriteAndRead();
+  for (int i = 0; i < options.num_cq_threads; ++i) {
+    handler->cqs_.push_back(builder->AddCompletionQueue());
+  }
+
+  return std::move(handler);
+}
+
+::util::Status P4AsyncRpcHandler::Start() {
+  absl::MutexLock l(&lock_);
+  if (shutdown_) {
+    return MAKE_ERROR(ERR_CANCELLED) << "P4AsyncRpcHandler is shut down.";
+  }
+  if (started_) return ::util::OkStatus();
+  started_ = true;
+  for (const auto& cq : cqs_) {
+    // The calls are deleted by the polling threads.
+    new WriteCall(this, cq.get());
+    new ReadCall(this, cq.get());
+    pthread_t tid;
+    int ret = pthread_create(&tid, nullptr,
+                             &P4AsyncRpcHandler::PollerThreadFunc,
+                             new PollerArgs{this, cq.get()});
+    if (ret != 0) {
+      // The already running threads are joined by Shutdown().
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to spawn completion queue polling thread. Err: "
+             << ret << ".";
+    }
+    poller_tids_.push_back(tid);
+  }
+  LOG(INFO) << "Serving P4Runtime Write and Read RPCs asynchronously with "
+            << cqs_.size() << " completion queues.";
+
+  return ::util::OkStatus();
+}
+
+void P4AsyncRpcHandler::Shutdown() {
+  {
+    absl::MutexLock l(&lock_);
+    if (shutdown_) return;
+    shutdown_ = true;
+  }
+  // Let the RPCs in flight finish first. The polling threads are still needed
+  // at this point to complete their stream writes and Finish() calls.
+  executor_->Shutdown();
+  for (const auto& cq : cqs_) cq->Shutdown();
+  for (const auto& tid : poller_tids_) {
+    int ret = pthread_join(tid, nullptr);
+    if (ret != 0) {
+      LOG(ERROR) << "Failed to join completion queue polling thread with "
+                 << "error " << ret << ".";
+    }
+  }
+  poller_tids_.clear();
+  // Drain the queues which had no polling thread, e.g. if Start() was never
+  // called or failed.
+  for (const auto& cq : cqs_) PollCompletionQueue(cq.get());
+}
+
+bool P4AsyncRpcHandler::StartCall(Call* call) {
+  absl::MutexLock l(&lock_);
+  if (shutdown_) return false;
+  call->RequestNext();
+  ::util::Status status = executor_->Submit([call]() { call->Run(); });
+  if (!status.ok()) {
+    LOG_EVERY_N(WARNING, 100) << "Rejected P4Runtime call: "
+                              << status.error_message();
+    call->Fail(::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                              status.error_message()));
+  }
+
+  return true;
+}
+
+void* P4AsyncRpcHandler::PollerThreadFunc(void* arg) {
+  std::unique_ptr<PollerArgs> args(static_cast<PollerArgs*>(arg));
+  args->handler->PollCompletionQueue(args->cq);
+  return nullptr;
+}
+
+void P4AsyncRpcHandler::PollCompletionQueue(
+    ::grpc::ServerCompletionQueue* cq) {
+  void* tag = nullptr;
+  bool ok = false;
+  while (cq->Next(&tag, &ok)) {
+    static_cast<Tag*>(tag)->OnCompletion(ok);
+  }
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,142 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_P4_ASYNC_RPC_HANDLER_H_
+#define STRATUM_HAL_LIB_COMMON_P4_ASYNC_RPC_HANDLER_H_
+
+#include <pthread.h>
+
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "grpcpp/grpcpp.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/p4_service.h"
+#include "stratum/lib/bounded_executor.h"
+
+namespace stratum {
+namespace hal {
+
+// The "P4AsyncRpcHandler" class serves the P4Runtime Write and Read RPCs of a
+// P4Service using the gRPC async API. In the default sync mode, every Write and
+// Read in flight occupies a gRPC server thread, which then blocks in the
+// SwitchInterface calls. In async mode, a fixed number of polling threads
+// (one per completion queue) accept the calls and hand them to a bounded
+// executor, which runs the existing P4Service Write/Read logic. The number of
+// threads hence no longer grows with the number of controllers and requests
+// in flight. When the executor queue is full, new calls are failed right away
+// with RESOURCE_EXHAUSTED. All the other P4Runtime RPCs are still served by
+// the sync server.
+//
+// Usage:
+//   ::grpc::ServerBuilder builder;
+//   ASSIGN_OR_RETURN(auto handler, P4AsyncRpcHandler::CreateInstance(
+//       p4_service, &builder, options));
+//   builder.RegisterService(p4_service);
+//   auto server = builder.BuildAndStart();
+//   RETURN_IF_ERROR(handler->Start());
+//   ...
+//   server->Shutdown();
+//   handler->Shutdown();
+class P4AsyncRpcHandler {
+ public:
+  struct Options {
+    // Number of completion queues, each polled by its own thread.
+    int num_cq_threads = 2;
+    // Number of threads running the Write/Read RPCs.
+    int num_executor_threads = 8;
+    // Max number of RPCs waiting for an executor thread.
+    size_t max_pending_requests = 256;
+  };
+
+  virtual ~P4AsyncRpcHandler();
+
+  // Starts the polling threads and requests the first Write and Read calls on
+  // every completion queue. Must be called after the server is started.
+  ::util::Status Start() LOCKS_EXCLUDED(lock_);
+
+  // Finishes the RPCs in flight, shuts down the completion queues and joins
+  // all the threads. Must be called after the server is shut down (i.e. after
+  // ::grpc::Server::Shutdown() returned). Called by the destructor.
+  void Shutdown() LOCKS_EXCLUDED(lock_);
+
+  // Creates the handler for the given P4Service. Switches the Write and Read
+  // RPCs of the service to async mode and adds the completion queues to the
+  // builder. Must be called before the service is registered with the builder.
+  static ::util::StatusOr<std::unique_ptr<P4AsyncRpcHandler>> CreateInstance(
+      P4Service* p4_service, ::grpc::ServerBuilder* builder,
+      const Options& options);
+
+  // P4AsyncRpcHandler is neither copyable nor movable.
+  P4AsyncRpcHandler(const P4AsyncRpcHandler&) = delete;
+  P4AsyncRpcHandler& operator=(const P4AsyncRpcHandler&) = delete;
+
+ private:
+  // Base class of all the tags put on the completion queues.
+  class Tag {
+   public:
+    virtual ~Tag() {}
+    // Called by the polling thread for the completion of the tagged operation.
+    // ok is the result returned by ::grpc::CompletionQueue::Next().
+    virtual void OnCompletion(bool ok) = 0;
+  };
+
+  // State of a single Write or Read call. Defined in the .cc file.
+  class Call;
+  class WriteCall;
+  class ReadCall;
+
+  // PollerArgs encapsulates the arguments for a polling thread.
+  struct PollerArgs {
+    P4AsyncRpcHandler* handler;
+    ::grpc::ServerCompletionQueue* cq;
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance.
+  P4AsyncRpcHandler(P4Service* p4_service,
+                    std::unique_ptr<BoundedExecutor> executor);
+
+  // Called by the polling thread when a new call arrives. Requests the next
+  // call of the same type and schedules the call on the executor, or fails it
+  // if the executor is full. Returns false if the handler is shutting down, in
+  // which case the call is not started and must be deleted by the caller.
+  bool StartCall(Call* call) LOCKS_EXCLUDED(lock_);
+
+  // Thread function for the polling threads.
+  static void* PollerThreadFunc(void* arg);
+
+  // Dispatches the events of the given completion queue until it is shut
+  // down and drained.
+  void PollCompletionQueue(::grpc::ServerCompletionQueue* cq);
+
+  // Pointer to the service implementing the RPCs. Not owned by this class.
+  P4Service* p4_service_;
+
+  // The executor running the RPCs.
+  std::unique_ptr<BoundedExecutor> executor_;
+
+  // The completion queues, one per polling thread. Added to the builder in
+  // CreateInstance() and never changed afterwards.
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> cqs_;
+
+  // Protects the state of the handler. Held while requesting new calls and
+  // while failing calls from the polling threads, so that nothing is put on
+  // the completion queues after Shutdown() started.
+  absl::Mutex lock_;
+
+  // Set to true by Start() and by Shutdown(), respectively.
+  bool started_ GUARDED_BY(lock_);
+  bool shutdown_ GUARDED_BY(lock_);
+
+  // The polling thread ids. Only changed by Start() and Shutdown().
+  std::vector<pthread_t> poller_tids_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_P4_ASYNC_RPC_HANDLER_H_
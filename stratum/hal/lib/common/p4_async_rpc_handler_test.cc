@@ -0,0 +1,213 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/p4_async_rpc_handler.h"
+
+#include <pthread.h>
+
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "grpcpp/grpcpp.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/net_util/ports.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/error_buffer.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/security/auth_policy_checker_mock.h"
+#include "stratum/lib/utils.h"
+
+DECLARE_string(forwarding_pipeline_configs_file);
+DECLARE_string(write_req_log_file);
+DECLARE_string(read_req_log_file);
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+class P4AsyncRpcHandlerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    switch_mock_ = absl::make_unique<SwitchMock>();
+    auth_policy_checker_mock_ = absl::make_unique<AuthPolicyCheckerMock>();
+    error_buffer_ = absl::make_unique<ErrorBuffer>();
+    FLAGS_forwarding_pipeline_configs_file =
+        FLAGS_test_tmpdir + "/forwarding_pipeline_configs_file.pb.txt";
+    FLAGS_write_req_log_file = "";
+    FLAGS_read_req_log_file = "";
+    p4_service_ = absl::make_unique<P4Service>(
+        OPERATION_MODE_STANDALONE, switch_mock_.get(),
+        auth_policy_checker_mock_.get(), error_buffer_.get());
+  }
+
+  void StartServer(const P4AsyncRpcHandler::Options& options) {
+    std::string url =
+        "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
+    auto ret =
+        P4AsyncRpcHandler::CreateInstance(p4_service_.get(), &builder, options);
+    ASSERT_OK(ret.status());
+    handler_ = ret.ConsumeValueOrDie();
+    builder.RegisterService(p4_service_.get());
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+    ASSERT_OK(handler_->Start());
+    stub_ = ::p4::v1::P4Runtime::NewStub(
+        ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
+    ASSERT_NE(stub_, nullptr);
+  }
+
+  void TearDown() override {
+    if (server_) server_->Shutdown(absl::ToChronoTime(absl::Now()));
+    if (handler_) handler_->Shutdown();
+  }
+
+  // Arguments and result of a Write RPC sent from a separate thread.
+  struct WriteArgs {
+    ::p4::v1::P4Runtime::Stub* stub;
+    ::grpc::Status status;
+    absl::Notification done;
+  };
+
+  static void* WriteThreadFunc(void* arg) {
+    WriteArgs* args = static_cast<WriteArgs*>(arg);
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteRequest req;
+    req.add_updates()->set_type(::p4::v1::Update::INSERT);
+    ::p4::v1::WriteResponse resp;
+    args->status = args->stub->Write(&context, req, &resp);
+    args->done.Notify();
+    return nullptr;
+  }
+
+  std::unique_ptr<SwitchMock> switch_mock_;
+  std::unique_ptr<AuthPolicyCheckerMock> auth_policy_checker_mock_;
+  std::unique_ptr<ErrorBuffer> error_buffer_;
+  std::unique_ptr<P4Service> p4_service_;
+  std::unique_ptr<P4AsyncRpcHandler> handler_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::unique_ptr<::p4::v1::P4Runtime::Stub> stub_;
+};
+
+TEST_F(P4AsyncRpcHandlerTest, WriteIsServedAsynchronously) {
+  ASSERT_NO_FATAL_FAILURE(StartServer(P4AsyncRpcHandler::Options()));
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteRequest req;
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+  ::p4::v1::WriteResponse resp;
+  ::grpc::Status status = stub_->Write(&context, req, &resp);
+
+  // No device ID given.
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  EXPECT_EQ("Invalid device ID.", status.error_message());
+}
+
+TEST_F(P4AsyncRpcHandlerTest, ReadIsServedAsynchronously) {
+  ASSERT_NO_FATAL_FAILURE(StartServer(P4AsyncRpcHandler::Options()));
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Read", _))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+
+  {
+    // Empty read.
+    ::grpc::ClientContext context;
+    ::p4::v1::ReadRequest req;
+    req.set_device_id(1);
+    ::p4::v1::ReadResponse resp;
+    auto reader = stub_->Read(&context, req);
+    EXPECT_FALSE(reader->Read(&resp));
+    EXPECT_TRUE(reader->Finish().ok());
+  }
+  {
+    // No device ID given.
+    ::grpc::ClientContext context;
+    ::p4::v1::ReadRequest req;
+    req.add_entities()->mutable_table_entry();
+    ::p4::v1::ReadResponse resp;
+    auto reader = stub_->Read(&context, req);
+    EXPECT_FALSE(reader->Read(&resp));
+    ::grpc::Status status = reader->Finish();
+    EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  }
+}
+
+TEST_F(P4AsyncRpcHandlerTest, WriteIsRejectedWhenExecutorIsFull) {
+  P4AsyncRpcHandler::Options options;
+  options.num_cq_threads = 1;
+  options.num_executor_threads = 1;
+  options.max_pending_requests = 1;
+  ASSERT_NO_FATAL_FAILURE(StartServer(options));
+  absl::Notification first_call_started, release_first_call;
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Invoke([&](const std::string&, const std::string&,
+                           const ::grpc::AuthContext&) {
+        first_call_started.Notify();
+        release_first_call.WaitForNotification();
+        return ::util::OkStatus();
+      }))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // The first call occupies the only executor thread. Of the next two calls,
+  // one is queued and the other one is rejected right away.
+  WriteArgs args[3];
+  pthread_t tids[3];
+  for (int i = 0; i < 3; ++i) {
+    args[i].stub = stub_.get();
+    ASSERT_FALSE(
+        pthread_create(&tids[i], nullptr, &WriteThreadFunc, &args[i]));
+    if (i == 0) first_call_started.WaitForNotification();
+  }
+  // The queued call cannot finish before the first one is released.
+  while (!args[1].done.HasBeenNotified() && !args[2].done.HasBeenNotified()) {
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+  const int rejected = args[1].done.HasBeenNotified() ? 1 : 2;
+  const int queued = 3 - rejected;
+  EXPECT_EQ(::grpc::StatusCode::RESOURCE_EXHAUSTED,
+            args[rejected].status.error_code());
+  release_first_call.Notify();
+  for (pthread_t tid : tids) ASSERT_FALSE(pthread_join(tid, nullptr));
+
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, args[0].status.error_code());
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT,
+            args[queued].status.error_code());
+}
+
+TEST_F(P4AsyncRpcHandlerTest, ShutdownWithoutStart) {
+  ::grpc::ServerBuilder builder;
+  auto ret = P4AsyncRpcHandler::CreateInstance(
+      p4_service_.get(), &builder, P4AsyncRpcHandler::Options());
+  ASSERT_OK(ret.status());
+  ret.ValueOrDie()->Shutdown();
+}
+
+TEST_F(P4AsyncRpcHandlerTest, CreateInstanceFailsForInvalidOptions) {
+  ::grpc::ServerBuilder builder;
+  P4AsyncRpcHandler::Options options;
+  options.num_cq_threads = 0;
+  EXPECT_FALSE(
+      P4AsyncRpcHandler::CreateInstance(p4_service_.get(), &builder, options)
+          .ok());
+  options = P4AsyncRpcHandler::Options();
+  options.num_executor_threads = 0;
+  EXPECT_FALSE(
+      P4AsyncRpcHandler::CreateInstance(p4_service_.get(), &builder, options)
+          .ok());
+}
+
+}  // namespace hal
+}  // namespace stratum
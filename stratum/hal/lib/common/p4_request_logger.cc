@@ -0,0 +1,320 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/p4_request_logger.h"
+
+#include <stdio.h>
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/util/delimited_message_util.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/p4_request_log.pb.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+P4RequestLogger::P4RequestLogger(const std::string& file_path,
+                                 const Options& options)
+    : file_path_(file_path),
+      options_(options),
+      ring_(options.ring_buffer_size),
+      ring_head_(0),
+      ring_size_(0),
+      num_enqueued_(0),
+      num_handled_(0),
+      num_dropped_(0),
+      num_written_records_(0),
+      flush_requested_(false),
+      shutdown_(false),
+      writer_tid_(0),
+      log_file_(),
+      log_file_size_(0) {}
+
+P4RequestLogger::~P4RequestLogger() { Shutdown(); }
+
+::util::StatusOr<std::unique_ptr<P4RequestLogger>>
+P4RequestLogger::CreateInstance(const std::string& file_path,
+                                const Options& options) {
+  RET_CHECK(!file_path.empty()) << "Empty log file path.";
+  RET_CHECK(options.ring_buffer_size > 0)
+      << "Ring buffer size must be positive.";
+  RET_CHECK(options.max_file_size_bytes >= 0)
+      << "Max file size must not be negative.";
+  RET_CHECK(options.max_rotated_files >= 0)
+      << "Number of rotated files must not be negative.";
+  auto logger = absl::WrapUnique(new P4RequestLogger(file_path, options));
+  int ret = pthread_create(&logger->writer_tid_, nullptr,
+                           &P4RequestLogger::WriterThreadFunc, logger.get());
+  if (ret != 0) {
+    logger->writer_tid_ = 0;
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to spawn the request logger thread for " << file_path
+           << ". Err: " << ret << ".";
+  }
+
+  return std::move(logger);
+}
+
+void P4RequestLogger::LogWriteRequest(
+    uint64 node_id, std::shared_ptr<const ::p4::v1::WriteRequest> req,
+    std::vector<::util::Status> results, absl::Time timestamp) {
+  // Nothing to log if the switch interface did not fill in any error details.
+  if (req == nullptr || results.empty()) return;
+  if (results.size() != req->updates_size()) {
+    LOG(ERROR) << "Size mismatch: " << results.size()
+               << " != " << req->updates_size() << ". Did not log anything!";
+    return;
+  }
+  auto request = absl::make_unique<PendingRequest>();
+  request->node_id = node_id;
+  request->timestamp = timestamp;
+  request->write_req = std::move(req);
+  request->results = std::move(results);
+  Enqueue(std::move(request));
+}
+
+void P4RequestLogger::LogReadRequest(
+    uint64 node_id, std::shared_ptr<const ::p4::v1::ReadRequest> req,
+    std::vector<::util::Status> results, absl::Time timestamp) {
+  // Nothing to log if the switch interface did not fill in any error details.
+  if (req == nullptr || results.empty()) return;
+  if (results.size() != req->entities_size()) {
+    LOG(ERROR) << "Size mismatch: " << results.size()
+               << " != " << req->entities_size() << ". Did not log anything!";
+    return;
+  }
+  auto request = absl::make_unique<PendingRequest>();
+  request->node_id = node_id;
+  request->timestamp = timestamp;
+  request->read_req = std::move(req);
+  request->results = std::move(results);
+  Enqueue(std::move(request));
+}
+
+void P4RequestLogger::Flush() {
+  absl::MutexLock l(&ring_lock_);
+  const uint64 target = num_enqueued_;
+  while (num_handled_ < target) {
+    flush_requested_ = true;
+    ring_not_empty_.Signal();
+    batch_written_.Wait(&ring_lock_);
+  }
+}
+
+void P4RequestLogger::Shutdown() {
+  {
+    absl::MutexLock l(&ring_lock_);
+    if (shutdown_) return;
+    shutdown_ = true;
+    ring_not_empty_.Signal();
+  }
+  if (writer_tid_ != 0) {
+    int ret = pthread_join(writer_tid_, nullptr);
+    if (ret != 0) {
+      LOG(ERROR) << "Failed to join the request logger thread for "
+                 << file_path_ << " with error " << ret << ".";
+    }
+    writer_tid_ = 0;
+  }
+  if (log_file_.is_open()) log_file_.close();
+}
+
+uint64 P4RequestLogger::GetDroppedRequestsCount() const {
+  absl::MutexLock l(&ring_lock_);
+  return num_dropped_;
+}
+
+uint64 P4RequestLogger::GetWrittenRecordsCount() const {
+  absl::MutexLock l(&ring_lock_);
+  return num_written_records_;
+}
+
+void P4RequestLogger::Enqueue(std::unique_ptr<PendingRequest> request) {
+  absl::MutexLock l(&ring_lock_);
+  if (shutdown_ || ring_size_ == ring_.size()) {
+    ++num_dropped_;
+    LOG_EVERY_N(WARNING, 500) << "Request log buffer for " << file_path_
+                              << " is full. Dropped " << num_dropped_
+                              << " requests so far.";
+    return;
+  }
+  ring_[(ring_head_ + ring_size_) % ring_.size()] = std::move(request);
+  ++ring_size_;
+  ++num_enqueued_;
+  // Wake up the writer early only if the buffer starts filling up. Otherwise
+  // it wakes up by itself every flush_interval, to write bigger batches.
+  if (ring_size_ >= (ring_.size() + 1) / 2) ring_not_empty_.Signal();
+}
+
+void* P4RequestLogger::WriterThreadFunc(void* arg) {
+  P4RequestLogger* logger = static_cast<P4RequestLogger*>(arg);
+  logger->WriterLoop();
+  return nullptr;
+}
+
+void P4RequestLogger::WriterLoop() {
+  std::vector<std::unique_ptr<PendingRequest>> batch;
+  batch.reserve(ring_.size());
+  while (true) {
+    {
+      absl::MutexLock l(&ring_lock_);
+      if (!shutdown_ && !flush_requested_ &&
+          ring_size_ < (ring_.size() + 1) / 2) {
+        ring_not_empty_.WaitWithTimeout(&ring_lock_, options_.flush_interval);
+      }
+      while (ring_size_ > 0) {
+        batch.push_back(std::move(ring_[ring_head_]));
+        ring_head_ = (ring_head_ + 1) % ring_.size();
+        --ring_size_;
+      }
+      flush_requested_ = false;
+      if (batch.empty()) {
+        // Wake up any Flush() which raced with an empty drain.
+        batch_written_.SignalAll();
+        if (shutdown_) break;
+        continue;
+      }
+    }
+    // No lock held while formatting and writing. The requests are released
+    // before Flush() returns.
+    const uint64 num_records = WriteBatch(batch);
+    const size_t num_requests = batch.size();
+    batch.clear();
+    {
+      absl::MutexLock l(&ring_lock_);
+      num_handled_ += num_requests;
+      num_written_records_ += num_records;
+      batch_written_.SignalAll();
+    }
+  }
+}
+
+uint64 P4RequestLogger::WriteBatch(
+    const std::vector<std::unique_ptr<PendingRequest>>& batch) {
+  std::string buffer;
+  uint64 num_records = 0;
+  for (const auto& request : batch) {
+    FormatRequest(*request, &buffer, &num_records);
+  }
+
+  if (!log_file_.is_open()) {
+    ::util::Status status = OpenLogFile();
+    if (!status.ok()) {
+      LOG_EVERY_N(ERROR, 50) << "Failed to log the requests: "
+                             << status.error_message();
+      return 0;
+    }
+  }
+  if (options_.max_file_size_bytes > 0 && log_file_size_ > 0 &&
+      log_file_size_ + static_cast<int64>(buffer.size()) >
+          options_.max_file_size_bytes) {
+    ::util::Status status = RotateLogFile();
+    if (!status.ok()) {
+      LOG_EVERY_N(ERROR, 50) << "Failed to rotate the request log file: "
+                             << status.error_message();
+      return 0;
+    }
+  }
+  log_file_.write(buffer.data(), buffer.size());
+  log_file_.flush();
+  if (!log_file_.good()) {
+    LOG_EVERY_N(ERROR, 50) << "Failed to write to the request log file "
+                           << file_path_ << ".";
+    log_file_.close();
+    return 0;
+  }
+  log_file_size_ += buffer.size();
+
+  return num_records;
+}
+
+void P4RequestLogger::FormatRequest(const PendingRequest& request,
+                                    std::string* buffer,
+                                    uint64* num_records) const {
+  const int num_items = request.write_req ? request.write_req->updates_size()
+                                          : request.read_req->entities_size();
+  if (options_.format == LOG_FORMAT_BINARY) {
+    ::google::protobuf::io::StringOutputStream output(buffer);
+    P4RequestLogEntry entry;
+    entry.set_timestamp_usec(absl::ToUnixMicros(request.timestamp));
+    entry.set_node_id(request.node_id);
+    for (int i = 0; i < num_items; ++i) {
+      if (request.write_req) {
+        *entry.mutable_update() = request.write_req->updates(i);
+      } else {
+        *entry.mutable_entity() = request.read_req->entities(i);
+      }
+      const ::util::Status& result = request.results[i];
+      entry.set_canonical_code(ToGoogleRpcCode(result.CanonicalCode()));
+      entry.set_error_code(result.error_code());
+      entry.set_error_message(result.error_message());
+      if (!::google::protobuf::util::SerializeDelimitedToZeroCopyStream(
+              entry, &output)) {
+        LOG_EVERY_N(ERROR, 50) << "Failed to serialize request log entry.";
+        continue;
+      }
+      ++*num_records;
+    }
+  } else {
+    const std::string ts = absl::FormatTime(
+        "%Y-%m-%d %H:%M:%E6S", request.timestamp, absl::LocalTimeZone());
+    for (int i = 0; i < num_items; ++i) {
+      absl::StrAppend(buffer, ts, ";", request.node_id, ";",
+                      request.write_req
+                          ? request.write_req->updates(i).ShortDebugString()
+                          : request.read_req->entities(i).ShortDebugString(),
+                      ";", request.results[i].error_message(), "\n");
+      ++*num_records;
+    }
+  }
+}
+
+::util::Status P4RequestLogger::OpenLogFile() {
+  log_file_.clear();
+  log_file_.open(file_path_.c_str(), std::ofstream::out |
+                                         std::ofstream::app |
+                                         std::ofstream::binary);
+  if (!log_file_.is_open()) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Error when opening " << file_path_ << ".";
+  }
+  log_file_.seekp(0, std::ofstream::end);
+  log_file_size_ = log_file_.tellp();
+  if (log_file_size_ < 0) log_file_size_ = 0;
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4RequestLogger::RotateLogFile() {
+  log_file_.close();
+  if (options_.max_rotated_files == 0) {
+    RETURN_IF_ERROR(RemoveFile(file_path_));
+  } else {
+    // <file>.N-1 -> <file>.N, ..., <file> -> <file>.1. The oldest file is
+    // overwritten by the rename.
+    for (int i = options_.max_rotated_files - 1; i >= 0; --i) {
+      const std::string from =
+          i == 0 ? file_path_ : absl::StrCat(file_path_, ".", i);
+      const std::string to = absl::StrCat(file_path_, ".", i + 1);
+      if (!PathExists(from)) continue;
+      if (rename(from.c_str(), to.c_str()) != 0) {
+        return MAKE_ERROR(ERR_INTERNAL)
+               << "Failed to rename " << from << " to " << to << ".";
+      }
+    }
+  }
+
+  return OpenLogFile();
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,195 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_P4_REQUEST_LOGGER_H_
+#define STRATUM_HAL_LIB_COMMON_P4_REQUEST_LOGGER_H_
+
+#include <pthread.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+
+namespace stratum {
+namespace hal {
+
+// The "P4RequestLogger" class logs P4Runtime Write and Read requests together
+// with their per-update/per-entity results, without doing any formatting or
+// file I/O on the calling (RPC) thread. The callers push a shared reference to
+// the immutable request into a bounded ring buffer. Callers which do not own
+// the request, like the synchronous gRPC handlers, have to copy it first. A
+// background thread drains the buffer in batches, formats the records and
+// appends them to the log file, rotating the file when it grows beyond a
+// configured size. If the ring buffer is full, the request is dropped and
+// accounted for in a drop counter.
+class P4RequestLogger {
+ public:
+  // Format of the log records.
+  enum LogFormat {
+    // One line per update/entity:
+    // <timestamp>;<node_id>;<update/entity proto>;<status>
+    LOG_FORMAT_TEXT,
+    // Length-delimited P4RequestLogEntry protos.
+    LOG_FORMAT_BINARY,
+  };
+
+  struct Options {
+    LogFormat format = LOG_FORMAT_TEXT;
+    // Max number of requests waiting in the ring buffer to be written.
+    size_t ring_buffer_size = 1024;
+    // The log file is rotated when its size goes beyond this limit. A value of
+    // 0 disables rotation.
+    int64 max_file_size_bytes = 0;
+    // Number of rotated files (<file>.1 ... <file>.N) kept around.
+    int max_rotated_files = 1;
+    // Max time a record may wait in the ring buffer before being written.
+    absl::Duration flush_interval = absl::Milliseconds(100);
+  };
+
+  virtual ~P4RequestLogger();
+
+  // Enqueues a write request and the results of its individual updates. The
+  // logger shares the ownership of the request until it is written, so the
+  // request must not be modified afterwards. The request is not logged if
+  // results is empty or its size does not match the number of updates.
+  void LogWriteRequest(uint64 node_id,
+                       std::shared_ptr<const ::p4::v1::WriteRequest> req,
+                       std::vector<::util::Status> results,
+                       absl::Time timestamp) LOCKS_EXCLUDED(ring_lock_);
+
+  // Enqueues a read request and the results of its individual entities. The
+  // logger shares the ownership of the request until it is written, so the
+  // request must not be modified afterwards. The request is not logged if
+  // results is empty or its size does not match the number of entities.
+  void LogReadRequest(uint64 node_id,
+                      std::shared_ptr<const ::p4::v1::ReadRequest> req,
+                      std::vector<::util::Status> results,
+                      absl::Time timestamp) LOCKS_EXCLUDED(ring_lock_);
+
+  // Blocks until all the requests enqueued before this call have been written
+  // to the log file.
+  void Flush() LOCKS_EXCLUDED(ring_lock_);
+
+  // Writes all the pending requests and stops the background thread. Further
+  // requests are dropped. Called by the destructor.
+  void Shutdown() LOCKS_EXCLUDED(ring_lock_);
+
+  // Returns the number of requests dropped because the ring buffer was full
+  // (or the logger was shut down).
+  uint64 GetDroppedRequestsCount() const LOCKS_EXCLUDED(ring_lock_);
+
+  // Returns the number of records (i.e. updates or entities) written so far.
+  uint64 GetWrittenRecordsCount() const LOCKS_EXCLUDED(ring_lock_);
+
+  // Returns the path of the log file.
+  const std::string& file_path() const { return file_path_; }
+
+  // Returns the options the logger was created with.
+  const Options& options() const { return options_; }
+
+  // Creates a logger appending to the given file and starts its background
+  // thread.
+  static ::util::StatusOr<std::unique_ptr<P4RequestLogger>> CreateInstance(
+      const std::string& file_path, const Options& options);
+
+  // P4RequestLogger is neither copyable nor movable.
+  P4RequestLogger(const P4RequestLogger&) = delete;
+  P4RequestLogger& operator=(const P4RequestLogger&) = delete;
+
+ private:
+  // A single request waiting in the ring buffer. Exactly one of write_req and
+  // read_req is set.
+  struct PendingRequest {
+    uint64 node_id;
+    absl::Time timestamp;
+    std::shared_ptr<const ::p4::v1::WriteRequest> write_req;
+    std::shared_ptr<const ::p4::v1::ReadRequest> read_req;
+    std::vector<::util::Status> results;
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance.
+  P4RequestLogger(const std::string& file_path, const Options& options);
+
+  // Pushes the request into the ring buffer, or drops it if the buffer is
+  // full.
+  void Enqueue(std::unique_ptr<PendingRequest> request)
+      LOCKS_EXCLUDED(ring_lock_);
+
+  // Thread function for the background writer.
+  static void* WriterThreadFunc(void* arg);
+
+  // Main loop of the background writer.
+  void WriterLoop() LOCKS_EXCLUDED(ring_lock_);
+
+  // Formats the given requests and appends them to the log file. Returns the
+  // number of records written.
+  uint64 WriteBatch(const std::vector<std::unique_ptr<PendingRequest>>& batch);
+
+  // Appends the formatted record(s) of a single request to the buffer.
+  void FormatRequest(const PendingRequest& request, std::string* buffer,
+                     uint64* num_records) const;
+
+  // Opens (or re-opens) the log file in append mode.
+  ::util::Status OpenLogFile();
+
+  // Closes the current log file, shifts the rotated files and opens a new,
+  // empty log file.
+  ::util::Status RotateLogFile();
+
+  // Path and options, set in the constructor and never changed afterwards.
+  const std::string file_path_;
+  const Options options_;
+
+  // Protects the ring buffer and the counters. Only held for O(1) operations
+  // on the RPC threads. No formatting or file I/O is done while holding it.
+  mutable absl::Mutex ring_lock_;
+
+  // Signaled when new requests are enqueued or on shutdown.
+  absl::CondVar ring_not_empty_;
+
+  // Signaled by the writer thread after writing a batch.
+  absl::CondVar batch_written_;
+
+  // The ring buffer of pending requests, with ring_size_ elements starting at
+  // ring_head_.
+  std::vector<std::unique_ptr<PendingRequest>> ring_ GUARDED_BY(ring_lock_);
+  size_t ring_head_ GUARDED_BY(ring_lock_);
+  size_t ring_size_ GUARDED_BY(ring_lock_);
+
+  // Number of requests enqueued and number of requests handled (written or
+  // failed to be written) by the writer thread. Used by Flush().
+  uint64 num_enqueued_ GUARDED_BY(ring_lock_);
+  uint64 num_handled_ GUARDED_BY(ring_lock_);
+
+  // Counters exposed for monitoring.
+  uint64 num_dropped_ GUARDED_BY(ring_lock_);
+  uint64 num_written_records_ GUARDED_BY(ring_lock_);
+
+  // Set by Flush() to make the writer thread drain the ring buffer right away.
+  bool flush_requested_ GUARDED_BY(ring_lock_);
+
+  // Set to true when the logger is shutting down.
+  bool shutdown_ GUARDED_BY(ring_lock_);
+
+  // The background writer thread id, 0 if not running.
+  pthread_t writer_tid_;
+
+  // The log file and its current size. Only accessed by the writer thread
+  // (and by CreateInstance() before the thread is started).
+  std::ofstream log_file_;
+  int64 log_file_size_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_P4_REQUEST_LOGGER_H_
@@ -0,0 +1,228 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/p4_request_logger.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/util/delimited_message_util.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/p4_request_log.pb.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+namespace hal {
+
+using ::testing::HasSubstr;
+
+class P4RequestLoggerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    log_file_ = FLAGS_test_tmpdir + "/p4_request_logger_test.log";
+    for (const auto& path : {log_file_, log_file_ + ".1", log_file_ + ".2"}) {
+      if (PathExists(path)) {
+        ASSERT_OK(RemoveFile(path));
+      }
+    }
+  }
+
+  std::unique_ptr<P4RequestLogger> CreateLogger(
+      const P4RequestLogger::Options& options) {
+    auto ret = P4RequestLogger::CreateInstance(log_file_, options);
+    EXPECT_OK(ret.status());
+    return ret.ok() ? ret.ConsumeValueOrDie() : nullptr;
+  }
+
+  static std::shared_ptr<const ::p4::v1::WriteRequest> MakeWriteRequest(
+      int num_updates) {
+    auto req = std::make_shared<::p4::v1::WriteRequest>();
+    req->set_device_id(kNodeId);
+    for (int i = 0; i < num_updates; ++i) {
+      auto* update = req->add_updates();
+      update->set_type(::p4::v1::Update::INSERT);
+      update->mutable_entity()->mutable_table_entry()->set_table_id(kTableId);
+      update->mutable_entity()->mutable_table_entry()->set_priority(i + 1);
+    }
+    return req;
+  }
+
+  static constexpr uint64 kNodeId = 123123123;
+  static constexpr uint32 kTableId = 33554433;
+  static constexpr char kErrorMsg[] = "Some error";
+
+  std::string log_file_;
+};
+
+constexpr uint64 P4RequestLoggerTest::kNodeId;
+constexpr uint32 P4RequestLoggerTest::kTableId;
+constexpr char P4RequestLoggerTest::kErrorMsg[];
+
+TEST_F(P4RequestLoggerTest, LogWriteRequestInTextFormat) {
+  auto logger = CreateLogger(P4RequestLogger::Options());
+  ASSERT_NE(nullptr, logger);
+  const auto req = MakeWriteRequest(2);
+  std::vector<::util::Status> results = {
+      ::util::OkStatus(),
+      ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM, kErrorMsg)};
+
+  logger->LogWriteRequest(kNodeId, req, results, absl::Now());
+  logger->Flush();
+
+  EXPECT_EQ(2U, logger->GetWrittenRecordsCount());
+  EXPECT_EQ(0U, logger->GetDroppedRequestsCount());
+  std::string s;
+  ASSERT_OK(ReadFileToString(log_file_, &s));
+  std::vector<std::string> lines = absl::StrSplit(s, '\n', absl::SkipEmpty());
+  ASSERT_EQ(2U, lines.size());
+  EXPECT_THAT(lines[0], HasSubstr(absl::StrCat(";", kNodeId, ";")));
+  EXPECT_THAT(lines[0], HasSubstr(req->updates(0).ShortDebugString()));
+  EXPECT_THAT(lines[1], HasSubstr(req->updates(1).ShortDebugString()));
+  EXPECT_THAT(lines[1], HasSubstr(kErrorMsg));
+}
+
+TEST_F(P4RequestLoggerTest, LogReadRequestInBinaryFormat) {
+  P4RequestLogger::Options options;
+  options.format = P4RequestLogger::LOG_FORMAT_BINARY;
+  auto logger = CreateLogger(options);
+  ASSERT_NE(nullptr, logger);
+  auto req = std::make_shared<::p4::v1::ReadRequest>();
+  req->set_device_id(kNodeId);
+  req->add_entities()->mutable_table_entry()->set_table_id(kTableId);
+  req->add_entities()->mutable_counter_entry()->set_counter_id(kTableId);
+  std::vector<::util::Status> results = {
+      ::util::Status(StratumErrorSpace(), ERR_ENTRY_NOT_FOUND, kErrorMsg),
+      ::util::OkStatus()};
+  const absl::Time timestamp = absl::Now();
+
+  logger->LogReadRequest(kNodeId, req, results, timestamp);
+  logger->Flush();
+
+  EXPECT_EQ(2U, logger->GetWrittenRecordsCount());
+  std::string s;
+  ASSERT_OK(ReadFileToString(log_file_, &s));
+  ::google::protobuf::io::ArrayInputStream input(s.data(), s.size());
+  for (int i = 0; i < req->entities_size(); ++i) {
+    P4RequestLogEntry entry;
+    bool clean_eof = false;
+    ASSERT_TRUE(::google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+        &entry, &input, &clean_eof));
+    EXPECT_EQ(kNodeId, entry.node_id());
+    EXPECT_EQ(absl::ToUnixMicros(timestamp), entry.timestamp_usec());
+    EXPECT_TRUE(ProtoEqual(req->entities(i), entry.entity()));
+    EXPECT_EQ(results[i].error_code(), entry.error_code());
+    EXPECT_EQ(results[i].error_message(), entry.error_message());
+  }
+  P4RequestLogEntry entry;
+  bool clean_eof = false;
+  EXPECT_FALSE(::google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+      &entry, &input, &clean_eof));
+  EXPECT_TRUE(clean_eof);
+}
+
+TEST_F(P4RequestLoggerTest, RequestIsReleasedOnceWritten) {
+  auto logger = CreateLogger(P4RequestLogger::Options());
+  ASSERT_NE(nullptr, logger);
+  auto req = MakeWriteRequest(1);
+  std::weak_ptr<const ::p4::v1::WriteRequest> weak_req = req;
+
+  logger->LogWriteRequest(kNodeId, std::move(req), {::util::OkStatus()},
+                          absl::Now());
+  logger->Flush();
+
+  EXPECT_EQ(1U, logger->GetWrittenRecordsCount());
+  EXPECT_TRUE(weak_req.expired());
+}
+
+TEST_F(P4RequestLoggerTest, SizeMismatchIsNotLogged) {
+  auto logger = CreateLogger(P4RequestLogger::Options());
+  ASSERT_NE(nullptr, logger);
+  const auto req = MakeWriteRequest(2);
+
+  logger->LogWriteRequest(kNodeId, req, {::util::OkStatus()}, absl::Now());
+  logger->LogWriteRequest(kNodeId, req, {}, absl::Now());
+  logger->Flush();
+
+  EXPECT_EQ(0U, logger->GetWrittenRecordsCount());
+  EXPECT_EQ(0U, logger->GetDroppedRequestsCount());
+  EXPECT_FALSE(PathExists(log_file_));
+}
+
+TEST_F(P4RequestLoggerTest, LogFileIsRotated) {
+  P4RequestLogger::Options options;
+  options.max_file_size_bytes = 100;
+  options.max_rotated_files = 2;
+  auto logger = CreateLogger(options);
+  ASSERT_NE(nullptr, logger);
+  const auto req = MakeWriteRequest(1);
+
+  // Every request is bigger than half of the max file size. Flushing after
+  // each request makes every request its own batch.
+  for (int i = 0; i < 4; ++i) {
+    logger->LogWriteRequest(kNodeId, req, {::util::OkStatus()}, absl::Now());
+    logger->Flush();
+  }
+
+  EXPECT_EQ(4U, logger->GetWrittenRecordsCount());
+  EXPECT_TRUE(PathExists(log_file_));
+  EXPECT_TRUE(PathExists(log_file_ + ".1"));
+  EXPECT_TRUE(PathExists(log_file_ + ".2"));
+  EXPECT_FALSE(PathExists(log_file_ + ".3"));
+  std::string s;
+  ASSERT_OK(ReadFileToString(log_file_, &s));
+  EXPECT_THAT(s, HasSubstr(req->updates(0).ShortDebugString()));
+}
+
+TEST_F(P4RequestLoggerTest, RequestsAreDroppedAfterShutdown) {
+  auto logger = CreateLogger(P4RequestLogger::Options());
+  ASSERT_NE(nullptr, logger);
+  const auto req = MakeWriteRequest(1);
+
+  logger->LogWriteRequest(kNodeId, req, {::util::OkStatus()}, absl::Now());
+  logger->Shutdown();
+  logger->LogWriteRequest(kNodeId, req, {::util::OkStatus()}, absl::Now());
+
+  // The pending request is written on shutdown, the later one is dropped.
+  EXPECT_EQ(1U, logger->GetWrittenRecordsCount());
+  EXPECT_EQ(1U, logger->GetDroppedRequestsCount());
+}
+
+TEST_F(P4RequestLoggerTest, AllRequestsAreWrittenOrDropped) {
+  P4RequestLogger::Options options;
+  options.ring_buffer_size = 4;
+  auto logger = CreateLogger(options);
+  ASSERT_NE(nullptr, logger);
+  const auto req = MakeWriteRequest(1);
+
+  constexpr uint64 kNumRequests = 1000;
+  for (uint64 i = 0; i < kNumRequests; ++i) {
+    logger->LogWriteRequest(kNodeId, req, {::util::OkStatus()}, absl::Now());
+  }
+  logger->Flush();
+
+  EXPECT_EQ(kNumRequests, logger->GetWrittenRecordsCount() +
+                              logger->GetDroppedRequestsCount());
+}
+
+TEST_F(P4RequestLoggerTest, CreateInstanceFailsForInvalidOptions) {
+  P4RequestLogger::Options options;
+  options.ring_buffer_size = 0;
+  EXPECT_FALSE(P4RequestLogger::CreateInstance(log_file_, options).ok());
+  EXPECT_FALSE(
+      P4RequestLogger::CreateInstance("", P4RequestLogger::Options()).ok());
+}
+
+}  // namespace hal
+}  // namespace stratum
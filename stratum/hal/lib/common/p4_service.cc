@@ -32,15 +32,35 @@ DEFINE_string(forwarding_pipeline_configs_file,
               "The latest set of verified ForwardingPipelineConfig protos "
               "pushed to the switch. This file is updated whenever "
               "ForwardingPipelineConfig proto for switching node is added or "
-              "modified.");
+              "modified. The file is written in the background; a failed "
+              "write is logged and reported as a critical error of the "
+              "switch.");
 DEFINE_string(write_req_log_file, "/var/log/stratum/p4_writes.pb.txt",
               "The log file for all the individual write request updates and "
-              "the corresponding result. The format for each line is: "
-              "<timestamp>;<node_id>;<update proto>;<status>.");
+              "the corresponding result. In text format, each line is: "
+              "<timestamp>;<node_id>;<update proto>;<status>. Empty to "
+              "disable logging.");
 DEFINE_string(read_req_log_file, "/var/log/stratum/p4_reads.pb.txt",
               "The log file for all the individual read request and "
-              "the corresponding result. The format for each line is: "
-              "<timestamp>;<node_id>;<request proto>;<status>.");
+              "the corresponding result. In text format, each line is: "
+              "<timestamp>;<node_id>;<request proto>;<status>. Empty to "
+              "disable logging.");
+DEFINE_string(p4_req_log_format, "text",
+              "Format of the write and read request logs. Either 'text' or "
+              "'binary' (length-delimited P4RequestLogEntry protos).");
+DEFINE_int32(p4_req_log_buffer_size, 1024,
+             "Max number of requests waiting to be written to a request log. "
+             "Requests are dropped when the buffer is full.");
+DEFINE_int64(p4_req_log_max_file_size, 64 * 1024 * 1024,
+             "Request log files are rotated when they grow beyond this size in "
+             "bytes. 0 disables rotation.");
+DEFINE_int32(p4_req_log_max_rotated_files, 3,
+             "Number of rotated request log files kept around.");
+DEFINE_bool(skip_unchanged_forwarding_pipeline_push, true,
+            "If true, a VERIFY_AND_COMMIT or RECONCILE_AND_COMMIT of a "
+            "forwarding pipeline config identical to the one already pushed "
+            "to the node returns right away, without reprogramming the "
+            "switch.");
 DEFINE_int32(max_num_controllers_per_node, 5,
              "Max number of controllers that can manage a node.");
 DEFINE_int32(max_num_controller_connections, 20,
@@ -50,8 +70,86 @@ DEFINE_int32(max_num_controller_connections, 20,
 namespace stratum {
 namespace hal {
 
-// TODO(unknown): This class move possibly big configs in memory. See if there
-// is a way to make this more efficient.
+namespace {
+
+// Helper to build the request logger options from the current flags.
+P4RequestLogger::Options GetRequestLoggerOptions() {
+  P4RequestLogger::Options options;
+  options.format = FLAGS_p4_req_log_format == "binary"
+                       ? P4RequestLogger::LOG_FORMAT_BINARY
+                       : P4RequestLogger::LOG_FORMAT_TEXT;
+  // Checked before the conversion, as a negative size would wrap around. A
+  // size of 0 makes the logger creation fail.
+  options.ring_buffer_size =
+      FLAGS_p4_req_log_buffer_size > 0 ? FLAGS_p4_req_log_buffer_size : 0;
+  options.max_file_size_bytes = FLAGS_p4_req_log_max_file_size;
+  options.max_rotated_files = FLAGS_p4_req_log_max_rotated_files;
+  return options;
+}
+
+// Returns true if the given logger writes to the given file with the given
+// options.
+bool IsRequestLoggerConfigured(const P4RequestLogger& logger,
+                               const std::string& file_path,
+                               const P4RequestLogger::Options& options) {
+  return logger.file_path() == file_path &&
+         logger.options().format == options.format &&
+         logger.options().ring_buffer_size == options.ring_buffer_size &&
+         logger.options().max_file_size_bytes == options.max_file_size_bytes &&
+         logger.options().max_rotated_files == options.max_rotated_files &&
+         logger.options().flush_interval == options.flush_interval;
+}
+
+// Helper to create a request logger for the given file. Returns nullptr if
+// the logger cannot be created.
+std::shared_ptr<P4RequestLogger> CreateRequestLogger(
+    const std::string& file_path, const P4RequestLogger::Options& options) {
+  LOG_IF(ERROR, FLAGS_p4_req_log_format != "text" &&
+                    FLAGS_p4_req_log_format != "binary")
+      << "Invalid request log format '" << FLAGS_p4_req_log_format
+      << "'. Using text format.";
+  auto ret = P4RequestLogger::CreateInstance(file_path, options);
+  if (!ret.ok()) {
+    // Creating the logger is retried by every request.
+    LOG_EVERY_N(ERROR, 100) << "Failed to create the request logger for "
+                            << file_path << ": "
+                            << ret.status().error_message();
+    return nullptr;
+  }
+
+  return ret.ConsumeValueOrDie();
+}
+
+// Helper to create the forwarding pipeline config file saver, reporting failed
+// saves to the given ErrorBuffer. Returns nullptr if the saver cannot be
+// created.
+std::unique_ptr<ConfigFileSaver> CreateConfigFileSaver(
+    ErrorBuffer* error_buffer) {
+  auto ret = ConfigFileSaver::CreateInstance(error_buffer);
+  if (!ret.ok()) {
+    LOG(ERROR) << "Failed to create the config file saver: "
+               << ret.status().error_message()
+               << ". Forwarding pipeline configs will be saved synchronously.";
+    return nullptr;
+  }
+
+  return ret.ConsumeValueOrDie();
+}
+
+// Returns true if the two forwarding pipeline configs are the same. The
+// cheap comparisons (sizes, cookie) are done first so that different configs
+// are usually told apart without comparing the whole P4Info.
+bool IsSameForwardingPipelineConfig(
+    const ::p4::v1::ForwardingPipelineConfig& a,
+    const ::p4::v1::ForwardingPipelineConfig& b) {
+  if (a.p4_device_config().size() != b.p4_device_config().size()) return false;
+  if (a.cookie().cookie() != b.cookie().cookie()) return false;
+  if (a.p4_device_config() != b.p4_device_config()) return false;
+
+  return ProtoEqual(a.p4info(), b.p4info());
+}
+
+}  // namespace
 
 P4Service::P4Service(OperationMode mode, SwitchInterface* switch_interface,
                      AuthPolicyChecker* auth_policy_checker,
@@ -59,10 +157,14 @@ P4Service::P4Service(OperationMode mode, SwitchInterface* switch_interface,
     : node_id_to_controller_manager_(),
       num_controller_connections_(),
       forwarding_pipeline_configs_(nullptr),
+      node_id_to_committed_config_(),
       mode_(mode),
       switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
       auth_policy_checker_(ABSL_DIE_IF_NULL(auth_policy_checker)),
-      error_buffer_(ABSL_DIE_IF_NULL(error_buffer)) {}
+      error_buffer_(ABSL_DIE_IF_NULL(error_buffer)),
+      write_req_logger_(nullptr),
+      read_req_logger_(nullptr),
+      config_file_saver_(CreateConfigFileSaver(error_buffer)) {}
 
 P4Service::~P4Service() {}
 
@@ -108,9 +210,21 @@ P4Service::~P4Service() {}
     }
   }
   {
+    absl::MutexLock push_lock(&config_push_lock_);
+    node_id_to_committed_config_.clear();
     absl::WriterMutexLock l(&config_lock_);
     forwarding_pipeline_configs_ = nullptr;
   }
+  // Make sure the last pushed configs are in the file.
+  if (config_file_saver_) {
+    ::util::Status status = config_file_saver_->Flush();
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to save the forwarding pipeline configs: "
+                 << status.error_message();
+    }
+  }
+  // Make sure all the requests received so far are in the log files.
+  FlushRequestLoggers();
 
   return ::util::OkStatus();
 }
@@ -120,7 +234,9 @@ P4Service::~P4Service() {}
   // push them to the nodes.
   LOG(INFO) << "Pushing the saved forwarding pipeline configs read from "
             << FLAGS_forwarding_pipeline_configs_file << "...";
-  absl::WriterMutexLock l(&config_lock_);
+  absl::MutexLock push_lock(&config_push_lock_);
+  // A save scheduled earlier may still be in flight.
+  if (config_file_saver_) config_file_saver_->Flush().IgnoreError();
   ForwardingPipelineConfigs configs;
   ::util::Status status =
       ReadProtoFromTextFile(FLAGS_forwarding_pipeline_configs_file, &configs);
@@ -146,7 +262,7 @@ P4Service::~P4Service() {}
 
   // Push the forwarding pipeline config for all the nodes we know about. Push
   // the config to hardware only if it is a coldboot setup.
-  forwarding_pipeline_configs_ = absl::make_unique<ForwardingPipelineConfigs>();
+  auto new_configs = std::make_shared<ForwardingPipelineConfigs>();
   if (!warmboot) {
     for (const auto& e : configs.node_id_to_config()) {
       ::util::Status error =
@@ -160,15 +276,24 @@ P4Service::~P4Service() {}
             GTL_LOC);
         APPEND_STATUS_IF_ERROR(status, error);
       } else {
-        (*forwarding_pipeline_configs_->mutable_node_id_to_config())[e.first] =
-            e.second;
+        (*new_configs->mutable_node_id_to_config())[e.first] = e.second;
       }
     }
   } else {
     // In the case of warmboot, the assumption is that the configs saved into
     // file are the latest configs which were already pushed to one or more
     // nodes.
-    *forwarding_pipeline_configs_ = configs;
+    new_configs->Swap(&configs);
+  }
+  node_id_to_committed_config_.clear();
+  for (const auto& e : new_configs->node_id_to_config()) {
+    node_id_to_committed_config_[e.first] =
+        std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>(new_configs,
+                                                                  &e.second);
+  }
+  {
+    absl::WriterMutexLock l(&config_lock_);
+    forwarding_pipeline_configs_ = std::move(new_configs);
   }
 
   return status;
@@ -222,72 +347,6 @@ namespace {
                         from.SerializeAsString());
 }
 
-// Helper to facilitate logging the write requests to the desired log file.
-void LogWriteRequest(uint64 node_id, const ::p4::v1::WriteRequest& req,
-                     const std::vector<::util::Status>& results,
-                     const absl::Time timestamp) {
-  if (FLAGS_write_req_log_file.empty()) {
-    return;
-  }
-  if (results.empty()) {
-    // Nothing to log as the switch interface did not fill in any error details.
-    // TODO(max): Consider logging the requests with the overall status in this
-    //            case. But keep in mind that LogWriteRequest will not be called
-    //            for auth errors or invalid device IDs.
-    return;
-  }
-  if (results.size() != req.updates_size()) {
-    LOG(ERROR) << "Size mismatch: " << results.size()
-               << " != " << req.updates_size() << ". Did not log anything!";
-    return;
-  }
-  std::string msg = "";
-  std::string ts =
-      absl::FormatTime("%Y-%m-%d %H:%M:%E6S", timestamp, absl::LocalTimeZone());
-  for (size_t i = 0; i < results.size(); ++i) {
-    absl::StrAppend(&msg, ts, ";", node_id, ";",
-                    req.updates(i).ShortDebugString(), ";",
-                    results[i].error_message(), "\n");
-  }
-  ::util::Status status =
-      WriteStringToFile(msg, FLAGS_write_req_log_file, /*append=*/true);
-  LOG_IF_EVERY_N(ERROR, !status.ok(), 50)
-      << "Failed to log the write request: " << status.error_message();
-}
-
-// Helper to facilitate logging the read requests to the desired log file.
-void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
-                    const std::vector<::util::Status>& results,
-                    const absl::Time timestamp) {
-  if (FLAGS_read_req_log_file.empty()) {
-    return;
-  }
-  if (results.empty()) {
-    // Nothing to log as the switch interface did not fill in any error details.
-    // TODO(max): Consider logging the requests with the overall status in this
-    //            case. But keep in mind that LogReadRequest will not be called
-    //            for auth errors or invalid device IDs.
-    return;
-  }
-  if (results.size() != req.entities_size()) {
-    LOG(ERROR) << "Size mismatch: " << results.size()
-               << " != " << req.entities_size() << ". Did not log anything!";
-    return;
-  }
-  std::string msg = "";
-  std::string ts =
-      absl::FormatTime("%Y-%m-%d %H:%M:%E6S", timestamp, absl::LocalTimeZone());
-  for (size_t i = 0; i < results.size(); ++i) {
-    absl::StrAppend(&msg, ts, ";", node_id, ";",
-                    req.entities(i).ShortDebugString(), ";",
-                    results[i].error_message(), "\n");
-  }
-  ::util::Status status =
-      WriteStringToFile(msg, FLAGS_read_req_log_file, /*append=*/true);
-  LOG_IF_EVERY_N(ERROR, !status.ok(), 50)
-      << "Failed to log the read request: " << status.error_message();
-}
-
 // Helper function to generate a StreamMessageResponse from a failed Status.
 ::p4::v1::StreamMessageResponse ToStreamMessageResponse(
     const ::util::Status& status) {
@@ -306,6 +365,13 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
 ::grpc::Status P4Service::Write(::grpc::ServerContext* context,
                                 const ::p4::v1::WriteRequest* req,
                                 ::p4::v1::WriteResponse* resp) {
+  return DoWrite(context, req, nullptr, resp);
+}
+
+::grpc::Status P4Service::DoWrite(
+    ::grpc::ServerContext* context, const ::p4::v1::WriteRequest* req,
+    std::shared_ptr<const ::p4::v1::WriteRequest> shared_req,
+    ::p4::v1::WriteResponse* resp) {
   RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, Write, context);
 
   if (!req->updates_size()) return ::grpc::Status::OK;  // Nothing to do.
@@ -317,7 +383,8 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                           "Invalid device ID.");
   }
 
-  // Check that a forwarding config is present.
+  // Check that a forwarding config is present. This only takes a reference to
+  // the current config snapshot, the config itself is not copied.
   auto ret = DoGetForwardingPipelineConfig(node_id);
   if (!ret.ok()) {
     return ::grpc::Status(ToGrpcCode(ret.status().CanonicalCode()),
@@ -344,15 +411,35 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                << ": " << status.error_message();
   }
 
-  // Log debug info for future debugging.
-  LogWriteRequest(node_id, *req, results, timestamp);
+  ::grpc::Status grpc_status = ToGrpcStatus(status, results);
 
-  return ToGrpcStatus(status, results);
+  // Log debug info for future debugging. This only enqueues the request, the
+  // logging is done in the background.
+  std::shared_ptr<P4RequestLogger> logger =
+      GetRequestLogger(FLAGS_write_req_log_file, &write_req_logger_);
+  if (logger) {
+    // A request owned by gRPC is only valid during this call.
+    if (shared_req == nullptr) {
+      shared_req = std::make_shared<const ::p4::v1::WriteRequest>(*req);
+    }
+    logger->LogWriteRequest(node_id, std::move(shared_req), std::move(results),
+                            timestamp);
+  }
+
+  return grpc_status;
 }
 
 ::grpc::Status P4Service::Read(
     ::grpc::ServerContext* context, const ::p4::v1::ReadRequest* req,
     ::grpc::ServerWriter<::p4::v1::ReadResponse>* writer) {
+  ServerWriterWrapper<::p4::v1::ReadResponse> wrapper(writer);
+  return DoRead(context, req, nullptr, &wrapper);
+}
+
+::grpc::Status P4Service::DoRead(
+    ::grpc::ServerContext* context, const ::p4::v1::ReadRequest* req,
+    std::shared_ptr<const ::p4::v1::ReadRequest> shared_req,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
   RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, Read, context);
 
   if (!req->entities_size()) return ::grpc::Status::OK;
@@ -363,12 +450,15 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                           "Invalid device ID.");
   }
 
-  // Check that a forwarding config is present.
+  // Check that a forwarding config is present. The returned snapshot is kept
+  // alive for the duration of this RPC, even if a new pipeline is pushed.
   auto ret = DoGetForwardingPipelineConfig(node_id);
   if (!ret.ok()) {
     return ::grpc::Status(ToGrpcCode(ret.status().CanonicalCode()),
                           ret.status().error_message());
   }
+  const std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig> config =
+      ret.ConsumeValueOrDie();
 
   // To allow role config read filtering in wildcard requests, we have to expand
   // wildcard reads targeting all tables into individual table wildcards. At the
@@ -377,8 +467,7 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
   const ::p4::v1::ReadRequest* original_req = req;  // For later logging.
   ::p4::v1::ReadRequest expanded_req;
   if (!req->role().empty()) {
-    expanded_req =
-        ExpandWildcardsInReadRequest(*req, ret.ValueOrDie().p4info());
+    expanded_req = ExpandWildcardsInReadRequest(*req, config->p4info());
     req = &expanded_req;
     VLOG(1) << "Expanded wildcard read into "
             << expanded_req.ShortDebugString();
@@ -387,20 +476,92 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
   // Verify the request only contains entities allowed by the role config.
   RETURN_IF_GRPC_ERROR(IsReadPermitted(req->device_id(), *req));
 
-  ServerWriterWrapper<::p4::v1::ReadResponse> wrapper(writer);
   std::vector<::util::Status> details = {};
   absl::Time timestamp = absl::Now();
   ::util::Status status =
-      switch_interface_->ReadForwardingEntries(*req, &wrapper, &details);
+      switch_interface_->ReadForwardingEntries(*req, writer, &details);
   if (!status.ok()) {
     LOG(ERROR) << "Failed to read forwarding entries from node " << node_id
                << ": " << status.error_message();
   }
 
-  // Log debug info for future debugging.
-  LogReadRequest(node_id, *original_req, details, timestamp);
+  ::grpc::Status grpc_status = ToGrpcStatus(status, details);
+
+  // Log debug info for future debugging. This only enqueues the request, the
+  // logging is done in the background.
+  std::shared_ptr<P4RequestLogger> logger =
+      GetRequestLogger(FLAGS_read_req_log_file, &read_req_logger_);
+  if (logger) {
+    // A request owned by gRPC is only valid during this call.
+    if (shared_req == nullptr) {
+      shared_req = std::make_shared<const ::p4::v1::ReadRequest>(*original_req);
+    }
+    logger->LogReadRequest(node_id, std::move(shared_req), std::move(details),
+                           timestamp);
+  }
 
-  return ToGrpcStatus(status, details);
+  return grpc_status;
+}
+
+std::shared_ptr<P4RequestLogger> P4Service::GetRequestLogger(
+    const std::string& file_path, std::shared_ptr<P4RequestLogger>* logger) {
+  // The flags are read on every call, so that they can be changed at runtime.
+  const P4RequestLogger::Options options = GetRequestLoggerOptions();
+  {
+    absl::ReaderMutexLock l(&req_logger_lock_);
+    if (*logger == nullptr
+            ? file_path.empty()
+            : IsRequestLoggerConfigured(**logger, file_path, options)) {
+      return *logger;
+    }
+  }
+  // Declared before the lock, so that a replaced logger writes its pending
+  // requests after the lock is released.
+  std::shared_ptr<P4RequestLogger> old_logger;
+  absl::WriterMutexLock l(&req_logger_lock_);
+  if (*logger != nullptr &&
+      IsRequestLoggerConfigured(**logger, file_path, options)) {
+    return *logger;
+  }
+  old_logger = std::move(*logger);
+  if (!file_path.empty()) *logger = CreateRequestLogger(file_path, options);
+
+  return *logger;
+}
+
+void P4Service::FlushRequestLoggers() {
+  std::shared_ptr<P4RequestLogger> write_req_logger;
+  std::shared_ptr<P4RequestLogger> read_req_logger;
+  {
+    absl::ReaderMutexLock l(&req_logger_lock_);
+    write_req_logger = write_req_logger_;
+    read_req_logger = read_req_logger_;
+  }
+  if (write_req_logger) write_req_logger->Flush();
+  if (read_req_logger) read_req_logger->Flush();
+}
+
+void P4Service::EnableAsyncWriteAndRead() {
+  MarkMethodAsync(kWriteMethodIndex);
+  MarkMethodAsync(kReadMethodIndex);
+}
+
+void P4Service::RequestWrite(
+    ::grpc::ServerContext* context, ::p4::v1::WriteRequest* req,
+    ::grpc::ServerAsyncResponseWriter<::p4::v1::WriteResponse>* responder,
+    ::grpc::CompletionQueue* new_call_cq,
+    ::grpc::ServerCompletionQueue* notification_cq, void* tag) {
+  RequestAsyncUnary(kWriteMethodIndex, context, req, responder, new_call_cq,
+                    notification_cq, tag);
+}
+
+void P4Service::RequestRead(
+    ::grpc::ServerContext* context, ::p4::v1::ReadRequest* req,
+    ::grpc::ServerAsyncWriter<::p4::v1::ReadResponse>* writer,
+    ::grpc::CompletionQueue* new_call_cq,
+    ::grpc::ServerCompletionQueue* notification_cq, void* tag) {
+  RequestAsyncServerStreaming(kReadMethodIndex, context, req, writer,
+                              new_call_cq, notification_cq, tag);
 }
 
 ::grpc::Status P4Service::SetForwardingPipelineConfig(
@@ -440,23 +601,47 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                                  node_id, req->config()));
       break;
     case ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT:
-    case ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_SAVE: {
-      absl::WriterMutexLock l(&config_lock_);
+    case ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_SAVE:
+    case ::p4::v1::SetForwardingPipelineConfigRequest::RECONCILE_AND_COMMIT: {
+      // Concurrent pushes are serialized by config_push_lock_. config_lock_
+      // is only taken to copy and swap the snapshot pointer, so readers are
+      // not blocked while the switch is being programmed.
+      absl::MutexLock push_lock(&config_push_lock_);
+      std::shared_ptr<const ForwardingPipelineConfigs> current_configs =
+          GetForwardingPipelineConfigsSnapshot();
+      const bool commit = req->action() !=
+                          ::p4::v1::SetForwardingPipelineConfigRequest::
+                              VERIFY_AND_SAVE;
+      // Re-pushing the config the node already runs is a no-op. Controllers
+      // commonly do this on every reconnect, and reprogramming the switch
+      // would needlessly disrupt the forwarding state. Note that the current
+      // snapshot may hold a config which was only saved, not committed.
+      if (FLAGS_skip_unchanged_forwarding_pipeline_push && commit) {
+        const auto* config =
+            gtl::FindOrNull(node_id_to_committed_config_, node_id);
+        if (config != nullptr &&
+            IsSameForwardingPipelineConfig(**config, req->config())) {
+          LOG(INFO) << "Forwarding pipeline config for node " << node_id
+                    << " is unchanged. Skipping the push.";
+          break;
+        }
+      }
       // configs_to_save_in_file will have a copy of the configs that will be
       // saved in file at the end. Note that this copy may NOT be the same as
       // forwarding_pipeline_configs_.
       ForwardingPipelineConfigs configs_to_save_in_file;
-      if (forwarding_pipeline_configs_ != nullptr) {
-        configs_to_save_in_file = *forwarding_pipeline_configs_;
-      } else {
-        forwarding_pipeline_configs_ =
-            absl::make_unique<ForwardingPipelineConfigs>();
+      if (current_configs != nullptr) {
+        configs_to_save_in_file = *current_configs;
       }
       ::util::Status error;
       if (req->action() ==
           ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT) {
         error = switch_interface_->PushForwardingPipelineConfig(node_id,
                                                                 req->config());
+      } else if (req->action() == ::p4::v1::SetForwardingPipelineConfigRequest::
+                                      RECONCILE_AND_COMMIT) {
+        error = switch_interface_->ReconcileAndCommitForwardingPipelineConfig(
+            node_id, req->config());
       } else {  // VERIFY_AND_SAVE
         error = switch_interface_->SaveForwardingPipelineConfig(node_id,
                                                                 req->config());
@@ -468,28 +653,60 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
       // TODO(unknown): this may not be appropriate for the VERIFY_AND_SAVE ->
       // COMMIT sequence of operations.
       if (error.ok() || error.error_code() == ERR_REBOOT_REQUIRED) {
-        (*configs_to_save_in_file.mutable_node_id_to_config())[node_id] =
-            req->config();
-        APPEND_STATUS_IF_ERROR(
-            status,
-            WriteProtoToTextFile(configs_to_save_in_file,
-                                 FLAGS_forwarding_pipeline_configs_file));
-      }
-      if (error.ok()) {
-        (*forwarding_pipeline_configs_->mutable_node_id_to_config())[node_id] =
-            req->config();
+        // Never modify the published snapshot in place. The new set of configs
+        // is handed over as the new snapshot (only if status was OK) and is
+        // shared with the file saver, which writes it in the background.
+        // RPCs still holding the old snapshot keep a consistent view.
+        auto new_configs = std::make_shared<ForwardingPipelineConfigs>();
+        new_configs->Swap(&configs_to_save_in_file);
+        (*new_configs->mutable_node_id_to_config())[node_id] = req->config();
+        if (config_file_saver_) {
+          // The file is written in the background. A failed save is logged
+          // and added to error_buffer_ by the saver, it is not returned to the
+          // caller.
+          config_file_saver_->Save(FLAGS_forwarding_pipeline_configs_file,
+                                   new_configs);
+        } else {
+          APPEND_STATUS_IF_ERROR(
+              status,
+              WriteProtoToTextFile(*new_configs,
+                                   FLAGS_forwarding_pipeline_configs_file));
+        }
+        if (error.ok()) {
+          if (commit) {
+            node_id_to_committed_config_[node_id] =
+                std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>(
+                    new_configs, &new_configs->node_id_to_config().at(node_id));
+          }
+          absl::WriterMutexLock l(&config_lock_);
+          forwarding_pipeline_configs_ = std::move(new_configs);
+        }
       }
+      // The state of the node is unknown after a failed commit.
+      if (commit && !error.ok()) node_id_to_committed_config_.erase(node_id);
       break;
     }
     case ::p4::v1::SetForwardingPipelineConfigRequest::COMMIT: {
+      absl::MutexLock push_lock(&config_push_lock_);
       ::util::Status error =
           switch_interface_->CommitForwardingPipelineConfig(node_id);
       APPEND_STATUS_IF_ERROR(status, error);
+      // The node now runs the config saved last with VERIFY_AND_SAVE.
+      std::shared_ptr<const ForwardingPipelineConfigs> configs =
+          GetForwardingPipelineConfigsSnapshot();
+      const auto* config =
+          error.ok() && configs != nullptr
+              ? gtl::FindOrNull(configs->node_id_to_config(), node_id)
+              : nullptr;
+      if (config != nullptr) {
+        node_id_to_committed_config_[node_id] =
+            std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>(configs,
+                                                                      config);
+      } else {
+        node_id_to_committed_config_.erase(node_id);
+      }
       break;
     }
-    case ::p4::v1::SetForwardingPipelineConfigRequest::RECONCILE_AND_COMMIT:
-      return ::grpc::Status(::grpc::StatusCode::UNIMPLEMENTED,
-                            "RECONCILE_AND_COMMIT action not supported yet");
     default:
       return ::grpc::Status(
           ::grpc::StatusCode::INVALID_ARGUMENT,
@@ -528,7 +745,7 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
     return ::grpc::Status(ToGrpcCode(status.status().CanonicalCode()),
                           status.status().error_message());
   }
-  const ::p4::v1::ForwardingPipelineConfig& config = status.ValueOrDie();
+  const ::p4::v1::ForwardingPipelineConfig& config = *status.ValueOrDie();
 
   switch (req->response_type()) {
     case ::p4::v1::GetForwardingPipelineConfigRequest::ALL: {
@@ -812,23 +1029,32 @@ bool P4Service::IsMasterController(
   return it->second.AllowRequest(role_name, election_id).ok();
 }
 
-::util::StatusOr<::p4::v1::ForwardingPipelineConfig>
-P4Service::DoGetForwardingPipelineConfig(uint64 node_id) const {
+std::shared_ptr<const ForwardingPipelineConfigs>
+P4Service::GetForwardingPipelineConfigsSnapshot() const {
   absl::ReaderMutexLock l(&config_lock_);
-  if (forwarding_pipeline_configs_ == nullptr ||
-      forwarding_pipeline_configs_->node_id_to_config_size() == 0) {
+  return forwarding_pipeline_configs_;
+}
+
+::util::StatusOr<std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>>
+P4Service::DoGetForwardingPipelineConfig(uint64 node_id) const {
+  std::shared_ptr<const ForwardingPipelineConfigs> configs =
+      GetForwardingPipelineConfigsSnapshot();
+  if (configs == nullptr || configs->node_id_to_config_size() == 0) {
     return MAKE_ERROR(ERR_FAILED_PRECONDITION)
            << "No valid forwarding pipeline config has been pushed for any "
            << "node so far.";
   }
-  auto it = forwarding_pipeline_configs_->node_id_to_config().find(node_id);
-  if (it == forwarding_pipeline_configs_->node_id_to_config().end()) {
+  auto it = configs->node_id_to_config().find(node_id);
+  if (it == configs->node_id_to_config().end()) {
     return MAKE_ERROR(ERR_FAILED_PRECONDITION)
            << "Invalid node id or no valid forwarding pipeline config has been "
            << "pushed for node " << node_id << " yet.";
   }
 
-  return it->second;
+  // Aliasing constructor: points to the node config, but shares ownership of
+  // the whole snapshot.
+  return std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>(
+      configs, &it->second);
 }
 
 p4::v1::ReadRequest P4Service::ExpandWildcardsInReadRequest(
@@ -25,8 +25,11 @@
 #include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/common/channel_writer_wrapper.h"
 #include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/config_file_saver.h"
 #include "stratum/hal/lib/common/error_buffer.h"
+#include "stratum/hal/lib/common/p4_request_logger.h"
 #include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/hal/lib/p4/forwarding_pipeline_configs.pb.h"
 #include "stratum/lib/p4runtime/sdn_controller_manager.h"
 #include "stratum/lib/security/auth_policy_checker.h"
@@ -51,16 +54,18 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // the function initializes the class and pushes the saved forwarding pipeline
   // config to the switch. In the warmboot mode, it only restores the internal
   // state of the class.
-  ::util::Status Setup(bool warmboot) LOCKS_EXCLUDED(config_lock_);
+  ::util::Status Setup(bool warmboot)
+      LOCKS_EXCLUDED(config_push_lock_, config_lock_);
 
   // Tears down the class. Called in both warmboot or coldboot mode. It will
   // not alter any state on the hardware when called.
-  ::util::Status Teardown() LOCKS_EXCLUDED(config_lock_, controller_lock_,
-                                           stream_response_thread_lock_);
+  ::util::Status Teardown()
+      LOCKS_EXCLUDED(config_push_lock_, config_lock_, controller_lock_,
+                     stream_response_thread_lock_);
 
   // Public helper function called in Setup().
   ::util::Status PushSavedForwardingPipelineConfigs(bool warmboot)
-      LOCKS_EXCLUDED(config_lock_);
+      LOCKS_EXCLUDED(config_push_lock_, config_lock_);
 
   // Writes one or more forwarding entries on the target as part of P4 Runtime
   // API. Entries include tables entries, action profile members/groups, meter
@@ -81,7 +86,7 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       ::grpc::ServerContext* context,
       const ::p4::v1::SetForwardingPipelineConfigRequest* req,
       ::p4::v1::SetForwardingPipelineConfigResponse* resp) override
-      LOCKS_EXCLUDED(config_lock_);
+      LOCKS_EXCLUDED(config_push_lock_, config_lock_);
 
   // Gets the P4-based forwarding pipeline configuration of one or more
   // switching nodes previously pushed to the switch.
@@ -104,6 +109,26 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       const ::p4::v1::CapabilitiesRequest* request,
       ::p4::v1::CapabilitiesResponse* response) override;
 
+  // Switches the Write and Read RPCs to the gRPC async API. Must be called
+  // before the service is registered with the ::grpc::ServerBuilder. Once
+  // called, gRPC does not dispatch these RPCs to Write() and Read() anymore.
+  // Instead, they need to be requested using RequestWrite() and RequestRead()
+  // on a completion queue, which is what P4AsyncRpcHandler does.
+  void EnableAsyncWriteAndRead();
+
+  // Requests the server to start handling a new Write/Read RPC. Equivalent to
+  // the methods generated in P4Runtime::WithAsyncMethod_Write/Read, which
+  // cannot be used here as P4Service also implements the sync methods.
+  void RequestWrite(
+      ::grpc::ServerContext* context, ::p4::v1::WriteRequest* req,
+      ::grpc::ServerAsyncResponseWriter<::p4::v1::WriteResponse>* responder,
+      ::grpc::CompletionQueue* new_call_cq,
+      ::grpc::ServerCompletionQueue* notification_cq, void* tag);
+  void RequestRead(::grpc::ServerContext* context, ::p4::v1::ReadRequest* req,
+                   ::grpc::ServerAsyncWriter<::p4::v1::ReadResponse>* writer,
+                   ::grpc::CompletionQueue* new_call_cq,
+                   ::grpc::ServerCompletionQueue* notification_cq, void* tag);
+
   // P4Service is neither copyable nor movable.
   P4Service(const P4Service&) = delete;
   P4Service& operator=(const P4Service&) = delete;
@@ -117,6 +142,11 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
     uint64 node_id;
   };
 
+  // Index of the Write and Read RPCs in the P4Runtime service, i.e. the order
+  // in which they are defined in p4runtime.proto.
+  static constexpr int kWriteMethodIndex = 0;
+  static constexpr int kReadMethodIndex = 1;
+
   // Specifies the max number of controllers that can connect for a node.
   static constexpr size_t kMaxNumControllerPerNode = 5;
 
@@ -168,11 +198,49 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       const absl::optional<absl::uint128>& election_id) const
       LOCKS_EXCLUDED(controller_lock_);
 
-  // Return the stored forwarding pipeline for the given node.
-  ::util::StatusOr<::p4::v1::ForwardingPipelineConfig>
+  // Returns the current immutable snapshot of the forwarding pipeline configs
+  // of all the nodes. The returned pointer may be nullptr if no config was
+  // pushed so far. config_lock_ is held only while copying the shared_ptr.
+  std::shared_ptr<const ForwardingPipelineConfigs>
+  GetForwardingPipelineConfigsSnapshot() const LOCKS_EXCLUDED(config_lock_);
+
+  // Return the stored forwarding pipeline for the given node. The returned
+  // pointer shares ownership of the snapshot it points into, so the config
+  // stays valid even if a new pipeline is pushed concurrently. No copy of the
+  // (possibly big) config is made.
+  ::util::StatusOr<std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>>
   DoGetForwardingPipelineConfig(uint64 node_id) const
       LOCKS_EXCLUDED(config_lock_);
 
+  // Implements the Write RPC for both the sync and async server. shared_req
+  // shares the ownership of req, or is nullptr if req is owned by gRPC. In the
+  // latter case req is copied if it gets logged, as it is only valid during
+  // the call.
+  ::grpc::Status DoWrite(
+      ::grpc::ServerContext* context, const ::p4::v1::WriteRequest* req,
+      std::shared_ptr<const ::p4::v1::WriteRequest> shared_req,
+      ::p4::v1::WriteResponse* resp) LOCKS_EXCLUDED(req_logger_lock_);
+
+  // Implements the Read RPC for both the sync and async server. The read
+  // responses are streamed out through the given writer. shared_req is handled
+  // as in DoWrite().
+  ::grpc::Status DoRead(::grpc::ServerContext* context,
+                        const ::p4::v1::ReadRequest* req,
+                        std::shared_ptr<const ::p4::v1::ReadRequest> shared_req,
+                        WriterInterface<::p4::v1::ReadResponse>* writer)
+      LOCKS_EXCLUDED(req_logger_lock_);
+
+  // Returns the request logger for the given log file, as configured by the
+  // current flags. The logger pointed to by logger is replaced if the file or
+  // the log flags changed since it was created. Returns nullptr if file_path is
+  // empty, i.e. logging is disabled, or the logger cannot be created.
+  std::shared_ptr<P4RequestLogger> GetRequestLogger(
+      const std::string& file_path, std::shared_ptr<P4RequestLogger>* logger)
+      LOCKS_EXCLUDED(req_logger_lock_);
+
+  // Blocks until all the requests logged so far are in the log files.
+  void FlushRequestLoggers() LOCKS_EXCLUDED(req_logger_lock_);
+
   // Expands a generic wildcard request into individual entity wildcard reads.
   ::p4::v1::ReadRequest ExpandWildcardsInReadRequest(
       const ::p4::v1::ReadRequest& req,
@@ -202,8 +270,14 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // mastership authorization on a request.
   mutable absl::Mutex controller_lock_;
 
+  // Mutex lock which serializes the forwarding pipeline config pushes. It is
+  // held for the whole push, including the programming of the switch. Always
+  // acquired before config_lock_.
+  absl::Mutex config_push_lock_;
+
   // Mutex lock for protecting the internal forwarding pipeline configs pushed
-  // to the switch.
+  // to the switch. Only held while the snapshot pointer is copied or swapped,
+  // so readers are never blocked by a push in progress.
   mutable absl::Mutex config_lock_;
 
   // Mutex which protects the creation and destruction of the stream response RX
@@ -236,10 +310,22 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       stream_response_channels_ GUARDED_BY(stream_response_thread_lock_);
 
   // Forwarding pipeline configs of all the switching nodes. Updated as we push
-  // forwarding pipeline configs for new or existing nodes.
-  std::unique_ptr<ForwardingPipelineConfigs> forwarding_pipeline_configs_
+  // forwarding pipeline configs for new or existing nodes. The pointed-to
+  // configs are never modified in place: a push builds a new copy and swaps
+  // the pointer (RCU-style), so that RPCs holding an older snapshot can keep
+  // using it without copying or locking.
+  std::shared_ptr<const ForwardingPipelineConfigs> forwarding_pipeline_configs_
       GUARDED_BY(config_lock_);
 
+  // Map from node ID to the forwarding pipeline config last committed to the
+  // node, i.e. pushed with VERIFY_AND_COMMIT, RECONCILE_AND_COMMIT or COMMIT.
+  // Unlike forwarding_pipeline_configs_, it is not updated by VERIFY_AND_SAVE.
+  // Used to skip the pushes of unchanged configs. The configs point into the
+  // snapshots they were committed with.
+  absl::flat_hash_map<uint64,
+                      std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>>
+      node_id_to_committed_config_ GUARDED_BY(config_push_lock_);
+
   // Determines the mode of operation:
   // - OPERATION_MODE_STANDALONE: when Stratum stack runs independently and
   // therefore needs to do all the SDK initialization itself.
@@ -261,6 +347,25 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // by this class.
   ErrorBuffer* error_buffer_;
 
+  // Protects the request loggers.
+  mutable absl::Mutex req_logger_lock_;
+
+  // Background loggers for the write and read requests. Created by the first
+  // request logged and replaced by GetRequestLogger() when the log flags
+  // change. nullptr while the corresponding log file flag is empty.
+  std::shared_ptr<P4RequestLogger> write_req_logger_
+      GUARDED_BY(req_logger_lock_);
+  std::shared_ptr<P4RequestLogger> read_req_logger_
+      GUARDED_BY(req_logger_lock_);
+
+  // Saves the forwarding pipeline configs to the file given by
+  // FLAGS_forwarding_pipeline_configs_file off the RPC path. nullptr if the
+  // saver could not be created, in which case the file is written
+  // synchronously. Initialized in the constructor and never changed
+  // afterwards.
+  const std::unique_ptr<ConfigFileSaver> config_file_saver_;
+
+  friend class P4AsyncRpcHandler;
   friend class P4ServiceTest;
 };
 
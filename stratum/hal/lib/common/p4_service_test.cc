@@ -33,6 +33,7 @@ DECLARE_int32(max_num_controller_connections);
 DECLARE_string(forwarding_pipeline_configs_file);
 DECLARE_string(write_req_log_file);
 DECLARE_string(read_req_log_file);
+DECLARE_int32(p4_req_log_buffer_size);
 DECLARE_string(test_tmpdir);
 
 namespace stratum {
@@ -61,19 +62,6 @@ class P4ServiceTest
     switch_mock_ = absl::make_unique<SwitchMock>();
     auth_policy_checker_mock_ = absl::make_unique<AuthPolicyCheckerMock>();
     error_buffer_ = absl::make_unique<ErrorBuffer>();
-    p4_service_ = absl::make_unique<P4Service>(mode_, switch_mock_.get(),
-                                               auth_policy_checker_mock_.get(),
-                                               error_buffer_.get());
-    std::string url =
-        "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
-    ::grpc::ServerBuilder builder;
-    builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
-    builder.RegisterService(p4_service_.get());
-    server_ = builder.BuildAndStart();
-    ASSERT_NE(server_, nullptr);
-    stub_ = ::p4::v1::P4Runtime::NewStub(
-        ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
-    ASSERT_NE(stub_, nullptr);
     FLAGS_max_num_controllers_per_node = 5;
     FLAGS_max_num_controller_connections = 20;
     FLAGS_forwarding_pipeline_configs_file =
@@ -87,6 +75,19 @@ class P4ServiceTest
     if (PathExists(FLAGS_read_req_log_file)) {
       ASSERT_OK(RemoveFile(FLAGS_read_req_log_file));
     }
+    p4_service_ = absl::make_unique<P4Service>(mode_, switch_mock_.get(),
+                                               auth_policy_checker_mock_.get(),
+                                               error_buffer_.get());
+    std::string url =
+        "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(p4_service_.get());
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+    stub_ = ::p4::v1::P4Runtime::NewStub(
+        ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
+    ASSERT_NE(stub_, nullptr);
   }
 
   void TearDown() override { server_->Shutdown(); }
@@ -127,14 +128,25 @@ class P4ServiceTest
   }
 
   void SetTestForwardingPipelineConfigs() {
+    absl::MutexLock push_lock(&p4_service_->config_push_lock_);
     absl::WriterMutexLock l(&p4_service_->config_lock_);
     ASSERT_TRUE(p4_service_->forwarding_pipeline_configs_ == nullptr);
-    p4_service_->forwarding_pipeline_configs_ =
-        absl::make_unique<ForwardingPipelineConfigs>();
+    auto configs = std::make_shared<ForwardingPipelineConfigs>();
     const std::string& configs_text = absl::Substitute(
         kForwardingPipelineConfigsTemplate, kNodeId1, kNodeId2);
-    ASSERT_OK(ParseProtoFromString(
-        configs_text, p4_service_->forwarding_pipeline_configs_.get()));
+    ASSERT_OK(ParseProtoFromString(configs_text, configs.get()));
+    // The configs are considered committed to the nodes.
+    for (const auto& e : configs->node_id_to_config()) {
+      p4_service_->node_id_to_committed_config_[e.first] =
+          std::shared_ptr<const ::p4::v1::ForwardingPipelineConfig>(configs,
+                                                                    &e.second);
+    }
+    p4_service_->forwarding_pipeline_configs_ = configs;
+  }
+
+  std::shared_ptr<const ForwardingPipelineConfigs>
+  GetForwardingPipelineConfigsSnapshot() {
+    return p4_service_->GetForwardingPipelineConfigsSnapshot();
   }
 
   void AddFakeMasterController(
@@ -161,6 +173,10 @@ class P4ServiceTest
         .ActiveConnections();
   }
 
+  // Waits until the background request loggers wrote all the requests
+  // received so far.
+  void FlushRequestLogs() { p4_service_->FlushRequestLoggers(); }
+
   int GetNumberOfConnections() {
     absl::WriterMutexLock l(&p4_service_->controller_lock_);
     return p4_service_->num_controller_connections_;
@@ -506,6 +522,229 @@ TEST_P(P4ServiceTest, SetupAndPushForwardingPipelineConfigSuccess) {
   CheckForwardingPipelineConfigs(nullptr, 0 /*ignored*/);
 }
 
+TEST_P(P4ServiceTest, ReconcileAndCommitForwardingPipelineConfigSuccess) {
+  ForwardingPipelineConfigs configs;
+  FillTestForwardingPipelineConfigsAndSave(&configs);
+
+  EXPECT_CALL(*switch_mock_, PushForwardingPipelineConfig(_, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_,
+              ReconcileAndCommitForwardingPipelineConfig(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "SetForwardingPipelineConfig", _))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(p4_service_->Setup(false));
+
+  ::grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::p4::v1::SetForwardingPipelineConfigRequest request;
+  ::p4::v1::SetForwardingPipelineConfigResponse response;
+  request.set_device_id(kNodeId1);
+  request.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  request.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  request.set_role(role_name_);
+  request.set_action(
+      ::p4::v1::SetForwardingPipelineConfigRequest::RECONCILE_AND_COMMIT);
+  configs.mutable_node_id_to_config()->at(kNodeId1).set_p4_device_config(
+      "fake");  // emulate a modification in the config
+  *request.mutable_config() = configs.node_id_to_config().at(kNodeId1);
+
+  ::grpc::Status status =
+      p4_service_->SetForwardingPipelineConfig(&context, &request, &response);
+  EXPECT_TRUE(status.ok()) << "Error: " << status.error_message();
+  CheckForwardingPipelineConfigs(&configs, kNodeId1);
+  ASSERT_OK(p4_service_->Teardown());
+}
+
+TEST_P(P4ServiceTest, ReconcileAndCommitForwardingPipelineConfigFailure) {
+  SetTestForwardingPipelineConfigs();
+  std::shared_ptr<const ForwardingPipelineConfigs> old_snapshot =
+      GetForwardingPipelineConfigsSnapshot();
+  ASSERT_NE(nullptr, old_snapshot);
+
+  EXPECT_CALL(*switch_mock_,
+              ReconcileAndCommitForwardingPipelineConfig(kNodeId1, _))
+      .WillOnce(Return(::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                      "Incompatible.")));
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "SetForwardingPipelineConfig", _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::p4::v1::SetForwardingPipelineConfigRequest request;
+  ::p4::v1::SetForwardingPipelineConfigResponse response;
+  request.set_device_id(kNodeId1);
+  request.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  request.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  request.set_role(role_name_);
+  request.set_action(
+      ::p4::v1::SetForwardingPipelineConfigRequest::RECONCILE_AND_COMMIT);
+  *request.mutable_config() = old_snapshot->node_id_to_config().at(kNodeId1);
+  request.mutable_config()->set_p4_device_config("fake");
+
+  ::grpc::Status status =
+      p4_service_->SetForwardingPipelineConfig(&context, &request, &response);
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  // The published snapshot is unchanged.
+  EXPECT_EQ(old_snapshot, GetForwardingPipelineConfigsSnapshot());
+}
+
+TEST_P(P4ServiceTest, PushForwardingPipelineConfigKeepsOldSnapshotIntact) {
+  SetTestForwardingPipelineConfigs();
+  std::shared_ptr<const ForwardingPipelineConfigs> old_snapshot =
+      GetForwardingPipelineConfigsSnapshot();
+  ASSERT_NE(nullptr, old_snapshot);
+  const ForwardingPipelineConfigs old_configs = *old_snapshot;
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "SetForwardingPipelineConfig", _))
+      .WillOnce(Return(::util::OkStatus()));
+  // The snapshot can be read while the switch is being programmed.
+  EXPECT_CALL(*switch_mock_, PushForwardingPipelineConfig(kNodeId1, _))
+      .WillOnce(Invoke(
+          [this, &old_snapshot](uint64 node_id,
+                                const ::p4::v1::ForwardingPipelineConfig& c) {
+            EXPECT_EQ(old_snapshot.get(),
+                      GetForwardingPipelineConfigsSnapshot().get());
+            return ::util::OkStatus();
+          }));
+
+  ::grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::p4::v1::SetForwardingPipelineConfigRequest request;
+  ::p4::v1::SetForwardingPipelineConfigResponse response;
+  request.set_device_id(kNodeId1);
+  request.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  request.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  request.set_role(role_name_);
+  request.set_action(
+      ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT);
+  *request.mutable_config() = old_configs.node_id_to_config().at(kNodeId1);
+  request.mutable_config()->set_p4_device_config("fake");
+
+  ::grpc::Status status =
+      p4_service_->SetForwardingPipelineConfig(&context, &request, &response);
+  EXPECT_TRUE(status.ok()) << "Error: " << status.error_message();
+
+  // The snapshot taken before the push must not have been modified, while a
+  // new snapshot reflects the pushed config.
+  EXPECT_TRUE(ProtoEqual(old_configs, *old_snapshot));
+  std::shared_ptr<const ForwardingPipelineConfigs> new_snapshot =
+      GetForwardingPipelineConfigsSnapshot();
+  ASSERT_NE(nullptr, new_snapshot);
+  EXPECT_NE(old_snapshot.get(), new_snapshot.get());
+  EXPECT_EQ("fake",
+            new_snapshot->node_id_to_config().at(kNodeId1).p4_device_config());
+  EXPECT_TRUE(ProtoEqual(old_configs.node_id_to_config().at(kNodeId2),
+                         new_snapshot->node_id_to_config().at(kNodeId2)));
+
+  // The new configs are saved in the file in the background. Teardown waits
+  // for the save to complete.
+  ASSERT_OK(p4_service_->Teardown());
+  ForwardingPipelineConfigs saved_configs;
+  ASSERT_OK(ReadProtoFromTextFile(FLAGS_forwarding_pipeline_configs_file,
+                                  &saved_configs));
+  EXPECT_TRUE(ProtoEqual(*new_snapshot, saved_configs));
+}
+
+TEST_P(P4ServiceTest, PushForwardingPipelineConfigSkipsUnchangedConfig) {
+  SetTestForwardingPipelineConfigs();
+  std::shared_ptr<const ForwardingPipelineConfigs> old_snapshot =
+      GetForwardingPipelineConfigsSnapshot();
+  ASSERT_NE(nullptr, old_snapshot);
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "SetForwardingPipelineConfig", _))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushForwardingPipelineConfig(_, _)).Times(0);
+  EXPECT_CALL(*switch_mock_, ReconcileAndCommitForwardingPipelineConfig(_, _))
+      .Times(0);
+
+  ::grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::p4::v1::SetForwardingPipelineConfigRequest request;
+  ::p4::v1::SetForwardingPipelineConfigResponse response;
+  request.set_device_id(kNodeId1);
+  request.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  request.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  request.set_role(role_name_);
+  *request.mutable_config() = old_snapshot->node_id_to_config().at(kNodeId1);
+
+  // Re-pushing the config the node already has does not touch the switch nor
+  // the published snapshot.
+  for (const auto action :
+       {::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT,
+        ::p4::v1::SetForwardingPipelineConfigRequest::RECONCILE_AND_COMMIT}) {
+    request.set_action(action);
+    ::grpc::Status status =
+        p4_service_->SetForwardingPipelineConfig(&context, &request, &response);
+    EXPECT_TRUE(status.ok()) << "Error: " << status.error_message();
+    EXPECT_EQ(old_snapshot, GetForwardingPipelineConfigsSnapshot());
+  }
+}
+
+TEST_P(P4ServiceTest, PushForwardingPipelineConfigCommitsSavedConfig) {
+  SetTestForwardingPipelineConfigs();
+  std::shared_ptr<const ForwardingPipelineConfigs> old_snapshot =
+      GetForwardingPipelineConfigsSnapshot();
+  ASSERT_NE(nullptr, old_snapshot);
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "SetForwardingPipelineConfig", _))
+      .Times(3)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, SaveForwardingPipelineConfig(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushForwardingPipelineConfig(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::p4::v1::SetForwardingPipelineConfigRequest request;
+  ::p4::v1::SetForwardingPipelineConfigResponse response;
+  request.set_device_id(kNodeId1);
+  request.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  request.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  request.set_role(role_name_);
+  *request.mutable_config() = old_snapshot->node_id_to_config().at(kNodeId1);
+  request.mutable_config()->set_p4_device_config("fake");
+
+  // A config which was only saved is still pushed on VERIFY_AND_COMMIT, and
+  // skipped once it is committed.
+  for (const auto action :
+       {::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_SAVE,
+        ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT,
+        ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT}) {
+    request.set_action(action);
+    ::grpc::Status status =
+        p4_service_->SetForwardingPipelineConfig(&context, &request, &response);
+    EXPECT_TRUE(status.ok()) << "Error: " << status.error_message();
+  }
+}
+
 TEST_P(P4ServiceTest, VerifyForwardingPipelineConfigSuccess) {
   ForwardingPipelineConfigs configs;
   FillTestForwardingPipelineConfigsAndSave(&configs);
@@ -770,10 +1009,82 @@ TEST_P(P4ServiceTest, WriteSuccess) {
   EXPECT_TRUE(status.error_message().empty());
   EXPECT_TRUE(status.error_details().empty());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_write_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.updates(0).ShortDebugString()));
 }
 
+// The log flags are read on every request, so logging can be turned off at
+// runtime.
+TEST_P(P4ServiceTest, WriteIsNotLoggedAfterLogFileFlagIsCleared) {
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+  const std::string log_file = FLAGS_write_req_log_file;
+  FLAGS_write_req_log_file = "";
+
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteRequest req;
+  ::p4::v1::WriteResponse resp;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+  req.mutable_updates(0)->mutable_entity()->mutable_table_entry()->set_table_id(
+      kTableId1);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kExpectedResults = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResults),
+                      Return(::util::OkStatus())));
+
+  ::grpc::Status status = stub_->Write(&context, req, &resp);
+  EXPECT_TRUE(status.ok());
+  FlushRequestLogs();
+  EXPECT_FALSE(PathExists(log_file));
+}
+
+TEST_P(P4ServiceTest, WriteIsNotLoggedWithNegativeLogBufferSize) {
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+  gflags::FlagSaver flag_saver;
+  FLAGS_p4_req_log_buffer_size = -1;
+
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteRequest req;
+  ::p4::v1::WriteResponse resp;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+  req.mutable_updates(0)->mutable_entity()->mutable_table_entry()->set_table_id(
+      kTableId1);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kExpectedResults = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResults),
+                      Return(::util::OkStatus())));
+
+  // The invalid size disables the logger instead of failing the request.
+  ::grpc::Status status = stub_->Write(&context, req, &resp);
+  EXPECT_TRUE(status.ok());
+  FlushRequestLogs();
+  EXPECT_FALSE(PathExists(FLAGS_write_req_log_file));
+}
+
 TEST_P(P4ServiceTest, WriteSuccessForNoUpdatesToWrite) {
   SetTestForwardingPipelineConfigs();
   ::grpc::ClientContext context;
@@ -893,6 +1204,7 @@ TEST_P(P4ServiceTest, WriteFailureWhenWriteForwardingEntriesFails) {
   const auto& errors = error_buffer_->GetErrors();
   EXPECT_TRUE(errors.empty());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_write_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.updates(0).ShortDebugString()));
   EXPECT_THAT(s, HasSubstr(req.updates(1).ShortDebugString()));
@@ -1042,6 +1354,7 @@ TEST_P(P4ServiceTest, ReadSuccess) {
   ::grpc::Status status = reader->Finish();
   EXPECT_TRUE(status.ok());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_read_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.entities(0).ShortDebugString()));
 }
@@ -1111,6 +1424,7 @@ TEST_P(P4ServiceTest, ReadSuccessForRoleWildcardExpansion) {
   ::grpc::Status status = reader->Finish();
   EXPECT_TRUE(status.ok());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_read_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.entities(0).ShortDebugString()));
 }
@@ -1171,6 +1485,7 @@ TEST_P(P4ServiceTest, ReadFailureWhenReadForwardingEntriesFails) {
   const auto& errors = error_buffer_->GetErrors();
   EXPECT_TRUE(errors.empty());
   std::string s;
+  FlushRequestLogs();
   ASSERT_OK(ReadFileToString(FLAGS_read_req_log_file, &s));
   EXPECT_THAT(s, HasSubstr(req.entities(0).ShortDebugString()));
 }
@@ -88,6 +88,19 @@ class SwitchInterface {
   // the new forwarding pipeline configuration.
   virtual ::util::Status CommitForwardingPipelineConfig(uint64 node_id) = 0;
 
+  // Pushes a new P4-based forwarding pipeline configuration for the switching
+  // node while preserving the forwarding state (see the P4Runtime
+  // ::p4::SetForwardingPipelineConfigRequest::RECONCILE_AND_COMMIT action).
+  // The table entries, action profile members and groups, multicast groups and
+  // clone sessions programmed for the current pipeline are kept, with their
+  // P4Info IDs mapped to the IDs of the new pipeline. Returns an error, without
+  // changing anything, if the new config is not compatible with the forwarding
+  // state of the node. Implementations only reconcile changes which keep the
+  // entries programmed in place and return ERR_UNIMPLEMENTED for changes that
+  // would require reprogramming them, or if they cannot reconcile at all.
+  virtual ::util::Status ReconcileAndCommitForwardingPipelineConfig(
+      uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) = 0;
+
   // Verifies the P4-based forwarding pipeline specifications of a switching
   // node without programming anything to the hardware. It is expected that
   // PushForwardingPipelineConfig() calls VerifyForwardingPipelineConfig() to
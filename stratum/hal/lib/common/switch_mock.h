@@ -30,6 +30,10 @@ class SwitchMock : public SwitchInterface {
       ::util::Status(uint64 node_id,
                      const ::p4::v1::ForwardingPipelineConfig& config));
   MOCK_METHOD1(CommitForwardingPipelineConfig, ::util::Status(uint64 node_id));
+  MOCK_METHOD2(
+      ReconcileAndCommitForwardingPipelineConfig,
+      ::util::Status(uint64 node_id,
+                     const ::p4::v1::ForwardingPipelineConfig& config));
   MOCK_METHOD2(
       VerifyForwardingPipelineConfig,
       ::util::Status(uint64 node_id,
@@ -90,6 +90,16 @@ namespace dummy_switch {
          << "CommitForwardingPipelineConfig not implemented for this target";
 }
 
+::util::Status DummySwitch::ReconcileAndCommitForwardingPipelineConfig(
+    uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
+  absl::ReaderMutexLock l(&chassis_lock);
+  DummyNode* node = nullptr;
+  ASSIGN_OR_RETURN(node, GetDummyNode(node_id));
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "ReconcileAndCommitForwardingPipelineConfig not implemented for "
+         << "this target";
+}
+
 ::util::Status DummySwitch::VerifyForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   absl::ReaderMutexLock l(&chassis_lock);
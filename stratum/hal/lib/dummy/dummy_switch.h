@@ -43,6 +43,9 @@ class DummySwitch : public SwitchInterface {
       LOCKS_EXCLUDED(chassis_lock) override;
   ::util::Status CommitForwardingPipelineConfig(uint64 node_id)
       LOCKS_EXCLUDED(chassis_lock) override;
+  ::util::Status ReconcileAndCommitForwardingPipelineConfig(
+      uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config)
+      LOCKS_EXCLUDED(chassis_lock) override;
   ::util::Status VerifyForwardingPipelineConfig(
       uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config)
       LOCKS_EXCLUDED(chassis_lock) override;
@@ -106,6 +106,14 @@ NP4Switch::~NP4Switch() {}
   return ::util::OkStatus();
 }
 
+::util::Status NP4Switch::ReconcileAndCommitForwardingPipelineConfig(
+    uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
+  RETURN_IF_ERROR(GetPINodeFromNodeId(node_id).status());
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "ReconcileAndCommitForwardingPipelineConfig not implemented for "
+         << "this target";
+}
+
 ::util::Status NP4Switch::VerifyForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   ASSIGN_OR_RETURN(auto* pi_node, GetPINodeFromNodeId(node_id));
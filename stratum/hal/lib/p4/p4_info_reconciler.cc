@@ -0,0 +1,341 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/p4/p4_info_reconciler.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// Maps the objects of old_objects to the objects of new_objects with the same
+// name. Adds the ID mapping of each matched object to id_map and the matched
+// pairs to matched, if given.
+template <typename T>
+void MapObjectsByName(
+    const ::google::protobuf::RepeatedPtrField<T>& old_objects,
+    const ::google::protobuf::RepeatedPtrField<T>& new_objects,
+    absl::flat_hash_map<uint32, uint32>* id_map,
+    std::vector<std::pair<const T*, const T*>>* matched) {
+  absl::flat_hash_map<std::string, const T*> new_objects_by_name;
+  for (const auto& object : new_objects) {
+    new_objects_by_name[object.preamble().name()] = &object;
+  }
+  for (const auto& old_object : old_objects) {
+    auto it = new_objects_by_name.find(old_object.preamble().name());
+    if (it == new_objects_by_name.end()) continue;
+    (*id_map)[old_object.preamble().id()] = it->second->preamble().id();
+    if (matched) matched->emplace_back(&old_object, it->second);
+  }
+}
+
+}  // namespace
+
+P4InfoReconciler::P4InfoReconciler()
+    : ids_unchanged_(true), keeps_all_objects_(true) {}
+
+::util::StatusOr<std::unique_ptr<P4InfoReconciler>>
+P4InfoReconciler::CreateInstance(const ::p4::config::v1::P4Info& old_p4info,
+                                 const ::p4::config::v1::P4Info& new_p4info) {
+  auto reconciler = absl::WrapUnique(new P4InfoReconciler());
+  RETURN_IF_ERROR(reconciler->Initialize(old_p4info, new_p4info));
+
+  return std::move(reconciler);
+}
+
+::util::Status P4InfoReconciler::Initialize(
+    const ::p4::config::v1::P4Info& old_p4info,
+    const ::p4::config::v1::P4Info& new_p4info) {
+  std::vector<std::pair<const ::p4::config::v1::Table*,
+                        const ::p4::config::v1::Table*>>
+      tables;
+  std::vector<std::pair<const ::p4::config::v1::Action*,
+                        const ::p4::config::v1::Action*>>
+      actions;
+  MapObjectsByName(old_p4info.tables(), new_p4info.tables(), &id_map_,
+                   &tables);
+  MapObjectsByName(old_p4info.actions(), new_p4info.actions(), &id_map_,
+                   &actions);
+  MapObjectsByName<::p4::config::v1::ActionProfile>(
+      old_p4info.action_profiles(), new_p4info.action_profiles(), &id_map_,
+      nullptr);
+  MapObjectsByName<::p4::config::v1::Counter>(
+      old_p4info.counters(), new_p4info.counters(), &id_map_, nullptr);
+  MapObjectsByName<::p4::config::v1::DirectCounter>(
+      old_p4info.direct_counters(), new_p4info.direct_counters(), &id_map_,
+      nullptr);
+  MapObjectsByName<::p4::config::v1::Meter>(
+      old_p4info.meters(), new_p4info.meters(), &id_map_, nullptr);
+  MapObjectsByName<::p4::config::v1::DirectMeter>(
+      old_p4info.direct_meters(), new_p4info.direct_meters(), &id_map_,
+      nullptr);
+  MapObjectsByName<::p4::config::v1::Register>(
+      old_p4info.registers(), new_p4info.registers(), &id_map_, nullptr);
+  MapObjectsByName<::p4::config::v1::Digest>(
+      old_p4info.digests(), new_p4info.digests(), &id_map_, nullptr);
+  for (const auto& e : id_map_) {
+    if (e.first != e.second) ids_unchanged_ = false;
+  }
+  // P4Info IDs are unique, so every old object is mapped iff the map holds as
+  // many IDs as there are old objects.
+  const int num_old_objects =
+      old_p4info.tables_size() + old_p4info.actions_size() +
+      old_p4info.action_profiles_size() + old_p4info.counters_size() +
+      old_p4info.direct_counters_size() + old_p4info.meters_size() +
+      old_p4info.direct_meters_size() + old_p4info.registers_size() +
+      old_p4info.digests_size();
+  keeps_all_objects_ = id_map_.size() == static_cast<size_t>(num_old_objects);
+
+  for (const auto& pair : actions) {
+    const auto& old_action = *pair.first;
+    const auto& new_action = *pair.second;
+    absl::flat_hash_map<std::string, const ::p4::config::v1::Action::Param*>
+        new_params_by_name;
+    for (const auto& param : new_action.params()) {
+      new_params_by_name[param.name()] = &param;
+    }
+    auto& param_id_map = param_id_maps_[old_action.preamble().id()];
+    for (const auto& old_param : old_action.params()) {
+      auto it = new_params_by_name.find(old_param.name());
+      if (it == new_params_by_name.end() ||
+          it->second->bitwidth() != old_param.bitwidth()) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Param " << old_param.name() << " of action "
+               << old_action.preamble().name()
+               << " is missing or changed in the new P4Info.";
+      }
+      param_id_map[old_param.id()] = it->second->id();
+      if (old_param.id() != it->second->id()) ids_unchanged_ = false;
+    }
+    if (new_action.params_size() != old_action.params_size()) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Action " << old_action.preamble().name()
+             << " has new params in the new P4Info.";
+    }
+  }
+
+  for (const auto& pair : tables) {
+    const auto& old_table = *pair.first;
+    const auto& new_table = *pair.second;
+    const std::string& name = old_table.preamble().name();
+    absl::flat_hash_map<std::string, const ::p4::config::v1::MatchField*>
+        new_fields_by_name;
+    for (const auto& field : new_table.match_fields()) {
+      new_fields_by_name[field.name()] = &field;
+    }
+    auto& match_field_id_map = match_field_id_maps_[old_table.preamble().id()];
+    for (const auto& old_field : old_table.match_fields()) {
+      auto it = new_fields_by_name.find(old_field.name());
+      if (it == new_fields_by_name.end() ||
+          it->second->match_type() != old_field.match_type() ||
+          it->second->bitwidth() != old_field.bitwidth()) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Match field " << old_field.name() << " of table " << name
+               << " is missing or changed in the new P4Info.";
+      }
+      match_field_id_map[old_field.id()] = it->second->id();
+      if (old_field.id() != it->second->id()) ids_unchanged_ = false;
+      new_fields_by_name.erase(it);
+    }
+    // Existing entries do not specify new fields, which is only valid for
+    // fields which can be wildcarded.
+    for (const auto& e : new_fields_by_name) {
+      if (e.second->match_type() == ::p4::config::v1::MatchField::EXACT) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Table " << name << " has new exact match field " << e.first
+               << " in the new P4Info.";
+      }
+    }
+    absl::flat_hash_set<uint32> new_action_ids;
+    for (const auto& action_ref : new_table.action_refs()) {
+      new_action_ids.insert(action_ref.id());
+    }
+    for (const auto& action_ref : old_table.action_refs()) {
+      auto it = id_map_.find(action_ref.id());
+      if (it == id_map_.end() || !new_action_ids.count(it->second)) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Action " << action_ref.id() << " of table " << name
+               << " is missing in the new P4Info.";
+      }
+    }
+    if (old_table.implementation_id() != 0) {
+      auto it = id_map_.find(old_table.implementation_id());
+      if (it == id_map_.end() ||
+          it->second != new_table.implementation_id()) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Implementation of table " << name
+               << " changed in the new P4Info.";
+      }
+    } else if (new_table.implementation_id() != 0) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Implementation of table " << name
+             << " changed in the new P4Info.";
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<uint32> P4InfoReconciler::TranslateId(uint32 old_id) const {
+  auto it = id_map_.find(old_id);
+  if (it == id_map_.end()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "P4 object with ID " << old_id
+           << " is not part of the new P4Info.";
+  }
+
+  return it->second;
+}
+
+::util::Status P4InfoReconciler::TranslateAction(
+    ::p4::v1::Action* action) const {
+  const uint32 old_action_id = action->action_id();
+  ASSIGN_OR_RETURN(uint32 action_id, TranslateId(old_action_id));
+  action->set_action_id(action_id);
+  const auto& param_id_map = param_id_maps_.at(old_action_id);
+  for (auto& param : *action->mutable_params()) {
+    auto it = param_id_map.find(param.param_id());
+    if (it == param_id_map.end()) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unknown param " << param.param_id() << " of action "
+             << old_action_id << ".";
+    }
+    param.set_param_id(it->second);
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4InfoReconciler::TranslateTableEntry(
+    ::p4::v1::TableEntry* entry) const {
+  const uint32 old_table_id = entry->table_id();
+  ASSIGN_OR_RETURN(uint32 table_id, TranslateId(old_table_id));
+  entry->set_table_id(table_id);
+  const auto& match_field_id_map = match_field_id_maps_.at(old_table_id);
+  for (auto& match : *entry->mutable_match()) {
+    auto it = match_field_id_map.find(match.field_id());
+    if (it == match_field_id_map.end()) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unknown match field " << match.field_id() << " of table "
+             << old_table_id << ".";
+    }
+    match.set_field_id(it->second);
+  }
+  switch (entry->action().type_case()) {
+    case ::p4::v1::TableAction::kAction:
+      RETURN_IF_ERROR(
+          TranslateAction(entry->mutable_action()->mutable_action()));
+      break;
+    case ::p4::v1::TableAction::kActionProfileActionSet:
+      for (auto& profile_action : *entry->mutable_action()
+                                       ->mutable_action_profile_action_set()
+                                       ->mutable_action_profile_actions()) {
+        RETURN_IF_ERROR(TranslateAction(profile_action.mutable_action()));
+      }
+      break;
+    default:
+      // Member and group IDs are not P4Info IDs.
+      break;
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4InfoReconciler::TranslateEntity(
+    ::p4::v1::Entity* entity) const {
+  switch (entity->entity_case()) {
+    case ::p4::v1::Entity::kTableEntry:
+      return TranslateTableEntry(entity->mutable_table_entry());
+    case ::p4::v1::Entity::kActionProfileMember: {
+      auto* member = entity->mutable_action_profile_member();
+      ASSIGN_OR_RETURN(uint32 action_profile_id,
+                       TranslateId(member->action_profile_id()));
+      member->set_action_profile_id(action_profile_id);
+      if (!member->has_action()) return ::util::OkStatus();
+      return TranslateAction(member->mutable_action());
+    }
+    case ::p4::v1::Entity::kActionProfileGroup: {
+      auto* group = entity->mutable_action_profile_group();
+      ASSIGN_OR_RETURN(uint32 action_profile_id,
+                       TranslateId(group->action_profile_id()));
+      group->set_action_profile_id(action_profile_id);
+      return ::util::OkStatus();
+    }
+    case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+      // PRE entries do not refer to P4Info objects.
+      return ::util::OkStatus();
+    case ::p4::v1::Entity::kCounterEntry: {
+      auto* counter_entry = entity->mutable_counter_entry();
+      ASSIGN_OR_RETURN(uint32 counter_id,
+                       TranslateId(counter_entry->counter_id()));
+      counter_entry->set_counter_id(counter_id);
+      return ::util::OkStatus();
+    }
+    case ::p4::v1::Entity::kMeterEntry: {
+      auto* meter_entry = entity->mutable_meter_entry();
+      ASSIGN_OR_RETURN(uint32 meter_id, TranslateId(meter_entry->meter_id()));
+      meter_entry->set_meter_id(meter_id);
+      return ::util::OkStatus();
+    }
+    case ::p4::v1::Entity::kRegisterEntry: {
+      auto* register_entry = entity->mutable_register_entry();
+      ASSIGN_OR_RETURN(uint32 register_id,
+                       TranslateId(register_entry->register_id()));
+      register_entry->set_register_id(register_id);
+      return ::util::OkStatus();
+    }
+    case ::p4::v1::Entity::kDirectCounterEntry:
+      return TranslateTableEntry(
+          entity->mutable_direct_counter_entry()->mutable_table_entry());
+    case ::p4::v1::Entity::kDirectMeterEntry:
+      return TranslateTableEntry(
+          entity->mutable_direct_meter_entry()->mutable_table_entry());
+    default:
+      return MAKE_ERROR(ERR_UNIMPLEMENTED)
+             << "Reconciling entity " << entity->ShortDebugString()
+             << " is not supported.";
+  }
+}
+
+::util::Status P4InfoReconciler::BuildReplayRequest(
+    const std::vector<::p4::v1::Entity>& entities,
+    ::p4::v1::WriteRequest* req) const {
+  // Lower ranks are inserted first.
+  auto rank = [](const ::p4::v1::Entity& entity) {
+    switch (entity.entity_case()) {
+      case ::p4::v1::Entity::kActionProfileMember:
+        return 0;
+      case ::p4::v1::Entity::kActionProfileGroup:
+        return 1;
+      case ::p4::v1::Entity::kTableEntry:
+        return 2;
+      case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+        return 3;
+      default:
+        return 4;
+    }
+  };
+  for (int r = 0; r <= 4; ++r) {
+    for (const auto& entity : entities) {
+      if (rank(entity) != r) continue;
+      auto* update = req->add_updates();
+      update->set_type(::p4::v1::Update::INSERT);
+      *update->mutable_entity() = entity;
+      RETURN_IF_ERROR(TranslateEntity(update->mutable_entity()));
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace hal
+}  // namespace stratum
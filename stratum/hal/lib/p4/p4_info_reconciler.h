@@ -0,0 +1,108 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// The P4InfoReconciler maps the P4 objects of the P4Info in effect on a node
+// to the objects of a new P4Info, so that the forwarding state programmed for
+// the old P4Info can be carried over to the new one on a
+// RECONCILE_AND_COMMIT pipeline push.
+
+#ifndef STRATUM_HAL_LIB_P4_P4_INFO_RECONCILER_H_
+#define STRATUM_HAL_LIB_P4_P4_INFO_RECONCILER_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+
+namespace stratum {
+namespace hal {
+
+// P4 objects are matched by name between the old and the new P4Info. Two
+// P4Infos are compatible if every object present in both accepts the entries
+// programmed for the old object, i.e.:
+//  - tables keep their match fields (name, match type and bitwidth), do not
+//    add exact match fields, keep their actions and their implementation.
+//  - actions keep their params (name and bitwidth) and do not add params.
+// Objects can be added to or removed from the new P4Info. Translating an
+// entity of a removed object fails, so callers find out whether the actual
+// forwarding state can be carried over.
+// A P4InfoReconciler is immutable after creation and thus thread-safe.
+class P4InfoReconciler {
+ public:
+  virtual ~P4InfoReconciler() {}
+
+  // Creates a reconciler from old_p4info to new_p4info. Returns
+  // ERR_INVALID_PARAM if the two P4Infos are not compatible.
+  static ::util::StatusOr<std::unique_ptr<P4InfoReconciler>> CreateInstance(
+      const ::p4::config::v1::P4Info& old_p4info,
+      const ::p4::config::v1::P4Info& new_p4info);
+
+  // Returns true if every object of the old P4Info, including match fields
+  // and action params, keeps its ID in the new P4Info.
+  bool IdsUnchanged() const { return ids_unchanged_; }
+
+  // Returns true if every object of the old P4Info is part of the new P4Info,
+  // i.e. if the entries programmed for the old P4Info stay reachable.
+  bool KeepsAllObjects() const { return keeps_all_objects_; }
+
+  // Translates the P4Info IDs of the given entity, read with the old P4Info,
+  // to the IDs of the new P4Info. Returns ERR_INVALID_PARAM if the entity
+  // refers to an object which is not part of the new P4Info.
+  ::util::Status TranslateEntity(::p4::v1::Entity* entity) const;
+
+  // Translates the given entities and appends them as INSERT updates to req,
+  // ordered such that entities are inserted after the entities they refer to:
+  // action profile members, action profile groups, table entries and PRE
+  // entries, followed by everything else.
+  ::util::Status BuildReplayRequest(
+      const std::vector<::p4::v1::Entity>& entities,
+      ::p4::v1::WriteRequest* req) const;
+
+  // P4InfoReconciler is neither copyable nor movable.
+  P4InfoReconciler(const P4InfoReconciler&) = delete;
+  P4InfoReconciler& operator=(const P4InfoReconciler&) = delete;
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance.
+  P4InfoReconciler();
+
+  // Builds the ID maps, verifying the compatibility of the P4Infos.
+  ::util::Status Initialize(const ::p4::config::v1::P4Info& old_p4info,
+                            const ::p4::config::v1::P4Info& new_p4info);
+
+  // Returns the ID in the new P4Info of the object with the given old ID.
+  ::util::StatusOr<uint32> TranslateId(uint32 old_id) const;
+
+  // Helpers to translate the different parts of an entity.
+  ::util::Status TranslateTableEntry(::p4::v1::TableEntry* entry) const;
+  ::util::Status TranslateAction(::p4::v1::Action* action) const;
+
+  // Map from the ID of an object in the old P4Info to the ID of the object
+  // with the same name in the new P4Info. P4Info IDs are unique across object
+  // types, so a single map covers all the objects.
+  absl::flat_hash_map<uint32, uint32> id_map_;
+
+  // Map from old table ID to the map from old to new match field IDs.
+  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, uint32>>
+      match_field_id_maps_;
+
+  // Map from old action ID to the map from old to new param IDs.
+  absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, uint32>>
+      param_id_maps_;
+
+  // True if no ID changes between the old and the new P4Info.
+  bool ids_unchanged_;
+
+  // True if no object is removed from the old P4Info.
+  bool keeps_all_objects_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_P4_P4_INFO_RECONCILER_H_
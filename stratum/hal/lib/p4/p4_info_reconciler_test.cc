@@ -0,0 +1,263 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// This file contains P4InfoReconciler unit tests.
+
+#include "stratum/hal/lib/p4/p4_info_reconciler.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+using test_utils::EqualsProto;
+using ::testing::HasSubstr;
+
+namespace {
+
+constexpr char kOldP4Info[] = R"pb(
+  tables {
+    preamble { id: 33554433 name: "ingress.acl" }
+    match_fields { id: 1 name: "ether_type" bitwidth: 16 match_type: TERNARY }
+    match_fields { id: 2 name: "ipv4_dst" bitwidth: 32 match_type: TERNARY }
+    action_refs { id: 16777217 }
+  }
+  tables {
+    preamble { id: 33554434 name: "ingress.next" }
+    match_fields { id: 1 name: "next_id" bitwidth: 32 match_type: EXACT }
+    action_refs { id: 16777217 }
+    implementation_id: 285212673
+  }
+  actions {
+    preamble { id: 16777217 name: "ingress.set_port" }
+    params { id: 1 name: "port" bitwidth: 9 }
+  }
+  action_profiles {
+    preamble { id: 285212673 name: "ingress.selector" }
+    table_ids: 33554434
+  }
+)pb";
+
+// Same objects as kOldP4Info, with different IDs, an additional ternary match
+// field and an additional table.
+constexpr char kNewP4Info[] = R"pb(
+  tables {
+    preamble { id: 33554443 name: "ingress.next" }
+    match_fields { id: 1 name: "next_id" bitwidth: 32 match_type: EXACT }
+    action_refs { id: 16777227 }
+    implementation_id: 285212683
+  }
+  tables {
+    preamble { id: 33554444 name: "ingress.acl" }
+    match_fields { id: 3 name: "ip_proto" bitwidth: 8 match_type: TERNARY }
+    match_fields { id: 2 name: "ether_type" bitwidth: 16 match_type: TERNARY }
+    match_fields { id: 1 name: "ipv4_dst" bitwidth: 32 match_type: TERNARY }
+    action_refs { id: 16777227 }
+  }
+  tables {
+    preamble { id: 33554445 name: "ingress.new_table" }
+    action_refs { id: 16777227 }
+  }
+  actions {
+    preamble { id: 16777227 name: "ingress.set_port" }
+    params { id: 1 name: "port" bitwidth: 9 }
+  }
+  action_profiles {
+    preamble { id: 285212683 name: "ingress.selector" }
+    table_ids: 33554443
+  }
+)pb";
+
+}  // namespace
+
+class P4InfoReconcilerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_OK(ParseProtoFromString(kOldP4Info, &old_p4info_));
+    ASSERT_OK(ParseProtoFromString(kNewP4Info, &new_p4info_));
+  }
+
+  ::p4::config::v1::P4Info old_p4info_;
+  ::p4::config::v1::P4Info new_p4info_;
+};
+
+TEST_F(P4InfoReconcilerTest, SameP4InfoKeepsIds) {
+  ASSERT_OK_AND_ASSIGN(auto reconciler, P4InfoReconciler::CreateInstance(
+                                            old_p4info_, old_p4info_));
+  EXPECT_TRUE(reconciler->IdsUnchanged());
+  EXPECT_TRUE(reconciler->KeepsAllObjects());
+
+  ::p4::v1::Entity entity;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    table_entry {
+      table_id: 33554433
+      match { field_id: 1 ternary { value: "\x08\x00" mask: "\xff\xff" } }
+      action {
+        action { action_id: 16777217 params { param_id: 1 value: "\x01" } }
+      }
+      priority: 10
+    }
+  )pb", &entity));
+  ::p4::v1::Entity translated = entity;
+  EXPECT_OK(reconciler->TranslateEntity(&translated));
+  EXPECT_THAT(translated, EqualsProto(entity));
+}
+
+TEST_F(P4InfoReconcilerTest, TranslatesIds) {
+  ASSERT_OK_AND_ASSIGN(auto reconciler, P4InfoReconciler::CreateInstance(
+                                            old_p4info_, new_p4info_));
+  EXPECT_FALSE(reconciler->IdsUnchanged());
+
+  ::p4::v1::Entity entity;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    table_entry {
+      table_id: 33554433
+      match { field_id: 1 ternary { value: "\x08\x00" mask: "\xff\xff" } }
+      match { field_id: 2 ternary { value: "\x0a\x00\x00\x01" mask: "\xff" } }
+      action {
+        action { action_id: 16777217 params { param_id: 1 value: "\x01" } }
+      }
+      priority: 10
+    }
+  )pb", &entity));
+  ::p4::v1::Entity expected;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    table_entry {
+      table_id: 33554444
+      match { field_id: 2 ternary { value: "\x08\x00" mask: "\xff\xff" } }
+      match { field_id: 1 ternary { value: "\x0a\x00\x00\x01" mask: "\xff" } }
+      action {
+        action { action_id: 16777227 params { param_id: 1 value: "\x01" } }
+      }
+      priority: 10
+    }
+  )pb", &expected));
+  EXPECT_OK(reconciler->TranslateEntity(&entity));
+  EXPECT_THAT(entity, EqualsProto(expected));
+}
+
+TEST_F(P4InfoReconcilerTest, BuildReplayRequestOrdersByDependency) {
+  ASSERT_OK_AND_ASSIGN(auto reconciler, P4InfoReconciler::CreateInstance(
+                                            old_p4info_, new_p4info_));
+  std::vector<::p4::v1::Entity> entities(4);
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    table_entry {
+      table_id: 33554434
+      match { field_id: 1 exact { value: "\x01" } }
+      action { action_profile_group_id: 1 }
+    }
+  )pb", &entities[0]));
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    packet_replication_engine_entry {
+      multicast_group_entry { multicast_group_id: 1 }
+    }
+  )pb", &entities[1]));
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    action_profile_group { action_profile_id: 285212673 group_id: 1 }
+  )pb", &entities[2]));
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    action_profile_member {
+      action_profile_id: 285212673
+      member_id: 1
+      action { action_id: 16777217 params { param_id: 1 value: "\x01" } }
+    }
+  )pb", &entities[3]));
+
+  ::p4::v1::WriteRequest req;
+  ASSERT_OK(reconciler->BuildReplayRequest(entities, &req));
+  ::p4::v1::WriteRequest expected;
+  ASSERT_OK(ParseProtoFromString(R"pb(
+    updates {
+      type: INSERT
+      entity {
+        action_profile_member {
+          action_profile_id: 285212683
+          member_id: 1
+          action { action_id: 16777227 params { param_id: 1 value: "\x01" } }
+        }
+      }
+    }
+    updates {
+      type: INSERT
+      entity {
+        action_profile_group { action_profile_id: 285212683 group_id: 1 }
+      }
+    }
+    updates {
+      type: INSERT
+      entity {
+        table_entry {
+          table_id: 33554443
+          match { field_id: 1 exact { value: "\x01" } }
+          action { action_profile_group_id: 1 }
+        }
+      }
+    }
+    updates {
+      type: INSERT
+      entity {
+        packet_replication_engine_entry {
+          multicast_group_entry { multicast_group_id: 1 }
+        }
+      }
+    }
+  )pb", &expected));
+  EXPECT_THAT(req, EqualsProto(expected));
+}
+
+TEST_F(P4InfoReconcilerTest, EntityOfRemovedObjectFails) {
+  new_p4info_.mutable_tables()->RemoveLast();
+  new_p4info_.mutable_tables()->RemoveLast();
+  ASSERT_OK_AND_ASSIGN(auto reconciler, P4InfoReconciler::CreateInstance(
+                                            old_p4info_, new_p4info_));
+  EXPECT_FALSE(reconciler->KeepsAllObjects());
+
+  ::p4::v1::Entity entity;
+  entity.mutable_table_entry()->set_table_id(33554433);
+  ::util::Status status = reconciler->TranslateEntity(&entity);
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("not part of the new P4Info"));
+}
+
+TEST_F(P4InfoReconcilerTest, ChangedMatchFieldIsIncompatible) {
+  new_p4info_.mutable_tables(1)->mutable_match_fields(1)->set_bitwidth(12);
+  auto ret = P4InfoReconciler::CreateInstance(old_p4info_, new_p4info_);
+  EXPECT_EQ(ERR_INVALID_PARAM, ret.status().error_code());
+  EXPECT_THAT(ret.status().error_message(), HasSubstr("ether_type"));
+}
+
+TEST_F(P4InfoReconcilerTest, NewExactMatchFieldIsIncompatible) {
+  new_p4info_.mutable_tables(1)->mutable_match_fields(0)->set_match_type(
+      ::p4::config::v1::MatchField::EXACT);
+  auto ret = P4InfoReconciler::CreateInstance(old_p4info_, new_p4info_);
+  EXPECT_EQ(ERR_INVALID_PARAM, ret.status().error_code());
+  EXPECT_THAT(ret.status().error_message(), HasSubstr("ip_proto"));
+}
+
+TEST_F(P4InfoReconcilerTest, NewActionParamIsIncompatible) {
+  auto* param = new_p4info_.mutable_actions(0)->add_params();
+  param->set_id(2);
+  param->set_name("smac");
+  param->set_bitwidth(48);
+  auto ret = P4InfoReconciler::CreateInstance(old_p4info_, new_p4info_);
+  EXPECT_EQ(ERR_INVALID_PARAM, ret.status().error_code());
+  EXPECT_THAT(ret.status().error_message(), HasSubstr("ingress.set_port"));
+}
+
+TEST_F(P4InfoReconcilerTest, ChangedImplementationIsIncompatible) {
+  new_p4info_.mutable_tables(0)->clear_implementation_id();
+  auto ret = P4InfoReconciler::CreateInstance(old_p4info_, new_p4info_);
+  EXPECT_EQ(ERR_INVALID_PARAM, ret.status().error_code());
+  EXPECT_THAT(ret.status().error_message(), HasSubstr("ingress.next"));
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -11,6 +11,7 @@
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/logging.h"
 #include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/common/chunked_read_response_writer.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/constants.h"
 #include "stratum/lib/macros.h"
@@ -172,9 +173,11 @@ std::unique_ptr<PINode> PINode::CreateInstance(
   ::p4::v1::ReadResponse response;
   auto status = device_mgr_->read(req, &response);
   RETURN_IF_ERROR(toUtilStatus(status, details, req.entities_size()));
-  if (!writer->Write(response))
-    return MAKE_ERROR(ERR_INTERNAL) << "Write to stream channel failed.";
-  return ::util::OkStatus();
+  // The DeviceMgr returns all the entities at once. Still stream them in
+  // bounded chunks to stay below the max gRPC message size.
+  ChunkedReadResponseWriter chunked_writer(writer);
+  RETURN_IF_ERROR(chunked_writer.AddEntities(&response));
+  return chunked_writer.Flush();
 }
 
 ::util::Status PINode::RegisterStreamMessageResponseWriter(
@@ -0,0 +1,114 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/bounded_executor.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+
+BoundedExecutor::BoundedExecutor(const std::string& name,
+                                 size_t max_queue_size)
+    : name_(name),
+      max_queue_size_(max_queue_size),
+      tasks_(),
+      num_rejected_(0),
+      shutdown_(false),
+      worker_tids_() {}
+
+BoundedExecutor::~BoundedExecutor() { Shutdown(); }
+
+::util::StatusOr<std::unique_ptr<BoundedExecutor>>
+BoundedExecutor::CreateInstance(const std::string& name, int num_threads,
+                                size_t max_queue_size) {
+  RET_CHECK(num_threads > 0) << "Number of threads must be positive.";
+  RET_CHECK(max_queue_size > 0) << "Max queue size must be positive.";
+  auto executor = absl::WrapUnique(new BoundedExecutor(name, max_queue_size));
+  for (int i = 0; i < num_threads; ++i) {
+    pthread_t tid;
+    int ret = pthread_create(&tid, nullptr, &BoundedExecutor::WorkerThreadFunc,
+                             executor.get());
+    if (ret != 0) {
+      // The threads started so far are joined by the destructor.
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to spawn worker thread " << i << " of executor "
+             << name << ". Err: " << ret << ".";
+    }
+    executor->worker_tids_.push_back(tid);
+  }
+
+  return std::move(executor);
+}
+
+::util::Status BoundedExecutor::Submit(std::function<void()> task) {
+  absl::MutexLock l(&lock_);
+  if (shutdown_) {
+    return MAKE_ERROR(ERR_CANCELLED)
+           << "Executor " << name_ << " is shut down.";
+  }
+  if (tasks_.size() >= max_queue_size_) {
+    ++num_rejected_;
+    return MAKE_ERROR(ERR_NO_RESOURCE)
+           << "Executor " << name_ << " has " << tasks_.size()
+           << " pending tasks. Try again later.";
+  }
+  tasks_.push_back(std::move(task));
+  task_available_.Signal();
+
+  return ::util::OkStatus();
+}
+
+void BoundedExecutor::Shutdown() {
+  {
+    absl::MutexLock l(&lock_);
+    if (shutdown_) return;
+    shutdown_ = true;
+    task_available_.SignalAll();
+  }
+  for (const auto& tid : worker_tids_) {
+    int ret = pthread_join(tid, nullptr);
+    if (ret != 0) {
+      LOG(ERROR) << "Failed to join a worker thread of executor " << name_
+                 << " with error " << ret << ".";
+    }
+  }
+  worker_tids_.clear();
+}
+
+size_t BoundedExecutor::GetQueueSize() const {
+  absl::MutexLock l(&lock_);
+  return tasks_.size();
+}
+
+uint64 BoundedExecutor::GetRejectedTasksCount() const {
+  absl::MutexLock l(&lock_);
+  return num_rejected_;
+}
+
+void* BoundedExecutor::WorkerThreadFunc(void* arg) {
+  BoundedExecutor* executor = static_cast<BoundedExecutor*>(arg);
+  executor->WorkerLoop();
+  return nullptr;
+}
+
+void BoundedExecutor::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      absl::MutexLock l(&lock_);
+      while (tasks_.empty() && !shutdown_) task_available_.Wait(&lock_);
+      if (tasks_.empty()) break;  // Shut down and nothing left to run.
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace stratum
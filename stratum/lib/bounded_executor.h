@@ -0,0 +1,95 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_LIB_BOUNDED_EXECUTOR_H_
+#define STRATUM_LIB_BOUNDED_EXECUTOR_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+
+namespace stratum {
+
+// The "BoundedExecutor" class runs tasks on a fixed number of worker threads.
+// Tasks wait in a FIFO queue of bounded size until a worker picks them up.
+// Submitting a task to a full queue fails right away with ERR_NO_RESOURCE
+// instead of blocking the caller or growing the queue, so that the caller can
+// push back on its own clients (e.g. by failing the RPC with
+// RESOURCE_EXHAUSTED).
+class BoundedExecutor {
+ public:
+  virtual ~BoundedExecutor();
+
+  // Queues the task to be run by one of the worker threads. Returns
+  // ERR_NO_RESOURCE if the queue is full and ERR_CANCELLED if the executor is
+  // shut down. The task is not run if an error is returned.
+  ::util::Status Submit(std::function<void()> task) LOCKS_EXCLUDED(lock_);
+
+  // Runs all the tasks still in the queue, then stops and joins the worker
+  // threads. Further Submit() calls fail. Called by the destructor.
+  void Shutdown() LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of tasks waiting in the queue.
+  size_t GetQueueSize() const LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of tasks rejected because the queue was full.
+  uint64 GetRejectedTasksCount() const LOCKS_EXCLUDED(lock_);
+
+  // Creates an executor with the given number of worker threads and max queue
+  // size, and starts the worker threads. The name is only used in logs.
+  static ::util::StatusOr<std::unique_ptr<BoundedExecutor>> CreateInstance(
+      const std::string& name, int num_threads, size_t max_queue_size);
+
+  // BoundedExecutor is neither copyable nor movable.
+  BoundedExecutor(const BoundedExecutor&) = delete;
+  BoundedExecutor& operator=(const BoundedExecutor&) = delete;
+
+ private:
+  // Private constructor. Use CreateInstance() to create an instance.
+  BoundedExecutor(const std::string& name, size_t max_queue_size);
+
+  // Thread function for the worker threads.
+  static void* WorkerThreadFunc(void* arg);
+
+  // Main loop of a worker thread. Returns once the executor is shut down and
+  // the queue is empty.
+  void WorkerLoop() LOCKS_EXCLUDED(lock_);
+
+  // Name and max queue size, set in the constructor and never changed
+  // afterwards.
+  const std::string name_;
+  const size_t max_queue_size_;
+
+  // Protects the queue and the internal state. Never held while running a
+  // task.
+  mutable absl::Mutex lock_;
+
+  // Signaled when a task is queued or on shutdown.
+  absl::CondVar task_available_;
+
+  // The tasks waiting to be run.
+  std::deque<std::function<void()>> tasks_ GUARDED_BY(lock_);
+
+  // Number of tasks rejected because the queue was full.
+  uint64 num_rejected_ GUARDED_BY(lock_);
+
+  // Set to true when the executor is shutting down.
+  bool shutdown_ GUARDED_BY(lock_);
+
+  // The worker thread ids. Only changed by CreateInstance() and Shutdown().
+  std::vector<pthread_t> worker_tids_;
+};
+
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_BOUNDED_EXECUTOR_H_
@@ -0,0 +1,86 @@
+// Copyright 2018-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/bounded_executor.h"
+
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+
+class BoundedExecutorTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<BoundedExecutor> CreateExecutor(int num_threads,
+                                                  size_t max_queue_size) {
+    auto ret = BoundedExecutor::CreateInstance("test", num_threads,
+                                               max_queue_size);
+    EXPECT_OK(ret.status());
+    return ret.ok() ? ret.ConsumeValueOrDie() : nullptr;
+  }
+};
+
+TEST_F(BoundedExecutorTest, AllSubmittedTasksAreRun) {
+  auto executor = CreateExecutor(4, 1000);
+  ASSERT_NE(nullptr, executor);
+  absl::Mutex lock;
+  int counter = 0;
+
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_OK(executor->Submit([&lock, &counter]() {
+      absl::MutexLock l(&lock);
+      ++counter;
+    }));
+  }
+  executor->Shutdown();
+
+  absl::MutexLock l(&lock);
+  EXPECT_EQ(1000, counter);
+  EXPECT_EQ(0U, executor->GetQueueSize());
+  EXPECT_EQ(0U, executor->GetRejectedTasksCount());
+}
+
+TEST_F(BoundedExecutorTest, SubmitFailsWhenQueueIsFull) {
+  auto executor = CreateExecutor(1, 2);
+  ASSERT_NE(nullptr, executor);
+  absl::Notification started, release;
+
+  // Keep the single worker busy, then fill the queue.
+  ASSERT_OK(executor->Submit([&started, &release]() {
+    started.Notify();
+    release.WaitForNotification();
+  }));
+  started.WaitForNotification();
+  ASSERT_OK(executor->Submit([]() {}));
+  ASSERT_OK(executor->Submit([]() {}));
+  ::util::Status status = executor->Submit([]() {});
+
+  EXPECT_EQ(ERR_NO_RESOURCE, status.error_code());
+  EXPECT_EQ(2U, executor->GetQueueSize());
+  EXPECT_EQ(1U, executor->GetRejectedTasksCount());
+  release.Notify();
+  executor->Shutdown();
+  EXPECT_EQ(0U, executor->GetQueueSize());
+}
+
+TEST_F(BoundedExecutorTest, SubmitFailsAfterShutdown) {
+  auto executor = CreateExecutor(2, 10);
+  ASSERT_NE(nullptr, executor);
+  executor->Shutdown();
+
+  ::util::Status status = executor->Submit([]() {});
+
+  EXPECT_EQ(ERR_CANCELLED, status.error_code());
+  EXPECT_EQ(0U, executor->GetRejectedTasksCount());
+}
+
+TEST_F(BoundedExecutorTest, CreateInstanceFailsForInvalidArgs) {
+  EXPECT_FALSE(BoundedExecutor::CreateInstance("test", 0, 10).ok());
+  EXPECT_FALSE(BoundedExecutor::CreateInstance("test", 1, 0).ok());
+}
+
+}  // namespace stratum
@@ -35,6 +35,11 @@ ssize_t PassthroughLibcProxy::sendmsg(int sockfd, const struct msghdr* msg,
   return ::sendmsg(sockfd, msg, flags);
 }
 
+int PassthroughLibcProxy::sendmmsg(int sockfd, struct mmsghdr* msgvec,
+                                   unsigned int vlen, int flags) {
+  return ::sendmmsg(sockfd, msgvec, vlen, flags);
+}
+
 ssize_t PassthroughLibcProxy::recvmsg(int sockfd, struct msghdr* msg,
                                       int flags) {
   return ::recvmsg(sockfd, msg, flags);
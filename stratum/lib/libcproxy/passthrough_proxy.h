@@ -37,6 +37,9 @@ class PassthroughLibcProxy {
 
   virtual ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags);
 
+  virtual int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+                       int flags);
+
   virtual ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags);
 
   virtual int epoll_create1(int flags);
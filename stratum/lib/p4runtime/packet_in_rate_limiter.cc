@@ -0,0 +1,118 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/p4runtime/packet_in_rate_limiter.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "google/protobuf/util/message_differencer.h"
+#include "stratum/hal/lib/p4/utils.h"
+
+namespace stratum {
+namespace p4runtime {
+
+constexpr size_t PacketInRateLimiter::kMaxBucketsPerRateLimit;
+
+PacketInRateLimiter::PacketInRateLimiter(const P4RoleConfig& role_config)
+    : rate_limits_(CanonicalRateLimits(role_config)),
+      buckets_(),
+      bucket_counts_(rate_limits_.size(), 0),
+      dropped_counts_(rate_limits_.size(), 0) {}
+
+bool PacketInRateLimiter::Allow(const p4::v1::PacketIn& packet,
+                                absl::Time now) {
+  std::string value;
+  const int index = FindRateLimit(packet, &value);
+  if (index < 0) return true;  // Not rate limited.
+
+  const auto& rate_limit = rate_limits_[index];
+  const double burst = rate_limit.burst_size() > 0 ? rate_limit.burst_size()
+                                                   : rate_limit.rate_pps();
+  absl::optional<std::string> key;  // The shared bucket by default.
+  if (rate_limit.per_value()) key = std::move(value);
+  auto it = buckets_.find(std::make_pair(index, key));
+  if (it == buckets_.end()) {
+    if (key.has_value() && bucket_counts_[index] >= kMaxBucketsPerRateLimit) {
+      key.reset();  // Use the bucket shared by the excess values.
+      it = buckets_.find(std::make_pair(index, key));
+    }
+    if (it == buckets_.end()) {
+      // New buckets start full.
+      TokenBucket bucket = {burst, now};
+      it = buckets_.emplace(std::make_pair(index, key), bucket).first;
+      ++bucket_counts_[index];
+    }
+  }
+
+  TokenBucket& bucket = it->second;
+  if (now > bucket.last_refill) {
+    bucket.tokens = std::min(
+        burst, bucket.tokens + absl::ToDoubleSeconds(now - bucket.last_refill) *
+                                   rate_limit.rate_pps());
+    bucket.last_refill = now;
+  }
+  if (bucket.tokens < 1.0) {
+    ++dropped_counts_[index];
+    return false;
+  }
+  bucket.tokens -= 1.0;
+
+  return true;
+}
+
+bool PacketInRateLimiter::HasRateLimitsOf(
+    const P4RoleConfig& role_config) const {
+  const auto rate_limits = CanonicalRateLimits(role_config);
+  if (rate_limits.size() != rate_limits_.size()) return false;
+  for (size_t i = 0; i < rate_limits.size(); ++i) {
+    if (!google::protobuf::util::MessageDifferencer::Equals(rate_limits[i],
+                                                            rate_limits_[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::vector<P4RoleConfig::PacketInRateLimit>
+PacketInRateLimiter::CanonicalRateLimits(const P4RoleConfig& role_config) {
+  std::vector<P4RoleConfig::PacketInRateLimit> rate_limits(
+      role_config.packet_in_rate_limits().begin(),
+      role_config.packet_in_rate_limits().end());
+  // Metadata values are compared in canonical form.
+  for (auto& rate_limit : rate_limits) {
+    for (auto& value : *rate_limit.mutable_values()) {
+      value = hal::ByteStringToP4RuntimeByteString(value);
+    }
+  }
+
+  return rate_limits;
+}
+
+int PacketInRateLimiter::FindRateLimit(const p4::v1::PacketIn& packet,
+                                       std::string* value) const {
+  for (size_t i = 0; i < rate_limits_.size(); ++i) {
+    const auto& rate_limit = rate_limits_[i];
+    if (rate_limit.metadata_id() == 0) {
+      value->clear();
+      return i;
+    }
+    for (const auto& metadata : packet.metadata()) {
+      if (metadata.metadata_id() != rate_limit.metadata_id()) continue;
+      std::string canonical_value =
+          hal::ByteStringToP4RuntimeByteString(metadata.value());
+      if (rate_limit.values_size() == 0 ||
+          std::find(rate_limit.values().begin(), rate_limit.values().end(),
+                    canonical_value) != rate_limit.values().end()) {
+        *value = std::move(canonical_value);
+        return i;
+      }
+    }
+  }
+
+  return -1;
+}
+
+}  // namespace p4runtime
+}  // namespace stratum
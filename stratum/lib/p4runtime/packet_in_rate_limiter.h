@@ -0,0 +1,88 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_LIB_P4RUNTIME_PACKET_IN_RATE_LIMITER_H_
+#define STRATUM_LIB_P4RUNTIME_PACKET_IN_RATE_LIMITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/public/proto/p4_role_config.pb.h"
+
+namespace stratum {
+namespace p4runtime {
+
+// Enforces the packet_in_rate_limits of a P4RoleConfig on the PacketIns sent
+// to a role, using one token bucket per rate limit or, for per-value rate
+// limits, per distinct metadata value. Not thread-safe.
+class PacketInRateLimiter {
+ public:
+  // Max number of token buckets of a per-value rate limit. PacketIns with
+  // further values share a single bucket, so that a flood of distinct values
+  // cannot grow the limiter without bound.
+  static constexpr size_t kMaxBucketsPerRateLimit = 4096;
+
+  explicit PacketInRateLimiter(const P4RoleConfig& role_config);
+
+  // Returns true if the given PacketIn, received at the given time, is within
+  // its rate limit and can be sent. Consumes one token if so.
+  bool Allow(const p4::v1::PacketIn& packet, absl::Time now);
+
+  // Returns true if the given role config has the same packet_in_rate_limits
+  // as the one the limiter was built from, in which case the limiter can be
+  // kept for it with its current state.
+  bool HasRateLimitsOf(const P4RoleConfig& role_config) const;
+
+  // Returns the number of PacketIns dropped by each rate limit, in the order
+  // of the role config.
+  const std::vector<uint64_t>& GetDroppedCounts() const {
+    return dropped_counts_;
+  }
+
+ private:
+  struct TokenBucket {
+    double tokens;
+    absl::Time last_refill;
+  };
+
+  // Returns the packet_in_rate_limits of the given role config, with values
+  // in canonical form.
+  static std::vector<P4RoleConfig::PacketInRateLimit> CanonicalRateLimits(
+      const P4RoleConfig& role_config);
+
+  // Returns the index of the first rate limit matching the PacketIn, and the
+  // metadata value it matched on, in canonical form. Returns -1 if none
+  // matches.
+  int FindRateLimit(const p4::v1::PacketIn& packet,
+                    std::string* value) const;
+
+  // The rate limits, with values in canonical form.
+  std::vector<P4RoleConfig::PacketInRateLimit> rate_limits_;
+
+  // The token buckets, created on first use.
+  // key:   (rate limit index, metadata value or nullopt for a shared bucket)
+  // value: token bucket
+  // The shared bucket of a per-value rate limit, used by the excess values,
+  // must not be the bucket of an empty metadata value.
+  absl::flat_hash_map<std::pair<int, absl::optional<std::string>>, TokenBucket>
+      buckets_;
+
+  // The number of buckets per rate limit.
+  std::vector<size_t> bucket_counts_;
+
+  // The number of dropped PacketIns per rate limit.
+  std::vector<uint64_t> dropped_counts_;
+};
+
+}  // namespace p4runtime
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_P4RUNTIME_PACKET_IN_RATE_LIMITER_H_
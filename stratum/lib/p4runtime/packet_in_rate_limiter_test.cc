@@ -0,0 +1,171 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/p4runtime/packet_in_rate_limiter.h"
+
+#include <string>
+
+#include "absl/time/time.h"
+#include "glog/logging.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+namespace stratum {
+namespace p4runtime {
+
+constexpr uint32_t kIngressPortId = 1;
+constexpr uint32_t kReasonId = 2;
+
+class PacketInRateLimiterTest : public ::testing::Test {
+ protected:
+  static P4RoleConfig ParseRoleConfig(const std::string& text) {
+    P4RoleConfig role_config;
+    CHECK(google::protobuf::TextFormat::ParseFromString(text, &role_config));
+    return role_config;
+  }
+
+  static p4::v1::PacketIn PacketIn(const std::string& port,
+                                   const std::string& reason) {
+    p4::v1::PacketIn packet;
+    auto* metadata = packet.add_metadata();
+    metadata->set_metadata_id(kIngressPortId);
+    metadata->set_value(port);
+    metadata = packet.add_metadata();
+    metadata->set_metadata_id(kReasonId);
+    metadata->set_value(reason);
+    return packet;
+  }
+
+  // Returns the number of the given PacketIns allowed at the given time.
+  static int CountAllowed(PacketInRateLimiter* limiter,
+                          const p4::v1::PacketIn& packet, int num_packets,
+                          absl::Time now) {
+    int allowed = 0;
+    for (int i = 0; i < num_packets; ++i) {
+      if (limiter->Allow(packet, now)) ++allowed;
+    }
+    return allowed;
+  }
+
+  const absl::Time start_ = absl::UnixEpoch() + absl::Hours(1);
+};
+
+TEST_F(PacketInRateLimiterTest, NoRateLimitsAllowsEverything) {
+  PacketInRateLimiter limiter(P4RoleConfig{});
+
+  EXPECT_EQ(100, CountAllowed(&limiter, PacketIn("\x01", "\x01"), 100,
+                              start_));
+}
+
+TEST_F(PacketInRateLimiterTest, BurstThenSustainedRate) {
+  PacketInRateLimiter limiter(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { rate_pps: 10 burst_size: 5 }
+  )pb"));
+  const auto packet = PacketIn("\x01", "\x01");
+
+  EXPECT_EQ(5, CountAllowed(&limiter, packet, 20, start_));
+  // 10 pps refill 5 tokens in half a second.
+  EXPECT_EQ(5, CountAllowed(&limiter, packet, 20,
+                            start_ + absl::Milliseconds(500)));
+  // Tokens never exceed the burst size.
+  EXPECT_EQ(5, CountAllowed(&limiter, packet, 20, start_ + absl::Hours(1)));
+  EXPECT_THAT(limiter.GetDroppedCounts(), ::testing::ElementsAre(45U));
+}
+
+TEST_F(PacketInRateLimiterTest, FirstMatchingRateLimitApplies) {
+  // Reason 1 (e.g. LLDP) is allowed a high rate, everything else shares a
+  // low rate.
+  PacketInRateLimiter limiter(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 2 values: "\x01" rate_pps: 100 }
+    packet_in_rate_limits { rate_pps: 2 }
+  )pb"));
+
+  EXPECT_EQ(2, CountAllowed(&limiter, PacketIn("\x01", "\x02"), 50, start_));
+  EXPECT_EQ(50, CountAllowed(&limiter, PacketIn("\x01", "\x01"), 50, start_));
+  EXPECT_THAT(limiter.GetDroppedCounts(), ::testing::ElementsAre(0U, 48U));
+}
+
+TEST_F(PacketInRateLimiterTest, PerValueBuckets) {
+  PacketInRateLimiter limiter(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 1 per_value: true rate_pps: 3 }
+  )pb"));
+
+  // A storm on port 1 does not affect port 2.
+  EXPECT_EQ(3, CountAllowed(&limiter, PacketIn("\x01", "\x01"), 100, start_));
+  EXPECT_EQ(3, CountAllowed(&limiter, PacketIn("\x02", "\x01"), 3, start_));
+}
+
+TEST_F(PacketInRateLimiterTest, EmptyValueDoesNotShareTheOverflowBucket) {
+  PacketInRateLimiter limiter(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 1 per_value: true rate_pps: 1 }
+  )pb"));
+
+  // The empty value gets a bucket of its own, and uses its only token.
+  EXPECT_EQ(1, CountAllowed(&limiter, PacketIn("", "\x01"), 2, start_));
+  // Use up the remaining buckets.
+  for (size_t i = 1; i < PacketInRateLimiter::kMaxBucketsPerRateLimit; ++i) {
+    const std::string port = {static_cast<char>(i >> 8 | 0x80),
+                              static_cast<char>(i & 0xff)};
+    ASSERT_EQ(1, CountAllowed(&limiter, PacketIn(port, "\x01"), 1, start_));
+  }
+  // The excess values share a new, full bucket.
+  EXPECT_EQ(1, CountAllowed(&limiter, PacketIn("\x01", "\x01"), 2, start_));
+  EXPECT_EQ(0, CountAllowed(&limiter, PacketIn("\x02", "\x01"), 1, start_));
+  EXPECT_EQ(0, CountAllowed(&limiter, PacketIn("", "\x01"), 1, start_));
+}
+
+TEST_F(PacketInRateLimiterTest, ValuesAreCanonicalized) {
+  PacketInRateLimiter limiter(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 1 values: "\x00\x01" rate_pps: 1 }
+  )pb"));
+
+  EXPECT_EQ(1, CountAllowed(&limiter, PacketIn("\x01", "\x01"), 10, start_));
+  // Other ports are not limited.
+  EXPECT_EQ(10, CountAllowed(&limiter, PacketIn("\x02", "\x01"), 10, start_));
+}
+
+TEST_F(PacketInRateLimiterTest, PacketValuesAreCanonicalized) {
+  PacketInRateLimiter limiter(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 1 values: "\x01" rate_pps: 1 }
+    packet_in_rate_limits { metadata_id: 2 per_value: true rate_pps: 1 }
+  )pb"));
+
+  // Port 1 with a leading zero byte matches the first rate limit.
+  EXPECT_EQ(1, CountAllowed(&limiter,
+                            PacketIn(std::string("\x00\x01", 2), "\x01"),
+                            10, start_));
+  // Both forms of reason 1 share one bucket.
+  EXPECT_EQ(1, CountAllowed(&limiter, PacketIn("\x02", "\x01"), 10, start_));
+  EXPECT_EQ(0, CountAllowed(&limiter,
+                            PacketIn("\x02", std::string("\x00\x01", 2)),
+                            10, start_));
+}
+
+TEST_F(PacketInRateLimiterTest, HasRateLimitsOf) {
+  const auto role_config = ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 1 values: "\x00\x01" rate_pps: 1 }
+  )pb");
+  PacketInRateLimiter limiter(role_config);
+
+  EXPECT_TRUE(limiter.HasRateLimitsOf(role_config));
+  EXPECT_TRUE(limiter.HasRateLimitsOf(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 1 values: "\x01" rate_pps: 1 }
+  )pb")));
+  EXPECT_FALSE(limiter.HasRateLimitsOf(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 1 values: "\x01" rate_pps: 2 }
+  )pb")));
+  EXPECT_FALSE(limiter.HasRateLimitsOf(P4RoleConfig{}));
+}
+
+TEST_F(PacketInRateLimiterTest, ZeroRateDropsEverything) {
+  PacketInRateLimiter limiter(ParseRoleConfig(R"pb(
+    packet_in_rate_limits { metadata_id: 2 rate_pps: 0 }
+  )pb"));
+
+  EXPECT_EQ(0, CountAllowed(&limiter, PacketIn("\x01", "\x01"), 10,
+                            start_ + absl::Hours(1)));
+}
+
+}  // namespace p4runtime
+}  // namespace stratum
@@ -5,21 +5,48 @@
 #include "stratum/lib/p4runtime/sdn_controller_manager.h"
 
 #include <algorithm>
+#include <utility>
 
 #include "absl/numeric/int128.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/hal/lib/p4/utils.h"
 
+DEFINE_int32(p4runtime_stream_max_queued_responses, 1024,
+             "Max number of StreamMessageResponses queued for a single "
+             "controller stream. Overflow is handled according to "
+             "--p4runtime_stream_queue_drop_policy.");
+DEFINE_string(p4runtime_stream_queue_drop_policy, "drop-oldest",
+              "What to do with a StreamMessageResponse sent to a controller "
+              "whose queue is full. One of 'drop-oldest' or 'drop-newest'.");
+DEFINE_int32(p4runtime_stream_drain_timeout_ms, 1000,
+             "Max time in milliseconds to wait for the queued "
+             "StreamMessageResponses of a closing controller stream to be "
+             "written. The stream is cancelled after that.");
+
 namespace stratum {
 namespace p4runtime {
 namespace {
 
+SdnConnection::DropPolicy DropPolicyFromFlag() {
+  if (FLAGS_p4runtime_stream_queue_drop_policy == "drop-newest") {
+    return SdnConnection::DropPolicy::kDropNewest;
+  }
+  LOG_IF(ERROR, FLAGS_p4runtime_stream_queue_drop_policy != "drop-oldest")
+      << "Invalid --p4runtime_stream_queue_drop_policy '"
+      << FLAGS_p4runtime_stream_queue_drop_policy
+      << "'. Using 'drop-oldest' instead.";
+  return SdnConnection::DropPolicy::kDropOldest;
+}
+
 std::string PrettyPrintRoleName(const absl::optional<std::string>& name) {
   return (name.has_value()) ? absl::StrCat("'", *name, "'") : "<default>";
 }
@@ -193,10 +220,12 @@ bool VerifyStreamMessageNotFiltered(
     case p4::v1::StreamMessageResponse::kPacket: {
       if (!role_config->receives_packet_ins()) return false;
       if (!role_config->has_packet_in_filter()) return true;
+      // The filter value is in canonical form, so is the compared value.
       for (const auto& metadata : response.packet().metadata()) {
         if (role_config->packet_in_filter().metadata_id() ==
                 metadata.metadata_id() &&
-            role_config->packet_in_filter().value() == metadata.value()) {
+            role_config->packet_in_filter().value() ==
+                hal::ByteStringToP4RuntimeByteString(metadata.value())) {
           return true;
         }
       }
@@ -303,6 +332,76 @@ grpc::Status VerifyRoleCanAccessIds(
 
 }  // namespace
 
+SdnConnection::SdnConnection(
+    grpc::ServerContext* context,
+    grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
+                                      p4::v1::StreamMessageRequest>* stream)
+    : SdnConnection(
+          context, stream,
+          std::max(FLAGS_p4runtime_stream_max_queued_responses, 1),
+          DropPolicyFromFlag()) {}
+
+SdnConnection::SdnConnection(
+    grpc::ServerContext* context,
+    grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
+                                      p4::v1::StreamMessageRequest>* stream,
+    size_t max_queue_size, DropPolicy drop_policy)
+    : initialized_(false),
+      grpc_context_(context),
+      grpc_stream_(stream),
+      max_queue_size_(std::max<size_t>(max_queue_size, 1)),
+      drop_policy_(drop_policy),
+      next_seq_(0),
+      shutdown_(false),
+      writer_done_(false),
+      writer_tid_(0) {
+  int ret = pthread_create(&writer_tid_, nullptr,
+                           &SdnConnection::WriterThreadFunc, this);
+  if (ret != 0) {
+    LOG(ERROR) << "Failed to spawn the writer thread of a controller stream. "
+               << "Err: " << ret << ". Writing the responses synchronously.";
+    writer_tid_ = 0;
+  }
+}
+
+SdnConnection::~SdnConnection() {
+  if (writer_tid_ != 0) {
+    bool drained;
+    {
+      absl::MutexLock l(&queue_lock_);
+      shutdown_ = true;
+      queue_not_empty_.Signal();
+      const absl::Time deadline =
+          absl::Now() +
+          absl::Milliseconds(FLAGS_p4runtime_stream_drain_timeout_ms);
+      while (!writer_done_) {
+        // WaitWithDeadline() returns true on timeout.
+        if (writer_done_cond_.WaitWithDeadline(&queue_lock_, deadline)) break;
+      }
+      drained = writer_done_;
+    }
+    if (!drained) {
+      // The writer is most likely blocked in a Write() to a controller which
+      // stopped reading. Cancelling the call makes the Write() fail, after
+      // which the remaining responses are discarded.
+      LOG(WARNING) << "Controller stream did not drain in "
+                   << FLAGS_p4runtime_stream_drain_timeout_ms
+                   << " ms. Cancelling it.";
+      grpc_context_->TryCancel();
+    }
+    int ret = pthread_join(writer_tid_, nullptr);
+    if (ret != 0) {
+      LOG(ERROR) << "Failed to join the writer thread of a controller stream "
+                 << "with error " << ret << ".";
+    }
+  }
+  OutboundQueueStats stats = GetOutboundQueueStats();
+  LOG_IF(WARNING, stats.dropped > 0 || stats.write_failures > 0)
+      << "Controller stream dropped " << stats.dropped << " and failed to "
+      << "write " << stats.write_failures << " of " << stats.enqueued
+      << " stream message responses.";
+}
+
 void SdnConnection::SetElectionId(const absl::optional<absl::uint128>& id) {
   election_id_ = id;
 }
@@ -327,11 +426,109 @@ std::string SdnConnection::GetName() const {
 
 void SdnConnection::SendStreamMessageResponse(
     const p4::v1::StreamMessageResponse& response) {
+  if (writer_tid_ == 0) {
+    {
+      absl::MutexLock l(&queue_lock_);
+      ++stats_.enqueued;
+    }
+    WriteResponse(response, grpc::WriteOptions());
+    return;
+  }
+  absl::MutexLock l(&queue_lock_);
+  if (queue_.size() + arbitration_queue_.size() >= max_queue_size_ &&
+      !response.has_arbitration()) {
+    // Arbitration updates are never dropped, as the controller relies on them
+    // to know its role. They are rare and may exceed the limit a little.
+    ++stats_.dropped;
+    if (drop_policy_ == DropPolicy::kDropNewest) {
+      LOG_EVERY_N(WARNING, 500)
+          << "Outbound queue of controller stream is full. Dropping the "
+          << "newest stream message response (" << stats_.dropped
+          << " dropped so far).";
+      return;
+    }
+    if (!queue_.empty()) queue_.pop_front();
+    LOG_EVERY_N(WARNING, 500)
+        << "Outbound queue of controller stream is full. Dropping the "
+        << "oldest stream message response (" << stats_.dropped
+        << " dropped so far).";
+  }
+  auto* queue = response.has_arbitration() ? &arbitration_queue_ : &queue_;
+  queue->push_back({next_seq_++, response});
+  ++stats_.enqueued;
+  queue_not_empty_.Signal();
+}
+
+SdnConnection::OutboundQueueStats SdnConnection::GetOutboundQueueStats()
+    const {
+  absl::MutexLock l(&queue_lock_);
+  return stats_;
+}
+
+void* SdnConnection::WriterThreadFunc(void* arg) {
+  SdnConnection* connection = static_cast<SdnConnection*>(arg);
+  connection->WriterLoop();
+  return nullptr;
+}
+
+void SdnConnection::WriterLoop() {
+  // Once a write fails the stream is broken for good, and the remaining
+  // responses are discarded.
+  bool stream_broken = false;
+  while (true) {
+    p4::v1::StreamMessageResponse response;
+    bool more_queued;
+    {
+      absl::MutexLock l(&queue_lock_);
+      while (queue_.empty() && arbitration_queue_.empty() && !shutdown_) {
+        queue_not_empty_.Wait(&queue_lock_);
+      }
+      // Shut down and everything written.
+      if (queue_.empty() && arbitration_queue_.empty()) {
+        writer_done_ = true;
+        writer_done_cond_.SignalAll();
+        break;
+      }
+      // Write the responses in the order they were queued.
+      auto* queue = &queue_;
+      if (queue_.empty() ||
+          (!arbitration_queue_.empty() &&
+           arbitration_queue_.front().seq < queue_.front().seq)) {
+        queue = &arbitration_queue_;
+      }
+      response.Swap(&queue->front().response);
+      queue->pop_front();
+      more_queued = !queue_.empty() || !arbitration_queue_.empty();
+    }
+    if (stream_broken) {
+      absl::MutexLock l(&queue_lock_);
+      ++stats_.write_failures;
+      continue;
+    }
+    // Let gRPC coalesce the writes of a burst. The last response of the
+    // burst is written without the hint, which flushes the stream.
+    grpc::WriteOptions options;
+    if (more_queued) options.set_buffer_hint();
+    stream_broken = !WriteResponse(response, options);
+  }
+}
+
+bool SdnConnection::WriteResponse(const p4::v1::StreamMessageResponse& response,
+                                  const grpc::WriteOptions& options) {
   VLOG(2) << "Sending response: " << response.ShortDebugString();
-  if (!grpc_stream_->Write(response)) {
+  bool success = grpc_stream_->Write(response, options);
+  if (!success) {
     LOG(ERROR) << "Could not send stream message response to gRPC context '"
                << grpc_context_ << "': " << response.ShortDebugString();
   }
+  absl::MutexLock l(&queue_lock_);
+  if (success) {
+    ++stats_.written;
+  } else {
+    ++stats_.write_failures;
+  }
+
+  return success;
 }
 
 grpc::Status SdnControllerManager::HandleArbitrationUpdate(
@@ -456,6 +653,19 @@ grpc::Status SdnControllerManager::HandleArbitrationUpdate(
     election_id_past_for_role = new_election_id_for_connection;
     // Update the configuration for this controllers role.
     role_config_by_name_[role_name] = role_config;
+    // The rate limiter is kept, with its state, unless its limits changed.
+    auto limiter = packet_in_rate_limiter_by_role_.find(role_name);
+    if (!role_config.has_value() ||
+        role_config->packet_in_rate_limits_size() == 0) {
+      if (limiter != packet_in_rate_limiter_by_role_.end()) {
+        packet_in_rate_limiter_by_role_.erase(limiter);
+      }
+    } else if (limiter == packet_in_rate_limiter_by_role_.end()) {
+      packet_in_rate_limiter_by_role_.emplace(
+          role_name, PacketInRateLimiter(*role_config));
+    } else if (!limiter->second.HasRateLimitsOf(*role_config)) {
+      limiter->second = PacketInRateLimiter(*role_config);
+    }
     // The spec demands we send a notifcation even if the old & new primary
     // match.
     InformConnectionsAboutPrimaryChange(role_name);
@@ -799,6 +1009,7 @@ absl::Status SdnControllerManager::SendPacketInToPrimary(
 
 absl::Status SdnControllerManager::SendStreamMessageToPrimary(
     const p4::v1::StreamMessageResponse& response) {
+  const absl::Time now = absl::Now();
   absl::MutexLock l(&lock_);
 
   bool found_at_least_one_primary = false;
@@ -810,12 +1021,37 @@ absl::Status SdnControllerManager::SendStreamMessageToPrimary(
         election_id_past_for_role == connection->GetElectionId()) {
       absl::optional<P4RoleConfig> role_config =
           role_config_by_name_[connection->GetRoleName()];
-      if (VerifyStreamMessageNotFiltered(role_config, response)) {
-        found_at_least_one_primary = true;
-        connection->SendStreamMessageResponse(response);
+      const bool is_packet_in =
+          response.update_case() == p4::v1::StreamMessageResponse::kPacket;
+      if (!VerifyStreamMessageNotFiltered(role_config, response)) {
+        // We don't report an error for packets getting filtered as this is
+        // expected operation.
+        if (is_packet_in) {
+          ++packet_in_stats_by_role_[connection->GetRoleName()]
+                .dropped_by_filter;
+        }
+        continue;
       }
-      // We don't report an error for packets getting filtered as this is
-      // expected operation.
+      found_at_least_one_primary = true;
+      if (is_packet_in) {
+        PacketInStats& stats =
+            packet_in_stats_by_role_[connection->GetRoleName()];
+        auto it = packet_in_rate_limiter_by_role_.find(
+            connection->GetRoleName());
+        if (it != packet_in_rate_limiter_by_role_.end() &&
+            !it->second.Allow(response.packet(), now)) {
+          // Neither is this an error, but the controller will miss packets.
+          ++stats.dropped_by_rate_limit;
+          VLOG_EVERY_N(1, 1000)
+              << "PacketIn for role "
+              << PrettyPrintRoleName(connection->GetRoleName())
+              << " dropped by rate limit (" << stats.dropped_by_rate_limit
+              << " dropped so far).";
+          continue;
+        }
+        ++stats.sent;
+      }
+      connection->SendStreamMessageResponse(response);
     }
   }
 
@@ -829,5 +1065,13 @@ absl::Status SdnControllerManager::SendStreamMessageToPrimary(
   return absl::OkStatus();
 }
 
+SdnControllerManager::PacketInStats SdnControllerManager::GetPacketInStats(
+    const absl::optional<std::string>& role_name) const {
+  absl::MutexLock l(&lock_);
+  auto it = packet_in_stats_by_role_.find(role_name);
+  if (it == packet_in_stats_by_role_.end()) return PacketInStats();
+  return it->second;
+}
+
 }  // namespace p4runtime
 }  // namespace stratum
@@ -5,6 +5,11 @@
 #ifndef STRATUM_LIB_P4RUNTIME_SDN_CONTROLLER_MANAGER_H_
 #define STRATUM_LIB_P4RUNTIME_SDN_CONTROLLER_MANAGER_H_
 
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -12,8 +17,10 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/numeric/int128.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
+#include "stratum/lib/p4runtime/packet_in_rate_limiter.h"
 #include "stratum/public/proto/p4_role_config.pb.h"
 
 namespace stratum {
@@ -23,13 +30,47 @@ namespace p4runtime {
 constexpr char kP4RuntimeRoleSdnController[] = "sdn_controller";
 
 // A connection between a controller and p4rt server.
+//
+// Responses are not written to the gRPC stream by the caller. They are put
+// into a bounded outbound queue, which is drained by a writer thread owned by
+// the connection. A slow or stalled controller therefore never blocks the
+// sender, e.g. the PacketIn RX path, and only ever loses its own messages when
+// its queue overflows.
 class SdnConnection {
  public:
+  // What to do with a response sent while the outbound queue is full.
+  enum class DropPolicy {
+    kDropOldest,  // Drop the oldest queued response to make room.
+    kDropNewest,  // Drop the response being sent.
+  };
+
+  // Counters of the outbound queue.
+  struct OutboundQueueStats {
+    uint64_t enqueued = 0;        // Responses accepted into the queue.
+    uint64_t written = 0;         // Responses written to the stream.
+    uint64_t dropped = 0;         // Responses dropped due to overflow.
+    uint64_t write_failures = 0;  // Responses the stream failed to write.
+  };
+
+  // Uses the queue size and drop policy given by the
+  // --p4runtime_stream_max_queued_responses and
+  // --p4runtime_stream_queue_drop_policy flags.
+  SdnConnection(
+      grpc::ServerContext* context,
+      grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
+                                        p4::v1::StreamMessageRequest>* stream);
   SdnConnection(
       grpc::ServerContext* context,
       grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
-                                        p4::v1::StreamMessageRequest>* stream)
-      : initialized_(false), grpc_context_(context), grpc_stream_(stream) {}
+                                        p4::v1::StreamMessageRequest>* stream,
+      size_t max_queue_size, DropPolicy drop_policy);
+
+  // Writes the responses still queued and stops the writer thread. If the
+  // queue is not drained within --p4runtime_stream_drain_timeout_ms, e.g.
+  // because the controller stopped reading, the call is cancelled and the
+  // remaining responses are discarded. The gRPC stream is not used anymore
+  // once the destructor returns.
+  ~SdnConnection() ABSL_LOCKS_EXCLUDED(queue_lock_);
 
   void Initialize() { initialized_ = true; }
   bool IsInitialized() const { return initialized_; }
@@ -43,10 +84,33 @@ class SdnConnection {
   // A unique name string for the controller.
   std::string GetName() const;
 
-  // Sends back StreamMessageResponse to this controller.
-  void SendStreamMessageResponse(const p4::v1::StreamMessageResponse& response);
+  // Queues a StreamMessageResponse to be sent back to this controller. Never
+  // blocks on the gRPC stream.
+  void SendStreamMessageResponse(const p4::v1::StreamMessageResponse& response)
+      ABSL_LOCKS_EXCLUDED(queue_lock_);
+
+  // Returns the counters of the outbound queue.
+  OutboundQueueStats GetOutboundQueueStats() const
+      ABSL_LOCKS_EXCLUDED(queue_lock_);
+
+  // SdnConnection is neither copyable nor movable.
+  SdnConnection(const SdnConnection&) = delete;
+  SdnConnection& operator=(const SdnConnection&) = delete;
 
  private:
+  // Thread function for the writer thread.
+  static void* WriterThreadFunc(void* arg);
+
+  // Writes the queued responses to the gRPC stream until the connection is
+  // destroyed.
+  void WriterLoop() ABSL_LOCKS_EXCLUDED(queue_lock_);
+
+  // Writes a response to the gRPC stream and updates the counters. Returns
+  // false if the write failed.
+  bool WriteResponse(const p4::v1::StreamMessageResponse& response,
+                     const grpc::WriteOptions& options)
+      ABSL_LOCKS_EXCLUDED(queue_lock_);
+
   // The SDN connection should be initialized through arbitration before it can
   // be used.
   bool initialized_;
@@ -68,10 +132,58 @@ class SdnConnection {
   grpc::ServerReaderWriterInterface<p4::v1::StreamMessageResponse,
                                     p4::v1::StreamMessageRequest>*
       grpc_stream_;  // not owned.
+
+  // Max number of queued responses and what to do when it is exceeded.
+  const size_t max_queue_size_;
+  const DropPolicy drop_policy_;
+
+  // Lock for protecting the outbound queue.
+  mutable absl::Mutex queue_lock_;
+
+  // Signaled when a response is queued or the connection is shutting down.
+  absl::CondVar queue_not_empty_;
+
+  // A queued response, with its position in the order of the queued responses.
+  struct QueuedResponse {
+    uint64_t seq;
+    p4::v1::StreamMessageResponse response;
+  };
+
+  // Responses waiting to be written by the writer thread, in order of seq.
+  // Arbitration updates are never dropped and are queued apart, so that the
+  // oldest droppable response is always at the front of queue_.
+  std::deque<QueuedResponse> queue_ ABSL_GUARDED_BY(queue_lock_);
+  std::deque<QueuedResponse> arbitration_queue_ ABSL_GUARDED_BY(queue_lock_);
+
+  // The seq of the next queued response.
+  uint64_t next_seq_ ABSL_GUARDED_BY(queue_lock_);
+
+  // Set when the connection is destroyed.
+  bool shutdown_ ABSL_GUARDED_BY(queue_lock_);
+
+  // Set by the writer thread when it is done writing, and signaled through
+  // writer_done_cond_.
+  bool writer_done_ ABSL_GUARDED_BY(queue_lock_);
+  absl::CondVar writer_done_cond_;
+
+  OutboundQueueStats stats_ ABSL_GUARDED_BY(queue_lock_);
+
+  // The thread writing the queued responses. The only user of grpc_stream_
+  // for writing, as gRPC streams do not support concurrent writes. 0 if the
+  // thread could not be spawned, in which case the responses are written
+  // synchronously by SendStreamMessageResponse().
+  pthread_t writer_tid_;
 };
 
 class SdnControllerManager {
  public:
+  // Counters of the PacketIns sent to the primary connection of a role.
+  struct PacketInStats {
+    uint64_t sent = 0;                   // PacketIns sent.
+    uint64_t dropped_by_filter = 0;      // Dropped by the packet_in_filter.
+    uint64_t dropped_by_rate_limit = 0;  // Dropped by packet_in_rate_limits.
+  };
+
   explicit SdnControllerManager(uint64_t device_id) : device_id_(device_id) {}
 
   grpc::Status HandleArbitrationUpdate(
@@ -105,6 +217,11 @@ class SdnControllerManager {
   absl::Status SendStreamMessageToPrimary(
       const p4::v1::StreamMessageResponse& response) ABSL_LOCKS_EXCLUDED(lock_);
 
+  // Returns the PacketIn counters of the given role.
+  PacketInStats GetPacketInStats(
+      const absl::optional<std::string>& role_name) const
+      ABSL_LOCKS_EXCLUDED(lock_);
+
  private:
   SdnControllerManager() : device_id_(0) {}
 
@@ -169,6 +286,22 @@ class SdnControllerManager {
   absl::flat_hash_map<absl::optional<std::string>,
                       absl::optional<absl::uint128>>
       election_id_past_by_role_ ABSL_GUARDED_BY(lock_);
+
+  // We maintain a map of the PacketIn rate limiters of the roles which have
+  // packet_in_rate_limits in their role config. Rebuilt, and thus reset, only
+  // when the role config sets different rate limits.
+  //
+  // key:   role_name (no value indicates the default/root role)
+  // value: rate limiter
+  absl::flat_hash_map<absl::optional<std::string>, PacketInRateLimiter>
+      packet_in_rate_limiter_by_role_ ABSL_GUARDED_BY(lock_);
+
+  // We maintain a map of the PacketIn counters of each role.
+  //
+  // key:   role_name (no value indicates the default/root role)
+  // value: PacketIn counters
+  absl::flat_hash_map<absl::optional<std::string>, PacketInStats>
+      packet_in_stats_by_role_ ABSL_GUARDED_BY(lock_);
 };
 
 }  // namespace p4runtime
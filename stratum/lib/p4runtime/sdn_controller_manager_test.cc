@@ -0,0 +1,261 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/p4runtime/sdn_controller_manager.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/lib/p4runtime/stream_message_reader_writer_mock.h"
+
+namespace stratum {
+namespace p4runtime {
+
+using ::testing::_;
+using ::testing::Invoke;
+
+class SdnConnectionTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Record the written packets. The first write blocks until released, to
+    // simulate a stalled controller.
+    EXPECT_CALL(stream_, Write(_, _))
+        .WillRepeatedly(Invoke([this](const p4::v1::StreamMessageResponse& r,
+                                      grpc::WriteOptions options) {
+          if (!first_write_started_.HasBeenNotified()) {
+            first_write_started_.Notify();
+          }
+          release_writes_.WaitForNotification();
+          absl::MutexLock l(&lock_);
+          written_.push_back(r.packet().payload());
+          return true;
+        }));
+  }
+
+  static p4::v1::StreamMessageResponse Packet(const std::string& payload) {
+    p4::v1::StreamMessageResponse response;
+    response.mutable_packet()->set_payload(payload);
+    return response;
+  }
+
+  std::vector<std::string> Written() {
+    absl::MutexLock l(&lock_);
+    return written_;
+  }
+
+  grpc::ServerContext context_;
+  StreamMessageReaderWriterMock stream_;
+  absl::Notification first_write_started_;
+  absl::Notification release_writes_;
+  absl::Mutex lock_;
+  std::vector<std::string> written_ ABSL_GUARDED_BY(lock_);
+};
+
+TEST_F(SdnConnectionTest, ResponsesAreWrittenInOrder) {
+  release_writes_.Notify();
+  auto connection = absl::make_unique<SdnConnection>(
+      &context_, &stream_, 8, SdnConnection::DropPolicy::kDropOldest);
+  connection->SendStreamMessageResponse(Packet("a"));
+  connection->SendStreamMessageResponse(Packet("b"));
+  connection->SendStreamMessageResponse(Packet("c"));
+  // Destroying the connection writes the queued responses.
+  auto stats_before = connection->GetOutboundQueueStats();
+  connection.reset();
+
+  EXPECT_EQ(3U, stats_before.enqueued);
+  EXPECT_THAT(Written(), ::testing::ElementsAre("a", "b", "c"));
+}
+
+TEST_F(SdnConnectionTest, DropOldestWhenQueueIsFull) {
+  auto connection = absl::make_unique<SdnConnection>(
+      &context_, &stream_, 2, SdnConnection::DropPolicy::kDropOldest);
+  // "a" is taken by the writer, which then blocks on the stream.
+  connection->SendStreamMessageResponse(Packet("a"));
+  first_write_started_.WaitForNotification();
+  // Sending never blocks on the stalled stream.
+  connection->SendStreamMessageResponse(Packet("b"));
+  connection->SendStreamMessageResponse(Packet("c"));
+  connection->SendStreamMessageResponse(Packet("d"));
+  SdnConnection::OutboundQueueStats stats =
+      connection->GetOutboundQueueStats();
+  EXPECT_EQ(4U, stats.enqueued);
+  EXPECT_EQ(1U, stats.dropped);
+
+  release_writes_.Notify();
+  connection.reset();
+  EXPECT_THAT(Written(), ::testing::ElementsAre("a", "c", "d"));
+}
+
+TEST_F(SdnConnectionTest, DropNewestWhenQueueIsFull) {
+  auto connection = absl::make_unique<SdnConnection>(
+      &context_, &stream_, 2, SdnConnection::DropPolicy::kDropNewest);
+  connection->SendStreamMessageResponse(Packet("a"));
+  first_write_started_.WaitForNotification();
+  connection->SendStreamMessageResponse(Packet("b"));
+  connection->SendStreamMessageResponse(Packet("c"));
+  connection->SendStreamMessageResponse(Packet("d"));
+  SdnConnection::OutboundQueueStats stats =
+      connection->GetOutboundQueueStats();
+  EXPECT_EQ(3U, stats.enqueued);
+  EXPECT_EQ(1U, stats.dropped);
+
+  release_writes_.Notify();
+  connection.reset();
+  EXPECT_THAT(Written(), ::testing::ElementsAre("a", "b", "c"));
+}
+
+TEST_F(SdnConnectionTest, ArbitrationUpdatesAreNeverDropped) {
+  auto connection = absl::make_unique<SdnConnection>(
+      &context_, &stream_, 1, SdnConnection::DropPolicy::kDropNewest);
+  connection->SendStreamMessageResponse(Packet("a"));
+  first_write_started_.WaitForNotification();
+  connection->SendStreamMessageResponse(Packet("b"));
+  p4::v1::StreamMessageResponse arbitration;
+  arbitration.mutable_arbitration()->set_device_id(1);
+  connection->SendStreamMessageResponse(arbitration);
+
+  release_writes_.Notify();
+  connection.reset();
+  // The arbitration update has no packet payload.
+  EXPECT_THAT(Written(), ::testing::ElementsAre("a", "b", ""));
+}
+
+TEST_F(SdnConnectionTest, DropOldestSkipsQueuedArbitrationUpdates) {
+  auto connection = absl::make_unique<SdnConnection>(
+      &context_, &stream_, 2, SdnConnection::DropPolicy::kDropOldest);
+  connection->SendStreamMessageResponse(Packet("a"));
+  first_write_started_.WaitForNotification();
+  p4::v1::StreamMessageResponse arbitration;
+  arbitration.mutable_arbitration()->set_device_id(1);
+  connection->SendStreamMessageResponse(arbitration);
+  connection->SendStreamMessageResponse(Packet("b"));
+  connection->SendStreamMessageResponse(Packet("c"));
+  EXPECT_EQ(1U, connection->GetOutboundQueueStats().dropped);
+
+  release_writes_.Notify();
+  connection.reset();
+  // "b" is dropped, the arbitration update stays in its place.
+  EXPECT_THAT(Written(), ::testing::ElementsAre("a", "", "c"));
+}
+
+TEST_F(SdnConnectionTest, WriteFailureDiscardsRemainingResponses) {
+  ::testing::Mock::VerifyAndClearExpectations(&stream_);
+  // Only the first response is written to the broken stream.
+  EXPECT_CALL(stream_, Write(_, _)).WillOnce(::testing::Return(false));
+  auto connection = absl::make_unique<SdnConnection>(
+      &context_, &stream_, 8, SdnConnection::DropPolicy::kDropOldest);
+  connection->SendStreamMessageResponse(Packet("a"));
+  connection->SendStreamMessageResponse(Packet("b"));
+  connection.reset();
+}
+
+TEST(SdnControllerManagerTest, PacketInsAreRateLimitedPerRole) {
+  grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  SdnConnection connection(&context, &stream);
+  SdnControllerManager manager(/*device_id=*/1);
+
+  p4::v1::MasterArbitrationUpdate update;
+  update.set_device_id(1);
+  update.mutable_election_id()->set_low(1);
+  update.mutable_role()->set_name("r");
+  P4RoleConfig role_config;
+  role_config.set_receives_packet_ins(true);
+  role_config.add_packet_in_rate_limits()->set_rate_pps(3);
+  update.mutable_role()->mutable_config()->PackFrom(role_config);
+  ASSERT_TRUE(manager.HandleArbitrationUpdate(update, &connection).ok());
+
+  p4::v1::StreamMessageResponse packet_in;
+  packet_in.mutable_packet()->set_payload("a");
+  for (int i = 0; i < 10; ++i) {
+    // Dropped PacketIns are not an error.
+    EXPECT_TRUE(manager.SendPacketInToPrimary(packet_in).ok());
+  }
+
+  SdnControllerManager::PacketInStats stats = manager.GetPacketInStats("r");
+  EXPECT_EQ(3U, stats.sent);
+  EXPECT_EQ(7U, stats.dropped_by_rate_limit);
+  EXPECT_EQ(0U, stats.dropped_by_filter);
+  EXPECT_EQ(0U, manager.GetPacketInStats(absl::nullopt).sent);
+}
+
+TEST(SdnControllerManagerTest, RateLimiterIsKeptAcrossArbitrationUpdates) {
+  grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  SdnConnection connection(&context, &stream);
+  SdnControllerManager manager(/*device_id=*/1);
+
+  p4::v1::MasterArbitrationUpdate update;
+  update.set_device_id(1);
+  update.mutable_election_id()->set_low(1);
+  update.mutable_role()->set_name("r");
+  P4RoleConfig role_config;
+  role_config.set_receives_packet_ins(true);
+  auto* rate_limit = role_config.add_packet_in_rate_limits();
+  rate_limit->set_rate_pps(1);
+  rate_limit->set_burst_size(3);
+  update.mutable_role()->mutable_config()->PackFrom(role_config);
+  ASSERT_TRUE(manager.HandleArbitrationUpdate(update, &connection).ok());
+
+  p4::v1::StreamMessageResponse packet_in;
+  packet_in.mutable_packet()->set_payload("a");
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(manager.SendPacketInToPrimary(packet_in).ok());
+  }
+  // The same role config again does not refill the bucket.
+  ASSERT_TRUE(manager.HandleArbitrationUpdate(update, &connection).ok());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(manager.SendPacketInToPrimary(packet_in).ok());
+  }
+  EXPECT_EQ(3U, manager.GetPacketInStats("r").sent);
+
+  // New rate limits start from a full bucket.
+  rate_limit->set_burst_size(2);
+  update.mutable_role()->mutable_config()->PackFrom(role_config);
+  ASSERT_TRUE(manager.HandleArbitrationUpdate(update, &connection).ok());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(manager.SendPacketInToPrimary(packet_in).ok());
+  }
+  EXPECT_EQ(5U, manager.GetPacketInStats("r").sent);
+}
+
+TEST(SdnControllerManagerTest, PacketInFilterComparesCanonicalValues) {
+  grpc::ServerContext context;
+  StreamMessageReaderWriterMock stream;
+  SdnConnection connection(&context, &stream);
+  SdnControllerManager manager(/*device_id=*/1);
+
+  p4::v1::MasterArbitrationUpdate update;
+  update.set_device_id(1);
+  update.mutable_election_id()->set_low(1);
+  update.mutable_role()->set_name("r");
+  P4RoleConfig role_config;
+  role_config.set_receives_packet_ins(true);
+  role_config.mutable_packet_in_filter()->set_metadata_id(1);
+  role_config.mutable_packet_in_filter()->set_value("\x01");
+  update.mutable_role()->mutable_config()->PackFrom(role_config);
+  ASSERT_TRUE(manager.HandleArbitrationUpdate(update, &connection).ok());
+
+  // The PacketIn metadata value has a leading zero byte.
+  p4::v1::StreamMessageResponse packet_in;
+  auto* metadata = packet_in.mutable_packet()->add_metadata();
+  metadata->set_metadata_id(1);
+  metadata->set_value(std::string("\x00\x01", 2));
+  EXPECT_TRUE(manager.SendPacketInToPrimary(packet_in).ok());
+  // A filtered PacketIn reaches no primary.
+  metadata->set_value("\x02");
+  EXPECT_FALSE(manager.SendPacketInToPrimary(packet_in).ok());
+
+  SdnControllerManager::PacketInStats stats = manager.GetPacketInStats("r");
+  EXPECT_EQ(1U, stats.sent);
+  EXPECT_EQ(1U, stats.dropped_by_filter);
+}
+
+}  // namespace p4runtime
+}  // namespace stratum